@@ -0,0 +1,1279 @@
+/*
+ * unikit_bench.c
+ * ==============
+ * 
+ * Repeatable benchmarks of Unikit's lookup functions.
+ * 
+ * Syntax
+ * ------
+ * 
+ *   unikit_bench
+ *   unikit_bench tiers
+ *   unikit_bench fold
+ *   unikit_bench corpus
+ *   unikit_bench par
+ *   unikit_bench all 9
+ * 
+ * The optional first argument selects a group of benchmarks, or "all"
+ * to run every group, which is the default.  The optional second
+ * argument is the number of timed repetitions of each benchmark, in
+ * range 1 to 999, which defaults to 5.
+ * 
+ * Description
+ * -----------
+ * 
+ * The "tiers" group times unikit_category() on codepoints that are
+ * answered by each of the lookup tiers of the library: the core table
+ * for U+0000 to U+00FF, the character bitmap for Lo, Ll, and So in
+ * U+0100 to U+1FFFF, the general character tables for the other
+ * assigned categories in that range, the remainder for surrogates,
+ * private use, and unassigned codepoints in that range, and the astral
+ * table beyond U+1FFFF.  In the UNIKIT_UNIFIED_GCAT build mode, the
+ * bitmap, general, and remainder tiers all use the unified table, but
+ * they are still reported separately.
+ * 
+ * The "fold" group times unikit_fold() on the valid codepoints of the
+ * lower plane U+0000 to U+FFFF and the upper plane U+10000 to U+1FFFF.
+ * 
+ * The "corpus" group generates synthetic text for a set of scripts and
+ * times unikit_category(), unikit_category_inline() of the
+ * unikit_inline.h header, unikit_category_buf(),
+ * unikit_category_utf8(), and unikit_fold_utf8() over the whole text,
+ * along with unikit_category() followed by unikit_fold() for each
+ * codepoint against the single lookup of unikit_props().  The same
+ * text is also classified and case folded in UTF-16 and UTF-32.
+ * It also times unikit_decode_category() fed with chunks of CHUNK_LEN
+ * bytes, as text arriving from a socket would be.  Finally, the text
+ * is searched without regard to case with unikit_casefind_utf8() for a
+ * needle that it does not contain.
+ * 
+ * The "par" group times unikit_category_utf8_par() and
+ * unikit_fold_utf8_par() over the ascii and cyrillic corpora, split
+ * into chunks of PAR_CHUNK_LEN bytes, with a simple thread pool of one
+ * thread and then of twice as many threads each time, up to the number
+ * of online processors.  The "all" group does not include "par".
+ * 
+ * Every benchmark input has exactly BENCH_LEN codepoints, drawn from a
+ * fixed pseudo-random sequence, so that runs are repeatable and results
+ * are comparable between builds.  Each benchmark is run once untimed to
+ * warm up, and then the fastest of the timed repetitions is reported.
+ * 
+ * Each result line gives the nanoseconds per codepoint, followed by the
+ * CPU cycles per codepoint and the cache misses per thousand
+ * codepoints.  Cycles and cache misses are read from the Linux
+ * perf_event interface.  When that interface is not available, such as
+ * on other platforms or when perf events are disabled, these columns
+ * are printed as a dash.
+ * 
+ * Requirements
+ * ------------
+ * 
+ * Requires the unikit library, which consists of the unikit.c and
+ * unikit_data.c modules.
+ * 
+ * Requires the diagnostic.c module, which is contained within the test
+ * directory.
+ * 
+ * Requires a POSIX platform for clock_gettime() and POSIX threads.
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#else
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "diagnostic.h"
+#include "unikit.h"
+#include "unikit_inline.h"
+
+/*
+ * Diagnostics
+ * ===========
+ */
+
+static void raiseErr(int lnum, const char *pDetail, ...) {
+  va_list ap;
+  va_start(ap, pDetail);
+  diagnostic_global(1, __FILE__, lnum, pDetail, ap);
+  va_end(ap);
+}
+
+/*
+ * Constants
+ * =========
+ */
+
+/*
+ * The number of codepoints in every benchmark input.
+ */
+#define BENCH_LEN (INT32_C(1) << 20)
+
+/*
+ * The chunk size in bytes used by the streaming decoder kernel.
+ */
+#define CHUNK_LEN (4096)
+
+/*
+ * The chunk size in bytes used by the parallel kernels.
+ */
+#define PAR_CHUNK_LEN (65536)
+
+/*
+ * The needle of the case-insensitive search benchmark, which does not
+ * occur in any corpus, so that each search scans the whole text.
+ */
+#define FIND_NEEDLE "Unikit\xc3\x9f"
+
+/*
+ * The default and maximum number of timed repetitions.
+ */
+#define DEFAULT_REPS (5)
+#define MAX_REPS (999)
+
+/*
+ * The maximum number of weighted ranges in a corpus definition.
+ */
+#define MAX_RANGES (8)
+
+/*
+ * Type declarations
+ * =================
+ */
+
+/*
+ * A weighted range of codepoints used to generate a synthetic corpus.
+ */
+typedef struct {
+  int32_t lo;
+  int32_t hi;
+  int weight;
+} CPRANGE;
+
+/*
+ * A synthetic corpus definition.
+ * 
+ * The ranges array ends with a record that has a weight of zero.
+ */
+typedef struct {
+  const char *pName;
+  CPRANGE ranges[MAX_RANGES];
+} CORPUS;
+
+/*
+ * The input of a benchmark kernel.
+ * 
+ * pCps is an array of BENCH_LEN codepoints, which is also the text in
+ * UTF-32.  pUtf8 is the same text encoded in UTF-8, which is utf8_len
+ * bytes long, and pUtf16 is the same text encoded in UTF-16, which is
+ * utf16_len units long.  pCat and pFold are output buffers large
+ * enough for any kernel.
+ */
+typedef struct {
+  int32_t *pCps;
+  uint8_t *pUtf8;
+  size_t utf8_len;
+  uint16_t *pUtf16;
+  size_t utf16_len;
+  uint16_t *pCat;
+  uint8_t *pFold;
+  size_t fold_cap;
+} BENCH_INPUT;
+
+/*
+ * A benchmark kernel, which performs one full pass over the input.
+ */
+typedef void (*fp_kernel)(const BENCH_INPUT *pIn);
+
+/*
+ * The shared state of the threads of one executor call.
+ * 
+ * next is the index of the next chunk to hand out, which may only be
+ * accessed while holding the lock.
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  unikit_fp_job fpJob;
+  void *pJob;
+  size_t count;
+  size_t next;
+} PAR_POOL;
+
+/*
+ * Local data
+ * ==========
+ */
+
+/*
+ * The synthetic corpora.
+ */
+static const CORPUS m_corpora[] = {
+  {"ascii", {
+    {0x0020, 0x007e, 95},
+    {0x000a, 0x000a, 5},
+    {0, 0, 0}}},
+  {"latin1", {
+    {0x0020, 0x007e, 85},
+    {0x00c0, 0x00ff, 15},
+    {0, 0, 0}}},
+  {"cyrillic", {
+    {0x0020, 0x0040, 15},
+    {0x0410, 0x044f, 85},
+    {0, 0, 0}}},
+  {"cjk-bmp", {
+    {0x3000, 0x3002, 5},
+    {0x4e00, 0x9fff, 95},
+    {0, 0, 0}}},
+  {"cjk-ext-b", {
+    {0x3000, 0x3002, 5},
+    {0x20000, 0x2a6df, 95},
+    {0, 0, 0}}},
+  {"emoji", {
+    {0x0020, 0x0020, 20},
+    {0x1f300, 0x1f5ff, 40},
+    {0x1f600, 0x1f64f, 30},
+    {0x200d, 0x200d, 5},
+    {0xfe0f, 0xfe0f, 5},
+    {0, 0, 0}}},
+  {NULL, {{0, 0, 0}}}
+};
+
+/*
+ * The state of the pseudo-random number generator.
+ */
+static uint32_t m_seed = 0;
+
+/*
+ * Results are accumulated here so that the compiler can not remove the
+ * benchmark loops.
+ */
+static volatile uint32_t m_sink = 0;
+
+/*
+ * File descriptors of the cycle and cache miss performance counters,
+ * or -1 if not available.
+ */
+static int m_fd_cycles = -1;
+static int m_fd_misses = -1;
+
+/*
+ * The number of threads used by the parallel kernels.
+ */
+static int m_par_threads = 1;
+
+/*
+ * The compiled FIND_NEEDLE search of the corpus benchmarks.
+ */
+static UNIKIT_CASEFIND *m_find = NULL;
+
+/*
+ * Local functions
+ * ===============
+ */
+
+/* Prototypes */
+static void unikit_err(int lnum, const char *pDetail);
+
+static void seedRandom(uint32_t seed);
+static uint32_t nextRandom(void);
+static int encodeUtf8(int32_t cv, uint8_t *pBuf);
+static int encodeUtf16(int32_t cv, uint16_t *pBuf);
+
+static double getTime(void);
+static int openCounter(int which);
+static void startCounters(void);
+static void stopCounters(int64_t *pCycles, int64_t *pMisses);
+
+static void kCategory(const BENCH_INPUT *pIn);
+static void kCategoryInline(const BENCH_INPUT *pIn);
+static void kCategoryBuf(const BENCH_INPUT *pIn);
+static void kCategoryUtf8(const BENCH_INPUT *pIn);
+static void kDecodeCategory(const BENCH_INPUT *pIn);
+static void kFold(const BENCH_INPUT *pIn);
+static void kCategoryFold(const BENCH_INPUT *pIn);
+static void kProps(const BENCH_INPUT *pIn);
+static void kFoldUtf8(const BENCH_INPUT *pIn);
+static void kCategoryUtf16(const BENCH_INPUT *pIn);
+static void kFoldUtf16(const BENCH_INPUT *pIn);
+static void kCategoryUtf32(const BENCH_INPUT *pIn);
+static void kFoldUtf32(const BENCH_INPUT *pIn);
+static void kCasefind(const BENCH_INPUT *pIn);
+static void *parWorker(void *pArg);
+static void parExecutor(void *pCustom, unikit_fp_job fpJob, void *pJob,
+                          size_t count);
+static void kCategoryPar(const BENCH_INPUT *pIn);
+static void kFoldPar(const BENCH_INPUT *pIn);
+
+static void finishInput(BENCH_INPUT *pIn);
+static void fillFromSet(BENCH_INPUT *pIn, const int32_t *pSet,
+                          int32_t set_len);
+static void fillFromCorpus(BENCH_INPUT *pIn, const CORPUS *pCorpus);
+static void runBench(const char *pName, fp_kernel kernel,
+                      const BENCH_INPUT *pIn, int reps);
+
+static void benchTiers(BENCH_INPUT *pIn, int reps);
+static void benchFold(BENCH_INPUT *pIn, int reps);
+static void benchCorpus(BENCH_INPUT *pIn, int reps);
+static void benchPar(BENCH_INPUT *pIn, int reps);
+
+/*
+ * Custom error handler for Unikit library.
+ */
+static void unikit_err(int lnum, const char *pDetail) {
+  if (pDetail != NULL) {
+    raiseErr(__LINE__, "[Unikit error, line %d] %s",
+              lnum, pDetail);
+  } else {
+    raiseErr(__LINE__, "[Unikit error, line %d] Error", lnum);
+  }
+}
+
+/*
+ * Reset the pseudo-random number generator to a given seed.
+ * 
+ * Parameters:
+ * 
+ *   seed - the new seed
+ */
+static void seedRandom(uint32_t seed) {
+  m_seed = seed;
+}
+
+/*
+ * Get the next value from the pseudo-random number generator.
+ * 
+ * This is a 32-bit xorshift generator, which is the same on every
+ * platform so that benchmark inputs are repeatable.
+ * 
+ * Return:
+ * 
+ *   the next pseudo-random value
+ */
+static uint32_t nextRandom(void) {
+  if (m_seed == 0) {
+    m_seed = UINT32_C(0x9e3779b9);
+  }
+  m_seed ^= m_seed << 13;
+  m_seed ^= m_seed >> 17;
+  m_seed ^= m_seed << 5;
+  return m_seed;
+}
+
+/*
+ * Encode a codepoint in UTF-8.
+ * 
+ * cv must be in range 0 to 0x10FFFF.  Surrogates are encoded like any
+ * other value, which gives ill-formed UTF-8 that the library replaces.
+ * pBuf must have room for at least four bytes.
+ * 
+ * Parameters:
+ * 
+ *   cv - the codepoint to encode
+ * 
+ *   pBuf - the buffer to receive the encoded bytes
+ * 
+ * Return:
+ * 
+ *   the number of bytes written, in range 1 to 4
+ */
+static int encodeUtf8(int32_t cv, uint8_t *pBuf) {
+  if (cv < 0x80) {
+    pBuf[0] = (uint8_t) cv;
+    return 1;
+
+  } else if (cv < 0x800) {
+    pBuf[0] = (uint8_t) (0xc0 | (cv >> 6));
+    pBuf[1] = (uint8_t) (0x80 | (cv & 0x3f));
+    return 2;
+
+  } else if (cv < 0x10000) {
+    pBuf[0] = (uint8_t) (0xe0 | (cv >> 12));
+    pBuf[1] = (uint8_t) (0x80 | ((cv >> 6) & 0x3f));
+    pBuf[2] = (uint8_t) (0x80 | (cv & 0x3f));
+    return 3;
+  }
+
+  pBuf[0] = (uint8_t) (0xf0 | (cv >> 18));
+  pBuf[1] = (uint8_t) (0x80 | ((cv >> 12) & 0x3f));
+  pBuf[2] = (uint8_t) (0x80 | ((cv >> 6) & 0x3f));
+  pBuf[3] = (uint8_t) (0x80 | (cv & 0x3f));
+  return 4;
+}
+
+/*
+ * Encode a codepoint in UTF-16 code units of the native byte order.
+ * 
+ * cv must be in range 0 to 0x10FFFF.  Surrogates are encoded as single
+ * units, which gives unpaired surrogates that the library replaces.
+ * pBuf must have room for at least two units.
+ * 
+ * Parameters:
+ * 
+ *   cv - the codepoint to encode
+ * 
+ *   pBuf - the buffer to receive the encoded units
+ * 
+ * Return:
+ * 
+ *   the number of units written, either 1 or 2
+ */
+static int encodeUtf16(int32_t cv, uint16_t *pBuf) {
+  if (cv < 0x10000) {
+    pBuf[0] = (uint16_t) cv;
+    return 1;
+  }
+
+  pBuf[0] = (uint16_t) (0xd800 + ((cv - 0x10000) >> 10));
+  pBuf[1] = (uint16_t) (0xdc00 + ((cv - 0x10000) & 0x3ff));
+  return 2;
+}
+
+/*
+ * Get a monotonic time in seconds.
+ * 
+ * Return:
+ * 
+ *   the current time in seconds
+ */
+static double getTime(void) {
+
+  struct timespec ts;
+
+  memset(&ts, 0, sizeof(struct timespec));
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+    raiseErr(__LINE__, "Failed to read clock");
+  }
+
+  return ((double) ts.tv_sec) + (((double) ts.tv_nsec) * 1.0e-9);
+}
+
+/*
+ * Open a hardware performance counter for the calling thread.
+ * 
+ * The counter is opened disabled, counting only user space.
+ * 
+ * Parameters:
+ * 
+ *   which - zero for CPU cycles, one for cache misses
+ * 
+ * Return:
+ * 
+ *   the counter file descriptor, or -1 if not available
+ */
+static int openCounter(int which) {
+#ifdef __linux__
+
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(struct perf_event_attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(struct perf_event_attr);
+  attr.config = (which == 0) ? PERF_COUNT_HW_CPU_CYCLES
+                              : PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+#else
+  (void) which;
+  return -1;
+#endif
+}
+
+/*
+ * Reset and enable the performance counters that are available.
+ */
+static void startCounters(void) {
+#ifdef __linux__
+  if (m_fd_cycles >= 0) {
+    ioctl(m_fd_cycles, PERF_EVENT_IOC_RESET, 0);
+    ioctl(m_fd_cycles, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  if (m_fd_misses >= 0) {
+    ioctl(m_fd_misses, PERF_EVENT_IOC_RESET, 0);
+    ioctl(m_fd_misses, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+/*
+ * Disable the performance counters and read them.
+ * 
+ * Each counter that is not available is read as -1.
+ * 
+ * Parameters:
+ * 
+ *   pCycles - variable to receive the cycle count
+ * 
+ *   pMisses - variable to receive the cache miss count
+ */
+static void stopCounters(int64_t *pCycles, int64_t *pMisses) {
+
+  int64_t v = 0;
+
+  *pCycles = -1;
+  *pMisses = -1;
+
+#ifdef __linux__
+  if (m_fd_cycles >= 0) {
+    ioctl(m_fd_cycles, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(m_fd_cycles, &v, sizeof(int64_t)) == sizeof(int64_t)) {
+      *pCycles = v;
+    }
+  }
+  if (m_fd_misses >= 0) {
+    ioctl(m_fd_misses, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(m_fd_misses, &v, sizeof(int64_t)) == sizeof(int64_t)) {
+      *pMisses = v;
+    }
+  }
+#else
+  (void) v;
+#endif
+}
+
+/*
+ * Kernel that looks up the category of each codepoint individually.
+ */
+static void kCategory(const BENCH_INPUT *pIn) {
+
+  int32_t i = 0;
+  uint32_t acc = 0;
+
+  for(i = 0; i < BENCH_LEN; i++) {
+    acc += unikit_category(pIn->pCps[i]);
+  }
+  m_sink += acc;
+}
+
+/*
+ * Kernel that looks up the category of each codepoint with the inline
+ * version of the lookup.
+ */
+static void kCategoryInline(const BENCH_INPUT *pIn) {
+
+  int32_t i = 0;
+  uint32_t acc = 0;
+
+  for(i = 0; i < BENCH_LEN; i++) {
+    acc += unikit_category_inline(pIn->pCps[i]);
+  }
+  m_sink += acc;
+}
+
+/*
+ * Kernel that looks up all categories with unikit_category_buf().
+ */
+static void kCategoryBuf(const BENCH_INPUT *pIn) {
+  unikit_category_buf(pIn->pCps, pIn->pCat, (size_t) BENCH_LEN);
+  m_sink += pIn->pCat[BENCH_LEN - 1];
+}
+
+/*
+ * Kernel that looks up all categories of the UTF-8 text.
+ */
+static void kCategoryUtf8(const BENCH_INPUT *pIn) {
+  m_sink += (uint32_t) unikit_category_utf8(
+                pIn->pUtf8, pIn->utf8_len,
+                pIn->pCat, (size_t) BENCH_LEN);
+}
+
+/*
+ * Kernel that looks up all categories of the UTF-8 text with the
+ * streaming decoder, feeding it CHUNK_LEN bytes at a time.
+ */
+static void kDecodeCategory(const BENCH_INPUT *pIn) {
+
+  UNIKIT_DECODER d;
+  size_t i = 0;
+  size_t ch = 0;
+  size_t used = 0;
+  size_t olen = 0;
+
+  unikit_decoder_init(&d, UNIKIT_ENC_UTF8);
+  while (i < pIn->utf8_len) {
+    ch = pIn->utf8_len - i;
+    if (ch > CHUNK_LEN) {
+      ch = CHUNK_LEN;
+    }
+    olen += unikit_decode_category(&d, pIn->pUtf8 + i, ch,
+              pIn->pCat + olen, ((size_t) BENCH_LEN) - olen, &used);
+    i += used;
+  }
+  m_sink += (uint32_t) (olen + (size_t) unikit_decode_end(&d));
+}
+
+/*
+ * Kernel that case folds each codepoint individually.
+ */
+static void kFold(const BENCH_INPUT *pIn) {
+
+  int32_t i = 0;
+  uint32_t acc = 0;
+  UNIKIT_FOLD f;
+
+  memset(&f, 0, sizeof(UNIKIT_FOLD));
+  for(i = 0; i < BENCH_LEN; i++) {
+    unikit_fold(&f, pIn->pCps[i]);
+    acc += (uint32_t) f.cpa[0];
+  }
+  m_sink += acc;
+}
+
+/*
+ * Kernel that looks up the category and then the case folding of each
+ * codepoint, as a tokenizer does without the combined record.
+ */
+static void kCategoryFold(const BENCH_INPUT *pIn) {
+
+  int32_t i = 0;
+  uint32_t acc = 0;
+  UNIKIT_FOLD f;
+
+  memset(&f, 0, sizeof(UNIKIT_FOLD));
+  for(i = 0; i < BENCH_LEN; i++) {
+    acc += unikit_category(pIn->pCps[i]);
+    unikit_fold(&f, pIn->pCps[i]);
+    acc += (uint32_t) f.len;
+  }
+  m_sink += acc;
+}
+
+/*
+ * Kernel that looks up the combined property record of each codepoint.
+ */
+static void kProps(const BENCH_INPUT *pIn) {
+
+  int32_t i = 0;
+  uint32_t acc = 0;
+
+  for(i = 0; i < BENCH_LEN; i++) {
+    acc += unikit_props(pIn->pCps[i]);
+  }
+  m_sink += acc;
+}
+
+/*
+ * Kernel that case folds the UTF-8 text.
+ */
+static void kFoldUtf8(const BENCH_INPUT *pIn) {
+  m_sink += (uint32_t) unikit_fold_utf8(
+                pIn->pUtf8, pIn->utf8_len, pIn->pFold, pIn->fold_cap);
+}
+
+/*
+ * Kernel that looks up all categories of the UTF-16 text.
+ */
+static void kCategoryUtf16(const BENCH_INPUT *pIn) {
+  m_sink += (uint32_t) unikit_category_utf16(
+                pIn->pUtf16, pIn->utf16_len,
+                pIn->pCat, (size_t) BENCH_LEN);
+}
+
+/*
+ * Kernel that case folds the UTF-16 text.
+ */
+static void kFoldUtf16(const BENCH_INPUT *pIn) {
+  m_sink += (uint32_t) unikit_fold_utf16(
+                pIn->pUtf16, pIn->utf16_len,
+                (uint16_t *) pIn->pFold, pIn->fold_cap / 2);
+}
+
+/*
+ * Kernel that looks up all categories of the UTF-32 text.
+ */
+static void kCategoryUtf32(const BENCH_INPUT *pIn) {
+  m_sink += (uint32_t) unikit_category_utf32(
+                pIn->pCps, (size_t) BENCH_LEN,
+                pIn->pCat, (size_t) BENCH_LEN);
+}
+
+/*
+ * Kernel that case folds the UTF-32 text.
+ */
+static void kFoldUtf32(const BENCH_INPUT *pIn) {
+  m_sink += (uint32_t) unikit_fold_utf32(
+                pIn->pCps, (size_t) BENCH_LEN,
+                (int32_t *) pIn->pFold, pIn->fold_cap / 4);
+}
+
+/*
+ * Kernel that searches the UTF-8 text for FIND_NEEDLE without regard
+ * to case.
+ */
+static void kCasefind(const BENCH_INPUT *pIn) {
+  size_t off = 0;
+  size_t len = 0;
+
+  if (unikit_casefind_utf8(m_find, pIn->pUtf8, pIn->utf8_len,
+                            &off, &len)) {
+    m_sink += (uint32_t) off;
+  }
+}
+
+/*
+ * Thread function of the executor, which runs chunks until there are
+ * none left.
+ * 
+ * Parameters:
+ * 
+ *   pArg - the PAR_POOL state
+ * 
+ * Return:
+ * 
+ *   always NULL
+ */
+static void *parWorker(void *pArg) {
+
+  PAR_POOL *pp = NULL;
+  size_t i = 0;
+
+  pp = (PAR_POOL *) pArg;
+  for(;;) {
+    pthread_mutex_lock(&(pp->lock));
+    i = pp->next;
+    if (i < pp->count) {
+      pp->next++;
+    }
+    pthread_mutex_unlock(&(pp->lock));
+
+    if (i >= pp->count) {
+      break;
+    }
+    pp->fpJob(pp->pJob, i);
+  }
+
+  return NULL;
+}
+
+/*
+ * Executor of the parallel kernels.
+ * 
+ * pCustom points to the int thread count.  The calling thread works as
+ * one of the threads.
+ */
+static void parExecutor(void *pCustom, unikit_fp_job fpJob, void *pJob,
+                          size_t count) {
+
+  PAR_POOL pool;
+  pthread_t th[64];
+  int threads = 0;
+  int i = 0;
+
+  memset(&pool, 0, sizeof(PAR_POOL));
+
+  threads = *((const int *) pCustom);
+  if (threads > 64) {
+    threads = 64;
+  }
+
+  if (pthread_mutex_init(&(pool.lock), NULL) != 0) {
+    raiseErr(__LINE__, "Can't create mutex");
+  }
+  pool.fpJob = fpJob;
+  pool.pJob = pJob;
+  pool.count = count;
+
+  for(i = 1; i < threads; i++) {
+    if (pthread_create(&(th[i]), NULL, &parWorker, &pool) != 0) {
+      raiseErr(__LINE__, "Can't create thread");
+    }
+  }
+  parWorker(&pool);
+  for(i = 1; i < threads; i++) {
+    pthread_join(th[i], NULL);
+  }
+
+  pthread_mutex_destroy(&(pool.lock));
+}
+
+/*
+ * Kernel that looks up all categories of the UTF-8 text in parallel.
+ */
+static void kCategoryPar(const BENCH_INPUT *pIn) {
+  m_sink += (uint32_t) unikit_category_utf8_par(
+                pIn->pUtf8, pIn->utf8_len,
+                pIn->pCat, (size_t) BENCH_LEN,
+                PAR_CHUNK_LEN, &parExecutor, &m_par_threads);
+}
+
+/*
+ * Kernel that case folds the UTF-8 text in parallel.
+ */
+static void kFoldPar(const BENCH_INPUT *pIn) {
+  m_sink += (uint32_t) unikit_fold_utf8_par(
+                pIn->pUtf8, pIn->utf8_len, pIn->pFold, pIn->fold_cap,
+                PAR_CHUNK_LEN, &parExecutor, &m_par_threads);
+}
+
+/*
+ * Encode the codepoints of a benchmark input into its UTF-8 buffer.
+ * 
+ * Parameters:
+ * 
+ *   pIn - the benchmark input
+ */
+static void finishInput(BENCH_INPUT *pIn) {
+
+  int32_t i = 0;
+  size_t n = 0;
+
+  for(i = 0; i < BENCH_LEN; i++) {
+    n += (size_t) encodeUtf8(pIn->pCps[i], pIn->pUtf8 + n);
+  }
+  pIn->utf8_len = n;
+
+  n = 0;
+  for(i = 0; i < BENCH_LEN; i++) {
+    n += (size_t) encodeUtf16(pIn->pCps[i], pIn->pUtf16 + n);
+  }
+  pIn->utf16_len = n;
+}
+
+/*
+ * Fill a benchmark input with codepoints drawn from a set.
+ * 
+ * Parameters:
+ * 
+ *   pIn - the benchmark input
+ * 
+ *   pSet - the codepoints to draw from
+ * 
+ *   set_len - the number of codepoints in the set, at least one
+ */
+static void fillFromSet(BENCH_INPUT *pIn, const int32_t *pSet,
+                          int32_t set_len) {
+
+  int32_t i = 0;
+
+  if (set_len < 1) {
+    raiseErr(__LINE__, "Empty benchmark set");
+  }
+
+  seedRandom(UINT32_C(12345));
+  for(i = 0; i < BENCH_LEN; i++) {
+    pIn->pCps[i] = pSet[nextRandom() % ((uint32_t) set_len)];
+  }
+  finishInput(pIn);
+}
+
+/*
+ * Fill a benchmark input with synthetic text from a corpus definition.
+ * 
+ * Parameters:
+ * 
+ *   pIn - the benchmark input
+ * 
+ *   pCorpus - the corpus definition
+ */
+static void fillFromCorpus(BENCH_INPUT *pIn, const CORPUS *pCorpus) {
+
+  int32_t i = 0;
+  int j = 0;
+  int total = 0;
+  int w = 0;
+  const CPRANGE *pr = NULL;
+
+  for(j = 0; pCorpus->ranges[j].weight > 0; j++) {
+    total += pCorpus->ranges[j].weight;
+  }
+
+  seedRandom(UINT32_C(67890));
+  for(i = 0; i < BENCH_LEN; i++) {
+    /* Choose a range according to the weights */
+    w = (int) (nextRandom() % ((uint32_t) total));
+    for(j = 0; w >= pCorpus->ranges[j].weight; j++) {
+      w -= pCorpus->ranges[j].weight;
+    }
+    pr = &((pCorpus->ranges)[j]);
+
+    /* Choose a codepoint within the range */
+    pIn->pCps[i] = pr->lo + (int32_t) (nextRandom()
+                      % ((uint32_t) (pr->hi - pr->lo + 1)));
+  }
+  finishInput(pIn);
+}
+
+/*
+ * Run a benchmark and print its result line.
+ * 
+ * Parameters:
+ * 
+ *   pName - the name of the benchmark
+ * 
+ *   kernel - the benchmark kernel
+ * 
+ *   pIn - the benchmark input
+ * 
+ *   reps - the number of timed repetitions
+ */
+static void runBench(const char *pName, fp_kernel kernel,
+                      const BENCH_INPUT *pIn, int reps) {
+
+  int i = 0;
+  double t = 0.0;
+  double best_t = -1.0;
+  int64_t cycles = 0;
+  int64_t misses = 0;
+  int64_t best_cycles = -1;
+  int64_t best_misses = -1;
+
+  /* Warm up */
+  kernel(pIn);
+
+  /* Keep the fastest repetition */
+  for(i = 0; i < reps; i++) {
+    startCounters();
+    t = getTime();
+    kernel(pIn);
+    t = getTime() - t;
+    stopCounters(&cycles, &misses);
+
+    if ((best_t < 0.0) || (t < best_t)) {
+      best_t = t;
+      best_cycles = cycles;
+      best_misses = misses;
+    }
+  }
+
+  /* Print the results */
+  printf("%-26s %9.2f ns/cp", pName, (best_t * 1.0e9) / BENCH_LEN);
+  if (best_cycles >= 0) {
+    printf(" %9.2f cyc/cp", ((double) best_cycles) / BENCH_LEN);
+  } else {
+    printf(" %9s cyc/cp", "-");
+  }
+  if (best_misses >= 0) {
+    printf(" %9.3f miss/kcp",
+            (((double) best_misses) * 1000.0) / BENCH_LEN);
+  } else {
+    printf(" %9s miss/kcp", "-");
+  }
+  printf("\n");
+}
+
+/*
+ * Run the lookup tier benchmarks.
+ * 
+ * Parameters:
+ * 
+ *   pIn - the benchmark input buffers
+ * 
+ *   reps - the number of timed repetitions
+ */
+static void benchTiers(BENCH_INPUT *pIn, int reps) {
+
+  static const char *pTierName[5] = {
+    "category/core", "category/bitmap", "category/general",
+    "category/remainder", "category/astral"
+  };
+
+  int32_t *pSet = NULL;
+  int32_t set_len = 0;
+  int32_t cv = 0;
+  int tier = 0;
+  int t = 0;
+  uint16_t gc = 0;
+
+  pSet = (int32_t *) calloc((size_t) 0x110000, sizeof(int32_t));
+  if (pSet == NULL) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+
+  for(tier = 0; tier < 5; tier++) {
+    /* Gather every codepoint answered by this tier */
+    set_len = 0;
+    for(cv = 0; cv <= 0x10ffff; cv++) {
+      gc = unikit_category(cv);
+
+      if (cv <= 0xff) {
+        t = 0;
+      } else if (cv > 0x1ffff) {
+        t = 4;
+      } else if ((gc == UNIKIT_GCAT_Lo) || (gc == UNIKIT_GCAT_Ll) ||
+                  (gc == UNIKIT_GCAT_So)) {
+        t = 1;
+      } else if ((gc == UNIKIT_GCAT_Cs) || (gc == UNIKIT_GCAT_Co) ||
+                  (gc == UNIKIT_GCAT_Cn)) {
+        t = 3;
+      } else {
+        t = 2;
+      }
+
+      /* Unassigned astral codepoints are not interesting, because the
+       * directory usually answers them without any record */
+      if ((t == 4) && (gc == UNIKIT_GCAT_Cn)) {
+        t = -1;
+      }
+
+      if (t == tier) {
+        pSet[set_len] = cv;
+        set_len++;
+      }
+    }
+
+    /* Run the benchmark */
+    fillFromSet(pIn, pSet, set_len);
+    runBench(pTierName[tier], &kCategory, pIn, reps);
+  }
+
+  free(pSet);
+}
+
+/*
+ * Run the case folding benchmarks.
+ * 
+ * Parameters:
+ * 
+ *   pIn - the benchmark input buffers
+ * 
+ *   reps - the number of timed repetitions
+ */
+static void benchFold(BENCH_INPUT *pIn, int reps) {
+
+  int32_t *pSet = NULL;
+  int32_t set_len = 0;
+  int32_t cv = 0;
+  int plane = 0;
+
+  pSet = (int32_t *) calloc((size_t) 0x10000, sizeof(int32_t));
+  if (pSet == NULL) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+
+  for(plane = 0; plane < 2; plane++) {
+    set_len = 0;
+    for(cv = plane * 0x10000; cv < (plane + 1) * 0x10000; cv++) {
+      if (unikit_valid(cv)) {
+        pSet[set_len] = cv;
+        set_len++;
+      }
+    }
+
+    fillFromSet(pIn, pSet, set_len);
+    runBench((plane == 0) ? "fold/lower" : "fold/upper",
+              &kFold, pIn, reps);
+  }
+
+  free(pSet);
+}
+
+/*
+ * Run the corpus benchmarks.
+ * 
+ * Parameters:
+ * 
+ *   pIn - the benchmark input buffers
+ * 
+ *   reps - the number of timed repetitions
+ */
+static void benchCorpus(BENCH_INPUT *pIn, int reps) {
+
+  char name[64];
+  const CORPUS *pc = NULL;
+
+  memset(name, 0, sizeof(name));
+
+  m_find = unikit_casefind_compile(
+              (const uint8_t *) FIND_NEEDLE, strlen(FIND_NEEDLE));
+
+  for(pc = m_corpora; pc->pName != NULL; pc++) {
+    fillFromCorpus(pIn, pc);
+
+    snprintf(name, sizeof(name), "%s/category", pc->pName);
+    runBench(name, &kCategory, pIn, reps);
+
+    snprintf(name, sizeof(name), "%s/category_inline", pc->pName);
+    runBench(name, &kCategoryInline, pIn, reps);
+
+    snprintf(name, sizeof(name), "%s/category_buf", pc->pName);
+    runBench(name, &kCategoryBuf, pIn, reps);
+
+    snprintf(name, sizeof(name), "%s/category_utf8", pc->pName);
+    runBench(name, &kCategoryUtf8, pIn, reps);
+
+    snprintf(name, sizeof(name), "%s/decode_category", pc->pName);
+    runBench(name, &kDecodeCategory, pIn, reps);
+
+    snprintf(name, sizeof(name), "%s/category_fold", pc->pName);
+    runBench(name, &kCategoryFold, pIn, reps);
+
+    snprintf(name, sizeof(name), "%s/props", pc->pName);
+    runBench(name, &kProps, pIn, reps);
+
+    snprintf(name, sizeof(name), "%s/fold_utf8", pc->pName);
+    runBench(name, &kFoldUtf8, pIn, reps);
+
+    snprintf(name, sizeof(name), "%s/category_utf16", pc->pName);
+    runBench(name, &kCategoryUtf16, pIn, reps);
+
+    snprintf(name, sizeof(name), "%s/fold_utf16", pc->pName);
+    runBench(name, &kFoldUtf16, pIn, reps);
+
+    snprintf(name, sizeof(name), "%s/category_utf32", pc->pName);
+    runBench(name, &kCategoryUtf32, pIn, reps);
+
+    snprintf(name, sizeof(name), "%s/fold_utf32", pc->pName);
+    runBench(name, &kFoldUtf32, pIn, reps);
+
+    snprintf(name, sizeof(name), "%s/casefind", pc->pName);
+    runBench(name, &kCasefind, pIn, reps);
+  }
+
+  unikit_casefind_free(m_find);
+  m_find = NULL;
+}
+
+/*
+ * Run the parallel benchmarks.
+ * 
+ * Parameters:
+ * 
+ *   pIn - the benchmark input buffers
+ * 
+ *   reps - the number of timed repetitions
+ */
+static void benchPar(BENCH_INPUT *pIn, int reps) {
+
+  char name[64];
+  const CORPUS *pc = NULL;
+  long cpus = 0;
+
+  memset(name, 0, sizeof(name));
+
+  cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpus < 1) {
+    cpus = 1;
+  } else if (cpus > 64) {
+    cpus = 64;
+  }
+
+  for(pc = m_corpora; pc->pName != NULL; pc++) {
+    if ((strcmp(pc->pName, "ascii") != 0) &&
+        (strcmp(pc->pName, "cyrillic") != 0)) {
+      continue;
+    }
+    fillFromCorpus(pIn, pc);
+
+    for(m_par_threads = 1; m_par_threads <= cpus; m_par_threads *= 2) {
+      snprintf(name, sizeof(name), "%s/category_par/%d",
+                pc->pName, m_par_threads);
+      runBench(name, &kCategoryPar, pIn, reps);
+
+      snprintf(name, sizeof(name), "%s/fold_par/%d",
+                pc->pName, m_par_threads);
+      runBench(name, &kFoldPar, pIn, reps);
+    }
+  }
+}
+
+/*
+ * Program entrypoint
+ * ==================
+ */
+
+int main(int argc, char *argv[]) {
+
+  const char *pGroup = "all";
+  int reps = DEFAULT_REPS;
+  BENCH_INPUT in;
+
+  /* Initialize structures */
+  memset(&in, 0, sizeof(BENCH_INPUT));
+
+  /* Initialize diagnostics and check parameters */
+  diagnostic_startup(argc, argv, "unikit_bench");
+
+  if (argc > 3) {
+    raiseErr(__LINE__, "Too many program arguments");
+  }
+  if (argc >= 2) {
+    pGroup = argv[1];
+  }
+  if (argc >= 3) {
+    reps = atoi(argv[2]);
+    if ((reps < 1) || (reps > MAX_REPS)) {
+      raiseErr(__LINE__, "Repetition count out of range");
+    }
+  }
+
+  if ((strcmp(pGroup, "all") != 0) &&
+      (strcmp(pGroup, "tiers") != 0) &&
+      (strcmp(pGroup, "fold") != 0) &&
+      (strcmp(pGroup, "corpus") != 0) &&
+      (strcmp(pGroup, "par") != 0)) {
+    raiseErr(__LINE__, "Unrecognized benchmark group: %s", pGroup);
+  }
+
+  /* Initialize unikit and the performance counters */
+  unikit_init(&unikit_err);
+
+  m_fd_cycles = openCounter(0);
+  m_fd_misses = openCounter(1);
+
+  /* Allocate the input buffers; case folding expands each codepoint to
+   * at most three codepoints of at most four bytes each */
+  in.pCps = (int32_t *) calloc((size_t) BENCH_LEN, sizeof(int32_t));
+  in.pUtf8 = (uint8_t *) calloc((size_t) BENCH_LEN, 4);
+  in.pUtf16 = (uint16_t *) calloc(
+                ((size_t) BENCH_LEN) * 2, sizeof(uint16_t));
+  in.pCat = (uint16_t *) calloc((size_t) BENCH_LEN, sizeof(uint16_t));
+  in.fold_cap = ((size_t) BENCH_LEN) * 12;
+  in.pFold = (uint8_t *) calloc(in.fold_cap, 1);
+  if ((in.pCps == NULL) || (in.pUtf8 == NULL) || (in.pUtf16 == NULL) ||
+      (in.pCat == NULL) || (in.pFold == NULL)) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+
+  /* Run the selected benchmarks */
+  if ((strcmp(pGroup, "all") == 0) || (strcmp(pGroup, "tiers") == 0)) {
+    benchTiers(&in, reps);
+  }
+  if ((strcmp(pGroup, "all") == 0) || (strcmp(pGroup, "fold") == 0)) {
+    benchFold(&in, reps);
+  }
+  if ((strcmp(pGroup, "all") == 0) || (strcmp(pGroup, "corpus") == 0)) {
+    benchCorpus(&in, reps);
+  }
+  if (strcmp(pGroup, "par") == 0) {
+    benchPar(&in, reps);
+  }
+
+  /* Release resources */
+  free(in.pCps);
+  free(in.pUtf8);
+  free(in.pUtf16);
+  free(in.pCat);
+  free(in.pFold);
+
+#ifdef __linux__
+  if (m_fd_cycles >= 0) {
+    close(m_fd_cycles);
+  }
+  if (m_fd_misses >= 0) {
+    close(m_fd_misses);
+  }
+#endif
+
+  unikit_shutdown();
+  return 0;
+}
@@ -32,12 +32,46 @@ GeneralTable - Parser for the general UnicodeData data table file.
 Read through parsed records of the UnicodeData.txt data file.  Only the
 fields relevant to Unikit are parsed by this class.
 
+The parsed records of each file are cached in memory for the rest of the
+process, so that a script which builds many tables from the same file
+only parses it once.  Later parsers of the same path replay the cached
+records, as long as the size and modification time of the file have not
+changed.  The cached records are shared between all parsers of a file,
+so clients must not modify the returned records.
+
 =cut
 
+# ==========
+# Local data
+# ==========
+
+# The parsed record cache, mapping the path of each fully parsed file to
+# a hash reference with a 'stamp' key holding the size and modification
+# time of the file when it was parsed, and a 'recs' key holding an array
+# reference to all its records in order.
+#
+my %m_cache;
+
 # ===============
 # Local functions
 # ===============
 
+# fileStamp(path)
+# ---------------
+#
+# Return a string that identifies the current size and modification time
+# of the file at the given path.
+#
+sub fileStamp {
+  ($#_ == 0) or die "Bad call";
+  my $path = shift;
+  
+  my @st = stat($path);
+  (scalar(@st) > 0) or die "Failed to stat file '$path'";
+  
+  return "$st[7]:$st[9]";
+}
+
 # rawRec(fh)
 # ----------
 #
@@ -171,20 +205,39 @@ sub parse {
   (not ref($path)) or croak("Bad parameter type");
   (-f $path) or croak("Can't find data file '$path'");
   
-  # Open the file in raw binary mode
-  open(my $fh, "< :raw", $path) or 
-    die "Failed to open file '$path'";
-  
   # Create new object
   my $self = { };
   bless($self);
   
-  # '_fh' stores the file handle of the data file
-  $self->{'_fh'} = $fh;
+  # '_path' stores the path and '_stamp' the stamp of the data file
+  $self->{'_path'} = $path;
+  $self->{'_stamp'} = fileStamp($path);
   
   # '_done' is 1 if iteration is complete, 0 if not yet complete
   $self->{'_done'} = 0;
   
+  # If the file is in the cache and unchanged, '_recs' stores the cached
+  # records and '_next' the index of the next one to return, and there
+  # is no file handle
+  my $c = $m_cache{$path};
+  if ((defined $c) and ($c->{'stamp'} eq $self->{'_stamp'})) {
+    $self->{'_fh'} = undef;
+    $self->{'_recs'} = $c->{'recs'};
+    $self->{'_next'} = 0;
+    return $self;
+  }
+  
+  # Open the file in raw binary mode
+  open(my $fh, "< :raw", $path) or 
+    die "Failed to open file '$path'";
+  
+  # '_fh' stores the file handle of the data file
+  $self->{'_fh'} = $fh;
+  
+  # '_parsed' collects the records returned so far, which are cached
+  # once the whole file has been parsed
+  $self->{'_parsed'} = [];
+  
   # '_pos' is the last codepoint that was present in a returned record,
   # or -1 if no records have been returned yet
   $self->{'_pos'} = -1;
@@ -207,9 +260,11 @@ sub DESTROY {
   my $self = shift;
   (ref($self) and $self->isa(__PACKAGE__)) or croak("Bad self");
   
-  # Close file
-  close($self->{'_fh'}) or carp("Failed to close file");
-  $self->{'_fh'} = undef;
+  # Close file if not replaying cached records
+  if (defined $self->{'_fh'}) {
+    close($self->{'_fh'}) or carp("Failed to close file");
+    $self->{'_fh'} = undef;
+  }
 }
 
 =head1 PUBLIC INSTANCE FUNCTIONS
@@ -254,6 +309,9 @@ The parsed records are guaranteed to be in ascending order of codepoint,
 such that each record after the first has an C<lbound> that is greater
 than the previous record's C<ubound>.
 
+The returned record may be shared with other parsers of the same file
+through the record cache, so it must not be modified.
+
 =cut
 
 sub readRec {
@@ -265,10 +323,23 @@ sub readRec {
   # Return undef if iteration is finished
   ($self->{'_done'} == 0) or return undef;
   
-  # Read a raw record
+  # Replay cached records if available
+  if (defined $self->{'_recs'}) {
+    if ($self->{'_next'} >= scalar(@{$self->{'_recs'}})) {
+      $self->{'_done'} = 1;
+      return undef;
+    }
+    return $self->{'_recs'}->[$self->{'_next'}++];
+  }
+  
+  # Read a raw record, caching all the records at the end of the file
   my $rec = rawRec($self->{'_fh'});
   unless (defined $rec) {
     $self->{'_done'} = 1;
+    $m_cache{$self->{'_path'}} = {
+      'stamp' => $self->{'_stamp'},
+      'recs'  => $self->{'_parsed'}
+    };
     return undef;
   }
   
@@ -318,7 +389,8 @@ sub readRec {
     die "Records out of order";
   $self->{'_pos'} = $rec->{'ubound'};
   
-  # Return the record
+  # Collect the record for the cache and return it
+  push @{$self->{'_parsed'}}, ($rec);
   return $rec;
 }
 
@@ -0,0 +1,218 @@
+package StageTable;
+use v5.16;
+use warnings;
+
+use Carp;
+use Scalar::Util qw(looks_like_number);
+
+=head1 NAME
+
+StageTable - Two-stage lookup table compiler for Unikit.
+
+=head1 SYNOPSIS
+
+  use StageTable;
+
+  # Compile a flat array of 65536 values into a two-stage table with an
+  # 11-bit/5-bit split of the 16-bit keys
+  my @arr = StageTable->compile(\@values, 5);
+  
+  # Or place the data blocks of the keys 0x0000 to 0x07FF first
+  my @hot = StageTable->compile(\@values, 5, [[0x0000, 0x07FF]]);
+
+=head1 DESCRIPTION
+
+Two-stage tables map integer keys to unsigned 16-bit values with exactly
+two array lookups per query.  The key is split into a high part and a
+low part, where the low part has a bit width selected at compilation
+time, called the shift.  The whole key space is divided into blocks of
+(1 << shift) consecutive keys, and identical blocks are stored only
+once.
+
+The compiled two-stage table is a single array of unsigned 16-bit
+integers.  The array begins with the index, which has one element for
+each block of the key space.  The index is followed by the deduplicated
+data blocks, each of which is exactly (1 << shift) elements.  Each index
+element holds the position of its data block within the array, measured
+in units of (1 << shift) elements from the start of the array.  The
+index length is always a multiple of the block size, so the index itself
+occupies the first few block positions.  To query a key:
+
+  value = arr[(arr[key >> shift] << shift) + (key & ((1 << shift) - 1))]
+
+The stored values may be any unsigned 16-bit integer.  It is up to the
+client to reserve a special value, such as 0xFFFF, if some keys need to
+be marked as having no value.
+
+The order of the data blocks after the index does not affect queries.
+By default, the data blocks are stored in the order of the first key
+that uses them.  Clients may instead give a list of hot key ranges,
+which are expected to be queried much more often than the rest of the
+key space.  The data blocks used by the hot ranges are then stored
+first, directly after the index, in the order the ranges are listed.
+This keeps the working set of typical queries within a few cache lines
+and pages, instead of interleaving it with blocks that are rarely used.
+
+=cut
+
+# ===============
+# Local functions
+# ===============
+
+# isInteger(val)
+# --------------
+#
+# Check that the given value is an integer.  Return 1 if an integer or 0
+# if not.
+#
+sub isInteger {
+  ($#_ == 0) or die "Bad call";
+  my $val = shift;
+  
+  looks_like_number($val) or return 0;
+  (int($val) == $val) or return 0;
+  
+  return 1;
+}
+
+=head1 CLASS FUNCTIONS
+
+=over 4
+
+=item B<compile(\@values, shift [, \@hot])>
+
+Compile a flat array of values into a two-stage table.
+
+values is an array reference holding the value of every key, where the
+key is the index into the array.  Each element must be an integer in
+range 0x0000 to 0xFFFF.
+
+shift is the number of low bits of the key that select an element
+within a data block.  It must be an integer in range 1 to 8.  The length
+of the values array must be a non-zero multiple of (1 << (2 * shift)),
+so that the index always fills a whole number of blocks.  For 16-bit
+keys, a shift of 8 gives an 8-bit/8-bit split and a shift of 5 gives an
+11-bit/5-bit split.  Key spaces that are not a power of two, such as the
+69632 words of a bitset over every codepoint, are allowed as long as
+they are such a multiple.
+
+hot is an optional array reference of hot key ranges, each of which is
+a subarray reference holding the first and last key of the range.  The
+ranges are listed in order of decreasing priority.  Keys in the ranges
+that are beyond the end of the values array are ignored.  See the
+documentation at the top of this module for how the hot ranges affect
+the order of the data blocks.
+
+The return is the compiled array in list context.  See the documentation
+at the top of this module for the format of the array and how to query
+it.  An error occurs if the compiled array would have more than 65536
+elements or if any block position does not fit in 16 bits.
+
+=cut
+
+sub compile {
+  # Get parameters
+  (($#_ == 2) or ($#_ == 3)) or croak("Bad call");
+  shift;
+  
+  my $values = shift;
+  (ref($values) eq 'ARRAY') or croak("Bad parameter type");
+  
+  my $shift = shift;
+  isInteger($shift) or croak("Bad parameter type");
+  
+  my $hot = [];
+  if ($#_ >= 0) {
+    $hot = shift;
+    (ref($hot) eq 'ARRAY') or croak("Bad parameter type");
+    for my $r (@$hot) {
+      ((ref($r) eq 'ARRAY') and (scalar(@$r) == 2)) or
+        croak("Bad hot range");
+      (isInteger($r->[0]) and isInteger($r->[1])) or
+        croak("Bad hot range");
+      (($r->[0] >= 0) and ($r->[0] <= $r->[1])) or
+        croak("Bad hot range");
+    }
+  }
+  
+  # Check the shift and the length
+  (($shift >= 1) and ($shift <= 8)) or croak("Shift out of range");
+  ((scalar(@$values) > 0) and
+      ((scalar(@$values) % (1 << (2 * $shift))) == 0)) or
+    croak("Value count must be a multiple of the squared block size");
+  
+  # Check the values
+  for my $v (@$values) {
+    (isInteger($v) and ($v >= 0) and ($v <= 0xFFFF)) or
+      croak("Value out of range");
+  }
+  
+  # Determine block size and counts
+  my $block_size = 1 << $shift;
+  my $index_len = scalar(@$values) / $block_size;
+  my $index_blocks = $index_len / $block_size;
+  
+  # Get the signature of each block of the key space, and the distinct
+  # blocks in the order of the first key that uses them
+  my @sigs;
+  my @blocks;
+  my %block_data;
+  for(my $i = 0; $i < $index_len; $i++) {
+    my @blk = @$values[
+                ($i * $block_size) .. ((($i + 1) * $block_size) - 1)];
+    my $sig = join ',', @blk;
+    
+    unless (defined $block_data{$sig}) {
+      $block_data{$sig} = \@blk;
+      push @blocks, ($sig);
+    }
+    push @sigs, ($sig);
+  }
+  
+  # Put the distinct blocks used by the hot ranges first, in the order
+  # of the ranges, followed by all remaining blocks in their first use
+  # order
+  my @order;
+  my %seen;
+  for my $r (@$hot) {
+    for(my $i = $r->[0] >> $shift;
+        ($i <= ($r->[1] >> $shift)) and ($i < $index_len); $i++) {
+      unless ($seen{$sigs[$i]}) {
+        $seen{$sigs[$i]} = 1;
+        push @order, ($sigs[$i]);
+      }
+    }
+  }
+  for my $sig (@blocks) {
+    unless ($seen{$sig}) {
+      $seen{$sig} = 1;
+      push @order, ($sig);
+    }
+  }
+  
+  # Assign the block positions and build the index
+  my %block_pos;
+  for(my $i = 0; $i < scalar(@order); $i++) {
+    ($index_blocks + $i <= 0xFFFF) or
+      croak("Too many blocks in two-stage table");
+    $block_pos{$order[$i]} = $index_blocks + $i;
+  }
+  my @index = map { $block_pos{$_} } @sigs;
+  
+  # Assemble the result
+  my @result = @index;
+  for my $sig (@order) {
+    push @result, (@{$block_data{$sig}});
+  }
+  (scalar(@result) <= 65536) or croak("Two-stage table too large");
+  
+  # Return results
+  return @result;
+}
+
+=back
+
+=cut
+
+# End with something that evaluates to true
+1;
@@ -5,6 +5,8 @@ use warnings;
 use Carp;
 use Scalar::Util qw(looks_like_number);
 
+use StageTable;
+
 =head1 NAME
 
 Trie - Trie data structure implementation for Unikit.
@@ -21,6 +23,9 @@ Trie - Trie data structure implementation for Unikit.
   
   # Get the compiled trie array
   my @arr = $tr->compile;
+  
+  # Or get a two-stage table with 8-bit blocks instead
+  my @stage = $tr->compileStage(8);
 
 =head1 DESCRIPTION
 
@@ -39,6 +44,10 @@ In each table, one of the nybbles from the key is used as an index into
 the table to select one of the 16 records.  For all tables, the special
 value 0xFFFF means that the particular record is empty and unassigned.
 
+Identical tables are stored only once in the compiled array, so the
+same table may be selected from more than one place in the tables above
+it.  This is invisible to queries.
+
 Each query consults N tables, where N is the number of nybbles in the
 key.  The first nybble is always used to query the first table.  For all
 tables but the last in the query, the integer value selects a specific
@@ -47,6 +56,12 @@ table in the array.  For the last table in the query, the value is the
 actual value the key maps to, provided it is not the special value
 0xFFFF.
 
+Tries can alternatively be compiled into a two-stage table, which
+answers every query with exactly two array lookups instead of one lookup
+per nybble.  See the StageTable module for the format of two-stage
+tables.  When a trie is compiled this way, the special value 0xFFFF
+still means that no value is mapped to the key.
+
 =cut
 
 # ===============
@@ -76,7 +91,10 @@ sub isInteger {
 # properties.
 #
 # tptr is the table to recursively assign.  The table and all tables
-# referenced from it will get their IDs assigned.
+# referenced from it will get their IDs assigned.  Tables that already
+# have an ID, such as those assigned by hotID(), keep it, but the tables
+# referenced from them are still visited.  Tables shared by more than
+# one parent after dedupTable() are only visited once.
 #
 # next_id is the next ID to assign to a table.  It should be zero on the
 # first call to assign zero to the first table.  It must be an integer
@@ -99,11 +117,17 @@ sub assignID {
   my $next_id = shift;
   isInteger($next_id) or die "Bad parameter type";
   ($next_id >= 0) or die "Bad ID value";
-  ($next_id <= 0xFFFE) or die "Too many tables in 16-bit trie";
   
-  # Current table gets the given ID value
-  $tptr->{'id'} = $next_id;
-  $next_id++;
+  # Current table gets the given ID value unless already assigned
+  unless (defined $tptr->{'id'}) {
+    ($next_id <= 0xFFFE) or die "Too many tables in 16-bit trie";
+    $tptr->{'id'} = $next_id;
+    $next_id++;
+  }
+  
+  # Only visit the referenced tables once
+  (not $tptr->{'seen'}) or return $next_id;
+  $tptr->{'seen'} = 1;
   
   # There should be a t key mapped to an array
   (defined $tptr->{'t'}) or die;
@@ -121,6 +145,108 @@ sub assignID {
   return $next_id;
 }
 
+# dedupTable(tptr, level, \%canon)
+# --------------------------------
+#
+# Recursively merge identical tables, so that each distinct table is
+# only stored once in the compiled array.
+#
+# tptr is the table to deduplicate, at the given level, where the root
+# table is level zero.  canon is a hash that maps the signature of each
+# distinct table seen so far to that table.  It should be empty on the
+# root call.
+#
+# The tables referenced from tptr are deduplicated first and replaced
+# with their canonical tables, so that two tables are identical exactly
+# when their signatures are equal.  The return value is the canonical
+# table that should replace tptr.
+#
+sub dedupTable {
+  # Get parameters
+  ($#_ == 2) or die "Bad call";
+  
+  my $tptr = shift;
+  (ref($tptr) eq 'HASH') or die "Bad parameter type";
+  
+  my $level = shift;
+  isInteger($level) or die "Bad parameter type";
+  
+  my $canon = shift;
+  (ref($canon) eq 'HASH') or die "Bad parameter type";
+  
+  # Replace referenced tables with their canonical tables and form the
+  # signature of this table, where referenced tables are identified by
+  # their canonical index
+  my @sig = ($level);
+  for my $e (@{$tptr->{'t'}}) {
+    if (not defined $e) {
+      push @sig, ('-');
+      
+    } elsif (ref($e) eq 'HASH') {
+      $e = dedupTable($e, $level + 1, $canon);
+      push @sig, ('t' . $e->{'cid'});
+      
+    } else {
+      push @sig, ($e);
+    }
+  }
+  my $sig = join ',', @sig;
+  
+  # Return the canonical table of this signature, making this table
+  # canonical if it is the first one with the signature
+  unless (defined $canon->{$sig}) {
+    $tptr->{'cid'} = scalar(keys %$canon);
+    $canon->{$sig} = $tptr;
+  }
+  return $canon->{$sig};
+}
+
+# hotID(root, depth, key, next_id)
+# --------------------------------
+#
+# Assign unique ID values to the tables along the path of a single key,
+# starting at the root table root of a trie with the given depth.  key
+# is the whole key as an integer, with the first nybble in the most
+# significant position.  Tables that already have an ID keep it, and
+# the walk stops early if the path leaves the defined tables.
+#
+# next_id is the next ID to assign to a table, with the same meaning as
+# for assignID().  The return value is the updated next_id.
+#
+sub hotID {
+  # Get parameters
+  ($#_ == 3) or die "Bad call";
+  
+  my $tptr = shift;
+  (ref($tptr) eq 'HASH') or die "Bad parameter type";
+  
+  my $depth = shift;
+  isInteger($depth) or die "Bad parameter type";
+  
+  my $key = shift;
+  isInteger($key) or die "Bad parameter type";
+  
+  my $next_id = shift;
+  isInteger($next_id) or die "Bad parameter type";
+  
+  # Walk down the tables of the path, assigning IDs in path order
+  for(my $level = 0; $level < $depth; $level++) {
+    unless (defined $tptr->{'id'}) {
+      ($next_id <= 0xFFFE) or die "Too many tables in 16-bit trie";
+      $tptr->{'id'} = $next_id;
+      $next_id++;
+    }
+    
+    ($level < $depth - 1) or last;
+    my $e = $tptr->{'t'}->[($key >> (4 * ($depth - $level - 1))) & 0xf];
+    (ref($e) eq 'HASH') or last;
+    $tptr = $e;
+  }
+  
+  # Return updated ID count
+  return $next_id;
+}
+
 # genTable(\@result, tptr)
 # ------------------------
 #
@@ -143,8 +269,9 @@ sub genTable {
   my $tptr = shift;
   (ref($tptr) eq 'HASH') or die "Bad parameter type";
   
-  # Get the ID of this table
+  # Get the ID of this table and mark it generated
   (defined $tptr->{'id'}) or die "Unassigned table ID";
+  $tptr->{'gen'} = 1;
   
   my $tid = $tptr->{'id'};
   isInteger($tid) or die;
@@ -206,8 +333,61 @@ sub genTable {
     # Skip elements except hash references
     (ref($e) eq 'HASH') or next;
     
-    # Recursively generate table
-    genTable($result, $e);
+    # Recursively generate table, unless already generated through
+    # another reference
+    ($e->{'gen'}) or genTable($result, $e);
+  }
+}
+
+# flatTable(\@result, tptr, level, depth, base)
+# ---------------------------------------------
+#
+# Recursively write all values stored in the given table and all tables
+# referenced from it into the given result array, indexed by key.
+#
+# level is the depth of tptr, where the root table is level zero.  depth
+# is the depth of the whole trie.  base is the key value formed by the
+# nybbles that lead to tptr.
+#
+# Before calling this on the root table, result should be allocated to
+# cover the whole key space and all elements initialized to 0xFFFF.
+#
+sub flatTable {
+  # Get parameters
+  ($#_ == 4) or die "Bad call";
+  
+  my $result = shift;
+  (ref($result) eq 'ARRAY') or die "Bad parameter type";
+  
+  my $tptr = shift;
+  (ref($tptr) eq 'HASH') or die "Bad parameter type";
+  
+  my $level = shift;
+  isInteger($level) or die "Bad parameter type";
+  
+  my $depth = shift;
+  isInteger($depth) or die "Bad parameter type";
+  
+  my $base = shift;
+  isInteger($base) or die "Bad parameter type";
+  
+  # Go through all elements of the table
+  for(my $i = 0; $i < 16; $i++) {
+    # Get element and skip if undefined
+    my $e = $tptr->{'t'}->[$i];
+    (defined $e) or next;
+    
+    # Compute the key prefix of this element
+    my $key = ($base << 4) | $i;
+    
+    # Handle leaf and non-leaf tables
+    if ($level == $depth - 1) {
+      (not ref($e)) or die;
+      $result->[$key] = $e;
+    } else {
+      (ref($e) eq 'HASH') or die;
+      flatTable($result, $e, $level + 1, $depth, $key);
+    }
   }
 }
 
@@ -253,7 +433,9 @@ sub create {
   # 0xFFFE.
   #
   # During compilation, each table will get an 'id' key that is the 
-  # unique index of the table that is in range zero or 0xFFFE.
+  # unique index of the table that is in range zero or 0xFFFE.  The
+  # 'cid', 'seen' and 'gen' keys are bookkeeping of the deduplication,
+  # ID assignment and generation passes.
   #
   $self->{'_q'} = {
     't' => [
@@ -345,10 +527,22 @@ sub add {
   $tptr->{'t'}->[$kl] = $val;
 }
 
-=item B<compile()>
+=item B<compile([\@hot])>
 
 Compile the trie to an array of unsigned 16-bit values.
 
+hot is an optional array reference of hot key ranges, each of which is
+a subarray reference holding the first and last key of the range as
+integers, with the first nybble of the key in the most significant
+position.  The ranges are listed in order of decreasing priority.  The
+tables along the paths of the hot keys are stored first, right after
+the first table, in the order the ranges are listed, so that the
+working set of typical queries is packed together.  The order of the
+tables does not affect queries.
+
+Identical tables are merged with a hash of their contents before they
+are stored, so each distinct table is stored only once.
+
 The return is the compiled array in list context.  It is never empty and
 its length is always a multiple of 16.
 
@@ -368,14 +562,42 @@ sub compile {
   # Check state
   ($self->{'_done'} == 0) or croak("Bad object state");
   
-  # Check parameters
-  ($#_ < 0) or croak("Bad call");
+  # Get parameters
+  ($#_ <= 0) or croak("Bad call");
+  
+  my $hot = [];
+  if ($#_ >= 0) {
+    $hot = shift;
+    (ref($hot) eq 'ARRAY') or croak("Bad parameter type");
+    for my $r (@$hot) {
+      ((ref($r) eq 'ARRAY') and (scalar(@$r) == 2)) or
+        croak("Bad hot range");
+      (isInteger($r->[0]) and isInteger($r->[1])) or
+        croak("Bad hot range");
+      (($r->[0] >= 0) and ($r->[0] <= $r->[1])) or
+        croak("Bad hot range");
+    }
+  }
   
   # Update state
   $self->{'_done'} = 1;
   
-  # Recursively assign IDs and get the full table count
-  my $table_count = assignID($self->{'_q'}, 0);
+  # Merge identical tables
+  $self->{'_q'} = dedupTable($self->{'_q'}, 0, {});
+  
+  # Assign IDs to the tables of the hot ranges first, visiting each
+  # leaf table once, and then recursively assign IDs to all remaining
+  # tables and get the full table count
+  my $depth = $self->{'_depth'};
+  my $key_limit = 1 << (4 * $depth);
+  my $next_id = 0;
+  for my $r (@$hot) {
+    for(my $k = $r->[0] & ~0xf;
+        ($k <= $r->[1]) and ($k < $key_limit); $k += 16) {
+      $next_id = hotID($self->{'_q'}, $depth, $k, $next_id);
+    }
+  }
+  my $table_count = assignID($self->{'_q'}, $next_id);
   
   # Define the result array with all tables initially set to 0xFFFF
   # values indicating no record present
@@ -399,6 +621,69 @@ sub compile {
   return @result;
 }
 
+=item B<compileStage(shift [, \@hot])>
+
+Compile the trie to a two-stage table of unsigned 16-bit values.
+
+Two-stage tables are only supported for tries with a depth of at most 4.
+shift is the number of low bits of the key that select an element
+within a data block.  It must be an integer that is at least one and at
+most half the number of bits in the key, so that the index always fills
+a whole number of blocks.  For a trie of depth 4, a shift of 8 gives an
+8-bit/8-bit split and a shift of 5 gives an 11-bit/5-bit split.
+
+hot is an optional array reference of hot key ranges, which is passed
+through to the StageTable compiler.
+
+The return is the compiled array in list context.  See the StageTable
+module for the format of the array and how to query it.  An error occurs
+if the compiled array would have more than 65536 elements or if any
+block position does not fit in 16 bits.
+
+No further calls can be made to the object after it has been compiled.
+
+=cut
+
+sub compileStage {
+  # Get self
+  ($#_ >= 0) or croak("Bad call");
+  my $self = shift;
+  (ref($self) and $self->isa(__PACKAGE__)) or croak("Bad self");
+  
+  # Check state
+  ($self->{'_done'} == 0) or croak("Bad object state");
+  
+  # Get parameters
+  (($#_ == 0) or ($#_ == 1)) or croak("Bad call");
+  
+  my $shift = shift;
+  isInteger($shift) or croak("Bad parameter type");
+  
+  my $hot = [];
+  if ($#_ >= 0) {
+    $hot = shift;
+    (ref($hot) eq 'ARRAY') or croak("Bad parameter type");
+  }
+  
+  my $bits = $self->{'_depth'} * 4;
+  ($bits <= 16) or croak("Key too long for two-stage table");
+  (($shift >= 1) and ($shift * 2 <= $bits)) or
+    croak("Shift out of range");
+  
+  # Update state
+  $self->{'_done'} = 1;
+  
+  # Flatten the trie into an array covering the whole key space
+  my @flat = (0xFFFF) x (1 << $bits);
+  flatTable(\@flat, $self->{'_q'}, 0, $self->{'_depth'}, 0);
+  
+  # Clear internal data structures
+  $self->{'_q'} = undef;
+  
+  # Compile the flattened array
+  return StageTable->compile(\@flat, $shift, $hot);
+}
+
 =back
 
 =cut
@@ -2,10 +2,13 @@
 use v5.16;
 use warnings;
 
+use Digest::MD5;
 use Scalar::Util qw(looks_like_number);
+use Storable qw(nstore retrieve);
 
 use GeneralTable;
 use Trie;
+use StageTable;
 
 =head1 NAME
 
@@ -15,24 +18,52 @@ Database.
 =head1 SYNOPSIS
 
   unikit_db.pl case pretty UCD/CaseFolding.txt > case_table.txt
-  unikit_db.pl genchar b64 UCD/UnicodeData.txt > genchar.txt
+  unikit_db.pl casestage base64 UCD/CaseFolding.txt > case_stage.txt
+  unikit_db.pl casedelta base64 UCD/CaseFolding.txt > case_delta.txt
+  unikit_db.pl props base64 UCD/UnicodeData.txt UCD/CaseFolding.txt \
+    > props.txt
+  unikit_db.pl genchar base64 UCD/UnicodeData.txt > genchar.txt
+  unikit_db.pl genstage base64 UCD/UnicodeData.txt > genstage.txt
   unikit_db.pl astral pretty UCD/UnicodeData.txt > astral.txt
-  unikit_db.pl core b64 UCD/UnicodeData.txt > core.txt
+  unikit_db.pl astraldir pretty UCD/UnicodeData.txt > astraldir.txt
+  unikit_db.pl core array UCD/UnicodeData.txt > core.txt
   unikit_db.pl bitmap pretty UCD/UnicodeData.txt > bitmap.txt
+  unikit_db.pl unified base64 UCD/UnicodeData.txt > unified.txt
+  unikit_db.pl classes base64 UCD/UnicodeData.txt > classes.txt
   unikit_db.pl remainder pretty UCD/UnicodeData.txt > remainder.txt
+  unikit_db.pl inline UCD/UnicodeData.txt > unikit_inline.h
+  unikit_db.pl datafile 15.1.0 UCD/UnicodeData.txt UCD/CaseFolding.txt \
+    > unikit.dat
+  unikit_db.pl all out 15.1.0 UCD/UnicodeData.txt UCD/CaseFolding.txt
 
 =head1 DESCRIPTION
 
 The first parameter to this script selects the kind of Unikit data table
-that should be generated.  The second parameter to this script is either
-C<pretty> or C<base64> to select whether output should be in a readable
-format or in a base-64 C string literal format.
+that should be generated.  The second parameter to this script is
+C<pretty>, C<base64>, or C<array> to select whether output should be in
+a readable format, in a base-64 C string literal format, or in a C array
+initializer format.
+
+The base-64 format is what unikit_data.c stores by default and what
+unikit_init() decodes at startup.  The array format is the body of a
+C<static const uint16_t> array initializer, which unikit_data.c stores
+in the C<UNIKIT_STATIC_TABLES> build mode so that the tables can be used
+in place without any decoding.
 
 Following these initial parameters come one or more paths to specific
 data files in the Unicode Character Database which will be parsed.  The
 generated result is written to standard output.  This script is written
 against version 15.1 of the Unicode Character Database.
 
+All the tries and two-stage tables are compiled with the same list of
+hot codepoint ranges, which covers the scripts that dominate typical
+text: Latin, Greek, Cyrillic, general punctuation, and the CJK, kana and
+Hangul ranges.  The data blocks used by the hot ranges are stored first
+in each compiled array, right after the index, so that the part of each
+table that typical text touches is packed into a few cache lines.  The
+order of the blocks has no effect on lookups.  The list is HOT_RANGES in
+this script.
+
 The following subsections document the kind of data tables that can be
 generated and their format.
 
@@ -99,6 +130,77 @@ The 16-bit values that these tries map to are the two ASCII letters of
 the general category, with the first letter in the most significant byte
 and the second letter in the least significant byte.
 
+=head2 Two-stage tables
+
+The C<casestage> and C<genstage> invocations generate exactly the same
+tables as the C<case> and C<genchar> invocations, except that the tries
+are compiled as two-stage tables with a shift of 5, which is an
+11-bit/5-bit split of the 16-bit keys.  See the StageTable module for
+the details of how a two-stage table works.  The case folding data array
+is the same in both forms.
+
+Two-stage tables answer each query with two array lookups instead of
+four, at the cost of somewhat larger tables.  They are used by Unikit in
+the C<UNIKIT_STAGE_TABLES> build mode.
+
+=head2 Case folding delta table
+
+The case folding delta table is generated with the C<casedelta>
+invocation of the script.
+
+The case folding delta table is a faster path for the great majority of
+case foldings, which map a single codepoint to a single codepoint a
+small fixed distance away.  It consists of two two-stage tables with a
+shift of 5.
+
+The first two-stage table covers codepoints U+0000 to U+FFFF, while the
+second covers codepoints U+10000 to U+1FFFF, with the lower 16 bits of
+the codepoint as the key.  Each value is the 16-bit delta from the
+codepoint to its full case folding, computed modulo 0x10000.  Adding the
+delta to the lower 16 bits of the codepoint and keeping the 17th bit of
+the codepoint gives the case folding, so that codepoints without a case
+folding have a delta of zero.  The special value 0x8000 indicates
+instead that the full case folding is an expansion of more than one
+codepoint, which must be looked up in the case folding table.  No
+single-codepoint folding has a delta of 0x8000.
+
+=head2 Property table
+
+The property table is generated with the C<props> invocation of the
+script, which takes the path to C<UnicodeData.txt> followed by the path
+to C<CaseFolding.txt>.
+
+The table combines the properties that a tokenizer usually needs for
+every codepoint into a single record, so that one lookup answers them
+all: the general category, whether the codepoint has a case folding,
+and a few character class flags.  It does not replace the other
+tables, which hold the case foldings themselves and the rest of the
+properties.
+
+The table is a single two-stage table with a shift of 5.  The key is
+the codepoint for codepoints in range U+0000 to U+3FFFF, or the
+codepoint minus 0xA0000 for codepoints in range U+E0000 to U+E0FFF,
+which holds the tag characters and the variation selectors
+supplement.  All other codepoints are private use or unassigned, and
+have none of the flags.
+
+Each value has the unified category index of the general category in
+the 5 least significant bits, as listed for the unified category table.
+The flags are in the bits above them:
+
+  0x020 - the full case folding is not the codepoint itself
+  0x040 - the full case folding is more than one codepoint
+  0x080 - letter, which is a category in group L
+  0x100 - cased letter, which is Lu, Ll, or Lt
+  0x200 - number, which is a category in group N
+  0x400 - decimal digit, which is Nd
+  0x800 - white space
+
+The case folding flags are taken from the C and F records of the case
+folding file.  The white space flag is set for the separators in group
+Z and for the controls U+0009 to U+000D and U+0085, which is exactly
+the White_Space property of C<PropList.txt>.  The other bits are zero.
+
 =head2 Astral character table
 
 The astral character table is generated with the C<astral> invocation of
@@ -131,6 +233,30 @@ significant 8 bits.
 The range table records are sorted first by ascending plane and then by
 ascending ranges within the planes.
 
+=head2 Astral directory table
+
+The astral directory table is generated with the C<astraldir> invocation
+of the script.  It is an index into the astral character table that
+allows a record to be found without a binary search.
+
+Each astral plane from 0x0002 to 0x0010 is divided into 16 buckets of
+4096 codepoints.  The directory has one unsigned 16-bit element for each
+bucket, in ascending order of plane and then bucket, followed by one
+final element that is the total number of records in the astral
+character table.  This gives 241 elements.
+
+Each bucket element holds the index of the first astral record that is
+in the same plane as the bucket and has an upper offset that is at or
+beyond the first codepoint of the bucket.  If there is no such record,
+the element holds the index of the first record in a later plane, or
+the total record count if there are no later records.
+
+To look up an astral codepoint, start at the record selected by its
+bucket and scan forward.  The scan ends when the record is in a later
+plane, or when the lower offset of the record is beyond the codepoint.
+The bucket element that follows is an upper bound on the index of the
+record that contains the codepoint.
+
 =head2 Core character table
 
 The core character table is generated with the C<core> invocation of the
@@ -169,6 +295,145 @@ consulted in these cases, as well as the following fixed ranges:
   U+D800 to U+DFFF - Cs (surrogate)
   U+E000 to U+F8FF - Co (private use)
 
+=head2 Unified category table
+
+The unified category table is generated with the C<unified> invocation
+of the script.
+
+The unified category table covers every codepoint in range U+0000 to
+U+1FFFF with a single structure, so that it can replace the combination
+of the bitmap character table, the general character table, and the
+remainder character table.  Each codepoint is assigned an 8-bit category
+index, which is the position of its category in the following list:
+
+  Lu Ll Lt Lm Lo Mn Mc Me Nd Nl No Pc Pd Ps Pe
+  Pi Pf Po Sm Sc Sk So Zs Zl Zp Cc Cf Cs Co Cn
+
+Codepoints that are not listed in the data file receive the index of
+C<Cn>.  The category indices of each pair of adjacent codepoints are
+packed into one unsigned 16-bit integer, with the even codepoint in the
+least significant 8 bits and the odd codepoint in the most significant
+8 bits.  This gives 65536 packed integers, where the key of each integer
+is the codepoint shifted right by one.
+
+The packed integers are compiled into a two-stage table with a shift of
+4.  See the StageTable module for the details of how a two-stage table
+works.  The unified category table is used by Unikit in the
+C<UNIKIT_UNIFIED_GCAT> build mode.
+
+=head2 Character class tables
+
+The character class tables are generated with the C<classes> invocation
+of the script.
+
+Each character class table is a bitset over every codepoint in range
+U+0000 to U+10FFFF, where the bit of a codepoint is set if its general
+category belongs to the class.  Four tables are generated, for the
+following classes in this order:
+
+  L  : Lu Ll Lt Lm Lo
+  N  : Nd Nl No
+  Z  : Zs Zl Zp
+  LC : Lu Ll Lt
+
+The bits are packed into 69632 unsigned 16-bit integers, where integer
+I<k> holds the bits of codepoints 16I<k> to 16I<k>+15, with the lowest
+codepoint in the least significant bit.  Codepoints that are not listed
+in the data file have the category C<Cn>, which belongs to none of the
+classes.
+
+The packed integers are compiled into a two-stage table with a shift of
+5, so that each data block covers 512 codepoints.  See the StageTable
+module for the details of how a two-stage table works.  To test a
+codepoint:
+
+  word = arr[(arr[cv >> 9] << 5) + ((cv >> 4) & 31)]
+  bit  = (word >> (cv & 15)) & 1
+
+The same table format is used for the character classes that Unikit
+compiles at runtime with C<unikit_class_compile()>.
+
+=head2 Inline header
+
+The inline header is generated with the C<inline> invocation of the
+script.  Instead of a style and a data file path, this invocation only
+takes the path to C<UnicodeData.txt>.  The complete C<unikit_inline.h>
+header is written to standard output.
+
+The header holds the core character table described below in the array
+format, so that the inline functions of the header can be evaluated by
+the compiler.
+
+=head2 Binary data file
+
+The binary data file is generated with the C<datafile> invocation of the
+script.  Instead of a style and a single data file path, this invocation
+takes the version of the Unicode Character Database, such as C<15.1.0>,
+followed by the path to C<UnicodeData.txt> and the path to
+C<CaseFolding.txt>.  The binary file is written to standard output.
+
+The binary data file holds every table described in this documentation,
+in exactly the same form as in the generated C source, so that Unikit
+can map the file into memory with C<unikit_init_mapped()> and use the
+tables in place.  All integers in the file are little endian.  The
+file begins with a 16-byte header:
+
+  1. Magic: the four ASCII characters "UKDB"
+  2. Byte order mark: 16-bit integer 0xFEFF
+  3. Format version: 16-bit integer, currently 4
+  4. UCD major version: 16-bit integer
+  5. UCD minor version: 8-bit integer
+  6. UCD update version: 8-bit integer
+  7. Table count: 32-bit integer
+
+The header is followed by the table directory, which has one 16-byte
+record for each table, in ascending order of data key:
+
+  1. Data key: 32-bit integer
+  2. Offset: 32-bit integer
+  3. Length: 32-bit integer
+  4. Checksum: 32-bit integer
+
+The data key is one of the C<UNIKIT_DATA_KEY> constants defined in
+C<unikit_data.h>.  The offset is the byte offset of the table from the
+start of the file, which is always a multiple of 64.  The length is the
+number of 16-bit integers in the table.  The checksum is the 32-bit
+FNV-1a hash of the table bytes as stored in the file.
+
+The tables follow the directory.  Each table is an array of 16-bit
+integers at its recorded offset, and the space between tables is
+filled with zero bytes.
+
+=head2 All outputs
+
+Every generated output is written in a single run with the C<all>
+invocation of the script.  Instead of a style and a single data file
+path, this invocation takes the path to an existing output directory,
+followed by the same parameters as the C<datafile> invocation.  The
+invocation writes the following files to the output directory:
+
+  1. unikit_data.c - the complete data module
+  2. unikit_inline.h - the same header as the inline invocation
+  3. unikit.dat - the same file as the datafile invocation
+
+The data module holds every table of the data file, both as base-64
+string literals and as constant arrays, along with the functions that
+return them.  It is the same as the C<unikit_data.c> source file that
+is shipped with Unikit.  The declarations in C<unikit_data.h> do not
+depend on the Unicode Character Database, so that header is not
+generated.
+
+Each data file is only parsed once per run, no matter how many tables
+are built from it.  The tables are built in groups, where each group
+depends on a fixed set of the data files.  The tables of each group
+are stored in a cache file named C<unikit_db.cache> in the output
+directory, along with an MD5 digest of the data files of the group
+and of the source of this script and its modules.  On later runs, a
+group whose digest is unchanged reuses its cached tables without
+parsing anything.  An output file is only rewritten if its contents
+change.  A line for each group and each output file is reported to
+standard error.
+
 =head2 Remainder character table
 
 The remainder character table lists all defined category records that
@@ -187,6 +452,134 @@ encoding a data table.
 
 =cut
 
+# =========
+# Constants
+# =========
+
+# The shift of the two-stage tables generated by the casestage and
+# genstage modes.  This must match STAGE_SHIFT in unikit.c.
+#
+use constant STAGE_SHIFT => 5;
+
+# The shift of the two-stage table generated by the unified mode.  This
+# must match UNIFIED_SHIFT in unikit.c.
+#
+use constant UNIFIED_SHIFT => 4;
+
+# The number of low bits of the plane offset that select a codepoint
+# within a bucket of the astral directory.  This must match
+# ASTRAL_BUCKET_SHIFT in unikit.c.
+#
+use constant ASTRAL_BUCKET_SHIFT => 12;
+
+# The format version of the binary data file generated by the datafile
+# mode, and the alignment in bytes of each table within the file.  These
+# must match DATAFILE_VERSION and DATAFILE_ALIGN in unikit.c.  The
+# version must be raised whenever a table is added to the data file or
+# the layout of a table changes.
+#
+use constant DATAFILE_VERSION => 4;
+use constant DATAFILE_ALIGN => 64;
+
+# The shift of the two-stage tables generated by the classes mode.  This
+# must match CLASS_SHIFT in unikit.c.
+#
+use constant CLASS_SHIFT => 5;
+
+# The shift of the two-stage table generated by the props mode, the
+# number of keys that the table covers, and the parts of the packed
+# property values.  These must match the PROPS constants in unikit.c.
+#
+use constant PROPS_SHIFT => 5;
+use constant PROPS_KEYS => 0x41000;
+use constant PROPS_FLAG_SHIFT => 5;
+use constant PROPS_FOLD => 0x01;
+use constant PROPS_EXPAND => 0x02;
+use constant PROPS_LETTER => 0x04;
+use constant PROPS_CASED => 0x08;
+use constant PROPS_NUMBER => 0x10;
+use constant PROPS_DIGIT => 0x20;
+use constant PROPS_SPACE => 0x40;
+
+# The general categories in the order of their unified category
+# indices.  This must match the order of the category list in unikit.c.
+#
+use constant UNIFIED_CATS => qw(
+  Lu Ll Lt Lm Lo
+  Mn Mc Me
+  Nd Nl No
+  Pc Pd Ps Pe Pi Pf Po
+  Sm Sc Sk So
+  Zs Zl Zp
+  Cc Cf Cs Co Cn
+);
+
+# The hot codepoint ranges, in order of decreasing priority, whose data
+# blocks are stored first in every compiled trie and two-stage table.
+# See hot_keys().
+#
+use constant HOT_RANGES => (
+  [0x0000, 0x007F],   # Basic Latin
+  [0x0080, 0x024F],   # Latin-1 Supplement, Latin Extended-A and B
+  [0x0300, 0x036F],   # Combining Diacritical Marks
+  [0x0370, 0x03FF],   # Greek and Coptic
+  [0x0400, 0x052F],   # Cyrillic and Cyrillic Supplement
+  [0x1E00, 0x1EFF],   # Latin Extended Additional
+  [0x2000, 0x206F],   # General Punctuation
+  [0x3000, 0x30FF],   # CJK Symbols and Punctuation, Hiragana, Katakana
+  [0x4E00, 0x9FFF],   # CJK Unified Ideographs
+  [0xAC00, 0xD7AF],   # Hangul Syllables
+  [0xFF00, 0xFFEF]    # Halfwidth and Fullwidth Forms
+);
+
+# The data tables of the data module, in ascending order of data key.
+# Each table has its data key and its name.  The name prefixed with
+# "db_" is the variable of the table in unikit_data.c, and the name in
+# uppercase prefixed with "UNIKIT_DATA_KEY_" is its data key constant.
+# These must match unikit_data.h.
+#
+use constant DATA_TABLES => (
+  [100, 'case_lower'],
+  [101, 'case_upper'],
+  [102, 'case_data'],
+  [103, 'case_lower_stage'],
+  [104, 'case_upper_stage'],
+  [105, 'case_delta_lower'],
+  [106, 'case_delta_upper'],
+  [200, 'gcat_core'],
+  [201, 'gcat_gen_low'],
+  [202, 'gcat_gen_high'],
+  [203, 'gcat_bitmap'],
+  [204, 'gcat_astral'],
+  [205, 'gcat_gen_low_stage'],
+  [206, 'gcat_gen_high_stage'],
+  [207, 'gcat_unified'],
+  [208, 'gcat_astral_dir'],
+  [300, 'class_l'],
+  [301, 'class_n'],
+  [302, 'class_z'],
+  [303, 'class_lc'],
+  [600, 'props']
+);
+
+# The groups of data tables that are built together, each with the
+# names of the data files it is built from.  The tables of a group are
+# only rebuilt by the all mode when one of these files has changed.
+#
+use constant TABLE_GROUPS => (
+  ['case', 'casefold'],
+  ['casedelta', 'casefold'],
+  ['gcat', 'ucdata'],
+  ['classes', 'ucdata'],
+  ['props', 'ucdata', 'casefold']
+);
+
+# The name of the table cache file that the all mode keeps in its
+# output directory, and the format version of the cache.
+#
+use constant CACHE_NAME => 'unikit_db.cache';
+use constant CACHE_FORMAT => 1;
+
 # ===============
 # Local functions
 # ===============
@@ -207,6 +600,53 @@ sub isInteger {
   return 1;
 }
 
+# hot_keys(offset, shift, limit)
+# ------------------------------
+#
+# Translate the HOT_RANGES into hot key ranges for the compilers of the
+# Trie and StageTable modules.
+#
+# The key of codepoint cv in the table is ((cv - offset) >> shift),
+# and limit is the number of keys.  Ranges are clipped to the keys of
+# the table, and ranges that are entirely outside it are dropped.  The
+# return value is the list of key ranges in list context, each an array
+# reference holding the first and last key.
+#
+sub hot_keys {
+  # Get parameters
+  ($#_ == 2) or die "Bad call";
+  
+  my $offset = shift;
+  isInteger($offset) or die "Bad call";
+  
+  my $shift = shift;
+  isInteger($shift) or die "Bad call";
+  
+  my $limit = shift;
+  isInteger($limit) or die "Bad call";
+  
+  # Translate and clip each range
+  my @result;
+  for my $r (HOT_RANGES) {
+    my $lo = $r->[0] - $offset;
+    my $hi = $r->[1] - $offset;
+    (($hi >= 0) and (($lo >> $shift) < $limit)) or next;
+    
+    if ($lo < 0) {
+      $lo = 0;
+    }
+    $lo = $lo >> $shift;
+    $hi = $hi >> $shift;
+    if ($hi >= $limit) {
+      $hi = $limit - 1;
+    }
+    push @result, ([$lo, $hi]);
+  }
+  
+  # Return results
+  return @result;
+}
+
 # base64_table()
 # --------------
 #
@@ -257,8 +697,8 @@ sub encode_category {
   return (($upper << 8) | $lower);
 }
 
-# print_array16(\@ar, $use_b64)
-# -----------------------------
+# print_array16(\@ar, $style)
+# ---------------------------
 #
 # Print an array of unsigned 16-bit integers.
 #
@@ -266,9 +706,8 @@ sub encode_category {
 # most 65536 elements.  Each element must be a scalar integer that is in
 # range 0x0000 to 0xFFFF.
 #
-# use_b64 is an integer that is either 0 (false) or 1 (true).  If false,
-# then the array is printed in pretty format.  If true, then the array
-# is printed in base64 C literal format.
+# style is an integer that is either 0 (pretty), 1 (base64), or 2
+# (array).  It selects the format that the array is printed in.
 #
 # Pretty format begins each line with four base-16 characters indicating
 # the integer offset of the first integer in the line.  There are up to
@@ -278,6 +717,10 @@ sub encode_category {
 # line's literal contains up to 64 base-64 characters.  16-bit integers
 # are encoded in big endian format.
 #
+# Array format is the body of a C array initializer for a uint16_t
+# array, without the surrounding braces.  There are up to eight integers
+# on each line, written as base-16 C literals separated by commas.
+#
 sub print_array16 {
   # Get parameters
   ($#_ == 1) or die "Bad call";
@@ -287,12 +730,41 @@ sub print_array16 {
   ((scalar(@$ar) > 0) and (scalar(@$ar) <= 65536)) or
     die "Array length out of range";
   
-  my $use_b64 = shift;
-  isInteger($use_b64) or die "Bad parameter type";
-  (($use_b64 == 0) or ($use_b64 == 1)) or die "Parameter out of range";
+  my $style = shift;
+  isInteger($style) or die "Bad parameter type";
+  (($style >= 0) and ($style <= 2)) or die "Parameter out of range";
   
   # Print requested format
-  if ($use_b64) {
+  if ($style == 2) {
+    # C array initializer format, so print each integer individually
+    # with up to eight integers on each line
+    for(my $i = 0; $i < scalar(@$ar); $i++) {
+      # Get current element and check
+      my $e = $ar->[$i];
+      isInteger($e) or die "Wrong element type";
+      (($e >= 0) and ($e <= 0xFFFF)) or die "Element out of range";
+      
+      # If element index is multiple of eight, print line header; else,
+      # print space separator
+      if (($i % 8) == 0) {
+        print "  ";
+      } else {
+        print " ";
+      }
+      
+      # Print current element, followed by a comma if not the last
+      printf "0x%04x", $e;
+      if ($i < scalar(@$ar) - 1) {
+        print ",";
+      }
+      
+      # Print line break after every eighth element and after the last
+      if (((($i + 1) % 8) == 0) or ($i == scalar(@$ar) - 1)) {
+        print "\n";
+      }
+    }
+    
+  } elsif ($style == 1) {
     # Base-64 C literal format, so each line will encode up to 24 16-bit
     # integers, which will result in up to 64 base-64 digits per line
     my @encode_table = base64_table();
@@ -476,23 +948,19 @@ sub do_remainder {
   }
 }
 
-# do_bitmap(path_unicodedata, use_b64)
-# ------------------------------------
+# build_bitmap(path_unicodedata)
+# ------------------------------
 #
-# Generate the character bitmap table.
+# Build the character bitmap table and return it in list context.
 #
-sub do_bitmap {
+sub build_bitmap {
   # Get parameters
-  ($#_ == 1) or die "Bad call";
+  ($#_ == 0) or die "Bad call";
   
   my $path_ucdata = shift;
   (not ref($path_ucdata)) or die "Bad call";
   (-f $path_ucdata) or die "Failed to find file '$path_ucdata'";
   
-  my $use_b64 = shift;
-  isInteger($use_b64) or die "Bad call";
-  (($use_b64 == 0) or ($use_b64 == 1)) or die "Bad param";
-  
   # Open general table parser
   my $parse = GeneralTable->parse($path_ucdata);
   
@@ -553,27 +1021,222 @@ sub do_bitmap {
     }
   }
   
-  # Print bitmap
-  print "Character bitmap:\n\n";
-  print_array16(\@table, $use_b64);
+  # Return bitmap
+  return @table;
 }
 
-# do_core(path_unicodedata, use_b64)
+# do_bitmap(path_unicodedata, style)
 # ----------------------------------
 #
-# Generate the core character table.
+# Generate the character bitmap table.
 #
-sub do_core {
+sub do_bitmap {
+  # Get parameters
+  ($#_ == 1) or die "Bad call";
+  
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  
+  my $style = shift;
+  isInteger($style) or die "Bad call";
+  (($style >= 0) and ($style <= 2)) or die "Bad param";
+  
+  # Build and print bitmap
+  my @table = build_bitmap($path_ucdata);
+  print "Character bitmap:\n\n";
+  print_array16(\@table, $style);
+}
+
+# build_unified(path_unicodedata)
+# -------------------------------
+#
+# Build the unified category table and return it in list context.
+#
+sub build_unified {
+  # Get parameters
+  ($#_ == 0) or die "Bad call";
+  
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  (-f $path_ucdata) or die "Failed to find file '$path_ucdata'";
+  
+  # Build a hash mapping each category name to its category index
+  my @cat_names = (UNIFIED_CATS);
+  my %cat_index;
+  for(my $i = 0; $i < scalar(@cat_names); $i++) {
+    $cat_index{$cat_names[$i]} = $i;
+  }
+  
+  # Define a category index for every codepoint in range U+0000 to
+  # U+1FFFF, with everything starting out as Cn (unassigned)
+  my @cats;
+  for(my $i = 0; $i < 0x20000; $i++) {
+    push @cats, ($cat_index{'Cn'});
+  }
+  
+  # Open general table parser
+  my $parse = GeneralTable->parse($path_ucdata);
+  
+  # Parse records
+  for(my $rec = $parse->readRec; defined $rec; $rec = $parse->readRec) {
+    
+    # If record is beyond unified range, we are done
+    if ($rec->{'lbound'} > 0x1ffff) {
+      last;
+    }
+    
+    # Make sure record fully in unified range
+    ($rec->{'ubound'} <= 0x1ffff) or
+      die "Record overlaps unified range boundary";
+    
+    # Get the category index
+    defined $cat_index{$rec->{'gencat'}} or
+      die "Unrecognized category '$rec->{'gencat'}'";
+    my $ci = $cat_index{$rec->{'gencat'}};
+    
+    # Assign the index to all codepoints in range
+    for(my $cv = $rec->{'lbound'}; $cv <= $rec->{'ubound'}; $cv++) {
+      $cats[$cv] = $ci;
+    }
+  }
+  
+  # Pack pairs of category indices into 16-bit values, with the even
+  # codepoint in the least significant byte
+  my @packed;
+  for(my $i = 0; $i < 0x10000; $i++) {
+    push @packed, ($cats[$i * 2] | ($cats[$i * 2 + 1] << 8));
+  }
+  
+  # Compile into a two-stage table
+  my @table = StageTable->compile(
+                \@packed, UNIFIED_SHIFT, [hot_keys(0, 1, 0x10000)]);
+  
+  # Return table
+  return @table;
+}
+
+# do_unified(path_unicodedata, style)
+# -----------------------------------
+#
+# Generate the unified category table.
+#
+sub do_unified {
   # Get parameters
   ($#_ == 1) or die "Bad call";
   
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  
+  my $style = shift;
+  isInteger($style) or die "Bad call";
+  (($style >= 0) and ($style <= 2)) or die "Bad param";
+  
+  # Build and print table
+  my @table = build_unified($path_ucdata);
+  print "Unified category table:\n\n";
+  print_array16(\@table, $style);
+}
+
+# build_classes(path_unicodedata)
+# -------------------------------
+#
+# Build the character class tables and return them in list context as
+# array references, in the order L, N, Z, LC.
+#
+sub build_classes {
+  # Get parameters
+  ($#_ == 0) or die "Bad call";
+  
   my $path_ucdata = shift;
   (not ref($path_ucdata)) or die "Bad call";
   (-f $path_ucdata) or die "Failed to find file '$path_ucdata'";
   
-  my $use_b64 = shift;
-  isInteger($use_b64) or die "Bad call";
-  (($use_b64 == 0) or ($use_b64 == 1)) or die "Bad param";
+  # Define the categories of each class
+  my @class_cats = (
+    [qw(Lu Ll Lt Lm Lo)],
+    [qw(Nd Nl No)],
+    [qw(Zs Zl Zp)],
+    [qw(Lu Ll Lt)]
+  );
+  
+  # Start every class out with all bits clear
+  my @words;
+  for(my $i = 0; $i < scalar(@class_cats); $i++) {
+    my @w = (0) x 0x11000;
+    push @words, (\@w);
+  }
+  
+  # Open general table parser
+  my $parse = GeneralTable->parse($path_ucdata);
+  
+  # Set the bits of each record in every class that has its category
+  for(my $rec = $parse->readRec; defined $rec; $rec = $parse->readRec) {
+    for(my $i = 0; $i < scalar(@class_cats); $i++) {
+      (grep { $_ eq $rec->{'gencat'} } @{$class_cats[$i]}) or next;
+      
+      for(my $cv = $rec->{'lbound'}; $cv <= $rec->{'ubound'}; $cv++) {
+        $words[$i]->[$cv >> 4] |= (1 << ($cv & 0xf));
+      }
+    }
+  }
+  
+  # Compile each class into a two-stage table
+  my @result;
+  for my $w (@words) {
+    my @table = StageTable->compile(
+                  $w, CLASS_SHIFT, [hot_keys(0, 4, 0x11000)]);
+    push @result, (\@table);
+  }
+  
+  # Return tables
+  return @result;
+}
+
+# do_classes(path_unicodedata, style)
+# -----------------------------------
+#
+# Generate the character class tables.
+#
+sub do_classes {
+  # Get parameters
+  ($#_ == 1) or die "Bad call";
+  
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  
+  my $style = shift;
+  isInteger($style) or die "Bad call";
+  (($style >= 0) and ($style <= 2)) or die "Bad param";
+  
+  # Build and print tables
+  my ($class_l, $class_n, $class_z, $class_lc) =
+    build_classes($path_ucdata);
+  
+  print "L class:\n\n";
+  print_array16($class_l, $style);
+  
+  print "\nN class:\n\n";
+  print_array16($class_n, $style);
+  
+  print "\nZ class:\n\n";
+  print_array16($class_z, $style);
+  
+  print "\nLC class:\n\n";
+  print_array16($class_lc, $style);
+}
+
+# build_core(path_unicodedata)
+# ----------------------------
+#
+# Build the core character table and return it in list context.
+#
+sub build_core {
+  # Get parameters
+  ($#_ == 0) or die "Bad call";
+  
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  (-f $path_ucdata) or die "Failed to find file '$path_ucdata'";
   
   # Open general table parser
   my $parse = GeneralTable->parse($path_ucdata);
@@ -616,27 +1279,194 @@ sub do_core {
     ($table[$i] != 0x436E) or die "Unassigned core record";
   }
   
-  # Print table
-  print "Core table:\n\n";
-  print_array16(\@table, $use_b64);
+  # Return table
+  return @table;
 }
 
-# do_astral(path_unicodedata, use_b64)
-# ------------------------------------
+# do_core(path_unicodedata, style)
+# --------------------------------
 #
-# Generate the astral character table.
+# Generate the core character table.
 #
-sub do_astral {
+sub do_core {
   # Get parameters
   ($#_ == 1) or die "Bad call";
   
   my $path_ucdata = shift;
   (not ref($path_ucdata)) or die "Bad call";
-  (-f $path_ucdata) or die "Failed to find file '$path_ucdata'";
   
-  my $use_b64 = shift;
-  isInteger($use_b64) or die "Bad call";
-  (($use_b64 == 0) or ($use_b64 == 1)) or die "Bad param";
+  my $style = shift;
+  isInteger($style) or die "Bad call";
+  (($style >= 0) and ($style <= 2)) or die "Bad param";
+  
+  # Build and print table
+  my @table = build_core($path_ucdata);
+  print "Core table:\n\n";
+  print_array16(\@table, $style);
+}
+
+# do_inline(path_unicodedata)
+# ---------------------------
+#
+# Generate the inline header, unikit_inline.h, and write it to standard
+# output.
+#
+sub do_inline {
+  # Get parameters
+  ($#_ == 0) or die "Bad call";
+  
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  
+  # Build the core table
+  my @core = build_core($path_ucdata);
+  
+  # Print the header, with the table in array format
+  print <<'EOT';
+#ifndef UNIKIT_INLINE_H_INCLUDED
+#define UNIKIT_INLINE_H_INCLUDED
+
+/*
+ * unikit_inline.h
+ * ===============
+ * 
+ * Inline lookups for the core range of the Unikit library.
+ * 
+ * This header is generated by the inline mode of the unikit_db.pl
+ * script.  Do not edit it by hand, but regenerate it along with the
+ * unikit_data.c tables.
+ * 
+ * The functions of this header answer queries on codepoints in range
+ * U+0000 to U+00FF from a constant table held in the header itself, and
+ * pass every other codepoint on to the matching function of unikit.h.
+ * The core path is a static inline function reading a constant array,
+ * so compilers can inline it into the loops of the caller, and fold it
+ * away entirely when the codepoint is a constant.  When the header is
+ * compiled as C++11 or later, the table and functions are constexpr,
+ * so queries on constant codepoints in the core range may be used in
+ * constant expressions such as static_assert.
+ * 
+ * The results are the same as those of the unikit.h functions.  The
+ * core path does not require the module to be initialized, but the
+ * other codepoints are subject to the requirements of the matching
+ * unikit.h function.
+ * 
+ * Requirements
+ * ------------
+ * 
+ * Requires the unikit library, which consists of the unikit.c and
+ * unikit_data.c modules, for codepoints outside the core range.
+ */
+
+#include "unikit.h"
+
+/*
+ * Storage of the table and functions of this header: constexpr in
+ * C++11 and later, or static and inline in C.
+ */
+#if defined(__cplusplus) && (__cplusplus >= 201103L)
+#define UNIKIT_INLINE_DATA static constexpr
+#define UNIKIT_INLINE static constexpr
+#else
+#define UNIKIT_INLINE_DATA static const
+#define UNIKIT_INLINE static inline
+#endif
+
+/*
+ * The general categories of U+0000 to U+00FF, in the format of the
+ * UNIKIT_GCAT constants.
+ */
+UNIKIT_INLINE_DATA uint16_t unikit_inline_core[256] = {
+EOT
+  print_array16(\@core, 2);
+  print <<'EOT';
+};
+
+/*
+ * Inline version of unikit_valid().
+ * 
+ * Parameters:
+ * 
+ *   cv - the integer value to check
+ * 
+ * Return:
+ * 
+ *   non-zero if valid codepoint, zero if not
+ */
+UNIKIT_INLINE int unikit_valid_inline(int32_t cv) {
+  return ((cv >= 0) && (cv <= 0x10ffff) &&
+          ((cv < 0xd800) || (cv > 0xdfff))) ? 1 : 0;
+}
+
+/*
+ * Inline version of unikit_category().
+ * 
+ * Parameters:
+ * 
+ *   cv - the integer value to query
+ * 
+ * Return:
+ * 
+ *   the general category
+ */
+UNIKIT_INLINE uint16_t unikit_category_inline(int32_t cv) {
+  return ((cv >= 0) && (cv <= 0xff)) ?
+            unikit_inline_core[cv] : unikit_category(cv);
+}
+
+/*
+ * Inline version of testing a standard character class.
+ * 
+ * cls is one of the UNIKIT_CLASS constants.  The result is the same as
+ * calling unikit_class_test() on the class returned by
+ * unikit_class_std(), which is only done for codepoints outside the
+ * core range.
+ * 
+ * Parameters:
+ * 
+ *   cls - the standard character class
+ * 
+ *   cv - the integer value to test
+ * 
+ * Return:
+ * 
+ *   non-zero if the codepoint is in the class, zero if not
+ */
+UNIKIT_INLINE int unikit_class_test_inline(int cls, int32_t cv) {
+  return ((cv >= 0) && (cv <= 0xff)) ?
+    ((cls == UNIKIT_CLASS_L) ?
+        (((unikit_inline_core[cv] >> 8) == 'L') ? 1 : 0) :
+      (cls == UNIKIT_CLASS_N) ?
+        (((unikit_inline_core[cv] >> 8) == 'N') ? 1 : 0) :
+      (cls == UNIKIT_CLASS_Z) ?
+        (((unikit_inline_core[cv] >> 8) == 'Z') ? 1 : 0) :
+        (((unikit_inline_core[cv] == UNIKIT_GCAT_Lu) ||
+          (unikit_inline_core[cv] == UNIKIT_GCAT_Ll) ||
+          (unikit_inline_core[cv] == UNIKIT_GCAT_Lt)) ? 1 : 0)) :
+    unikit_class_test(unikit_class_std(cls), cv);
+}
+
+#endif
+EOT
+}
+
+# astral_records(path_unicodedata)
+# --------------------------------
+#
+# Parse the astral range records from the given UnicodeData.txt file.
+#
+# The return value is a list of array references in list context, each
+# of which is a range record of the astral character table holding the
+# plane, lower offset, upper offset, and encoded category in that order.
+# The records are sorted and adjacent records are merged where possible.
+#
+sub astral_records {
+  # Get parameters
+  ($#_ == 0) or die "Bad call";
+  
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  (-f $path_ucdata) or die "Failed to find file '$path_ucdata'";
   
   # Open general table parser
   my $parse = GeneralTable->parse($path_ucdata);
@@ -666,8 +1496,8 @@ sub do_astral {
     ($lbound_plane == $ubound_plane) or die "Astral plane overlap";
     my $plane = $lbound_plane;
     
-    $rec->{'lbound'} &= 0xffff;
-    $rec->{'ubound'} &= 0xffff;
+    my $lbound = $rec->{'lbound'} & 0xffff;
+    my $ubound = $rec->{'ubound'} & 0xffff;
     
     # Get category code
     my $catcode = encode_category($rec->{'gencat'});
@@ -676,8 +1506,8 @@ sub do_astral {
     if (scalar(@table) < 1) {
       push @table, ([
             $plane,
-            $rec->{'lbound'},
-            $rec->{'ubound'},
+            $lbound,
+            $ubound,
             $catcode
       ]);
       next;
@@ -687,27 +1517,51 @@ sub do_astral {
     # records is proper
     ($table[-1]->[0] <= $plane) or die "Records out of order";
     if ($table[-1]->[0] == $plane) {
-      ($table[-1]->[2] < $rec->{'lbound'}) or
+      ($table[-1]->[2] < $lbound) or
         die "Records out of order";
     }
     
     # If we can merge this new record into the last range, do that
     if (($table[-1]->[0] == $plane) and
-        ($table[-1]->[2] == $rec->{'lbound'} - 1) and
+        ($table[-1]->[2] == $lbound - 1) and
         ($table[-1]->[3] == $catcode)) {
-      $table[-1]->[2] = $rec->{'ubound'};
+      $table[-1]->[2] = $ubound;
       next;
     }
     
     # If we got here, add record range as-is
     push @table, ([
       $plane,
-      $rec->{'lbound'},
-      $rec->{'ubound'},
+      $lbound,
+      $ubound,
       $catcode
     ]);
   }
   
+  # Return the records
+  return @table;
+}
+
+# do_astral(path_unicodedata, style)
+# ----------------------------------
+#
+# Generate the astral character table.
+#
+sub do_astral {
+  # Get parameters
+  ($#_ == 1) or die "Bad call";
+  
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  (-f $path_ucdata) or die "Failed to find file '$path_ucdata'";
+  
+  my $style = shift;
+  isInteger($style) or die "Bad call";
+  (($style >= 0) and ($style <= 2)) or die "Bad param";
+  
+  # Get the astral records
+  my @table = astral_records($path_ucdata);
+  
   # Print table
   print "Astral table:\n\n";
     
@@ -718,38 +1572,109 @@ sub do_astral {
   }
   
   # Print the table
-  print_array16(\@flat, $use_b64);
+  print_array16(\@flat, $style);
 }
 
-# do_genchar(path_unicodedata, use_b64)
-# -------------------------------------
+# build_astraldir(path_unicodedata)
+# ---------------------------------
 #
-# Generate the general character table.  See the module documentation
-# for exclusions that are not covered in the general character table.
+# Build the astral directory table and return it in list context.
 #
-sub do_genchar {
+sub build_astraldir {
   # Get parameters
-  ($#_ == 1) or die "Bad call";
+  ($#_ == 0) or die "Bad call";
   
   my $path_ucdata = shift;
   (not ref($path_ucdata)) or die "Bad call";
   (-f $path_ucdata) or die "Failed to find file '$path_ucdata'";
   
-  my $use_b64 = shift;
-  isInteger($use_b64) or die "Bad call";
-  (($use_b64 == 0) or ($use_b64 == 1)) or die "Bad param";
-  
-  # Open general table parser
-  my $parse = GeneralTable->parse($path_ucdata);
+  # Get the astral records
+  my @table = astral_records($path_ucdata);
+  (scalar(@table) < 0xFFFF) or die "Too many astral records";
+  
+  # Build the directory with one entry per bucket, each holding the
+  # index of the first record that is in the same plane as the bucket
+  # and whose upper offset is at or beyond the start of the bucket, or
+  # else the index of the first record in a later plane
+  my $bucket_count = 0x10000 >> ASTRAL_BUCKET_SHIFT;
+  my @dir;
+  my $ri = 0;
+  for(my $plane = 2; $plane <= 0x10; $plane++) {
+    for(my $b = 0; $b < $bucket_count; $b++) {
+      my $start = $b << ASTRAL_BUCKET_SHIFT;
+      while (($ri < scalar(@table)) and
+              (($table[$ri]->[0] < $plane) or
+                (($table[$ri]->[0] == $plane) and
+                  ($table[$ri]->[2] < $start)))) {
+        $ri++;
+      }
+      push @dir, ($ri);
+    }
+  }
   
-  # Define tries for upper and lower ranges, each with a nybble depth of
-  # four
-  my $table_upper = Trie->create(4);
-  my $table_lower = Trie->create(4);
+  # Final entry is the total number of records
+  push @dir, (scalar(@table));
   
-  # Parse records
-  for(my $rec = $parse->readRec; defined $rec; $rec = $parse->readRec) {
-    
+  # Return the directory
+  return @dir;
+}
+
+# do_astraldir(path_unicodedata, style)
+# -------------------------------------
+#
+# Generate the astral directory table.
+#
+sub do_astraldir {
+  # Get parameters
+  ($#_ == 1) or die "Bad call";
+  
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  
+  my $style = shift;
+  isInteger($style) or die "Bad call";
+  (($style >= 0) and ($style <= 2)) or die "Bad param";
+  
+  # Build and print the directory
+  my @dir = build_astraldir($path_ucdata);
+  print "Astral directory:\n\n";
+  print_array16(\@dir, $style);
+}
+
+# build_genchar(path_unicodedata, shift)
+# --------------------------------------
+#
+# Build the general character table.  See the module documentation for
+# exclusions that are not covered in the general character table.
+#
+# shift is zero to compile the tables as nybble tries, or else the shift
+# of two-stage tables to compile instead.
+#
+# The return value in list context is two array references, the first
+# to the lower index and the second to the upper index.
+#
+sub build_genchar {
+  # Get parameters
+  ($#_ == 1) or die "Bad call";
+  
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  (-f $path_ucdata) or die "Failed to find file '$path_ucdata'";
+  
+  my $shift = shift;
+  isInteger($shift) or die "Bad call";
+  
+  # Open general table parser
+  my $parse = GeneralTable->parse($path_ucdata);
+  
+  # Define tries for upper and lower ranges, each with a nybble depth of
+  # four
+  my $table_upper = Trie->create(4);
+  my $table_lower = Trie->create(4);
+  
+  # Parse records
+  for(my $rec = $parse->readRec; defined $rec; $rec = $parse->readRec) {
+    
     # Skip codepoints that are not in range U+0100 to U+20000
     ($rec->{'ubound'} >= 0x100) or next;
     ($rec->{'lbound'} < 0x20000) or next;
@@ -794,23 +1719,67 @@ sub do_genchar {
   }
   
   # Compile the two tries
-  my @index_upper = $table_upper->compile;
-  my @index_lower = $table_lower->compile;
+  my @index_upper;
+  my @index_lower;
+  my @hot_upper = hot_keys(0x10000, 0, 0x10000);
+  my @hot_lower = hot_keys(0, 0, 0x10000);
+  if ($shift > 0) {
+    @index_upper = $table_upper->compileStage($shift, \@hot_upper);
+    @index_lower = $table_lower->compileStage($shift, \@hot_lower);
+  } else {
+    @index_upper = $table_upper->compile(\@hot_upper);
+    @index_lower = $table_lower->compile(\@hot_lower);
+  }
   
-  # Print the tries and the data table
+  # Return the tries
+  return (\@index_lower, \@index_upper);
+}
+
+# do_genchar(path_unicodedata, style, shift)
+# ------------------------------------------
+#
+# Generate the general character table.
+#
+# shift is zero to compile the tables as nybble tries, or else the shift
+# of two-stage tables to compile instead.
+#
+sub do_genchar {
+  # Get parameters
+  ($#_ == 2) or die "Bad call";
+  
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  
+  my $style = shift;
+  isInteger($style) or die "Bad call";
+  (($style >= 0) and ($style <= 2)) or die "Bad param";
+  
+  my $shift = shift;
+  isInteger($shift) or die "Bad call";
+  
+  # Build the tries
+  my ($index_lower, $index_upper) = build_genchar($path_ucdata, $shift);
+  
+  # Print the tries
   print "Lower index:\n\n";
-  print_array16(\@index_lower, $use_b64);
+  print_array16($index_lower, $style);
   
   print "\nUpper index:\n\n";
-  print_array16(\@index_upper, $use_b64);
+  print_array16($index_upper, $style);
 }
 
-# do_case(path_casefold, use_b64)
-# -------------------------------
+# build_case(path_casefold, shift)
+# --------------------------------
 #
-# Generate the case-folding table.
+# Build the case-folding table.
 #
-sub do_case {
+# shift is zero to compile the indices as nybble tries, or else the
+# shift of two-stage tables to compile instead.
+#
+# The return value in list context is three array references, to the
+# lower index, the upper index, and the data table in that order.
+#
+sub build_case {
   # Get parameters
   ($#_ == 1) or die "Bad call";
   
@@ -818,9 +1787,8 @@ sub do_case {
   (not ref($path_casefold)) or die "Bad call";
   (-f $path_casefold) or die "Failed to find file '$path_casefold'";
   
-  my $use_b64 = shift;
-  isInteger($use_b64) or die "Bad call";
-  (($use_b64 == 0) or ($use_b64 == 1)) or die "Bad param";
+  my $shift = shift;
+  isInteger($shift) or die "Bad call";
   
   # Open the data file in raw byte mode
   open(my $fh, "< :raw", $path_casefold) or
@@ -963,21 +1931,951 @@ sub do_case {
   }
   
   # Compile the two tries
-  my @index_upper = $fold_upper->compile;
-  my @index_lower = $fold_lower->compile;
+  my @index_upper;
+  my @index_lower;
+  my @hot_upper = hot_keys(0x10000, 0, 0x10000);
+  my @hot_lower = hot_keys(0, 0, 0x10000);
+  if ($shift > 0) {
+    @index_upper = $fold_upper->compileStage($shift, \@hot_upper);
+    @index_lower = $fold_lower->compileStage($shift, \@hot_lower);
+  } else {
+    @index_upper = $fold_upper->compile(\@hot_upper);
+    @index_lower = $fold_lower->compile(\@hot_lower);
+  }
+  
+  # Close the data file
+  close($fh) or warn "Failed to close file";
+  
+  # Return the tries and the data table
+  return (\@index_lower, \@index_upper, \@data);
+}
+
+# read_casedelta(path_casefold)
+# -----------------------------
+#
+# Read the case folding deltas of every codepoint in range U+0000 to
+# U+1FFFF, in the same form as the values of the case folding delta
+# table.
+#
+# The return value is an array reference holding the delta of each
+# codepoint.
+#
+sub read_casedelta {
+  # Get parameters
+  ($#_ == 0) or die "Bad call";
+  
+  my $path_casefold = shift;
+  (not ref($path_casefold)) or die "Bad call";
+  (-f $path_casefold) or die "Failed to find file '$path_casefold'";
+  
+  # Open the data file in raw byte mode
+  open(my $fh, "< :raw", $path_casefold) or
+    die "Failed to open file '$path_casefold'";
+  
+  # Start with a delta of zero for every codepoint in range U+0000 to
+  # U+1FFFF
+  my @delta = (0) x 0x20000;
+  
+  # Parse records
+  for(
+      my $ltext = readline($fh);
+      defined $ltext;
+      $ltext = readline($fh)) {
+    
+    # Drop line break, comments, and trim whitespace
+    chomp $ltext;
+    $ltext =~ s/#.*//;
+    $ltext =~ s/^\s+//;
+    $ltext =~ s/\s+$//;
+    
+    # Skip if blank
+    (length($ltext) > 0) or next;
+    
+    # Split record into fields
+    ($ltext =~ /^([^;]*);([^;]*);([^;]*);$/) or die "Invalid record";
+    my $ucode = $1;
+    my $ftype = $2;
+    my $mapping = $3;
+    
+    # Parse codepoint, folding type, and mapping fields
+    ($ucode =~ /^\s*([0-9A-Fa-f]{1,6})\s*$/) or
+      die "Invalid codepoint field";
+    $ucode = hex($1);
+    (($ucode >= 0) and ($ucode <= 0x1FFFF)) or
+      die "Codepoint out of range";
+    
+    ($ftype =~ /^\s*([CFST])\s*$/) or
+      die "Mapping type invalid";
+    $ftype = $1;
+    
+    $mapping =~ s/^\s+//;
+    $mapping =~ s/\s+$//;
+    
+    my @cpa = split /\s+/, $mapping;
+    ((scalar(@cpa) >= 1) and (scalar(@cpa) <= 3)) or
+      die "Mapping length out of range";
+    
+    for my $cv (@cpa) {
+      ($cv =~ /^[0-9A-Fa-f]{1,6}$/) or
+        die "Invalid codepoint in mapping";
+      $cv = hex($cv);
+      (($cv >> 16) == ($ucode >> 16)) or
+        die "Mapping codepoint not in correct subrange";
+    }
+    
+    # C records give the delta and F records mark an expansion; S and T
+    # records are not used
+    if ($ftype eq 'C') {
+      (scalar(@cpa) == 1) or die "Common folding must be one codepoint";
+      my $d = ($cpa[0] - $ucode) & 0xFFFF;
+      ($d != 0x8000) or die "Delta collides with expansion value";
+      $delta[$ucode] = $d;
+      
+    } elsif ($ftype eq 'F') {
+      $delta[$ucode] = 0x8000;
+    }
+  }
+  
+  # Close the data file
+  close($fh) or warn "Failed to close file";
+  
+  # Return the deltas
+  return \@delta;
+}
+
+# build_casedelta(path_casefold)
+# ------------------------------
+#
+# Build the case-folding delta table.
+#
+# The return value in list context is two array references, to the
+# lower two-stage table and the upper two-stage table in that order.
+#
+sub build_casedelta {
+  # Get parameters
+  ($#_ == 0) or die "Bad call";
+  
+  my $path_casefold = shift;
+  (not ref($path_casefold)) or die "Bad call";
+  
+  # Read the deltas
+  my $delta = read_casedelta($path_casefold);
+  
+  # Compile the two-stage tables
+  my @index_lower = StageTable->compile(
+                      [@{$delta}[0 .. 0xFFFF]], STAGE_SHIFT,
+                      [hot_keys(0, 0, 0x10000)]);
+  my @index_upper = StageTable->compile(
+                      [@{$delta}[0x10000 .. 0x1FFFF]], STAGE_SHIFT,
+                      [hot_keys(0x10000, 0, 0x10000)]);
+  
+  # Return the tables
+  return (\@index_lower, \@index_upper);
+}
+
+# do_casedelta(path_casefold, style)
+# ----------------------------------
+#
+# Generate the case-folding delta table.
+#
+sub do_casedelta {
+  # Get parameters
+  ($#_ == 1) or die "Bad call";
+  
+  my $path_casefold = shift;
+  (not ref($path_casefold)) or die "Bad call";
+  
+  my $style = shift;
+  isInteger($style) or die "Bad call";
+  (($style >= 0) and ($style <= 2)) or die "Bad param";
+  
+  # Build the tables
+  my ($index_lower, $index_upper) = build_casedelta($path_casefold);
+  
+  # Print the tables
+  print "Lower delta:\n\n";
+  print_array16($index_lower, $style);
+  
+  print "\nUpper delta:\n\n";
+  print_array16($index_upper, $style);
+}
+
+# do_case(path_casefold, style, shift)
+# ------------------------------------
+#
+# Generate the case-folding table.
+#
+# shift is zero to compile the indices as nybble tries, or else the
+# shift of two-stage tables to compile instead.
+#
+sub do_case {
+  # Get parameters
+  ($#_ == 2) or die "Bad call";
+  
+  my $path_casefold = shift;
+  (not ref($path_casefold)) or die "Bad call";
+  
+  my $style = shift;
+  isInteger($style) or die "Bad call";
+  (($style >= 0) and ($style <= 2)) or die "Bad param";
+  
+  my $shift = shift;
+  isInteger($shift) or die "Bad call";
+  
+  # Build the tries and the data table
+  my ($index_lower, $index_upper, $data) =
+    build_case($path_casefold, $shift);
   
   # Print the tries and the data table
   print "Lower index:\n\n";
-  print_array16(\@index_lower, $use_b64);
+  print_array16($index_lower, $style);
   
   print "\nUpper index:\n\n";
-  print_array16(\@index_upper, $use_b64);
+  print_array16($index_upper, $style);
   
   print "\nData table:\n\n";
-  print_array16(\@data, $use_b64);
+  print_array16($data, $style);
+}
+
+# props_key(cv)
+# -------------
+#
+# Return the key of a codepoint in the property table.  The codepoint
+# must be in range U+0000 to U+3FFFF or U+E0000 to U+E0FFF.
+#
+sub props_key {
+  ($#_ == 0) or die "Bad call";
   
-  # Close the data file
+  my $cv = shift;
+  isInteger($cv) or die "Bad call";
+  
+  if (($cv >= 0) and ($cv < 0x40000)) {
+    return $cv;
+  } elsif (($cv >= 0xE0000) and ($cv <= 0xE0FFF)) {
+    return $cv - 0xA0000;
+  }
+  die "Property table codepoint out of range";
+}
+
+# build_props(path_unicodedata, path_casefold)
+# --------------------------------------------
+#
+# Build the property table.
+#
+# The return value in list context is the two-stage table.
+#
+sub build_props {
+  # Get parameters
+  ($#_ == 1) or die "Bad call";
+  
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  (-f $path_ucdata) or die "Failed to find file '$path_ucdata'";
+  
+  my $path_casefold = shift;
+  (not ref($path_casefold)) or die "Bad call";
+  
+  # Build a hash mapping each category name to its category index
+  my @cat_names = (UNIFIED_CATS);
+  my %cat_index;
+  for(my $i = 0; $i < scalar(@cat_names); $i++) {
+    $cat_index{$cat_names[$i]} = $i;
+  }
+  
+  # Start with every key unassigned and without flags
+  my @values = ($cat_index{'Cn'}) x PROPS_KEYS;
+  
+  # Open general table parser
+  my $parse = GeneralTable->parse($path_ucdata);
+  
+  # Store the category and class flags of every record
+  for(my $rec = $parse->readRec; defined $rec; $rec = $parse->readRec) {
+    my $cat = $rec->{'gencat'};
+    defined $cat_index{$cat} or die "Unrecognized category '$cat'";
+    
+    my $flags = 0;
+    if ($cat =~ /^L/) {
+      $flags |= PROPS_LETTER;
+    }
+    if ($cat =~ /^L[lut]$/) {
+      $flags |= PROPS_CASED;
+    }
+    if ($cat =~ /^N/) {
+      $flags |= PROPS_NUMBER;
+    }
+    if ($cat eq 'Nd') {
+      $flags |= PROPS_DIGIT;
+    }
+    if ($cat =~ /^Z/) {
+      $flags |= PROPS_SPACE;
+    }
+    
+    # Codepoints outside the table must not need any flags
+    my $v = $cat_index{$cat} | ($flags << PROPS_FLAG_SHIFT);
+    for(my $cv = $rec->{'lbound'}; $cv <= $rec->{'ubound'}; $cv++) {
+      if (($cv < 0x40000) or (($cv >= 0xE0000) and ($cv <= 0xE0FFF))) {
+        $values[props_key($cv)] = $v;
+      } else {
+        ($flags == 0) or die "Property flags outside property table";
+      }
+    }
+  }
+  
+  # The white space controls
+  for my $cv (0x9 .. 0xD, 0x85) {
+    $values[$cv] |= (PROPS_SPACE << PROPS_FLAG_SHIFT);
+  }
+  
+  # Add the case folding flags
+  my $delta = read_casedelta($path_casefold);
+  for(my $cv = 0; $cv < 0x20000; $cv++) {
+    if ($delta->[$cv] == 0x8000) {
+      $values[$cv] |= ((PROPS_FOLD | PROPS_EXPAND) << PROPS_FLAG_SHIFT);
+    } elsif ($delta->[$cv] != 0) {
+      $values[$cv] |= (PROPS_FOLD << PROPS_FLAG_SHIFT);
+    }
+  }
+  
+  # Compile the two-stage table
+  my @table = StageTable->compile(
+                \@values, PROPS_SHIFT, [hot_keys(0, 0, PROPS_KEYS)]);
+  
+  # Return table
+  return @table;
+}
+
+# do_props(path_unicodedata, path_casefold, style)
+# ------------------------------------------------
+#
+# Generate the property table.
+#
+sub do_props {
+  # Get parameters
+  ($#_ == 2) or die "Bad call";
+  
+  my $path_ucdata = shift;
+  (not ref($path_ucdata)) or die "Bad call";
+  
+  my $path_casefold = shift;
+  (not ref($path_casefold)) or die "Bad call";
+  
+  my $style = shift;
+  isInteger($style) or die "Bad call";
+  (($style >= 0) and ($style <= 2)) or die "Bad param";
+  
+  # Build and print table
+  my @table = build_props($path_ucdata, $path_casefold);
+  
+  print "Property table:\n\n";
+  print_array16(\@table, $style);
+}
+
+# fnv1a_table(\@ar)
+# -----------------
+#
+# Compute the 32-bit FNV-1a checksum of an array of unsigned 16-bit
+# integers, where each integer is hashed as two bytes in little endian
+# order.  This must match the checksum computed in unikit.c.
+#
+sub fnv1a_table {
+  ($#_ == 0) or die "Bad call";
+  
+  my $ar = shift;
+  (ref($ar) eq 'ARRAY') or die "Bad call";
+  
+  my $h = 0x811c9dc5;
+  for my $v (@$ar) {
+    for my $b (($v & 0xff), ($v >> 8)) {
+      $h = $h ^ $b;
+      $h = (($h * 0x193) + (($h << 24) & 0xffffffff)) & 0xffffffff;
+    }
+  }
+  
+  return $h;
+}
+
+# file_digest(path)
+# -----------------
+#
+# Return the MD5 digest in base-16 of the contents of the given file.
+#
+sub file_digest {
+  ($#_ == 0) or die "Bad call";
+  
+  my $path = shift;
+  (not ref($path)) or die "Bad call";
+  
+  open(my $fh, "< :raw", $path) or die "Failed to open file '$path'";
+  my $digest = Digest::MD5->new->addfile($fh)->hexdigest;
   close($fh) or warn "Failed to close file";
+  
+  return $digest;
+}
+
+# generator_digest()
+# ------------------
+#
+# Return the MD5 digest in base-16 of the source of this script and of
+# the modules it uses, so that cached tables are rebuilt whenever the
+# generator itself changes.
+#
+sub generator_digest {
+  ($#_ < 0) or die "Bad call";
+  
+  my $md5 = Digest::MD5->new;
+  for my $path (__FILE__, $INC{'GeneralTable.pm'}, $INC{'Trie.pm'},
+                $INC{'StageTable.pm'}) {
+    $md5->add(file_digest($path));
+  }
+  
+  return $md5->hexdigest;
+}
+
+# array16_text(\@ar, style)
+# -------------------------
+#
+# Return the text that print_array16() would print for the same
+# parameters as a string, instead of printing it.
+#
+sub array16_text {
+  ($#_ == 1) or die "Bad call";
+  
+  my $ar = shift;
+  (ref($ar) eq 'ARRAY') or die "Bad call";
+  
+  my $style = shift;
+  isInteger($style) or die "Bad call";
+  
+  my $text = '';
+  open(my $fh, '>', \$text) or die "Failed to open string";
+  my $old = select($fh);
+  print_array16($ar, $style);
+  select($old);
+  close($fh) or warn "Failed to close string";
+  
+  return $text;
+}
+
+# build_group(name, \%paths)
+# --------------------------
+#
+# Build all the outputs of one of the TABLE_GROUPS, or of the inline
+# header if name is 'inline'.
+#
+# paths is a hash reference mapping the input names used in the
+# TABLE_GROUPS to the paths of the data files.
+#
+# The return value is a hash reference.  For table groups, it maps the
+# data key of each table in the group to an array reference holding the
+# table.  For the inline header, it maps 'inline' to the text of the
+# header.
+#
+sub build_group {
+  # Get parameters
+  ($#_ == 1) or die "Bad call";
+  
+  my $name = shift;
+  (not ref($name)) or die "Bad call";
+  
+  my $paths = shift;
+  (ref($paths) eq 'HASH') or die "Bad call";
+  
+  # Build the group
+  my %result;
+  if ($name eq 'case') {
+    my ($lower, $upper, $data) = build_case($paths->{'casefold'}, 0);
+    my ($lower_stage, $upper_stage) =
+      build_case($paths->{'casefold'}, STAGE_SHIFT);
+    %result = (
+      100 => $lower,
+      101 => $upper,
+      102 => $data,
+      103 => $lower_stage,
+      104 => $upper_stage
+    );
+    
+  } elsif ($name eq 'casedelta') {
+    my ($lower, $upper) = build_casedelta($paths->{'casefold'});
+    %result = (
+      105 => $lower,
+      106 => $upper
+    );
+    
+  } elsif ($name eq 'gcat') {
+    my $path_ucdata = $paths->{'ucdata'};
+    my @core = build_core($path_ucdata);
+    my ($gen_low, $gen_high) = build_genchar($path_ucdata, 0);
+    my @bitmap = build_bitmap($path_ucdata);
+    my @astral;
+    for my $r (astral_records($path_ucdata)) {
+      push @astral, ($r->[0], $r->[1], $r->[2], $r->[3]);
+    }
+    my ($gen_low_stage, $gen_high_stage) =
+      build_genchar($path_ucdata, STAGE_SHIFT);
+    my @unified = build_unified($path_ucdata);
+    my @astraldir = build_astraldir($path_ucdata);
+    %result = (
+      200 => \@core,
+      201 => $gen_low,
+      202 => $gen_high,
+      203 => \@bitmap,
+      204 => \@astral,
+      205 => $gen_low_stage,
+      206 => $gen_high_stage,
+      207 => \@unified,
+      208 => \@astraldir
+    );
+    
+  } elsif ($name eq 'classes') {
+    my ($class_l, $class_n, $class_z, $class_lc) =
+      build_classes($paths->{'ucdata'});
+    %result = (
+      300 => $class_l,
+      301 => $class_n,
+      302 => $class_z,
+      303 => $class_lc
+    );
+    
+  } elsif ($name eq 'props') {
+    my @props = build_props($paths->{'ucdata'}, $paths->{'casefold'});
+    %result = (
+      600 => \@props
+    );
+    
+  } elsif ($name eq 'inline') {
+    # Capture the header that the inline mode would print
+    my $text = '';
+    open(my $fh, '>', \$text) or die "Failed to open string";
+    my $old = select($fh);
+    do_inline($paths->{'ucdata'});
+    select($old);
+    close($fh) or warn "Failed to close string";
+    %result = (
+      'inline' => $text
+    );
+    
+  } else {
+    die "Unknown table group '$name'";
+  }
+  
+  # Return results
+  return \%result;
+}
+
+# build_tables(\%paths, \@groups, \%cache)
+# ----------------------------------------
+#
+# Build the outputs of a list of groups and return them merged into a
+# single hash reference, in the same format as for build_group().
+#
+# paths is the same as for build_group().  groups is an array reference
+# of groups in the same format as the TABLE_GROUPS, with the name of
+# each group followed by the names of its inputs.
+#
+# cache is either undef or a hash reference mapping the name of each
+# group that was built before to a hash reference with a 'digest' key
+# and an 'outputs' key.  The digest covers the generator and every
+# input of the group.  If the current digest of a group matches the
+# cache, the cached outputs are used without building the group again.
+# Otherwise, the group is built and the cache is updated.  A line for
+# each group is printed to standard error when a cache is given.
+#
+sub build_tables {
+  # Get parameters
+  ($#_ == 2) or die "Bad call";
+  
+  my $paths = shift;
+  (ref($paths) eq 'HASH') or die "Bad call";
+  
+  my $groups = shift;
+  (ref($groups) eq 'ARRAY') or die "Bad call";
+  
+  my $cache = shift;
+  ((not defined $cache) or (ref($cache) eq 'HASH')) or die "Bad call";
+  
+  # Digest the generator once, if caching
+  my $gen_digest;
+  if (defined $cache) {
+    $gen_digest = generator_digest();
+  }
+  
+  # Build or reuse each group and merge the outputs
+  my %result;
+  for my $g (@$groups) {
+    my ($name, @inputs) = @$g;
+    for my $input (@inputs) {
+      (defined $paths->{$input}) or die "Missing input '$input'";
+      (-f $paths->{$input}) or
+        die "Failed to find file '$paths->{$input}'";
+    }
+    
+    my $outputs;
+    if (defined $cache) {
+      my $md5 = Digest::MD5->new;
+      $md5->add($gen_digest, $name);
+      for my $input (@inputs) {
+        $md5->add(file_digest($paths->{$input}));
+      }
+      my $digest = $md5->hexdigest;
+      
+      my $c = $cache->{$name};
+      if ((defined $c) and ($c->{'digest'} eq $digest)) {
+        $outputs = $c->{'outputs'};
+        print STDERR "Reused cached $name tables\n";
+      } else {
+        $outputs = build_group($name, $paths);
+        $cache->{$name} = {
+          'digest'  => $digest,
+          'outputs' => $outputs
+        };
+        print STDERR "Built $name tables\n";
+      }
+      
+    } else {
+      $outputs = build_group($name, $paths);
+    }
+    
+    for my $k (keys %$outputs) {
+      $result{$k} = $outputs->{$k};
+    }
+  }
+  
+  # Return results
+  return \%result;
+}
+
+# datafile_bytes(ucd_version, \%tables)
+# -------------------------------------
+#
+# Return the contents of the binary data file as a binary string.
+#
+# ucd_version is the version of the Unicode Character Database, such as
+# 15.1.0.  tables is a hash reference mapping every data key of the
+# DATA_TABLES to an array reference holding the table.
+#
+sub datafile_bytes {
+  # Get parameters
+  ($#_ == 1) or die "Bad call";
+  
+  my $ucd_version = shift;
+  (not ref($ucd_version)) or die "Bad call";
+  ($ucd_version =~ /^([0-9]{1,5})\.([0-9]{1,3})\.([0-9]{1,3})$/) or
+    die "Invalid UCD version '$ucd_version'";
+  my $ver_major = int($1);
+  my $ver_minor = int($2);
+  my $ver_update = int($3);
+  (($ver_major <= 0xFFFF) and ($ver_minor <= 0xFF) and
+    ($ver_update <= 0xFF)) or die "UCD version out of range";
+  
+  my $tables = shift;
+  (ref($tables) eq 'HASH') or die "Bad call";
+  
+  # Get the tables in ascending order of data key
+  my @tables;
+  for my $t (DATA_TABLES) {
+    (defined $tables->{$t->[0]}) or die "Missing table $t->[0]";
+    push @tables, ([$t->[0], $tables->{$t->[0]}]);
+  }
+  
+  # Lay out the tables after the header and the directory, with each
+  # table starting on a DATAFILE_ALIGN boundary
+  my $offs = 16 + (16 * scalar(@tables));
+  my @dir;
+  for my $t (@tables) {
+    $offs = $offs + ((DATAFILE_ALIGN - ($offs % DATAFILE_ALIGN))
+                        % DATAFILE_ALIGN);
+    push @dir, ([
+      $t->[0],
+      $offs,
+      scalar(@{$t->[1]}),
+      fnv1a_table($t->[1])
+    ]);
+    $offs = $offs + (2 * scalar(@{$t->[1]}));
+  }
+  
+  # Write the header and the directory
+  my $out = 'UKDB';
+  $out .= pack('vvvCCV',
+                0xFEFF, DATAFILE_VERSION,
+                $ver_major, $ver_minor, $ver_update,
+                scalar(@tables));
+  for my $d (@dir) {
+    $out .= pack('VVVV', @$d);
+  }
+  
+  # Write the tables, padding each to its aligned offset
+  for(my $i = 0; $i < scalar(@tables); $i++) {
+    $out .= "\0" x ($dir[$i]->[1] - length($out));
+    $out .= pack('v*', @{$tables[$i]->[1]});
+  }
+  
+  # Return the file
+  return $out;
+}
+
+# data_source(\%tables)
+# ---------------------
+#
+# Return the complete source of the unikit_data.c data module as a
+# string.  tables is the same as for datafile_bytes().
+#
+sub data_source {
+  # Get parameters
+  ($#_ == 0) or die "Bad call";
+  
+  my $tables = shift;
+  (ref($tables) eq 'HASH') or die "Bad call";
+  
+  for my $t (DATA_TABLES) {
+    (defined $tables->{$t->[0]}) or die "Missing table $t->[0]";
+  }
+  
+  # Module header
+  my $src = <<'EOT';
+/*
+ * unikit_data.c
+ * =============
+ * 
+ * Implementation of unikit_data.h
+ * 
+ * See the header for further information.
+ */
+
+#include "unikit_data.h"
+
+/*
+ * Data tables
+ * ===========
+ * 
+ * The base-64 string literals are used by default.  In the
+ * UNIKIT_STATIC_TABLES build mode, the same tables are instead stored
+ * as constant integer arrays that can be used in place.
+ */
+
+#ifndef UNIKIT_STATIC_TABLES
+EOT
+  
+  # Base-64 string literals, with the statement ended after the last
+  # line of each literal
+  for my $t (DATA_TABLES) {
+    my $lit = array16_text($tables->{$t->[0]}, 1);
+    $lit =~ s/\n\z/;\n/;
+    $src .= "\nstatic const char *db_$t->[1] =\n$lit";
+  }
+  
+  # Constant arrays
+  $src .= "\n#else\n";
+  for my $t (DATA_TABLES) {
+    $src .= "\nstatic const uint16_t db_$t->[1]\[\] = {\n";
+    $src .= array16_text($tables->{$t->[0]}, 2);
+    $src .= "};\n";
+  }
+  $src .= "\n#endif\n\n";
+  
+  # unikit_data_table function
+  $src .= <<'EOT';
+/*
+ * Public function implementations
+ * ===============================
+ * 
+ * See the header for specifications.
+ */
+
+#ifdef UNIKIT_STATIC_TABLES
+
+/*
+ * The number of elements in one of the constant data arrays.
+ */
+#define DB_LEN(a) ((int32_t) (sizeof(a) / sizeof(uint16_t)))
+
+/*
+ * unikit_data_table function.
+ */
+const uint16_t *unikit_data_table(int key, int32_t *pLen) {
+  
+  const uint16_t *pResult = NULL;
+  int32_t rlen = 0;
+  
+  switch (key) {
+EOT
+  for my $t (DATA_TABLES) {
+    $src .= "    case UNIKIT_DATA_KEY_" . uc($t->[1]) . ":\n";
+    $src .= "      pResult = db_$t->[1];\n";
+    $src .= "      rlen = DB_LEN(db_$t->[1]);\n";
+    $src .= "      break;\n";
+    $src .= "    \n";
+  }
+  $src .= <<'EOT';
+    default:
+      pResult = NULL;
+      rlen = 0;
+  }
+  
+  if (pLen != NULL) {
+    *pLen = rlen;
+  }
+  return pResult;
+}
+
+#else
+
+/*
+ * unikit_data_fetch function.
+ */
+const char *unikit_data_fetch(int key) {
+  
+  const char *pResult = NULL;
+  
+  switch (key) {
+EOT
+  
+  # unikit_data_fetch function
+  for my $t (DATA_TABLES) {
+    $src .= "    case UNIKIT_DATA_KEY_" . uc($t->[1]) . ":\n";
+    $src .= "      pResult = db_$t->[1];\n";
+    $src .= "      break;\n";
+    $src .= "    \n";
+  }
+  $src .= <<'EOT';
+    default:
+      pResult = NULL;
+  }
+  
+  return pResult;
+}
+
+#endif
+EOT
+  
+  # Return the source
+  return $src;
+}
+
+# write_output(path, text)
+# ------------------------
+#
+# Write a generated output file, unless it already has exactly the
+# given contents, so that the modification times of unchanged outputs
+# are kept.  The file is written under a temporary name and then
+# renamed over the path, so an interrupted run never leaves a partial
+# output behind.  A line is printed to standard error either way.
+#
+sub write_output {
+  # Get parameters
+  ($#_ == 1) or die "Bad call";
+  
+  my $path = shift;
+  (not ref($path)) or die "Bad call";
+  
+  my $text = shift;
+  (not ref($text)) or die "Bad call";
+  
+  # Skip the write if the contents are unchanged
+  if (-f $path) {
+    open(my $fh, "< :raw", $path) or die "Failed to open file '$path'";
+    my $old = do { local $/; readline($fh) };
+    close($fh) or warn "Failed to close file";
+    
+    if ((defined $old) and ($old eq $text)) {
+      print STDERR "Unchanged $path\n";
+      return;
+    }
+  }
+  
+  # Write under a temporary name and rename into place
+  my $tmp = "$path.tmp";
+  open(my $fh, "> :raw", $tmp) or die "Failed to create file '$tmp'";
+  print {$fh} $text;
+  close($fh) or die "Failed to write file '$tmp'";
+  rename($tmp, $path) or die "Failed to rename '$tmp' to '$path'";
+  print STDERR "Wrote $path\n";
+}
+
+# do_datafile(ucd_version, path_unicodedata, path_casefold)
+# ---------------------------------------------------------
+#
+# Generate the binary data file and write it to standard output.
+#
+sub do_datafile {
+  # Get parameters
+  ($#_ == 2) or die "Bad call";
+  
+  my $ucd_version = shift;
+  (not ref($ucd_version)) or die "Bad call";
+  
+  my %paths;
+  for my $input (qw(ucdata casefold)) {
+    my $path = shift;
+    (not ref($path)) or die "Bad call";
+    $paths{$input} = $path;
+  }
+  
+  # Build all the tables and write the file
+  my $tables = build_tables(\%paths, [TABLE_GROUPS], undef);
+  my $out = datafile_bytes($ucd_version, $tables);
+  
+  binmode(STDOUT, ":raw") or die "Failed to set binary mode";
+  print $out;
+}
+
+# do_all(dir, ucd_version, path_unicodedata, path_casefold)
+# ---------------------------------------------------------
+#
+# Generate every output in the given directory in one run, reusing the
+# cached tables of groups whose inputs have not changed.
+#
+sub do_all {
+  # Get parameters
+  ($#_ == 3) or die "Bad call";
+  
+  my $dir = shift;
+  (not ref($dir)) or die "Bad call";
+  (-d $dir) or die "Failed to find directory '$dir'";
+  
+  my $ucd_version = shift;
+  (not ref($ucd_version)) or die "Bad call";
+  
+  my %paths;
+  for my $input (qw(ucdata casefold)) {
+    my $path = shift;
+    (not ref($path)) or die "Bad call";
+    $paths{$input} = $path;
+  }
+  
+  # Load the cache if present and in the current format, or else start
+  # with an empty cache
+  my $cache_path = "$dir/" . CACHE_NAME;
+  my $cache;
+  if (-f $cache_path) {
+    $cache = eval { retrieve($cache_path) };
+    unless ((ref($cache) eq 'HASH') and (defined $cache->{'format'}) and
+              ($cache->{'format'} == CACHE_FORMAT) and
+              (ref($cache->{'groups'}) eq 'HASH')) {
+      print STDERR "Ignoring unusable cache $cache_path\n";
+      $cache = undef;
+    }
+  }
+  unless (defined $cache) {
+    $cache = {
+      'format' => CACHE_FORMAT,
+      'groups' => { }
+    };
+  }
+  
+  # Build or reuse all the groups, along with the inline header
+  my $tables = build_tables(
+                  \%paths,
+                  [TABLE_GROUPS, ['inline', 'ucdata']],
+                  $cache->{'groups'});
+  
+  # Write the outputs
+  write_output("$dir/unikit_data.c", data_source($tables));
+  write_output("$dir/unikit_inline.h", $tables->{'inline'});
+  write_output("$dir/unikit.dat",
+                datafile_bytes($ucd_version, $tables));
+  
+  # Store the updated cache
+  nstore($cache, $cache_path) or die "Failed to store cache";
 }
 
 # ==================
@@ -991,7 +2889,7 @@ my $script_mode = shift @ARGV;
 
 # Handle the different modes
 #
-if ($script_mode eq 'case') {
+if (($script_mode eq 'case') or ($script_mode eq 'casestage')) {
   # Case folding mode
   (scalar(@ARGV) == 2) or die "Wrong number of arguments for mode";
   my $style = shift @ARGV;
@@ -1001,13 +2899,37 @@ if ($script_mode eq 'case') {
     $style = 0;
   } elsif ($style eq 'base64') {
     $style = 1;
+  } elsif ($style eq 'array') {
+    $style = 2;
   } else {
     die "Unrecognized style '$style'";
   }
   
-  do_case($path, $style);
+  if ($script_mode eq 'casestage') {
+    do_case($path, $style, STAGE_SHIFT);
+  } else {
+    do_case($path, $style, 0);
+  }
+  
+} elsif ($script_mode eq 'casedelta') {
+  # Case folding delta table
+  (scalar(@ARGV) == 2) or die "Wrong number of arguments for mode";
+  my $style = shift @ARGV;
+  my $path = shift @ARGV;
   
-} elsif ($script_mode eq 'genchar') {
+  if ($style eq 'pretty') {
+    $style = 0;
+  } elsif ($style eq 'base64') {
+    $style = 1;
+  } elsif ($style eq 'array') {
+    $style = 2;
+  } else {
+    die "Unrecognized style '$style'";
+  }
+  
+  do_casedelta($path, $style);
+  
+} elsif (($script_mode eq 'genchar') or ($script_mode eq 'genstage')) {
   # General category table
   (scalar(@ARGV) == 2) or die "Wrong number of arguments for mode";
   my $style = shift @ARGV;
@@ -1017,11 +2939,17 @@ if ($script_mode eq 'case') {
     $style = 0;
   } elsif ($style eq 'base64') {
     $style = 1;
+  } elsif ($style eq 'array') {
+    $style = 2;
   } else {
     die "Unrecognized style '$style'";
   }
   
-  do_genchar($path, $style);
+  if ($script_mode eq 'genstage') {
+    do_genchar($path, $style, STAGE_SHIFT);
+  } else {
+    do_genchar($path, $style, 0);
+  }
 
 } elsif ($script_mode eq 'astral') {
   # Astral character table
@@ -1033,12 +2961,32 @@ if ($script_mode eq 'case') {
     $style = 0;
   } elsif ($style eq 'base64') {
     $style = 1;
+  } elsif ($style eq 'array') {
+    $style = 2;
   } else {
     die "Unrecognized style '$style'";
   }
   
   do_astral($path, $style);
 
+} elsif ($script_mode eq 'astraldir') {
+  # Astral directory table
+  (scalar(@ARGV) == 2) or die "Wrong number of arguments for mode";
+  my $style = shift @ARGV;
+  my $path = shift @ARGV;
+  
+  if ($style eq 'pretty') {
+    $style = 0;
+  } elsif ($style eq 'base64') {
+    $style = 1;
+  } elsif ($style eq 'array') {
+    $style = 2;
+  } else {
+    die "Unrecognized style '$style'";
+  }
+  
+  do_astraldir($path, $style);
+
 } elsif ($script_mode eq 'core') {
   # Core character table
   (scalar(@ARGV) == 2) or die "Wrong number of arguments for mode";
@@ -1049,6 +2997,8 @@ if ($script_mode eq 'case') {
     $style = 0;
   } elsif ($style eq 'base64') {
     $style = 1;
+  } elsif ($style eq 'array') {
+    $style = 2;
   } else {
     die "Unrecognized style '$style'";
   }
@@ -1065,12 +3015,95 @@ if ($script_mode eq 'case') {
     $style = 0;
   } elsif ($style eq 'base64') {
     $style = 1;
+  } elsif ($style eq 'array') {
+    $style = 2;
   } else {
     die "Unrecognized style '$style'";
   }
   
   do_bitmap($path, $style);
 
+} elsif ($script_mode eq 'unified') {
+  # Unified category table
+  (scalar(@ARGV) == 2) or die "Wrong number of arguments for mode";
+  my $style = shift @ARGV;
+  my $path = shift @ARGV;
+  
+  if ($style eq 'pretty') {
+    $style = 0;
+  } elsif ($style eq 'base64') {
+    $style = 1;
+  } elsif ($style eq 'array') {
+    $style = 2;
+  } else {
+    die "Unrecognized style '$style'";
+  }
+  
+  do_unified($path, $style);
+
+} elsif ($script_mode eq 'classes') {
+  # Character class tables
+  (scalar(@ARGV) == 2) or die "Wrong number of arguments for mode";
+  my $style = shift @ARGV;
+  my $path = shift @ARGV;
+  
+  if ($style eq 'pretty') {
+    $style = 0;
+  } elsif ($style eq 'base64') {
+    $style = 1;
+  } elsif ($style eq 'array') {
+    $style = 2;
+  } else {
+    die "Unrecognized style '$style'";
+  }
+  
+  do_classes($path, $style);
+
+} elsif ($script_mode eq 'props') {
+  # Property table
+  (scalar(@ARGV) == 3) or die "Wrong number of arguments for mode";
+  my $style = shift @ARGV;
+  my $path_ucdata = shift @ARGV;
+  my $path_casefold = shift @ARGV;
+  
+  if ($style eq 'pretty') {
+    $style = 0;
+  } elsif ($style eq 'base64') {
+    $style = 1;
+  } elsif ($style eq 'array') {
+    $style = 2;
+  } else {
+    die "Unrecognized style '$style'";
+  }
+  
+  do_props($path_ucdata, $path_casefold, $style);
+
+} elsif ($script_mode eq 'inline') {
+  # Inline header
+  (scalar(@ARGV) == 1) or die "Wrong number of arguments for mode";
+  my $path_ucdata = shift @ARGV;
+  
+  do_inline($path_ucdata);
+
+} elsif ($script_mode eq 'datafile') {
+  # Binary data file
+  (scalar(@ARGV) == 3) or die "Wrong number of arguments for mode";
+  my $ucd_version = shift @ARGV;
+  my $path_ucdata = shift @ARGV;
+  my $path_casefold = shift @ARGV;
+  
+  do_datafile($ucd_version, $path_ucdata, $path_casefold);
+
+} elsif ($script_mode eq 'all') {
+  # Every output in one run
+  (scalar(@ARGV) == 4) or die "Wrong number of arguments for mode";
+  my $dir = shift @ARGV;
+  my $ucd_version = shift @ARGV;
+  my $path_ucdata = shift @ARGV;
+  my $path_casefold = shift @ARGV;
+  
+  do_all($dir, $ucd_version, $path_ucdata, $path_casefold);
+
 } elsif ($script_mode eq 'remainder') {
   # Core character table
   (scalar(@ARGV) == 2) or die "Wrong number of arguments for mode";
@@ -1081,11 +3114,13 @@ if ($script_mode eq 'case') {
     $style = 0;
   } elsif ($style eq 'base64') {
     $style = 1;
+  } elsif ($style eq 'array') {
+    $style = 2;
   } else {
     die "Unrecognized style '$style'";
   }
   
-  ($style == 0) or die "base64 not supported in remainder mode";
+  ($style == 0) or die "Only pretty supported in remainder mode";
   do_remainder($path);
 
 } else {
@@ -0,0 +1,617 @@
+/*
+ * unikit_fuzz.c
+ * =============
+ * 
+ * Fuzz target for Unikit's buffer functions.
+ * 
+ * Building
+ * --------
+ * 
+ * With libFuzzer, compile this module together with the unikit library
+ * and run the resulting program on a corpus directory:
+ * 
+ *   clang -g -O1 -fsanitize=fuzzer,address,undefined -I. \
+ *     test/unikit_fuzz.c unikit.c unikit_data.c -o unikit_fuzz
+ *   ./unikit_fuzz corpus/
+ * 
+ * With AFL, or to replay a single input, define UNIKIT_FUZZ_MAIN.  The
+ * program then reads one input from the file named by its argument, or
+ * from standard input if there is no argument:
+ * 
+ *   afl-clang-fast -DUNIKIT_FUZZ_MAIN -I. \
+ *     test/unikit_fuzz.c unikit.c unikit_data.c -o unikit_fuzz
+ *   afl-fuzz -i corpus -o findings -- ./unikit_fuzz @@
+ * 
+ * Description
+ * -----------
+ * 
+ * Each input is treated as arbitrary bytes of text that is meant to be
+ * UTF-8, which is usually not well-formed.  The buffer functions are
+ * run over it and their results are checked against each other and
+ * against the single codepoint functions, which unikit_verify.c checks
+ * exhaustively:
+ * 
+ *   1. The streaming decoder, fed with the whole input, gives the
+ *      reference codepoints.  Feeding it the input split at an offset
+ *      taken from the input gives the same codepoints.
+ * 
+ *   2. unikit_category_utf8() and unikit_category_utf8_par() return
+ *      the category of each reference codepoint.
+ * 
+ *   3. unikit_fold_utf8(), unikit_fold_utf8_par(), and
+ *      unikit_decode_fold() return the folding of each reference
+ *      codepoint, and measure the same length as they write.
+ *      unikit_casecmp_utf8() and unikit_casehash_utf8() find the input
+ *      equal to its folding.  unikit_casefind_utf8() finds the folding
+ *      in the input as a match of the whole input, and finds each
+ *      suffix of the input that begins with a lead byte at or before
+ *      the start of that suffix, for up to FUZZ_FIND suffixes.
+ * 
+ *   4. The input read as native UTF-16 code units, decoded by the
+ *      streaming decoder as UTF-16LE, and as UTF-32 code units give
+ *      reference codepoints of their own.  unikit_category_utf16(),
+ *      unikit_fold_utf16(), unikit_category_utf32(), and
+ *      unikit_fold_utf32() return the category and the folding of each
+ *      of them.
+ * 
+ * Any failed check calls abort(), which the fuzzer reports as a crash.
+ * The sanitizers catch any memory error on the way.
+ * 
+ * Requirements
+ * ------------
+ * 
+ * Requires the unikit library, which consists of the unikit.c and
+ * unikit_data.c modules.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unikit.h"
+
+/*
+ * Constants
+ * =========
+ */
+
+/*
+ * The chunk size in bytes for the parallel buffer functions.  It is
+ * small so that even short inputs are split into several chunks.
+ */
+#define FUZZ_CHUNK (5)
+
+/*
+ * The number of suffixes of each input that are searched for with
+ * unikit_casefind_utf8(), since each search compiles a needle.
+ */
+#define FUZZ_FIND (16)
+
+/*
+ * The maximum input length that is checked.  Longer inputs are cut to
+ * this length, so that every input is checked quickly.
+ */
+#define FUZZ_MAX (65536)
+
+/*
+ * Static data
+ * ===========
+ */
+
+/*
+ * Non-zero once the module has been initialized.
+ */
+static int m_init = 0;
+
+/*
+ * Local functions
+ * ===============
+ */
+
+/* Prototypes */
+static void check(int ok);
+static void *allocBuf(size_t n);
+static size_t encodeSeq(const UNIKIT_FOLD *pf, uint8_t *pBuf);
+static size_t encodeSeq16(const UNIKIT_FOLD *pf, uint16_t *pBuf);
+
+static void checkCategory(
+    const uint8_t * pSrc,
+          size_t    n,
+    const int32_t * pCps,
+          size_t    count);
+static void checkFold(
+    const uint8_t * pSrc,
+          size_t    n,
+    const int32_t * pCps,
+          size_t    count);
+static void checkWide(const uint8_t *pSrc, size_t n);
+
+/*
+ * Stop the program with abort() if a check fails.
+ * 
+ * Parameters:
+ * 
+ *   ok - non-zero if the check passed
+ */
+static void check(int ok) {
+  if (!ok) {
+    abort();
+  }
+}
+
+/*
+ * Allocate a buffer, which is never NULL, even for a length of zero.
+ * 
+ * Parameters:
+ * 
+ *   n - the number of bytes
+ * 
+ * Return:
+ * 
+ *   the buffer
+ */
+static void *allocBuf(size_t n) {
+  
+  void *p = NULL;
+  
+  p = malloc((n > 0) ? n : 1);
+  check(p != NULL);
+  return p;
+}
+
+/*
+ * Encode a codepoint sequence in UTF-8.
+ * 
+ * pBuf must have room for 16 bytes.
+ * 
+ * Parameters:
+ * 
+ *   pf - the codepoint sequence
+ * 
+ *   pBuf - the buffer that receives the encoding
+ * 
+ * Return:
+ * 
+ *   the number of bytes written
+ */
+static size_t encodeSeq(const UNIKIT_FOLD *pf, uint8_t *pBuf) {
+  
+  size_t len = 0;
+  int32_t cv = 0;
+  int i = 0;
+  
+  for(i = 0; i < pf->len; i++) {
+    cv = (pf->cpa)[i];
+    check(unikit_valid(cv));
+    
+    if (cv < 0x80) {
+      pBuf[len++] = (uint8_t) cv;
+    } else if (cv < 0x800) {
+      pBuf[len++] = (uint8_t) (0xc0 | (cv >> 6));
+      pBuf[len++] = (uint8_t) (0x80 | (cv & 0x3f));
+    } else if (cv < 0x10000L) {
+      pBuf[len++] = (uint8_t) (0xe0 | (cv >> 12));
+      pBuf[len++] = (uint8_t) (0x80 | ((cv >> 6) & 0x3f));
+      pBuf[len++] = (uint8_t) (0x80 | (cv & 0x3f));
+    } else {
+      pBuf[len++] = (uint8_t) (0xf0 | (cv >> 18));
+      pBuf[len++] = (uint8_t) (0x80 | ((cv >> 12) & 0x3f));
+      pBuf[len++] = (uint8_t) (0x80 | ((cv >> 6) & 0x3f));
+      pBuf[len++] = (uint8_t) (0x80 | (cv & 0x3f));
+    }
+  }
+  return len;
+}
+
+/*
+ * Encode a codepoint sequence in UTF-16 code units of the native byte
+ * order.
+ * 
+ * pBuf must have room for 8 units.
+ * 
+ * Parameters:
+ * 
+ *   pf - the codepoint sequence
+ * 
+ *   pBuf - the buffer that receives the encoding
+ * 
+ * Return:
+ * 
+ *   the number of units written
+ */
+static size_t encodeSeq16(const UNIKIT_FOLD *pf, uint16_t *pBuf) {
+  
+  size_t len = 0;
+  int32_t cv = 0;
+  int i = 0;
+  
+  for(i = 0; i < pf->len; i++) {
+    cv = (pf->cpa)[i];
+    check(unikit_valid(cv));
+    
+    if (cv < 0x10000L) {
+      pBuf[len++] = (uint16_t) cv;
+    } else {
+      pBuf[len++] = (uint16_t) (0xd800 + ((cv - 0x10000L) >> 10));
+      pBuf[len++] = (uint16_t) (0xdc00 + ((cv - 0x10000L) & 0x3ff));
+    }
+  }
+  return len;
+}
+
+/*
+ * Check the category buffer functions.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the input
+ * 
+ *   n - the number of bytes in the input
+ * 
+ *   pCps - the reference codepoints of the input
+ * 
+ *   count - the number of reference codepoints
+ */
+static void checkCategory(
+    const uint8_t * pSrc,
+          size_t    n,
+    const int32_t * pCps,
+          size_t    count) {
+  
+  uint16_t *pOut = NULL;
+  size_t i = 0;
+  
+  pOut = (uint16_t *) allocBuf(count * sizeof(uint16_t));
+  
+  check(unikit_category_utf8(pSrc, n, NULL, 0) == count);
+  check(unikit_category_utf8(pSrc, n, pOut, count) == count);
+  for(i = 0; i < count; i++) {
+    check(pOut[i] == unikit_category(pCps[i]));
+  }
+  
+  memset(pOut, 0, count * sizeof(uint16_t));
+  check(unikit_category_utf8_par(
+          pSrc, n, pOut, count, FUZZ_CHUNK, NULL, NULL) == count);
+  for(i = 0; i < count; i++) {
+    check(pOut[i] == unikit_category(pCps[i]));
+  }
+  
+  free(pOut);
+}
+
+/*
+ * Check the case folding buffer functions.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the input
+ * 
+ *   n - the number of bytes in the input
+ * 
+ *   pCps - the reference codepoints of the input
+ * 
+ *   count - the number of reference codepoints
+ */
+static void checkFold(
+    const uint8_t * pSrc,
+          size_t    n,
+    const int32_t * pCps,
+          size_t    count) {
+  
+  uint8_t *pExpect = NULL;
+  uint8_t *pOut = NULL;
+  size_t elen = 0;
+  size_t olen = 0;
+  size_t cap = 0;
+  size_t used = 0;
+  size_t off = 0;
+  size_t len = 0;
+  size_t i = 0;
+  UNIKIT_CASEFIND *pFind = NULL;
+  UNIKIT_FOLD f;
+  UNIKIT_DECODER dec;
+  
+  /* Initialize structures */
+  memset(&f, 0, sizeof(UNIKIT_FOLD));
+  unikit_decoder_init(&dec, UNIKIT_ENC_UTF8);
+  
+  /* Build the expected output from the single codepoint functions */
+  pExpect = (uint8_t *) allocBuf(count * 16);
+  for(i = 0; i < count; i++) {
+    unikit_fold(&f, pCps[i]);
+    elen += encodeSeq(&f, pExpect + elen);
+  }
+  
+  /* Measure, then write with an exact and with a short buffer */
+  cap = elen + 3 * (n + 3);
+  pOut = (uint8_t *) allocBuf(cap);
+  
+  check(unikit_fold_utf8(pSrc, n, NULL, 0) == elen);
+  check(unikit_fold_utf8(pSrc, n, pOut, elen) == elen);
+  check(memcmp(pOut, pExpect, elen) == 0);
+  if (elen > 0) {
+    check(unikit_fold_utf8(pSrc, n, pOut, elen - 1) == elen);
+  }
+  
+  memset(pOut, 0, cap);
+  check(unikit_fold_utf8_par(
+          pSrc, n, pOut, elen, FUZZ_CHUNK, NULL, NULL) == elen);
+  check(memcmp(pOut, pExpect, elen) == 0);
+  
+  /* The streaming decoder has room to consume the whole input */
+  memset(pOut, 0, cap);
+  olen = unikit_decode_fold(&dec, pSrc, n, pOut, cap, &used);
+  check(used == n);
+  check(unikit_decode_end(&dec) <= 2);
+  check(olen <= elen);
+  check(memcmp(pOut, pExpect, olen) == 0);
+  
+  check(unikit_casecmp_utf8(pSrc, n, pExpect, elen) == 0);
+  check(unikit_casecmp_utf8(pExpect, elen, pSrc, n) == 0);
+  check(unikit_casehash_utf8(pSrc, n, 0) ==
+          unikit_casehash_utf8(pExpect, elen, 0));
+  
+  pFind = unikit_casefind_compile(pExpect, elen);
+  check(unikit_casefind_utf8(pFind, pSrc, n, &off, &len));
+  check((off == 0) && (len == n));
+  unikit_casefind_free(pFind);
+  
+  for(i = 0; i < n; i += 1 + n / FUZZ_FIND) {
+    if ((pSrc[i] >= 0x80) && (pSrc[i] < 0xc0)) {
+      continue;
+    }
+    pFind = unikit_casefind_compile(pSrc + i, n - i);
+    check(unikit_casefind_utf8(pFind, pSrc, n, &off, &len));
+    check((off <= i) && (len <= n - off));
+    unikit_casefind_free(pFind);
+  }
+  
+  free(pExpect);
+  free(pOut);
+}
+
+/*
+ * Check the UTF-16 and UTF-32 buffer functions.
+ * 
+ * The input bytes are copied into arrays of native UTF-16 and UTF-32
+ * code units, ignoring any bytes left over at the end.  The reference
+ * codepoints of the UTF-16 units come from the streaming decoder, fed
+ * with the units in little endian order.  Each UTF-32 unit is its own
+ * reference codepoint, or U+FFFD if it is not valid.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the input
+ * 
+ *   n - the number of bytes in the input
+ */
+static void checkWide(const uint8_t *pSrc, size_t n) {
+  
+  uint16_t *pText16 = NULL;
+  uint16_t *pExpect16 = NULL;
+  uint16_t *pOut16 = NULL;
+  int32_t *pText32 = NULL;
+  int32_t *pExpect32 = NULL;
+  int32_t *pOut32 = NULL;
+  uint8_t *pLE = NULL;
+  int32_t *pCps = NULL;
+  uint16_t *pCats = NULL;
+  size_t m = 0;
+  size_t count = 0;
+  size_t elen = 0;
+  size_t used = 0;
+  size_t i = 0;
+  int32_t cv = 0;
+  int tail = 0;
+  UNIKIT_FOLD f;
+  UNIKIT_DECODER dec;
+  
+  /* Initialize structures */
+  memset(&f, 0, sizeof(UNIKIT_FOLD));
+  unikit_decoder_init(&dec, UNIKIT_ENC_UTF16LE);
+  
+  /* UTF-16 units, and their reference codepoints; every unit decodes
+   * to at most one codepoint */
+  m = n / 2;
+  pText16 = (uint16_t *) allocBuf(m * sizeof(uint16_t));
+  pLE = (uint8_t *) allocBuf(m * 2);
+  if (m > 0) {
+    memcpy(pText16, pSrc, m * sizeof(uint16_t));
+  }
+  for(i = 0; i < m; i++) {
+    pLE[2 * i] = (uint8_t) (pText16[i] & 0xff);
+    pLE[2 * i + 1] = (uint8_t) (pText16[i] >> 8);
+  }
+  
+  pCps = (int32_t *) allocBuf((m + 3) * sizeof(int32_t));
+  count = unikit_decode(&dec, pLE, m * 2, pCps, m + 1, &used);
+  check(used == m * 2);
+  for(tail = unikit_decode_end(&dec); tail > 0; tail--) {
+    pCps[count++] = 0xfffd;
+  }
+  check(count <= m);
+  
+  pCats = (uint16_t *) allocBuf((count + 1) * sizeof(uint16_t));
+  check(unikit_category_utf16(pText16, m, NULL, 0) == count);
+  check(unikit_category_utf16(pText16, m, pCats, count) == count);
+  for(i = 0; i < count; i++) {
+    check(pCats[i] == unikit_category(pCps[i]));
+  }
+  
+  pExpect16 = (uint16_t *) allocBuf((count * 8) * sizeof(uint16_t));
+  elen = 0;
+  for(i = 0; i < count; i++) {
+    unikit_fold(&f, pCps[i]);
+    elen += encodeSeq16(&f, pExpect16 + elen);
+  }
+  pOut16 = (uint16_t *) allocBuf(elen * sizeof(uint16_t));
+  check(unikit_fold_utf16(pText16, m, NULL, 0) == elen);
+  check(unikit_fold_utf16(pText16, m, pOut16, elen) == elen);
+  check(memcmp(pOut16, pExpect16, elen * sizeof(uint16_t)) == 0);
+  if (elen > 0) {
+    check(unikit_fold_utf16(pText16, m, pOut16, elen - 1) == elen);
+  }
+  
+  free(pCats);
+  
+  /* UTF-32 units, which are their own reference codepoints */
+  m = n / 4;
+  pText32 = (int32_t *) allocBuf(m * sizeof(int32_t));
+  if (m > 0) {
+    memcpy(pText32, pSrc, m * sizeof(int32_t));
+  }
+  
+  pCats = (uint16_t *) allocBuf((m + 1) * sizeof(uint16_t));
+  check(unikit_category_utf32(pText32, m, NULL, 0) == m);
+  check(unikit_category_utf32(pText32, m, pCats, m) == m);
+  
+  pExpect32 = (int32_t *) allocBuf((m * 3) * sizeof(int32_t));
+  elen = 0;
+  for(i = 0; i < m; i++) {
+    cv = pText32[i];
+    if (!unikit_valid(cv)) {
+      cv = 0xfffd;
+    }
+    check(pCats[i] == unikit_category(cv));
+    
+    unikit_fold(&f, cv);
+    memcpy(pExpect32 + elen, f.cpa, f.len * sizeof(int32_t));
+    elen += f.len;
+  }
+  pOut32 = (int32_t *) allocBuf(elen * sizeof(int32_t));
+  check(unikit_fold_utf32(pText32, m, NULL, 0) == elen);
+  check(unikit_fold_utf32(pText32, m, pOut32, elen) == elen);
+  check(memcmp(pOut32, pExpect32, elen * sizeof(int32_t)) == 0);
+  if (elen > 0) {
+    check(unikit_fold_utf32(pText32, m, pOut32, elen - 1) == elen);
+  }
+  
+  free(pText16);
+  free(pExpect16);
+  free(pOut16);
+  free(pText32);
+  free(pExpect32);
+  free(pOut32);
+  free(pLE);
+  free(pCps);
+  free(pCats);
+}
+
+/*
+ * Fuzzer entrypoint
+ * =================
+ */
+
+int LLVMFuzzerTestOneInput(const uint8_t *pData, size_t n);
+
+int LLVMFuzzerTestOneInput(const uint8_t *pData, size_t n) {
+  
+  int32_t *pCps = NULL;
+  int32_t *pSplit = NULL;
+  size_t count = 0;
+  size_t count2 = 0;
+  size_t split = 0;
+  size_t used = 0;
+  int tail = 0;
+  UNIKIT_DECODER dec;
+  
+  /* Initialize the module once */
+  if (!m_init) {
+    unikit_init(NULL);
+    m_init = 1;
+  }
+  
+  /* Cut long inputs */
+  if (n > FUZZ_MAX) {
+    n = FUZZ_MAX;
+  }
+  
+  /* Decode the reference codepoints; n + 1 elements always consume the
+   * whole input, and an incomplete sequence at the end adds up to two
+   * more U+FFFD codepoints */
+  pCps = (int32_t *) allocBuf((n + 3) * sizeof(int32_t));
+  unikit_decoder_init(&dec, UNIKIT_ENC_UTF8);
+  count = unikit_decode(&dec, pData, n, pCps, n + 1, &used);
+  check(used == n);
+  tail = unikit_decode_end(&dec);
+  check((tail >= 0) && (tail <= 2));
+  for( ; tail > 0; tail--) {
+    pCps[count++] = 0xfffd;
+  }
+  
+  /* Decoding in two chunks gives the same codepoints */
+  if (n > 0) {
+    split = ((size_t) pData[0]) % n;
+  }
+  pSplit = (int32_t *) allocBuf((n + 3) * sizeof(int32_t));
+  count2 = unikit_decode(&dec, pData, split, pSplit, n + 1, &used);
+  check(used == split);
+  count2 += unikit_decode(
+              &dec, pData + split, n - split,
+              pSplit + count2, n + 1, &used);
+  check(used == n - split);
+  tail = unikit_decode_end(&dec);
+  for( ; tail > 0; tail--) {
+    pSplit[count2++] = 0xfffd;
+  }
+  check(count2 == count);
+  check(memcmp(pCps, pSplit, count * sizeof(int32_t)) == 0);
+  
+  /* Run the checks */
+  checkCategory(pData, n, pCps, count);
+  checkFold(pData, n, pCps, count);
+  checkWide(pData, n);
+  
+  free(pCps);
+  free(pSplit);
+  return 0;
+}
+
+/*
+ * Program entrypoint
+ * ==================
+ */
+
+#ifdef UNIKIT_FUZZ_MAIN
+
+int main(int argc, char *argv[]) {
+  
+  FILE *fh = NULL;
+  uint8_t *pBuf = NULL;
+  size_t n = 0;
+  
+  /* Open the input */
+  if (argc > 2) {
+    fprintf(stderr, "Usage: unikit_fuzz [input]\n");
+    return EXIT_FAILURE;
+  }
+  if (argc == 2) {
+    fh = fopen(argv[1], "rb");
+    if (fh == NULL) {
+      fprintf(stderr, "Failed to open file: %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+  } else {
+    fh = stdin;
+  }
+  
+  /* Read up to FUZZ_MAX bytes and run the checks */
+  pBuf = (uint8_t *) allocBuf(FUZZ_MAX);
+  n = fread(pBuf, 1, FUZZ_MAX, fh);
+  if (ferror(fh)) {
+    fprintf(stderr, "Failed to read input\n");
+    return EXIT_FAILURE;
+  }
+  if (fh != stdin) {
+    fclose(fh);
+  }
+  
+  LLVMFuzzerTestOneInput(pBuf, n);
+  
+  free(pBuf);
+  return EXIT_SUCCESS;
+}
+
+#endif
@@ -11,6 +11,11 @@
  *   unikit_query gencat U+004D
  *   unikit_query gentab
  *   unikit_query genrange Sm
+ *   unikit_query stats input.txt
+ *   unikit_query fold-file input.txt > folded.txt
+ *   unikit_query gencat-file input.txt
+ *   unikit_query gencat-file -c codepoints.txt
+ *   unikit_query fold-file - < input.txt
  * 
  * Unicode codepoint parameters start with "U+" (case insensitive) and
  * are followed by 1 to 6 base-16 digits (case insensitive).
@@ -35,6 +40,39 @@
  * and prints out all codepoint ranges that have the given general
  * category.
  * 
+ * Both of these queries go through the codepoints with
+ * unikit_category_runs(), one category run at a time.
+ * 
+ * The "stats" query requires the path to a UTF-8 text file as a
+ * parameter.  It determines the general category and the case folding
+ * of every codepoint in the file, and then prints how many lookups were
+ * answered by each tier of the data tables.  This requires the unikit.c
+ * module to be compiled with the UNIKIT_INSTRUMENT build mode.
+ * 
+ * The "fold-file" and "gencat-file" queries answer a whole file of
+ * queries with the buffer functions of the library, so that scripted
+ * checks do not need to start one process per codepoint.  The path "-"
+ * reads the input from standard input.  By default, the input is UTF-8
+ * text.  "fold-file" writes its case folding to standard output with
+ * unikit_fold_utf8(), and "gencat-file" prints the category of each
+ * codepoint of the text, found with unikit_category_utf8(), in the same
+ * format as the "gencat" query.  Ill-formed sequences in the text are
+ * decoded to U+FFFD, as the library always does.
+ * 
+ * With the "-c" option, the input is instead a list of codepoints in
+ * the "U+004D" format, separated by whitespace.  "gencat-file" looks
+ * them up with unikit_category_buf(), and "fold-file" case folds them
+ * with unikit_fold_utf32() and prints the case folding of each of them
+ * after the codepoint itself.  Surrogates may not be case folded.
+ * 
+ * Both queries also print their throughput to standard error, so that
+ * they double as a quick throughput probe.  Only the library calls are
+ * timed, not reading the input or printing the results.  The calls are
+ * repeated until at least TIME_MIN seconds have passed, and the average
+ * is reported in megabytes and codepoints per second.  The megabytes
+ * count the bytes of the text, or four bytes for each codepoint of a
+ * list, which is the size of the array passed to the library.
+ * 
  * Requirements
  * ------------
  * 
@@ -43,14 +81,19 @@
  * 
  * Requires the diagnostic.c module, which is contained within this test
  * directory.
+ * 
+ * Requires a POSIX platform for clock_gettime().
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "diagnostic.h"
 #include "unikit.h"
@@ -66,7 +109,7 @@ static void raiseErr(int lnum, const char *pDetail, ...) {
   diagnostic_global(1, __FILE__, lnum, pDetail, ap);
   va_end(ap);
 }
- 
+
 static void sayWarn(int lnum, const char *pDetail, ...) {
   va_list ap;
   va_start(ap, pDetail);
@@ -74,6 +117,29 @@ static void sayWarn(int lnum, const char *pDetail, ...) {
   va_end(ap);
 }
 
+/*
+ * Constants
+ * =========
+ */
+
+/*
+ * The number of bytes of the input file that the "stats" subprogram
+ * reads at a time.
+ */
+#define STATS_CHUNK (4096)
+
+/*
+ * The number of bytes of the input that the "fold-file" and
+ * "gencat-file" subprograms read at a time.
+ */
+#define READ_CHUNK (65536)
+
+/*
+ * The minimum number of seconds that the "fold-file" and "gencat-file"
+ * subprograms repeat the timed library calls.
+ */
+#define TIME_MIN (0.25)
+
 /*
  * Type declarations
  * =================
@@ -113,10 +179,38 @@ static int32_t parseCodepoint(const char *pstr);
 static int gentab_cat_cmp(const void *pA, const void *pB);
 static int gentab_ord_cmp(const void *pA, const void *pB);
 static int gentab_search_cmp(const void *pKey, const void *pEl);
+static int gentab_run(
+    void     * pCustom,
+    int32_t    lo,
+    int32_t    hi,
+    uint16_t   gcat);
 static void gentab(void);
 
+static int genrange_run(
+    void     * pCustom,
+    int32_t    lo,
+    int32_t    hi,
+    uint16_t   gcat);
 static void genrange(uint16_t catcode);
 
+static void printCount(
+    const char *pLabel,
+          uint64_t count,
+          uint64_t total);
+static void stats(const char *pPath);
+
+static double getTime(void);
+static uint8_t *readInput(const char *pPath, size_t *pLen);
+static int32_t *parseList(
+    const uint8_t *pBuf,
+          size_t   n,
+          size_t  *pCount);
+static void printFold(const UNIKIT_FOLD *pf);
+static void printCat(int32_t cv, uint16_t gcat);
+static void printRate(size_t bytes, size_t cp_count, double secs);
+static void foldFile(const char *pPath, int list);
+static void gencatFile(const char *pPath, int list);
+
 /*
  * Custom error handler for Unikit library.
  */
@@ -295,18 +389,43 @@ static int gentab_search_cmp(const void *pKey, const void *pEl) {
   return result;
 }
 
+/*
+ * Category run callback of the "gentab" subprogram.
+ * 
+ * pCustom is the array of 30 GTAB records, sorted by gencat.  The
+ * length of the run is added to the record of its category.
+ */
+static int gentab_run(
+    void     * pCustom,
+    int32_t    lo,
+    int32_t    hi,
+    uint16_t   gcat) {
+  
+  GTAB *pr = NULL;
+  
+  if (pCustom == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  pr = (GTAB *) bsearch(
+                  &gcat, pCustom,
+                  30, sizeof(GTAB),
+                  &gentab_search_cmp);
+  if (pr == NULL) {
+    raiseErr(__LINE__, "Unrecognized category encountered");
+  }
+  pr->count += (hi - lo) + 1;
+  
+  return 1;
+}
+
 /*
  * The "gentab" subprogram.
  */
 static void gentab(void) {
   
   GTAB rec[30];
-  GTAB *pr = NULL;
   int32_t i = 0;
-  uint16_t ccat = 0;
-  
-  uint16_t buf_cat = 0;
-  int32_t buf_count = 0;
   
   /* Initialize records */
   memset(rec, 0, sizeof(GTAB) * 30);
@@ -321,15 +440,15 @@ static void gentab(void) {
   rec[ 2].gencat = UNIKIT_GCAT_Lt;
   rec[ 3].gencat = UNIKIT_GCAT_Lm;
   rec[ 4].gencat = UNIKIT_GCAT_Lo;
-
+  
   rec[ 5].gencat = UNIKIT_GCAT_Mn;
   rec[ 6].gencat = UNIKIT_GCAT_Mc;
   rec[ 7].gencat = UNIKIT_GCAT_Me;
-
+  
   rec[ 8].gencat = UNIKIT_GCAT_Nd;
   rec[ 9].gencat = UNIKIT_GCAT_Nl;
   rec[10].gencat = UNIKIT_GCAT_No;
-
+  
   rec[11].gencat = UNIKIT_GCAT_Pc;
   rec[12].gencat = UNIKIT_GCAT_Pd;
   rec[13].gencat = UNIKIT_GCAT_Ps;
@@ -337,16 +456,16 @@ static void gentab(void) {
   rec[15].gencat = UNIKIT_GCAT_Pi;
   rec[16].gencat = UNIKIT_GCAT_Pf;
   rec[17].gencat = UNIKIT_GCAT_Po;
-
+  
   rec[18].gencat = UNIKIT_GCAT_Sm;
   rec[19].gencat = UNIKIT_GCAT_Sc;
   rec[20].gencat = UNIKIT_GCAT_Sk;
   rec[21].gencat = UNIKIT_GCAT_So;
-
+  
   rec[22].gencat = UNIKIT_GCAT_Zs;
   rec[23].gencat = UNIKIT_GCAT_Zl;
   rec[24].gencat = UNIKIT_GCAT_Zp;
-
+  
   rec[25].gencat = UNIKIT_GCAT_Cc;
   rec[26].gencat = UNIKIT_GCAT_Cf;
   rec[27].gencat = UNIKIT_GCAT_Cs;
@@ -356,42 +475,8 @@ static void gentab(void) {
   /* Sort records according to general category */
   qsort(rec, (size_t) 30, sizeof(GTAB), &gentab_cat_cmp);
   
-  /* Tabulate codepoints */
-  for(i = 0; i <= 0x10ffff; i++) {
-    /* Get category */
-    ccat = unikit_category(i);
-    
-    /* Flush buffer if not relevant */
-    if ((buf_count > 0) && (buf_cat != ccat)) {
-      pr = (GTAB *) bsearch(
-                      &buf_cat, rec,
-                      30, sizeof(GTAB),
-                      &gentab_search_cmp);
-      if (pr == NULL) {
-        raiseErr(__LINE__, "Unrecognized category encountered",
-          buf_cat);
-      }
-      pr->count += buf_count;
-      buf_count = 0;
-    }
-    
-    /* Update buffer */
-    buf_cat = ccat;
-    buf_count++;
-  }
-  
-  /* Flush buffer */
-  if (buf_count > 0) {
-    pr = (GTAB *) bsearch(
-                    &buf_cat, rec,
-                    30, sizeof(GTAB),
-                    &gentab_search_cmp);
-    if (pr == NULL) {
-      raiseErr(__LINE__, "Unrecognized category encountered");
-    }
-    pr->count += buf_count;
-    buf_count = 0;
-  }
+  /* Tabulate codepoints one category run at a time */
+  unikit_category_runs(&gentab_run, rec);
   
   /* Sort records according to display order */
   qsort(rec, (size_t) 30, sizeof(GTAB), &gentab_ord_cmp);
@@ -405,20 +490,36 @@ static void gentab(void) {
 }
 
 /*
- * The "genrange" subprogram.
+ * Category run callback of the "genrange" subprogram.
+ * 
+ * pCustom points to the uint16_t category code that was requested.
+ * Runs of that category are printed.
  */
-static void genrange(uint16_t catcode) {
+static int genrange_run(
+    void     * pCustom,
+    int32_t    lo,
+    int32_t    hi,
+    uint16_t   gcat) {
   
-  int32_t i = 0;
-  
-  int buf_fill = 0;
-  int32_t buf_low = 0;
-  int32_t buf_hi  = 0;
+  if (pCustom == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
   
-  char gcat[3];
+  if (gcat == *((const uint16_t *) pCustom)) {
+    printf("%04lx - %04lx [%c%c]\n",
+      (long) lo,
+      (long) hi,
+      (int) (gcat >> 8),
+      (int) (gcat & 0xff));
+  }
   
-  /* Initialize buffer */
-  memset(gcat, 0, 3);
+  return 1;
+}
+
+/*
+ * The "genrange" subprogram.
+ */
+static void genrange(uint16_t catcode) {
   
   /* Check parameter */
   if (((catcode & 0xff00) == 0) || ((catcode & 0x00ff) == 0) ||
@@ -426,44 +527,603 @@ static void genrange(uint16_t catcode) {
     raiseErr(__LINE__, "Invalid category code");
   }
   
-  /* Get string form for category */
-  gcat[0] = (char) (catcode >> 8);
-  gcat[1] = (char) (catcode & 0xff);
+  /* Print the runs of the requested category */
+  unikit_category_runs(&genrange_run, &catcode);
+}
+
+/*
+ * Print one line of a "stats" histogram.
+ * 
+ * If total is greater than zero, the count is also printed as a
+ * percentage of the total.
+ * 
+ * Parameters:
+ * 
+ *   pLabel - the label of the line
+ * 
+ *   count - the count to print
+ * 
+ *   total - the total of the histogram, or zero
+ */
+static void printCount(
+    const char *pLabel,
+          uint64_t count,
+          uint64_t total) {
+  
+  if (pLabel == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  if (total > 0) {
+    printf("  %-10s : %12lu  (%5.1f%%)\n",
+      pLabel,
+      (unsigned long) count,
+      (100.0 * (double) count) / ((double) total));
+  } else {
+    printf("  %-10s : %12lu\n", pLabel, (unsigned long) count);
+  }
+}
+
+/*
+ * The "stats" subprogram.
+ */
+static void stats(const char *pPath) {
+  
+  static uint8_t buf[STATS_CHUNK];
+  static uint16_t cats[STATS_CHUNK + 1];
+  static uint8_t folds[3 * (STATS_CHUNK + 3)];
+  
+  FILE *fh = NULL;
+  size_t n = 0;
+  size_t used = 0;
+  uint64_t cp_count = 0;
+  uint64_t total = 0;
+  int i = 0;
+  char label[16];
+  
+  UNIKIT_DECODER dcat;
+  UNIKIT_DECODER dfold;
+  UNIKIT_STATS st;
+  
+  /* Initialize structures */
+  memset(label, 0, sizeof(label));
+  memset(&st, 0, sizeof(UNIKIT_STATS));
+  unikit_decoder_init(&dcat, UNIKIT_ENC_UTF8);
+  unikit_decoder_init(&dfold, UNIKIT_ENC_UTF8);
+  
+  /* Check parameter */
+  if (pPath == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Make sure the counters are available and start them from zero */
+  if (!unikit_stats_get(&st)) {
+    raiseErr(__LINE__,
+      "Unikit must be compiled with UNIKIT_INSTRUMENT for stats");
+  }
+  unikit_stats_reset();
+  
+  /* Classify and case fold the file one chunk at a time; the output
+   * buffers are large enough that each chunk is always consumed in
+   * full */
+  fh = fopen(pPath, "rb");
+  if (fh == NULL) {
+    raiseErr(__LINE__, "Failed to open file: %s", pPath);
+  }
+  
+  while ((n = fread(buf, 1, STATS_CHUNK, fh)) > 0) {
+    cp_count += (uint64_t) unikit_decode_category(
+                  &dcat, buf, n, cats, STATS_CHUNK + 1, &used);
+    if (used != n) {
+      raiseErr(__LINE__, NULL);
+    }
+    
+    unikit_decode_fold(
+      &dfold, buf, n, folds, 3 * (STATS_CHUNK + 3), &used);
+    if (used != n) {
+      raiseErr(__LINE__, NULL);
+    }
+  }
+  if (ferror(fh)) {
+    raiseErr(__LINE__, "Failed to read file: %s", pPath);
+  }
+  fclose(fh);
+  fh = NULL;
+  
+  cp_count += (uint64_t) unikit_decode_end(&dcat);
+  unikit_decode_end(&dfold);
+  
+  /* Get the counters */
+  unikit_stats_get(&st);
+  
+  /* Print the category tiers */
+  printf("Codepoints : %lu\n\n", (unsigned long) cp_count);
+  
+  total = st.cat_core + st.cat_bitmap + st.cat_gen + st.cat_remainder +
+            st.cat_unified + st.cat_astral + st.cat_invalid;
+  printf("Category lookups by tier:\n");
+  printCount("core", st.cat_core, total);
+  printCount("bitmap", st.cat_bitmap, total);
+  printCount("gen", st.cat_gen, total);
+  printCount("remainder", st.cat_remainder, total);
+  printCount("unified", st.cat_unified, total);
+  printCount("astral", st.cat_astral, total);
+  printCount("invalid", st.cat_invalid, total);
   
-  /* Go through all codepoints */
-  for(i = 0; i <= 0x10ffff; i++) {
-    /* Check if this codepoint is part of requested category */
-    if (unikit_category(i) == catcode) {
-      /* Part of requested category, so start buffer if not filled */
-      if (!buf_fill) {
-        buf_fill = 1;
-        buf_low = i;
-        buf_hi = i;
+  /* Print the astral scan histogram */
+  printf("\nAstral lookups by records passed over:\n");
+  for(i = 0; i < UNIKIT_STATS_SCAN_LEN; i++) {
+    if (i < UNIKIT_STATS_SCAN_LEN - 1) {
+      sprintf(label, "%d", i);
+    } else {
+      sprintf(label, "%d+", i);
+    }
+    printCount(label, (st.astral_scan)[i], st.cat_astral);
+  }
+  
+  /* Print the trie and two-stage table lookups */
+  total = 0;
+  for(i = 0; i < UNIKIT_STATS_TRIE_LEN; i++) {
+    total += (st.trie_levels)[i];
+  }
+  
+  printf("\nTrie lookups by levels read:\n");
+  for(i = 0; i < UNIKIT_STATS_TRIE_LEN; i++) {
+    sprintf(label, "%d", i + 1);
+    printCount(label, (st.trie_levels)[i], total);
+  }
+  
+  printf("\nTwo-stage table lookups:\n");
+  printCount("all", st.stage_queries, 0);
+  
+  /* Print the case folding histogram */
+  total = st.fold_ascii;
+  for(i = 0; i < 4; i++) {
+    total += (st.fold_len)[i];
+  }
+  
+  printf("\nCase foldings by length:\n");
+  printCount("ascii", st.fold_ascii, total);
+  for(i = 0; i < 4; i++) {
+    sprintf(label, "%d", i + 1);
+    printCount(label, (st.fold_len)[i], total);
+  }
+}
+
+/*
+ * Get a monotonic time in seconds.
+ * 
+ * Return:
+ * 
+ *   the current time in seconds
+ */
+static double getTime(void) {
+  
+  struct timespec ts;
+  
+  memset(&ts, 0, sizeof(struct timespec));
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+    raiseErr(__LINE__, "Failed to read clock");
+  }
+  
+  return ((double) ts.tv_sec) + (((double) ts.tv_nsec) * 1.0e-9);
+}
+
+/*
+ * Read a whole input file into memory.
+ * 
+ * The path "-" reads standard input.  The buffer is always allocated,
+ * even if the input is empty, and the caller must free it.
+ * 
+ * Parameters:
+ * 
+ *   pPath - the path to the file, or "-"
+ * 
+ *   pLen - variable to receive the number of bytes read
+ * 
+ * Return:
+ * 
+ *   the bytes of the input
+ */
+static uint8_t *readInput(const char *pPath, size_t *pLen) {
+  
+  FILE *fh = NULL;
+  uint8_t *pBuf = NULL;
+  uint8_t *pNew = NULL;
+  size_t len = 0;
+  size_t cap = 0;
+  size_t n = 0;
+  
+  /* Check parameters */
+  if ((pPath == NULL) || (pLen == NULL)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Open the input */
+  if (strcmp(pPath, "-") == 0) {
+    fh = stdin;
+  } else {
+    fh = fopen(pPath, "rb");
+    if (fh == NULL) {
+      raiseErr(__LINE__, "Failed to open file: %s", pPath);
+    }
+  }
+  
+  /* Read chunks, doubling the buffer whenever it has no room for
+   * another chunk */
+  cap = READ_CHUNK;
+  pBuf = (uint8_t *) malloc(cap);
+  if (pBuf == NULL) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+  
+  while ((n = fread(pBuf + len, 1, READ_CHUNK, fh)) > 0) {
+    len += n;
+    if (cap - len < READ_CHUNK) {
+      if (cap > ((size_t) -1) / 2) {
+        raiseErr(__LINE__, "Input too large");
       }
+      cap *= 2;
+      pNew = (uint8_t *) realloc(pBuf, cap);
+      if (pNew == NULL) {
+        raiseErr(__LINE__, "Out of memory");
+      }
+      pBuf = pNew;
+    }
+  }
+  if (ferror(fh)) {
+    raiseErr(__LINE__, "Failed to read file: %s", pPath);
+  }
+  if (fh != stdin) {
+    fclose(fh);
+  }
+  
+  *pLen = len;
+  return pBuf;
+}
+
+/*
+ * Parse a list of codepoints in "U+004D" format.
+ * 
+ * The codepoints are separated by any amount of ASCII whitespace.  Each
+ * of them is parsed with parseCodepoint(), so surrogates are allowed.
+ * The array is always allocated, even if the list is empty, and the
+ * caller must free it.
+ * 
+ * Parameters:
+ * 
+ *   pBuf - the text of the list
+ * 
+ *   n - the number of bytes in the text
+ * 
+ *   pCount - variable to receive the number of codepoints
+ * 
+ * Return:
+ * 
+ *   the parsed codepoints
+ */
+static int32_t *parseList(
+    const uint8_t *pBuf,
+          size_t   n,
+          size_t  *pCount) {
+  
+  int32_t *pCps = NULL;
+  size_t count = 0;
+  size_t i = 0;
+  size_t k = 0;
+  char tok[16];
+  
+  /* Check parameters */
+  if (((pBuf == NULL) && (n > 0)) || (pCount == NULL)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Every codepoint has at least three characters and a separator, so
+   * this is always enough room */
+  pCps = (int32_t *) malloc(((n / 2) + 1) * sizeof(int32_t));
+  if (pCps == NULL) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+  
+  i = 0;
+  while (i < n) {
+    /* Skip whitespace */
+    if ((pBuf[i] == ' ') || (pBuf[i] == '\t') || (pBuf[i] == '\r') ||
+        (pBuf[i] == '\n') || (pBuf[i] == '\f') || (pBuf[i] == '\v')) {
+      i++;
+      continue;
+    }
+    
+    /* Copy the token, which must fit in the buffer with its nul */
+    k = 0;
+    while ((i < n) && (pBuf[i] != ' ') && (pBuf[i] != '\t') &&
+            (pBuf[i] != '\r') && (pBuf[i] != '\n') &&
+            (pBuf[i] != '\f') && (pBuf[i] != '\v')) {
+      if (k >= sizeof(tok) - 1) {
+        raiseErr(__LINE__, "Invalid codepoint parameter");
+      }
+      tok[k] = (char) pBuf[i];
+      k++;
+      i++;
+    }
+    tok[k] = (char) 0;
+    
+    pCps[count] = parseCodepoint(tok);
+    count++;
+  }
+  
+  *pCount = count;
+  return pCps;
+}
+
+/*
+ * Print a case folding as a sequence of codepoints, followed by a line
+ * break.
+ * 
+ * Parameters:
+ * 
+ *   pf - the case folding
+ */
+static void printFold(const UNIKIT_FOLD *pf) {
+  
+  int i = 0;
+  
+  if (pf == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  for(i = 0; i < pf->len; i++) {
+    if (i > 0) {
+      printf(" ");
+    }
+    printf("U+%04lx", (long) (pf->cpa)[i]);
+  }
+  printf("\n");
+}
+
+/*
+ * Print the general category of a codepoint on a line.
+ * 
+ * Parameters:
+ * 
+ *   cv - the codepoint
+ * 
+ *   gcat - its general category
+ */
+static void printCat(int32_t cv, uint16_t gcat) {
+  printf("U+%04lx : ", (long) cv);
+  putchar((int) (gcat >> 8));
+  putchar((int) (gcat & 0xff));
+  printf("\n");
+}
+
+/*
+ * Print the throughput of a bulk query to standard error.
+ * 
+ * Parameters:
+ * 
+ *   bytes - the number of input bytes passed to the library
+ * 
+ *   cp_count - the number of codepoints in the input
+ * 
+ *   secs - the average time of one pass over the input, in seconds
+ */
+static void printRate(size_t bytes, size_t cp_count, double secs) {
+  
+  if (!(secs > 0.0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  fprintf(stderr,
+    "%lu bytes, %lu codepoints in %.1f us : "
+    "%.1f MB/s, %.0f codepoints/s\n",
+    (unsigned long) bytes,
+    (unsigned long) cp_count,
+    secs * 1.0e6,
+    (((double) bytes) / secs) * 1.0e-6,
+    ((double) cp_count) / secs);
+}
+
+/*
+ * The "fold-file" subprogram.
+ * 
+ * Parameters:
+ * 
+ *   pPath - the path to the input, or "-" for standard input
+ * 
+ *   list - non-zero if the input is a list of codepoints, zero if it is
+ *   UTF-8 text
+ */
+static void foldFile(const char *pPath, int list) {
+  
+  uint8_t *pText = NULL;
+  uint8_t *pOut = NULL;
+  int32_t *pCps = NULL;
+  int32_t *pOut32 = NULL;
+  size_t n = 0;
+  size_t count = 0;
+  size_t olen = 0;
+  size_t flen = 0;
+  size_t off = 0;
+  size_t i = 0;
+  long reps = 0;
+  double t0 = 0.0;
+  double t = 0.0;
+  UNIKIT_FOLD fold;
+  
+  /* Check parameter and read the input */
+  if (pPath == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  pText = readInput(pPath, &n);
+  
+  if (list) {
+    /* Parse the codepoints, which must all be valid */
+    pCps = parseList(pText, n, &count);
+    for(i = 0; i < count; i++) {
+      if (!unikit_valid(pCps[i])) {
+        raiseErr(__LINE__, "Codepoint out of range");
+      }
+    }
+    
+    /* Size the output without timing */
+    olen = unikit_fold_utf32(pCps, count, NULL, 0);
+    
+    pOut32 = (int32_t *) malloc((olen + 1) * sizeof(int32_t));
+    if (pOut32 == NULL) {
+      raiseErr(__LINE__, "Out of memory");
+    }
+    
+    /* Case fold the codepoints until enough time has passed */
+    t0 = getTime();
+    do {
+      if (unikit_fold_utf32(pCps, count, pOut32, olen) != olen) {
+        raiseErr(__LINE__, NULL);
+      }
+      reps++;
+      t = getTime() - t0;
+    } while (t < TIME_MIN);
+    
+    /* Print the results, measuring the part of the output that belongs
+     * to each codepoint */
+    memset(&fold, 0, sizeof(UNIKIT_FOLD));
+    for(i = 0; i < count; i++) {
+      flen = unikit_fold_utf32(&(pCps[i]), 1, NULL, 0);
+      if ((flen < 1) || (flen > 4) || (flen > olen - off)) {
+        raiseErr(__LINE__, NULL);
+      }
+      memcpy(fold.cpa, pOut32 + off, flen * sizeof(int32_t));
+      fold.len = (uint8_t) flen;
+      off += flen;
       
-      /* Update buffer */
-      buf_hi = i;
-      
+      printf("U+%04lx : ", (long) pCps[i]);
+      printFold(&fold);
+    }
+    
+    printRate(count * sizeof(int32_t), count, t / ((double) reps));
+    
+  } else {
+    /* Size the output and count the codepoints without timing */
+    olen = unikit_fold_utf8(pText, n, NULL, 0);
+    count = unikit_category_utf8(pText, n, NULL, 0);
+    
+    pOut = (uint8_t *) malloc(olen + 1);
+    if (pOut == NULL) {
+      raiseErr(__LINE__, "Out of memory");
+    }
+    
+    /* Case fold the text until enough time has passed */
+    t0 = getTime();
+    do {
+      if (unikit_fold_utf8(pText, n, pOut, olen) != olen) {
+        raiseErr(__LINE__, NULL);
+      }
+      reps++;
+      t = getTime() - t0;
+    } while (t < TIME_MIN);
+    
+    /* Write the case folded text */
+    if (fwrite(pOut, 1, olen, stdout) != olen) {
+      raiseErr(__LINE__, "Failed to write output");
+    }
+    
+    printRate(n, count, t / ((double) reps));
+  }
+  
+  /* Release buffers */
+  free(pText);
+  free(pOut);
+  free(pCps);
+  free(pOut32);
+}
+
+/*
+ * The "gencat-file" subprogram.
+ * 
+ * Parameters:
+ * 
+ *   pPath - the path to the input, or "-" for standard input
+ * 
+ *   list - non-zero if the input is a list of codepoints, zero if it is
+ *   UTF-8 text
+ */
+static void gencatFile(const char *pPath, int list) {
+  
+  uint8_t *pText = NULL;
+  int32_t *pCps = NULL;
+  uint16_t *pCats = NULL;
+  size_t n = 0;
+  size_t count = 0;
+  size_t used = 0;
+  size_t i = 0;
+  long reps = 0;
+  double t0 = 0.0;
+  double t = 0.0;
+  UNIKIT_DECODER dec;
+  
+  /* Check parameter and read the input */
+  if (pPath == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  pText = readInput(pPath, &n);
+  
+  if (list) {
+    /* Parse the codepoints */
+    pCps = parseList(pText, n, &count);
+    
+  } else {
+    /* Decode the codepoints of the text without timing, only so that
+     * they can be printed with their categories */
+    pCps = (int32_t *) malloc((n + 1) * sizeof(int32_t));
+    if (pCps == NULL) {
+      raiseErr(__LINE__, "Out of memory");
+    }
+    
+    unikit_decoder_init(&dec, UNIKIT_ENC_UTF8);
+    count = unikit_decode(&dec, pText, n, pCps, n + 1, &used);
+    if (used != n) {
+      raiseErr(__LINE__, NULL);
+    }
+    for(i = (size_t) unikit_decode_end(&dec); i > 0; i--) {
+      pCps[count] = 0xfffd;
+      count++;
+    }
+  }
+  
+  pCats = (uint16_t *) malloc((count + 1) * sizeof(uint16_t));
+  if (pCats == NULL) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+  
+  /* Look up the categories until enough time has passed */
+  t0 = getTime();
+  do {
+    if (list) {
+      unikit_category_buf(pCps, pCats, count);
     } else {
-      /* Not part of requested category, so flush buffer if filled */
-      if (buf_fill) {
-        printf("%04lx - %04lx [%s]\n",
-          (long) buf_low,
-          (long) buf_hi,
-          gcat);
-        buf_fill = 0;
+      if (unikit_category_utf8(pText, n, pCats, count) != count) {
+        raiseErr(__LINE__, NULL);
       }
     }
+    reps++;
+    t = getTime() - t0;
+  } while (t < TIME_MIN);
+  
+  /* Print the results */
+  for(i = 0; i < count; i++) {
+    printCat(pCps[i], pCats[i]);
   }
   
-  /* Flush buffer if filled */
-  if (buf_fill) {
-    printf("%04lx - %04lx [%s]\n",
-      (long) buf_low,
-      (long) buf_hi,
-      gcat);
-    buf_fill = 0;
+  if (list) {
+    printRate(count * sizeof(int32_t), count, t / ((double) reps));
+  } else {
+    printRate(n, count, t / ((double) reps));
   }
+  
+  /* Release buffers */
+  free(pText);
+  free(pCps);
+  free(pCats);
 }
 
 /*
@@ -474,8 +1134,9 @@ static void genrange(uint16_t catcode) {
 int main(int argc, char *argv[]) {
   
   int32_t cv = 0;
-  int i = 0;
+  int list = 0;
   uint16_t retval = 0;
+  const char *pPath = NULL;
   UNIKIT_FOLD fold;
   
   /* Initialize structures */
@@ -505,14 +1166,8 @@ int main(int argc, char *argv[]) {
     unikit_fold(&fold, cv);
     
     /* Print the case folding */
-    for(i = 0; i < fold.len; i++) {
-      if (i > 0) {
-        printf(" ");
-      }
-      printf("U+%04lx", (long) (fold.cpa)[i]);
-    }
-    printf("\n");
-  
+    printFold(&fold);
+    
   } else if (strcmp(argv[1], "gencat") == 0) {
     /* General category query -- must have one argument beyond mode */
     if (argc != 3) {
@@ -524,11 +1179,8 @@ int main(int argc, char *argv[]) {
     retval = unikit_category(cv);
     
     /* Print the result */
-    printf("U+%04lx : ", (long) cv);
-    putchar((int) (retval >> 8));
-    putchar((int) (retval & 0xff));
-    printf("\n");
-  
+    printCat(cv, retval);
+    
   } else if (strcmp(argv[1], "gentab") == 0) {
     /* General category tabulation -- no extra arguments */
     if (argc != 2) {
@@ -537,7 +1189,7 @@ int main(int argc, char *argv[]) {
     
     /* Invoke subprogram */
     gentab();
-  
+    
   } else if (strcmp(argv[1], "genrange") == 0) {
     /* Range for a general category -- must have one argument beyond
      * mode */
@@ -558,6 +1210,37 @@ int main(int argc, char *argv[]) {
     /* Invoke subprogram */
     genrange((uint16_t) (((uint16_t) argv[2][0]) << 8) |
                          ((uint16_t) argv[2][1]));
+                         
+  } else if (strcmp(argv[1], "stats") == 0) {
+    /* Lookup statistics for a file -- must have one argument beyond
+     * mode */
+    if (argc != 3) {
+      raiseErr(__LINE__, "Wrong number of arguments for stats");
+    }
+    
+    /* Invoke subprogram */
+    stats(argv[2]);
+    
+  } else if ((strcmp(argv[1], "fold-file") == 0) ||
+              (strcmp(argv[1], "gencat-file") == 0)) {
+    /* Bulk queries -- must have one argument beyond mode, which may be
+     * preceded by the -c option for a codepoint list */
+    if ((argc == 4) && (strcmp(argv[2], "-c") == 0)) {
+      list = 1;
+      pPath = argv[3];
+    } else if (argc == 3) {
+      list = 0;
+      pPath = argv[2];
+    } else {
+      raiseErr(__LINE__, "Wrong number of arguments for %s", argv[1]);
+    }
+    
+    /* Invoke subprogram */
+    if (strcmp(argv[1], "fold-file") == 0) {
+      foldFile(pPath, list);
+    } else {
+      gencatFile(pPath, list);
+    }
     
   } else {
     raiseErr(__LINE__, "Unrecognized subprogram: %s", argv[1]);
@@ -0,0 +1,1415 @@
+/*
+ * unikit_verify.c
+ * ===============
+ * 
+ * Exhaustively verify Unikit's lookups over the whole codepoint range.
+ * 
+ * Syntax
+ * ------
+ * 
+ *   unikit_verify ucd UCD/UnicodeData.txt UCD/CaseFolding.txt
+ *   unikit_verify self
+ *   unikit_verify dump > reference.txt
+ *   unikit_verify compare reference.txt
+ * 
+ * Description
+ * -----------
+ * 
+ * These checks are meant to be run after any change to the data
+ * tables, to the table generator, or to the lookup code, in every build
+ * mode of the library.  Each check prints the number of mismatches it
+ * found to standard output, along with the first MAX_REPORT mismatches
+ * to standard error.  The program exits with a failure status if there
+ * were any mismatches.
+ * 
+ * The "ucd" check parses UnicodeData.txt and CaseFolding.txt from the
+ * Unicode Character Database and compares unikit_category() and
+ * unikit_fold() against them for every codepoint in U+0000 to
+ * U+10FFFF.  It also checks that every value in a fixed list of
+ * integers outside that range, including negative values, is not
+ * valid, has the category Cn, is not in any standard class, and has no
+ * property flags.
+ * 
+ * The "self" check compares the different ways that the library offers
+ * to make the same lookups for every codepoint.  unikit_category() is
+ * compared against the inline header, unikit_category_buf(), the
+ * UTF-8, UTF-16, and UTF-32 buffer functions, the streaming decoder,
+ * and unikit_category_runs(), and the standard character classes are
+ * compared against the categories.  unikit_fold() is compared against
+ * the UTF-8, UTF-16, and UTF-32 buffer functions, the streaming
+ * decoder, unikit_casecmp_utf8(), and unikit_casehash_utf8().  Each
+ * field of unikit_props() is compared against the function that makes
+ * the same lookup on its own.
+ * 
+ * The "dump" check prints one line for every codepoint, and for every
+ * value in the list of integers outside the codepoint range, with every
+ * property that the library returns for it.  The "compare" check
+ * computes the same lines and compares them against a dump that was
+ * written earlier.  Writing the dump with a build of the previous table
+ * implementation, or of another build mode, and comparing it with the
+ * new build proves that a change of table format does not change any
+ * lookup result.
+ * 
+ * The unikit_fuzz.c module in this directory is a fuzz target for the
+ * buffer functions, which complements these checks with inputs
+ * that are not well-formed.
+ * 
+ * Requirements
+ * ------------
+ * 
+ * Requires the unikit library, which consists of the unikit.c and
+ * unikit_data.c modules.
+ * 
+ * Requires the diagnostic.c module, which is contained within this test
+ * directory.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diagnostic.h"
+#include "unikit.h"
+#include "unikit_inline.h"
+
+/*
+ * Diagnostics
+ * ===========
+ */
+
+static void raiseErr(int lnum, const char *pDetail, ...) {
+  va_list ap;
+  va_start(ap, pDetail);
+  diagnostic_global(1, __FILE__, lnum, pDetail, ap);
+  va_end(ap);
+}
+
+/*
+ * Constants
+ * =========
+ */
+
+/*
+ * The number of codepoints in U+0000 to U+10FFFF.
+ */
+#define CP_COUNT (0x110000L)
+
+/*
+ * The maximum length of a line in the UCD data files and in a dump.
+ */
+#define MAX_LINE (1024)
+
+/*
+ * The maximum number of mismatches that are reported individually.
+ */
+#define MAX_REPORT (32)
+
+/*
+ * The chunk size in bytes that the streaming decoder is fed with.  It
+ * is deliberately not a multiple of any sequence length, so that
+ * sequences are split across chunk boundaries in every possible way.
+ */
+#define DECODE_CHUNK (7)
+
+/*
+ * A non-zero seed for the caseless hash check.
+ */
+#define HASH_SEED UINT64_C(0x9e3779b97f4a7c15)
+
+/*
+ * Type declarations
+ * =================
+ */
+
+/*
+ * A record of the CaseFolding.txt file.
+ */
+typedef struct {
+  
+  /*
+   * The codepoint that is folded.
+   */
+  int32_t cv;
+  
+  /*
+   * The status letter, which is C, F, S, or T.
+   */
+  char status;
+  
+  /*
+   * The number of codepoints in the mapping, in range 1 to 3.
+   */
+  uint8_t len;
+  
+  /*
+   * The codepoints of the mapping.
+   */
+  int32_t cpa[3];
+  
+} FOLDREC;
+
+/*
+ * State of the category run check of the "self" subprogram.
+ */
+typedef struct {
+  
+  /*
+   * The codepoint that the next run should start at.
+   */
+  int32_t next;
+  
+  /*
+   * The category of the previous run, or zero before the first run.
+   */
+  uint16_t last;
+  
+} RUNSTATE;
+
+/*
+ * Static data
+ * ===========
+ */
+
+/*
+ * Integer values outside the codepoint range that are checked.
+ */
+static const int32_t m_invalid[] = {
+  INT32_MIN, INT32_MIN + 1, -0x110000L, -0x10000L, -0x100L, -2, -1,
+  0x110000L, 0x110001L, 0x1fffffL, 0x200000L, 0x7fffffffL
+};
+
+/*
+ * The number of mismatches found by the current check.
+ */
+static long m_errors = 0;
+
+/*
+ * Local functions
+ * ===============
+ */
+
+/* Prototypes */
+static void unikit_err(int lnum, const char *pDetail);
+static void report(const char *pCheck, int32_t cv);
+static int finish(const char *pCheck);
+
+static size_t encodeUtf8(int32_t cv, uint8_t *pBuf);
+static size_t encodeUtf16(int32_t cv, uint16_t *pBuf);
+static size_t encodeFold(const UNIKIT_FOLD *pf, uint8_t *pBuf);
+static int foldEqual(
+    const UNIKIT_FOLD * pf,
+    const int32_t     * pCpa,
+          int           len);
+
+static void readData(const char *pPath, uint16_t *pCats);
+static FOLDREC *readFold(const char *pPath, size_t *pCount);
+static void checkInvalid(void);
+static int ucd(const char *pUnicodeData, const char *pCaseFolding);
+
+static int runCheck(
+    void     * pCustom,
+    int32_t    lo,
+    int32_t    hi,
+    uint16_t   gcat);
+static void selfCategory(void);
+static void selfClass(void);
+static void selfFold(void);
+static void selfProps(void);
+
+static size_t appendSeq(char *pBuf, const UNIKIT_FOLD *pf);
+static void dumpLine(int32_t cv, char *pBuf);
+static void dump(void);
+static int compare(const char *pPath);
+
+/*
+ * Custom error handler for Unikit library.
+ */
+static void unikit_err(int lnum, const char *pDetail) {
+  if (pDetail != NULL) {
+    raiseErr(__LINE__, "[Unikit error, line %d] %s",
+              lnum, pDetail);
+  } else {
+    raiseErr(__LINE__, "[Unikit error, line %d] Error", lnum);
+  }
+}
+
+/*
+ * Count a mismatch, and report it if it is one of the first MAX_REPORT
+ * mismatches of the current check.
+ * 
+ * Parameters:
+ * 
+ *   pCheck - the name of the check that failed
+ * 
+ *   cv - the integer value that failed the check
+ */
+static void report(const char *pCheck, int32_t cv) {
+  if (pCheck == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  m_errors++;
+  if (m_errors <= MAX_REPORT) {
+    if (cv >= 0) {
+      fprintf(stderr, "Mismatch in %s at U+%04lX\n",
+                pCheck, (unsigned long) cv);
+    } else {
+      fprintf(stderr, "Mismatch in %s at value %ld\n",
+                pCheck, (long) cv);
+    }
+  }
+}
+
+/*
+ * Print the number of mismatches of a check and reset the count.
+ * 
+ * Parameters:
+ * 
+ *   pCheck - the name of the check
+ * 
+ * Return:
+ * 
+ *   non-zero if there were any mismatches, zero if none
+ */
+static int finish(const char *pCheck) {
+  
+  long count = 0;
+  
+  if (pCheck == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  count = m_errors;
+  m_errors = 0;
+  
+  printf("%-10s : %ld mismatches\n", pCheck, count);
+  return (count > 0) ? 1 : 0;
+}
+
+/*
+ * Encode a codepoint in UTF-8.
+ * 
+ * cv must pass unikit_valid().  pBuf must have room for four bytes.
+ * 
+ * Parameters:
+ * 
+ *   cv - the codepoint to encode
+ * 
+ *   pBuf - the buffer that receives the encoding
+ * 
+ * Return:
+ * 
+ *   the number of bytes written, in range 1 to 4
+ */
+static size_t encodeUtf8(int32_t cv, uint8_t *pBuf) {
+  
+  if ((!unikit_valid(cv)) || (pBuf == NULL)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  if (cv < 0x80) {
+    pBuf[0] = (uint8_t) cv;
+    return 1;
+    
+  } else if (cv < 0x800) {
+    pBuf[0] = (uint8_t) (0xc0 | (cv >> 6));
+    pBuf[1] = (uint8_t) (0x80 | (cv & 0x3f));
+    return 2;
+    
+  } else if (cv < 0x10000L) {
+    pBuf[0] = (uint8_t) (0xe0 | (cv >> 12));
+    pBuf[1] = (uint8_t) (0x80 | ((cv >> 6) & 0x3f));
+    pBuf[2] = (uint8_t) (0x80 | (cv & 0x3f));
+    return 3;
+  }
+  
+  pBuf[0] = (uint8_t) (0xf0 | (cv >> 18));
+  pBuf[1] = (uint8_t) (0x80 | ((cv >> 12) & 0x3f));
+  pBuf[2] = (uint8_t) (0x80 | ((cv >> 6) & 0x3f));
+  pBuf[3] = (uint8_t) (0x80 | (cv & 0x3f));
+  return 4;
+}
+
+/*
+ * Encode a codepoint in UTF-16 code units of the native byte order.
+ * 
+ * Parameters:
+ * 
+ *   cv - the codepoint to encode
+ * 
+ *   pBuf - the buffer that receives the encoding
+ * 
+ * Return:
+ * 
+ *   the number of units written, either 1 or 2
+ */
+static size_t encodeUtf16(int32_t cv, uint16_t *pBuf) {
+  
+  if ((!unikit_valid(cv)) || (pBuf == NULL)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  if (cv < 0x10000L) {
+    pBuf[0] = (uint16_t) cv;
+    return 1;
+  }
+  
+  pBuf[0] = (uint16_t) (0xd800 + ((cv - 0x10000L) >> 10));
+  pBuf[1] = (uint16_t) (0xdc00 + ((cv - 0x10000L) & 0x3ff));
+  return 2;
+}
+
+/*
+ * Encode the codepoints of a case folding result in UTF-8.
+ * 
+ * pBuf must have room for 16 bytes.
+ * 
+ * Parameters:
+ * 
+ *   pf - the case folding result
+ * 
+ *   pBuf - the buffer that receives the encoding
+ * 
+ * Return:
+ * 
+ *   the number of bytes written
+ */
+static size_t encodeFold(const UNIKIT_FOLD *pf, uint8_t *pBuf) {
+  
+  size_t len = 0;
+  int i = 0;
+  
+  if ((pf == NULL) || (pBuf == NULL)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  for(i = 0; i < pf->len; i++) {
+    len += encodeUtf8((pf->cpa)[i], pBuf + len);
+  }
+  return len;
+}
+
+/*
+ * Check whether a case folding result holds a given codepoint
+ * sequence.
+ * 
+ * Parameters:
+ * 
+ *   pf - the case folding result
+ * 
+ *   pCpa - the expected codepoints
+ * 
+ *   len - the number of expected codepoints
+ * 
+ * Return:
+ * 
+ *   non-zero if equal, zero if not
+ */
+static int foldEqual(
+    const UNIKIT_FOLD * pf,
+    const int32_t     * pCpa,
+          int           len) {
+  
+  int i = 0;
+  
+  if ((pf == NULL) || (pCpa == NULL)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  if ((int) pf->len != len) {
+    return 0;
+  }
+  for(i = 0; i < len; i++) {
+    if ((pf->cpa)[i] != pCpa[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+ * Parse the general categories from UnicodeData.txt.
+ * 
+ * pCats is an array of CP_COUNT elements that receives the category of
+ * every codepoint.  Codepoints that have no record are given the
+ * category Cn.  Ranges given by pairs of "First" and "Last" records
+ * are expanded.
+ * 
+ * Parameters:
+ * 
+ *   pPath - the path to the data file
+ * 
+ *   pCats - the array that receives the categories
+ */
+static void readData(const char *pPath, uint16_t *pCats) {
+  
+  FILE *fh = NULL;
+  char line[MAX_LINE];
+  char *pName = NULL;
+  char *pCat = NULL;
+  char *pEnd = NULL;
+  long lnum = 0;
+  long cv = 0;
+  long first = -1;
+  long i = 0;
+  uint16_t gcat = 0;
+  
+  /* Check parameters */
+  if ((pPath == NULL) || (pCats == NULL)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Every codepoint without a record is unassigned */
+  for(i = 0; i < CP_COUNT; i++) {
+    pCats[i] = UNIKIT_GCAT_Cn;
+  }
+  
+  /* Parse records */
+  fh = fopen(pPath, "rb");
+  if (fh == NULL) {
+    raiseErr(__LINE__, "Failed to open file: %s", pPath);
+  }
+  
+  while (fgets(line, MAX_LINE, fh) != NULL) {
+    lnum++;
+    if (strchr(line, '\n') == NULL) {
+      raiseErr(__LINE__, "Line %ld too long in %s", lnum, pPath);
+    }
+    if ((line[0] == '\n') || (line[0] == '\r') || (line[0] == '#')) {
+      continue;
+    }
+    
+    /* Get the codepoint, the name, and the category fields */
+    cv = strtol(line, &pEnd, 16);
+    if ((pEnd == line) || (*pEnd != ';') ||
+        (cv < 0) || (cv >= CP_COUNT)) {
+      raiseErr(__LINE__, "Invalid record on line %ld", lnum);
+    }
+    pName = pEnd + 1;
+    pCat = strchr(pName, ';');
+    if ((pCat == NULL) || (pCat[1] < 'A') || (pCat[1] > 'Z') ||
+        (pCat[2] < 'a') || (pCat[2] > 'z') || (pCat[3] != ';')) {
+      raiseErr(__LINE__, "Invalid record on line %ld", lnum);
+    }
+    *pCat = '\0';
+    gcat = (uint16_t) ((((uint16_t) pCat[1]) << 8) | pCat[2]);
+    
+    /* Record the category, expanding ranges */
+    if ((strlen(pName) > 8) &&
+        (strcmp(pName + strlen(pName) - 8, ", First>") == 0)) {
+      if (first >= 0) {
+        raiseErr(__LINE__, "Unclosed range before line %ld", lnum);
+      }
+      first = cv;
+      
+    } else if ((strlen(pName) > 7) &&
+        (strcmp(pName + strlen(pName) - 7, ", Last>") == 0)) {
+      if ((first < 0) || (first > cv)) {
+        raiseErr(__LINE__, "Invalid range on line %ld", lnum);
+      }
+      for(i = first; i <= cv; i++) {
+        pCats[i] = gcat;
+      }
+      first = -1;
+      
+    } else {
+      pCats[cv] = gcat;
+    }
+  }
+  if (ferror(fh)) {
+    raiseErr(__LINE__, "Failed to read file: %s", pPath);
+  }
+  if (first >= 0) {
+    raiseErr(__LINE__, "Unclosed range at end of %s", pPath);
+  }
+  fclose(fh);
+}
+
+/*
+ * Parse the records of CaseFolding.txt.
+ * 
+ * The records are returned in a dynamically allocated array, in the
+ * order of the file, which is ascending order of codepoint.  The
+ * caller must free the array.
+ * 
+ * Parameters:
+ * 
+ *   pPath - the path to the data file
+ * 
+ *   pCount - variable that receives the number of records
+ * 
+ * Return:
+ * 
+ *   the records
+ */
+static FOLDREC *readFold(const char *pPath, size_t *pCount) {
+  
+  FILE *fh = NULL;
+  char line[MAX_LINE];
+  char *p = NULL;
+  char *pEnd = NULL;
+  long lnum = 0;
+  long cv = 0;
+  FOLDREC *pRecs = NULL;
+  FOLDREC *pr = NULL;
+  size_t count = 0;
+  size_t cap = 0;
+  
+  /* Check parameters */
+  if ((pPath == NULL) || (pCount == NULL)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Parse records */
+  fh = fopen(pPath, "rb");
+  if (fh == NULL) {
+    raiseErr(__LINE__, "Failed to open file: %s", pPath);
+  }
+  
+  while (fgets(line, MAX_LINE, fh) != NULL) {
+    lnum++;
+    if (strchr(line, '\n') == NULL) {
+      raiseErr(__LINE__, "Line %ld too long in %s", lnum, pPath);
+    }
+    if ((line[0] == '\n') || (line[0] == '\r') || (line[0] == '#')) {
+      continue;
+    }
+    
+    /* Make room for another record */
+    if (count >= cap) {
+      cap = (cap > 0) ? (cap * 2) : 256;
+      pRecs = (FOLDREC *) realloc(pRecs, cap * sizeof(FOLDREC));
+      if (pRecs == NULL) {
+        raiseErr(__LINE__, "Out of memory");
+      }
+    }
+    pr = &(pRecs[count]);
+    memset(pr, 0, sizeof(FOLDREC));
+    
+    /* Get the codepoint and the status */
+    cv = strtol(line, &pEnd, 16);
+    if ((pEnd == line) || (pEnd[0] != ';') || (pEnd[1] != ' ') ||
+        (pEnd[3] != ';') || (cv < 0) || (cv >= CP_COUNT)) {
+      raiseErr(__LINE__, "Invalid record on line %ld", lnum);
+    }
+    pr->cv = (int32_t) cv;
+    pr->status = pEnd[2];
+    
+    /* Get the mapping, which ends at the next semicolon */
+    p = pEnd + 4;
+    while (*p == ' ') {
+      p++;
+    }
+    while (*p != ';') {
+      if (pr->len >= 3) {
+        raiseErr(__LINE__, "Mapping too long on line %ld", lnum);
+      }
+      cv = strtol(p, &pEnd, 16);
+      if ((pEnd == p) || (cv < 0) || (cv >= CP_COUNT)) {
+        raiseErr(__LINE__, "Invalid mapping on line %ld", lnum);
+      }
+      (pr->cpa)[pr->len] = (int32_t) cv;
+      pr->len++;
+      
+      p = pEnd;
+      while (*p == ' ') {
+        p++;
+      }
+    }
+    if (pr->len < 1) {
+      raiseErr(__LINE__, "Empty mapping on line %ld", lnum);
+    }
+    
+    /* Make sure records are in ascending order */
+    if ((count > 0) && (pRecs[count - 1].cv > pr->cv)) {
+      raiseErr(__LINE__, "Records out of order on line %ld", lnum);
+    }
+    count++;
+  }
+  if (ferror(fh)) {
+    raiseErr(__LINE__, "Failed to read file: %s", pPath);
+  }
+  fclose(fh);
+  
+  *pCount = count;
+  return pRecs;
+}
+
+/*
+ * Check the lookups of the integer values outside the codepoint range.
+ */
+static void checkInvalid(void) {
+  
+  size_t i = 0;
+  size_t ninv = 0;
+  int cls = 0;
+  int32_t v = 0;
+  uint16_t cats[sizeof(m_invalid) / sizeof(int32_t)];
+  int32_t folds[sizeof(m_invalid) / sizeof(int32_t)];
+  
+  memset(cats, 0, sizeof(cats));
+  memset(folds, 0, sizeof(folds));
+  ninv = sizeof(m_invalid) / sizeof(int32_t);
+  
+  for(i = 0; i < ninv; i++) {
+    v = m_invalid[i];
+    
+    if (unikit_valid(v) || unikit_valid_inline(v)) {
+      report("valid", v);
+    }
+    if ((unikit_category(v) != UNIKIT_GCAT_Cn) ||
+        (unikit_category_inline(v) != UNIKIT_GCAT_Cn)) {
+      report("category", v);
+    }
+    for(cls = UNIKIT_CLASS_L; cls <= UNIKIT_CLASS_LC; cls++) {
+      if (unikit_class_test(unikit_class_std(cls), v) ||
+          unikit_class_test_inline(cls, v)) {
+        report("class", v);
+      }
+    }
+    if (unikit_props(v) != (uint32_t) UNIKIT_GCAT_Cn) {
+      report("props", v);
+    }
+  }
+  
+  /* As UTF-32 text, every one of them is replaced with U+FFFD */
+  unikit_category_utf32(m_invalid, ninv, cats, ninv);
+  for(i = 0; i < ninv; i++) {
+    if (cats[i] != unikit_category(0xfffd)) {
+      report("utf32", m_invalid[i]);
+    }
+  }
+  if ((unikit_fold_utf32(m_invalid, ninv, folds, ninv) != ninv) ||
+      (folds[0] != 0xfffd) ||
+      (memcmp(folds, folds + 1, (ninv - 1) * sizeof(int32_t)) != 0)) {
+    report("utf32", -1);
+  }
+}
+
+/*
+ * The "ucd" subprogram.
+ * 
+ * Parameters:
+ * 
+ *   pUnicodeData - the path to UnicodeData.txt
+ * 
+ *   pCaseFolding - the path to CaseFolding.txt
+ * 
+ * Return:
+ * 
+ *   non-zero if there were any mismatches, zero if none
+ */
+static int ucd(const char *pUnicodeData, const char *pCaseFolding) {
+  
+  uint16_t *pCats = NULL;
+  FOLDREC *pRecs = NULL;
+  size_t count = 0;
+  size_t i = 0;
+  size_t j = 0;
+  int32_t cv = 0;
+  int result = 0;
+  const FOLDREC *pFull = NULL;
+  UNIKIT_FOLD fold;
+  
+  /* Initialize structures */
+  memset(&fold, 0, sizeof(UNIKIT_FOLD));
+  
+  /* Check parameters */
+  if ((pUnicodeData == NULL) || (pCaseFolding == NULL)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Parse the data files */
+  pCats = (uint16_t *) malloc(CP_COUNT * sizeof(uint16_t));
+  if (pCats == NULL) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+  readData(pUnicodeData, pCats);
+  pRecs = readFold(pCaseFolding, &count);
+  
+  /* Check the categories */
+  for(cv = 0; cv < CP_COUNT; cv++) {
+    if (unikit_category(cv) != pCats[cv]) {
+      report("category", cv);
+    }
+  }
+  checkInvalid();
+  result |= finish("category");
+  
+  /* Check the full case foldings, walking the records in step with
+   * the codepoints; the full folding is given by the C or F record */
+  i = 0;
+  for(cv = 0; cv < CP_COUNT; cv++) {
+    if (!unikit_valid(cv)) {
+      continue;
+    }
+    
+    while ((i < count) && (pRecs[i].cv < cv)) {
+      i++;
+    }
+    pFull = NULL;
+    for(j = i; (j < count) && (pRecs[j].cv == cv); j++) {
+      if ((pRecs[j].status == 'C') || (pRecs[j].status == 'F')) {
+        pFull = &(pRecs[j]);
+      }
+    }
+    
+    if (pFull != NULL) {
+      if ((!unikit_fold(&fold, cv)) ||
+          (!foldEqual(&fold, pFull->cpa, pFull->len))) {
+        report("fold", cv);
+      }
+    } else {
+      if (unikit_fold(&fold, cv) || (!foldEqual(&fold, &cv, 1))) {
+        report("fold", cv);
+      }
+    }
+  }
+  result |= finish("fold");
+  
+  /* Release the data */
+  free(pCats);
+  free(pRecs);
+  
+  return result;
+}
+
+/*
+ * Category run callback of the "self" subprogram.
+ */
+static int runCheck(
+    void     * pCustom,
+    int32_t    lo,
+    int32_t    hi,
+    uint16_t   gcat) {
+  
+  RUNSTATE *ps = NULL;
+  int32_t cv = 0;
+  
+  if (pCustom == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  ps = (RUNSTATE *) pCustom;
+  
+  /* Runs must be maximal and must follow each other without gaps */
+  if ((lo != ps->next) || (hi < lo) || (gcat == ps->last)) {
+    report("runs", lo);
+  }
+  for(cv = lo; cv <= hi; cv++) {
+    if (unikit_category(cv) != gcat) {
+      report("runs", cv);
+    }
+  }
+  
+  ps->next = hi + 1;
+  ps->last = gcat;
+  return 1;
+}
+
+/*
+ * Compare the category functions of the "self" subprogram.
+ */
+static void selfCategory(void) {
+  
+  int32_t *pCps = NULL;
+  uint16_t *pCats = NULL;
+  uint16_t *pOut = NULL;
+  uint8_t *pText = NULL;
+  uint16_t *pText16 = NULL;
+  size_t tlen = 0;
+  size_t tlen16 = 0;
+  size_t n = 0;
+  size_t i = 0;
+  size_t k = 0;
+  size_t used = 0;
+  size_t step = 0;
+  size_t ninv = 0;
+  int32_t cv = 0;
+  RUNSTATE rs;
+  UNIKIT_DECODER dec;
+  
+  /* Initialize structures */
+  memset(&rs, 0, sizeof(RUNSTATE));
+  unikit_decoder_init(&dec, UNIKIT_ENC_UTF8);
+  
+  /* Allocate buffers for every codepoint and every invalid value */
+  ninv = sizeof(m_invalid) / sizeof(int32_t);
+  pCps = (int32_t *) malloc((CP_COUNT + ninv) * sizeof(int32_t));
+  pCats = (uint16_t *) malloc((CP_COUNT + ninv) * sizeof(uint16_t));
+  pOut = (uint16_t *) malloc((CP_COUNT + ninv) * sizeof(uint16_t));
+  pText = (uint8_t *) malloc(CP_COUNT * 4);
+  pText16 = (uint16_t *) malloc(CP_COUNT * 2 * sizeof(uint16_t));
+  if ((pCps == NULL) || (pCats == NULL) || (pOut == NULL) ||
+      (pText == NULL) || (pText16 == NULL)) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+  
+  /* Single lookups against the inline header */
+  for(cv = 0; cv < CP_COUNT; cv++) {
+    pCps[cv] = cv;
+    pCats[cv] = unikit_category(cv);
+    if (unikit_category_inline(cv) != pCats[cv]) {
+      report("inline", cv);
+    }
+  }
+  for(i = 0; i < ninv; i++) {
+    pCps[CP_COUNT + i] = m_invalid[i];
+    pCats[CP_COUNT + i] = unikit_category(m_invalid[i]);
+  }
+  
+  /* Buffer of integer values, including the invalid values */
+  unikit_category_buf(pCps, pOut, CP_COUNT + ninv);
+  for(i = 0; i < CP_COUNT + ninv; i++) {
+    if (pOut[i] != pCats[i]) {
+      report("buf", pCps[i]);
+    }
+  }
+  
+  /* The UTF-8 text of every valid codepoint, with the categories of
+   * the valid codepoints moved to the front of pCats */
+  n = 0;
+  for(cv = 0; cv < CP_COUNT; cv++) {
+    if (unikit_valid(cv)) {
+      tlen += encodeUtf8(cv, pText + tlen);
+      tlen16 += encodeUtf16(cv, pText16 + tlen16);
+      pCps[n] = cv;
+      pCats[n] = pCats[cv];
+      n++;
+    }
+  }
+  
+  if (unikit_category_utf8(pText, tlen, pOut, n) != n) {
+    report("utf8", -1);
+  } else {
+    for(i = 0; i < n; i++) {
+      if (pOut[i] != pCats[i]) {
+        report("utf8", pCps[i]);
+      }
+    }
+  }
+  
+  /* The same text in UTF-16 and UTF-32 */
+  if (unikit_category_utf16(pText16, tlen16, pOut, n) != n) {
+    report("utf16", -1);
+  } else {
+    for(i = 0; i < n; i++) {
+      if (pOut[i] != pCats[i]) {
+        report("utf16", pCps[i]);
+      }
+    }
+  }
+  if (unikit_category_utf32(pCps, n, pOut, n) != n) {
+    report("utf32", -1);
+  } else {
+    for(i = 0; i < n; i++) {
+      if (pOut[i] != pCats[i]) {
+        report("utf32", pCps[i]);
+      }
+    }
+  }
+  
+  /* The same text through the streaming decoder, in small chunks */
+  k = 0;
+  for(i = 0; i < tlen; i += step) {
+    step = tlen - i;
+    if (step > DECODE_CHUNK) {
+      step = DECODE_CHUNK;
+    }
+    used = 0;
+    k += unikit_decode_category(
+          &dec, pText + i, step, pOut + k, n - k, &used);
+    if (used != step) {
+      raiseErr(__LINE__, NULL);
+    }
+  }
+  if ((unikit_decode_end(&dec) != 0) || (k != n)) {
+    report("decode", -1);
+  } else {
+    for(i = 0; i < n; i++) {
+      if (pOut[i] != pCats[i]) {
+        report("decode", pCps[i]);
+      }
+    }
+  }
+  
+  /* Category runs over the whole range */
+  if ((!unikit_category_runs(&runCheck, &rs)) ||
+      (rs.next != CP_COUNT)) {
+    report("runs", rs.next);
+  }
+  
+  /* Release buffers */
+  free(pCps);
+  free(pCats);
+  free(pOut);
+  free(pText);
+  free(pText16);
+}
+
+/*
+ * Compare the standard character classes of the "self" subprogram.
+ */
+static void selfClass(void) {
+  
+  int32_t cv = 0;
+  int cls = 0;
+  int expect = 0;
+  uint16_t gcat = 0;
+  
+  for(cv = 0; cv < CP_COUNT; cv++) {
+    gcat = unikit_category(cv);
+    for(cls = UNIKIT_CLASS_L; cls <= UNIKIT_CLASS_LC; cls++) {
+      if (cls == UNIKIT_CLASS_L) {
+        expect = ((gcat & UNIKIT_CTGR_MASK) == UNIKIT_CTGR_L);
+      } else if (cls == UNIKIT_CLASS_N) {
+        expect = ((gcat & UNIKIT_CTGR_MASK) == UNIKIT_CTGR_N);
+      } else if (cls == UNIKIT_CLASS_Z) {
+        expect = ((gcat & UNIKIT_CTGR_MASK) == UNIKIT_CTGR_Z);
+      } else {
+        expect = ((gcat == UNIKIT_GCAT_Lu) ||
+                  (gcat == UNIKIT_GCAT_Ll) ||
+                  (gcat == UNIKIT_GCAT_Lt));
+      }
+      
+      if (((unikit_class_test(unikit_class_std(cls), cv) != 0) !=
+              (expect != 0)) ||
+          ((unikit_class_test_inline(cls, cv) != 0) !=
+              (expect != 0))) {
+        report("class", cv);
+      }
+    }
+  }
+}
+
+/*
+ * Compare the case folding functions of the "self" subprogram.
+ */
+static void selfFold(void) {
+  
+  uint8_t *pText = NULL;
+  uint8_t *pExpect = NULL;
+  uint8_t *pOut = NULL;
+  uint16_t *pText16 = NULL;
+  uint16_t *pExpect16 = NULL;
+  uint16_t *pOut16 = NULL;
+  int32_t *pText32 = NULL;
+  int32_t *pExpect32 = NULL;
+  int32_t *pOut32 = NULL;
+  size_t tlen = 0;
+  size_t elen = 0;
+  size_t olen = 0;
+  size_t tlen16 = 0;
+  size_t elen16 = 0;
+  size_t tlen32 = 0;
+  size_t elen32 = 0;
+  size_t cap = 0;
+  int j = 0;
+  size_t i = 0;
+  size_t used = 0;
+  size_t step = 0;
+  int32_t cv = 0;
+  UNIKIT_FOLD fold;
+  UNIKIT_DECODER dec;
+  
+  /* Initialize structures */
+  memset(&fold, 0, sizeof(UNIKIT_FOLD));
+  unikit_decoder_init(&dec, UNIKIT_ENC_UTF8);
+  
+  /* Allocate buffers; a folding has at most three codepoints, so the
+   * folded text is at most three times as long as the text */
+  pText = (uint8_t *) malloc(CP_COUNT * 4);
+  pExpect = (uint8_t *) malloc(CP_COUNT * 12);
+  cap = CP_COUNT * 12 + 3 * (DECODE_CHUNK + 3);
+  pOut = (uint8_t *) malloc(cap);
+  pText16 = (uint16_t *) malloc(CP_COUNT * 2 * sizeof(uint16_t));
+  pExpect16 = (uint16_t *) malloc(CP_COUNT * 6 * sizeof(uint16_t));
+  pOut16 = (uint16_t *) malloc(CP_COUNT * 6 * sizeof(uint16_t));
+  pText32 = (int32_t *) malloc(CP_COUNT * sizeof(int32_t));
+  pExpect32 = (int32_t *) malloc(CP_COUNT * 3 * sizeof(int32_t));
+  pOut32 = (int32_t *) malloc(CP_COUNT * 3 * sizeof(int32_t));
+  if ((pText == NULL) || (pExpect == NULL) || (pOut == NULL) ||
+      (pText16 == NULL) || (pExpect16 == NULL) || (pOut16 == NULL) ||
+      (pText32 == NULL) || (pExpect32 == NULL) || (pOut32 == NULL)) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+  
+  /* Single lookups, building the text and its expected folding */
+  for(cv = 0; cv < CP_COUNT; cv++) {
+    if (!unikit_valid(cv)) {
+      continue;
+    }
+    
+    tlen += encodeUtf8(cv, pText + tlen);
+    unikit_fold(&fold, cv);
+    elen += encodeFold(&fold, pExpect + elen);
+    
+    tlen16 += encodeUtf16(cv, pText16 + tlen16);
+    pText32[tlen32++] = cv;
+    for(j = 0; j < fold.len; j++) {
+      elen16 += encodeUtf16((fold.cpa)[j], pExpect16 + elen16);
+      pExpect32[elen32++] = (fold.cpa)[j];
+    }
+  }
+  
+  /* Whole buffer */
+  olen = unikit_fold_utf8(pText, tlen, pOut, cap);
+  if ((olen != elen) || (memcmp(pOut, pExpect, elen) != 0)) {
+    report("utf8", -1);
+  }
+  if (unikit_fold_utf8(pText, tlen, NULL, 0) != elen) {
+    report("utf8", -1);
+  }
+  
+  /* The same text in UTF-16 and UTF-32 */
+  if ((unikit_fold_utf16(pText16, tlen16, pOut16, elen16) != elen16) ||
+      (memcmp(pOut16, pExpect16, elen16 * sizeof(uint16_t)) != 0) ||
+      (unikit_fold_utf16(pText16, tlen16, NULL, 0) != elen16)) {
+    report("utf16", -1);
+  }
+  if ((unikit_fold_utf32(pText32, tlen32, pOut32, elen32) != elen32) ||
+      (memcmp(pOut32, pExpect32, elen32 * sizeof(int32_t)) != 0) ||
+      (unikit_fold_utf32(pText32, tlen32, NULL, 0) != elen32)) {
+    report("utf32", -1);
+  }
+  
+  /* Streaming decoder, in small chunks */
+  olen = 0;
+  for(i = 0; i < tlen; i += step) {
+    step = tlen - i;
+    if (step > DECODE_CHUNK) {
+      step = DECODE_CHUNK;
+    }
+    used = 0;
+    olen += unikit_decode_fold(
+              &dec, pText + i, step, pOut + olen, cap - olen, &used);
+    if (used != step) {
+      raiseErr(__LINE__, NULL);
+    }
+  }
+  if ((unikit_decode_end(&dec) != 0) || (olen != elen) ||
+      (memcmp(pOut, pExpect, elen) != 0)) {
+    report("decode", -1);
+  }
+  
+  /* Caseless comparison and hash of the text against its folding */
+  if ((unikit_casecmp_utf8(pText, tlen, pExpect, elen) != 0) ||
+      (unikit_casecmp_utf8(pExpect, elen, pText, tlen) != 0)) {
+    report("casecmp", -1);
+  }
+  if ((unikit_casehash_utf8(pText, tlen, 0) !=
+        unikit_casehash_utf8(pExpect, elen, 0)) ||
+      (unikit_casehash_utf8(pText, tlen, HASH_SEED) !=
+        unikit_casehash_utf8(pExpect, elen, HASH_SEED))) {
+    report("casehash", -1);
+  }
+  
+  /* Release buffers */
+  free(pText);
+  free(pExpect);
+  free(pOut);
+  free(pText16);
+  free(pExpect16);
+  free(pOut16);
+  free(pText32);
+  free(pExpect32);
+  free(pOut32);
+}
+
+/*
+ * Compare the combined property records of the "self" subprogram.
+ */
+static void selfProps(void) {
+  
+  int32_t cv = 0;
+  uint32_t p = 0;
+  uint32_t expect = 0;
+  uint16_t gcat = 0;
+  UNIKIT_FOLD fold;
+  
+  memset(&fold, 0, sizeof(UNIKIT_FOLD));
+  
+  for(cv = 0; cv < CP_COUNT; cv++) {
+    gcat = unikit_category(cv);
+    
+    /* Surrogates have no case folding */
+    expect = gcat;
+    if (unikit_valid(cv)) {
+      unikit_fold(&fold, cv);
+      if ((fold.len != 1) || ((fold.cpa)[0] != cv)) {
+        expect |= UNIKIT_PROP_FOLD;
+      }
+      if (fold.len > 1) {
+        expect |= UNIKIT_PROP_EXPAND;
+      }
+    }
+    if (unikit_class_test(unikit_class_std(UNIKIT_CLASS_L), cv)) {
+      expect |= UNIKIT_PROP_LETTER;
+    }
+    if (unikit_class_test(unikit_class_std(UNIKIT_CLASS_LC), cv)) {
+      expect |= UNIKIT_PROP_CASED;
+    }
+    if (unikit_class_test(unikit_class_std(UNIKIT_CLASS_N), cv)) {
+      expect |= UNIKIT_PROP_NUMBER;
+    }
+    if (gcat == UNIKIT_GCAT_Nd) {
+      expect |= UNIKIT_PROP_DIGIT;
+    }
+    if (unikit_class_test(unikit_class_std(UNIKIT_CLASS_Z), cv) ||
+        ((cv >= 0x9) && (cv <= 0xd)) || (cv == 0x85)) {
+      expect |= UNIKIT_PROP_SPACE;
+    }
+    
+    p = unikit_props(cv);
+    if ((p != expect) || (UNIKIT_PROP_GCAT(p) != gcat)) {
+      report("props", cv);
+    }
+  }
+}
+
+/*
+ * Append a codepoint sequence to a dump line.
+ * 
+ * The codepoints are written in base-16, separated by spaces, followed
+ * by a semicolon.
+ * 
+ * Parameters:
+ * 
+ *   pBuf - the end of the line so far
+ * 
+ *   pf - the codepoint sequence
+ * 
+ * Return:
+ * 
+ *   the number of characters appended
+ */
+static size_t appendSeq(char *pBuf, const UNIKIT_FOLD *pf) {
+  
+  size_t len = 0;
+  int i = 0;
+  
+  if ((pBuf == NULL) || (pf == NULL)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  for(i = 0; i < pf->len; i++) {
+    len += (size_t) sprintf(pBuf + len, (i > 0) ? " %04lX" : "%04lX",
+                              (unsigned long) (pf->cpa)[i]);
+  }
+  pBuf[len] = ';';
+  len++;
+  pBuf[len] = '\0';
+  return len;
+}
+
+/*
+ * Compute the dump line of an integer value, without a line break.
+ * 
+ * The fields of the line are separated by semicolons.  They are the
+ * value in base-16, or in decimal if negative, the general category,
+ * the standard classes that hold the value as a string of the letters
+ * L, N, Z, and C for the classes L, N, Z, and LC in that order,
+ * then for valid codepoints only the full case folding.
+ * 
+ * Parameters:
+ * 
+ *   cv - the integer value
+ * 
+ *   pBuf - the buffer that receives the line, of MAX_LINE characters
+ */
+static void dumpLine(int32_t cv, char *pBuf) {
+  
+  size_t len = 0;
+  int cls = 0;
+  uint16_t gcat = 0;
+  UNIKIT_FOLD f;
+  
+  /* Initialize structures */
+  memset(&f, 0, sizeof(UNIKIT_FOLD));
+  
+  /* Check parameters */
+  if (pBuf == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Value, category, and classes */
+  gcat = unikit_category(cv);
+  if (cv >= 0) {
+    len = (size_t) sprintf(pBuf, "%04lX;%c%c;",
+            (unsigned long) cv, (int) (gcat >> 8), (int) (gcat & 0xff));
+  } else {
+    len = (size_t) sprintf(pBuf, "%ld;%c%c;",
+            (long) cv, (int) (gcat >> 8), (int) (gcat & 0xff));
+  }
+  for(cls = UNIKIT_CLASS_L; cls <= UNIKIT_CLASS_LC; cls++) {
+    if (unikit_class_test(unikit_class_std(cls), cv)) {
+      pBuf[len] = "LNZC"[cls];
+      len++;
+    }
+  }
+  pBuf[len] = ';';
+  len++;
+  pBuf[len] = '\0';
+  
+  /* The other properties are only defined for valid codepoints */
+  if (!unikit_valid(cv)) {
+    return;
+  }
+  
+  /* The folding is the last field, so drop its separator */
+  unikit_fold(&f, cv);
+  len += appendSeq(pBuf + len, &f);
+  pBuf[len - 1] = '\0';
+}
+
+/*
+ * The "dump" subprogram.
+ */
+static void dump(void) {
+  
+  char line[MAX_LINE];
+  int32_t cv = 0;
+  size_t i = 0;
+  
+  for(cv = 0; cv < CP_COUNT; cv++) {
+    dumpLine(cv, line);
+    printf("%s\n", line);
+  }
+  for(i = 0; i < sizeof(m_invalid) / sizeof(int32_t); i++) {
+    dumpLine(m_invalid[i], line);
+    printf("%s\n", line);
+  }
+}
+
+/*
+ * The "compare" subprogram.
+ * 
+ * Parameters:
+ * 
+ *   pPath - the path to a dump written earlier
+ * 
+ * Return:
+ * 
+ *   non-zero if there were any mismatches, zero if none
+ */
+static int compare(const char *pPath) {
+  
+  FILE *fh = NULL;
+  char line[MAX_LINE];
+  char ref[MAX_LINE];
+  char *p = NULL;
+  size_t ninv = 0;
+  long i = 0;
+  int32_t cv = 0;
+  
+  /* Check parameters */
+  if (pPath == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Compare the lines in order */
+  fh = fopen(pPath, "rb");
+  if (fh == NULL) {
+    raiseErr(__LINE__, "Failed to open file: %s", pPath);
+  }
+  
+  ninv = sizeof(m_invalid) / sizeof(int32_t);
+  for(i = 0; i < CP_COUNT + (long) ninv; i++) {
+    if (i < CP_COUNT) {
+      cv = (int32_t) i;
+    } else {
+      cv = m_invalid[i - CP_COUNT];
+    }
+    
+    if (fgets(ref, MAX_LINE, fh) == NULL) {
+      raiseErr(__LINE__, "Dump ends early: %s", pPath);
+    }
+    p = strchr(ref, '\n');
+    if (p != NULL) {
+      *p = '\0';
+    }
+    
+    dumpLine(cv, line);
+    if (strcmp(line, ref) != 0) {
+      report("dump", cv);
+    }
+  }
+  if (fgets(ref, MAX_LINE, fh) != NULL) {
+    raiseErr(__LINE__, "Dump has extra lines: %s", pPath);
+  }
+  if (ferror(fh)) {
+    raiseErr(__LINE__, "Failed to read file: %s", pPath);
+  }
+  fclose(fh);
+  
+  return finish("compare");
+}
+
+/*
+ * Program entrypoint
+ * ==================
+ */
+
+int main(int argc, char *argv[]) {
+  
+  int result = 0;
+  
+  /* Initialize diagnostics and check parameters */
+  diagnostic_startup(argc, argv, "unikit_verify");
+  
+  /* Initialize unikit */
+  unikit_init(&unikit_err);
+  
+  /* Parse specific subprogram invocation */
+  if (argc < 2) {
+    raiseErr(__LINE__, "Expecting program arguments");
+  }
+  if (strcmp(argv[1], "ucd") == 0) {
+    /* Check against the UCD -- must have two arguments beyond mode */
+    if (argc != 4) {
+      raiseErr(__LINE__, "Wrong number of arguments for ucd");
+    }
+    result = ucd(argv[2], argv[3]);
+    
+  } else if (strcmp(argv[1], "self") == 0) {
+    /* Internal consistency -- no extra arguments */
+    if (argc != 2) {
+      raiseErr(__LINE__, "Wrong number of arguments for self");
+    }
+    
+    selfCategory();
+    result |= finish("category");
+    selfClass();
+    checkInvalid();
+    result |= finish("class");
+    selfFold();
+    result |= finish("fold");
+    selfProps();
+    result |= finish("props");
+    
+  } else if (strcmp(argv[1], "dump") == 0) {
+    /* Dump every property -- no extra arguments */
+    if (argc != 2) {
+      raiseErr(__LINE__, "Wrong number of arguments for dump");
+    }
+    dump();
+    
+  } else if (strcmp(argv[1], "compare") == 0) {
+    /* Compare with an earlier dump -- must have one argument beyond
+     * mode */
+    if (argc != 3) {
+      raiseErr(__LINE__, "Wrong number of arguments for compare");
+    }
+    result = compare(argv[2]);
+    
+  } else {
+    raiseErr(__LINE__, "Unrecognized subprogram: %s", argv[1]);
+  }
+  
+  /* Shut down unikit */
+  unikit_shutdown();
+  
+  return (result ? EXIT_FAILURE : EXIT_SUCCESS);
+}
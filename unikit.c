@@ -7,12 +7,57 @@
  * See the header for further information.
  */
 
+/*
+ * Memory-mapped data files are supported on POSIX systems, which need
+ * the POSIX feature test macro defined before any system header.
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+#endif
+
 #include "unikit.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Initialization and shutdown are thread-safe whenever the compiler
+ * provides C11 atomics.  Otherwise, they must not be called
+ * concurrently.
+ */
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && \
+    !defined(__STDC_NO_ATOMICS__)
+#define HAVE_ATOMICS
+#include <stdatomic.h>
+#endif
+
+/*
+ * The lookup counters of the UNIKIT_INSTRUMENT build mode are kept in
+ * thread-local storage whenever the compiler provides it.  Otherwise,
+ * all threads share the same counters.
+ */
+#ifdef UNIKIT_INSTRUMENT
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && \
+    !defined(__STDC_NO_THREADS__)
+#define STATS_LOCAL _Thread_local
+#elif defined(__GNUC__)
+#define STATS_LOCAL __thread
+#else
+#define STATS_LOCAL
+#endif
+#endif
+
 #include "unikit_data.h"
 
 /*
@@ -53,6 +98,277 @@ static void raiseErr(int lnum, const char *pDetail) {
   }
 }
 
+/*
+ * Constants
+ * =========
+ */
+
+/*
+ * The shift of the two-stage tables used in the UNIKIT_STAGE_TABLES
+ * build mode.  This must match STAGE_SHIFT in the unikit_db.pl script.
+ * 
+ * STAGE_MASK selects the low bits of a key within a data block, and
+ * STAGE_INDEX_LEN is the number of index elements at the start of each
+ * two-stage table.
+ */
+#define STAGE_SHIFT (5)
+#define STAGE_MASK ((UINT32_C(1) << STAGE_SHIFT) - 1)
+#define STAGE_INDEX_LEN (INT32_C(1) << (16 - STAGE_SHIFT))
+
+/*
+ * The shift of the unified category table used in the
+ * UNIKIT_UNIFIED_GCAT build mode.  This must match UNIFIED_SHIFT in the
+ * unikit_db.pl script.
+ * 
+ * UNIFIED_MASK and UNIFIED_INDEX_LEN have the same meaning as the
+ * STAGE_MASK and STAGE_INDEX_LEN constants above.
+ */
+#define UNIFIED_SHIFT (4)
+#define UNIFIED_MASK ((UINT32_C(1) << UNIFIED_SHIFT) - 1)
+#define UNIFIED_INDEX_LEN (INT32_C(1) << (16 - UNIFIED_SHIFT))
+
+/*
+ * The number of low bits of the plane offset that select a codepoint
+ * within a bucket of the astral directory.  This must match
+ * ASTRAL_BUCKET_SHIFT in the unikit_db.pl script.
+ * 
+ * ASTRAL_DIR_LEN is the length of the astral directory, which has one
+ * element per bucket in planes 2 to 16 and one final element.
+ */
+#define ASTRAL_BUCKET_SHIFT (12)
+#define ASTRAL_DIR_LEN ((INT32_C(15) << (16 - ASTRAL_BUCKET_SHIFT)) + 1)
+
+/*
+ * The value in the case folding delta tables indicating that the full
+ * case folding of a codepoint is an expansion of more than one
+ * codepoint, which must be looked up in the case folding tables.
+ */
+#define FOLD_EXPAND (0x8000)
+
+/*
+ * The shift of the property table.  This must match PROPS_SHIFT in the
+ * unikit_db.pl script.
+ * 
+ * The property table covers PROPS_KEYS keys, which are the codepoints
+ * U+0000 to U+3FFFF followed by the codepoints U+E0000 to U+E0FFF.
+ * PROPS_MASK and PROPS_INDEX_LEN have the same meaning as the
+ * STAGE_MASK and STAGE_INDEX_LEN constants above.
+ */
+#define PROPS_SHIFT (5)
+#define PROPS_MASK ((INT32_C(1) << PROPS_SHIFT) - 1)
+#define PROPS_KEYS (INT32_C(0x41000))
+#define PROPS_INDEX_LEN (PROPS_KEYS >> PROPS_SHIFT)
+
+/*
+ * The parts of the property values.  The unified category index is in
+ * the PROPS_CAT_MASK bits, and the flags are in the PROPS_FLAG_MASK
+ * bits after shifting right by PROPS_FLAG_SHIFT.  The flags are in the
+ * same order as the UNIKIT_PROP flags of the header.  These must match
+ * the PROPS constants in the unikit_db.pl script.
+ */
+#define PROPS_CAT_MASK (0x1f)
+#define PROPS_FLAG_SHIFT (5)
+#define PROPS_FLAG_MASK (0x7f)
+
+/*
+ * The minimum length of the character bitmap, which has one element
+ * for each group of eight codepoints in range U+0100 to U+1FFFF.
+ */
+#define BITMAP_LEN (((INT32_C(0x1ffff) - 0x100) / 8) + 1)
+
+/*
+ * The table groups, which are loaded on first use.
+ * 
+ * TABLES_CASE is the case folding tables.  TABLES_CORE is the core
+ * character table.  TABLES_GCAT is all the other general category
+ * tables.  TABLES_CLASS is the standard character class tables.
+ * TABLES_PROPS is the property table.  TABLES_COUNT is the number of
+ * table groups.
+ */
+#define TABLES_CASE (0)
+#define TABLES_CORE (1)
+#define TABLES_GCAT (2)
+#define TABLES_CLASS (3)
+#define TABLES_PROPS (4)
+#define TABLES_COUNT (5)
+
+/*
+ * The shift of the two-stage tables of the character classes.  This
+ * must match CLASS_SHIFT in the unikit_db.pl script.
+ * 
+ * Each element of a character class table holds the bits of 16
+ * codepoints, so each data block covers CLASS_BLOCK_BITS bits of the
+ * codepoint.  CLASS_WORDS is the number of elements needed for every
+ * codepoint, and CLASS_INDEX_LEN is the number of index elements at the
+ * start of each table.  CLASS_COUNT is the number of standard classes.
+ */
+#define CLASS_SHIFT (5)
+#define CLASS_MASK ((INT32_C(1) << CLASS_SHIFT) - 1)
+#define CLASS_BLOCK_BITS (CLASS_SHIFT + 4)
+#define CLASS_WORDS (INT32_C(0x110000) / 16)
+#define CLASS_INDEX_LEN (CLASS_WORDS >> CLASS_SHIFT)
+#define CLASS_COUNT (4)
+
+/*
+ * The format version of the binary data files that can be mapped, and
+ * the byte alignment of each table within the file.  These must match
+ * DATAFILE_VERSION and DATAFILE_ALIGN in the unikit_db.pl script.  The
+ * version must be raised whenever a table is added to the data files
+ * or the layout of a table changes, so that files written for another
+ * set of tables are rejected.
+ * 
+ * DATAFILE_HEADER_LEN is the length in bytes of the file header, and
+ * DATAFILE_ENTRY_LEN is the length in bytes of each table directory
+ * record that follows it.
+ */
+#define DATAFILE_VERSION (4)
+#define DATAFILE_ALIGN (64)
+#define DATAFILE_HEADER_LEN (16)
+#define DATAFILE_ENTRY_LEN (16)
+
+/*
+ * The byte alignment of each table within a table arena, which is one
+ * cache line.  ARENA_ALIGN_LEN is the same alignment in integers.
+ */
+#define ARENA_ALIGN (64)
+#define ARENA_ALIGN_LEN (ARENA_ALIGN / 2)
+
+/*
+ * The number of categories in the unified category list.
+ */
+#define UNIFIED_CAT_COUNT (30)
+
+/*
+ * The output kinds of the streaming decoder.
+ * 
+ * DECODE_CODEPOINTS writes int32_t codepoints, DECODE_CATEGORIES writes
+ * uint16_t general categories, and DECODE_FOLDS writes case folded
+ * UTF-8 bytes.
+ */
+#define DECODE_CODEPOINTS (0)
+#define DECODE_CATEGORIES (1)
+#define DECODE_FOLDS (2)
+
+/*
+ * The value returned by the sequence decoders for a sequence that is
+ * valid so far but is cut off by the end of the available input.
+ */
+#define DECODE_TRUNCATED (-2)
+
+/*
+ * The chunk size in bytes of the parallel buffer functions when the
+ * client does not select one.
+ */
+#define PAR_CHUNK_DEFAULT ((size_t) 1048576)
+
+/*
+ * The output kinds of the parallel buffer functions.
+ * 
+ * PAR_CATEGORIES writes uint16_t general categories and PAR_FOLDS
+ * writes case folded UTF-8 bytes.
+ */
+#define PAR_CATEGORIES (0)
+#define PAR_FOLDS (1)
+
+/*
+ * The offset basis and prime of the 64-bit FNV-1a hash used by
+ * unikit_casehash_utf8().
+ */
+#define CASEHASH_BASIS UINT64_C(0xcbf29ce484222325)
+#define CASEHASH_PRIME UINT64_C(0x00000100000001b3)
+
+/*
+ * Type declarations
+ * =================
+ */
+
+/*
+ * An iterator over the case folded codepoints of UTF-8 text.
+ * 
+ * pSrc and n are the UTF-8 input, and i is the offset of the next
+ * sequence to decode.  cpa holds the case folding of the last decoded
+ * codepoint, which has len codepoints, and pos is the index within cpa
+ * of the next codepoint to return.  See foldIterNext().
+ */
+typedef struct {
+  const uint8_t *pSrc;
+  size_t n;
+  size_t i;
+  int32_t cpa[4];
+  int len;
+  int pos;
+} FOLD_ITER;
+
+/*
+ * The state of a walk over the general category runs.
+ * 
+ * fpRun and pCustom are the client callback and its custom parameter.
+ * lo, hi and gcat are the pending run, which is only valid if have is
+ * non-zero.  stop is set once the callback has asked to stop the walk.
+ * 
+ * ilo, ihi and ival are the pending run of identical values read from
+ * the general character tables, which is only valid if ihave is
+ * non-zero.  See runIndex().
+ */
+typedef struct {
+  unikit_fp_run fpRun;
+  void *pCustom;
+  int32_t lo;
+  int32_t hi;
+  uint16_t gcat;
+  int have;
+  int stop;
+  int32_t ilo;
+  int32_t ihi;
+  uint16_t ival;
+  int ihave;
+} RUN_WALK;
+
+/*
+ * The state of compiling a character class.
+ * 
+ * pCats and n are the category codes of the class.  pWords is the
+ * uncompressed bitset, which has CLASS_WORDS elements.
+ */
+typedef struct {
+  const uint16_t *pCats;
+  size_t n;
+  uint16_t *pWords;
+} CLASS_BUILD;
+
+/*
+ * The job state of the parallel buffer functions.
+ * 
+ * pSrc is the whole input.  pSplit has one element more than the chunk
+ * count, with chunk i running from pSplit[i] up to pSplit[i + 1].
+ * kind is one of the PAR constants.
+ * 
+ * In the measuring pass, pOut is NULL and each job stores the output
+ * length of its chunk in pLen.  In the writing pass, pOut is the output
+ * array and pLen holds the output offset of each chunk, with one more
+ * element for the total length.
+ */
+typedef struct {
+  const uint8_t *pSrc;
+  const size_t *pSplit;
+  size_t *pLen;
+  void *pOut;
+  int kind;
+} PAR_JOB;
+
+/*
+ * One data table of a table group.
+ * 
+ * key is the data key of the table, and ppTable and pLen are the
+ * variables that receive the table and its length when it is loaded.
+ * See groupSlots().
+ */
+typedef struct {
+  int key;
+  const uint16_t **ppTable;
+  int32_t *pLen;
+} TABLE_SLOT;
+
 /*
  * Local data
  * ==========
@@ -60,34 +376,228 @@ static void raiseErr(int lnum, const char *pDetail) {
 
 /*
  * Flag set to non-zero once the module is initialized.
+ * 
+ * m_loaded has a flag for each table group that is set to non-zero
+ * once the tables in the group are loaded.  See the TABLES constants.
+ * 
+ * m_refs is the number of unikit_init() calls that have not yet been
+ * matched by a unikit_shutdown() call.  It may only be accessed while
+ * holding the state lock; see lockState().
  */
+#ifdef HAVE_ATOMICS
+static atomic_int m_init;
+static atomic_int m_loaded[TABLES_COUNT];
+static atomic_flag m_lock = ATOMIC_FLAG_INIT;
+#else
 static int m_init = 0;
+static int m_loaded[TABLES_COUNT];
+#endif
+
+static int32_t m_refs = 0;
+
+/*
+ * The memory-mapped data file, or NULL if the tables come from the data
+ * module.  m_map_len is the length of the mapping in bytes and
+ * m_map_count is the number of tables in its directory.
+ */
+static const uint8_t *m_map = NULL;
+static size_t m_map_len = 0;
+static uint32_t m_map_count = 0;
+
+#ifndef UNIKIT_STATIC_TABLES
+
+/*
+ * The table arenas.
+ * 
+ * When the tables are decoded from the base-64 strings of the data
+ * module, all the tables of a group are decoded into a single
+ * allocation, the arena of the group, with each table starting on an
+ * ARENA_ALIGN boundary.  This keeps the tables of a group packed
+ * together in as few cache lines and pages as possible.  m_arena holds
+ * the allocation of each group as returned by malloc(), indexed by the
+ * TABLES constants, or NULL if the group has no arena.
+ * 
+ * While a group is loaded, m_arena_base is the aligned start of its
+ * arena, or NULL during the sizing pass that runs before the arena is
+ * allocated.  m_arena_used is the number of integers reserved in the
+ * arena so far.  These may only be accessed while holding the state
+ * lock.
+ */
+static void *m_arena[TABLES_COUNT];
+static uint16_t *m_arena_base = NULL;
+static int32_t m_arena_used = 0;
+
+#endif
 
 /*
  * The case folding indices and data table, along with their lengths.
+ * 
+ * The indices are nybble tries by default, or two-stage tables in the
+ * UNIKIT_STAGE_TABLES build mode.  The same applies to the general
+ * character tables below.
+ * 
+ * In the UNIKIT_STATIC_TABLES build mode, these and the general
+ * category tables below point directly into the constant arrays of the
+ * data module.  Otherwise, they point into the arena of their group,
+ * decoded when the group is loaded.
  */
-static uint16_t *m_case_lower = NULL;
-static uint16_t *m_case_upper = NULL;
-static uint16_t *m_case_data  = NULL;
+static const uint16_t *m_case_lower = NULL;
+static const uint16_t *m_case_upper = NULL;
+static const uint16_t *m_case_data  = NULL;
 
 static int32_t m_case_lower_len = 0;
 static int32_t m_case_upper_len = 0;
 static int32_t m_case_data_len = 0;
 
+/*
+ * The case folding delta tables, along with their lengths.
+ * 
+ * The delta tables are always two-stage tables, in every build mode.
+ * They are part of the case folding table group.
+ */
+static const uint16_t *m_case_delta_lower = NULL;
+static const uint16_t *m_case_delta_upper = NULL;
+
+static int32_t m_case_delta_lower_len = 0;
+static int32_t m_case_delta_upper_len = 0;
+
+/*
+ * The property table, along with its length.  It is loaded with the
+ * TABLES_PROPS group.
+ */
+static const uint16_t *m_props = NULL;
+static int32_t m_props_len = 0;
+
 /*
  * The general category tables, along with their lengths.
+ * 
+ * In the UNIKIT_UNIFIED_GCAT build mode, the unified category table
+ * takes the place of the bitmap and general character tables.
  */
-static uint16_t *m_gcat_core = NULL;
-static uint16_t *m_gcat_gen_low = NULL;
-static uint16_t *m_gcat_gen_high = NULL;
-static uint16_t *m_gcat_bitmap = NULL;
-static uint16_t *m_gcat_astral = NULL;
+static const uint16_t *m_gcat_core = NULL;
+#ifdef UNIKIT_UNIFIED_GCAT
+static const uint16_t *m_gcat_unified = NULL;
+#else
+static const uint16_t *m_gcat_gen_low = NULL;
+static const uint16_t *m_gcat_gen_high = NULL;
+static const uint16_t *m_gcat_bitmap = NULL;
+#endif
+static const uint16_t *m_gcat_astral = NULL;
+static const uint16_t *m_gcat_astral_dir = NULL;
 
 static int32_t m_gcat_core_len = 0;
+#ifdef UNIKIT_UNIFIED_GCAT
+static int32_t m_gcat_unified_len = 0;
+#else
 static int32_t m_gcat_gen_low_len = 0;
 static int32_t m_gcat_gen_high_len = 0;
 static int32_t m_gcat_bitmap_len = 0;
+#endif
 static int32_t m_gcat_astral_len = 0;
+static int32_t m_gcat_astral_dir_len = 0;
+
+/*
+ * The standard character classes, indexed by the UNIKIT_CLASS
+ * constants.  Their tables are loaded with the TABLES_CLASS group.
+ */
+static UNIKIT_CLASS m_class_std[CLASS_COUNT];
+
+/*
+ * The unified category list, which maps each category index stored in
+ * the unified category table and the property table to its category
+ * constant.  This must match the order of UNIFIED_CATS in the
+ * unikit_db.pl script.
+ */
+static const uint16_t m_unified_cats[UNIFIED_CAT_COUNT] = {
+  UNIKIT_GCAT_Lu, UNIKIT_GCAT_Ll, UNIKIT_GCAT_Lt, UNIKIT_GCAT_Lm,
+  UNIKIT_GCAT_Lo,
+  UNIKIT_GCAT_Mn, UNIKIT_GCAT_Mc, UNIKIT_GCAT_Me,
+  UNIKIT_GCAT_Nd, UNIKIT_GCAT_Nl, UNIKIT_GCAT_No,
+  UNIKIT_GCAT_Pc, UNIKIT_GCAT_Pd, UNIKIT_GCAT_Ps, UNIKIT_GCAT_Pe,
+  UNIKIT_GCAT_Pi, UNIKIT_GCAT_Pf, UNIKIT_GCAT_Po,
+  UNIKIT_GCAT_Sm, UNIKIT_GCAT_Sc, UNIKIT_GCAT_Sk, UNIKIT_GCAT_So,
+  UNIKIT_GCAT_Zs, UNIKIT_GCAT_Zl, UNIKIT_GCAT_Zp,
+  UNIKIT_GCAT_Cc, UNIKIT_GCAT_Cf, UNIKIT_GCAT_Cs, UNIKIT_GCAT_Co,
+  UNIKIT_GCAT_Cn
+};
+
+/*
+ * The lookup counters of the calling thread in the UNIKIT_INSTRUMENT
+ * build mode.
+ * 
+ * STAT_ADD() adds a count to one of the counters, and STAT_INC() adds
+ * one.  Both compile to nothing in the other build modes, so the field
+ * expressions passed to them must not have side effects.
+ */
+#ifdef UNIKIT_INSTRUMENT
+static STATS_LOCAL UNIKIT_STATS m_stats;
+#define STAT_ADD(f, k) (m_stats.f += (uint64_t) (k))
+#else
+#define STAT_ADD(f, k) ((void) 0)
+#endif
+#define STAT_INC(f) STAT_ADD(f, 1)
+
+/*
+ * The data tables of each table group.
+ * 
+ * This is the single list of the tables in each group, in the order
+ * they are placed in the arena.  Only the tables that the current build
+ * mode looks up are listed.  See groupSlots().
+ */
+static const TABLE_SLOT m_slots_case[] = {
+#ifdef UNIKIT_STAGE_TABLES
+  {UNIKIT_DATA_KEY_CASE_LOWER_STAGE, &m_case_lower, &m_case_lower_len},
+  {UNIKIT_DATA_KEY_CASE_UPPER_STAGE, &m_case_upper, &m_case_upper_len},
+#else
+  {UNIKIT_DATA_KEY_CASE_LOWER, &m_case_lower, &m_case_lower_len},
+  {UNIKIT_DATA_KEY_CASE_UPPER, &m_case_upper, &m_case_upper_len},
+#endif
+  {UNIKIT_DATA_KEY_CASE_DATA, &m_case_data, &m_case_data_len},
+  {UNIKIT_DATA_KEY_CASE_DELTA_LOWER,
+    &m_case_delta_lower, &m_case_delta_lower_len},
+  {UNIKIT_DATA_KEY_CASE_DELTA_UPPER,
+    &m_case_delta_upper, &m_case_delta_upper_len}
+};
+
+static const TABLE_SLOT m_slots_core[] = {
+  {UNIKIT_DATA_KEY_GCAT_CORE, &m_gcat_core, &m_gcat_core_len}
+};
+
+static const TABLE_SLOT m_slots_gcat[] = {
+#if defined(UNIKIT_UNIFIED_GCAT)
+  {UNIKIT_DATA_KEY_GCAT_UNIFIED, &m_gcat_unified, &m_gcat_unified_len},
+#elif defined(UNIKIT_STAGE_TABLES)
+  {UNIKIT_DATA_KEY_GCAT_GEN_LOW_STAGE,
+    &m_gcat_gen_low, &m_gcat_gen_low_len},
+  {UNIKIT_DATA_KEY_GCAT_GEN_HIGH_STAGE,
+    &m_gcat_gen_high, &m_gcat_gen_high_len},
+#else
+  {UNIKIT_DATA_KEY_GCAT_GEN_LOW, &m_gcat_gen_low, &m_gcat_gen_low_len},
+  {UNIKIT_DATA_KEY_GCAT_GEN_HIGH,
+    &m_gcat_gen_high, &m_gcat_gen_high_len},
+#endif
+#ifndef UNIKIT_UNIFIED_GCAT
+  {UNIKIT_DATA_KEY_GCAT_BITMAP, &m_gcat_bitmap, &m_gcat_bitmap_len},
+#endif
+  {UNIKIT_DATA_KEY_GCAT_ASTRAL, &m_gcat_astral, &m_gcat_astral_len},
+  {UNIKIT_DATA_KEY_GCAT_ASTRAL_DIR,
+    &m_gcat_astral_dir, &m_gcat_astral_dir_len}
+};
+
+static const TABLE_SLOT m_slots_class[] = {
+  {UNIKIT_DATA_KEY_CLASS_L, &(m_class_std[UNIKIT_CLASS_L].pTable),
+    &(m_class_std[UNIKIT_CLASS_L].len)},
+  {UNIKIT_DATA_KEY_CLASS_N, &(m_class_std[UNIKIT_CLASS_N].pTable),
+    &(m_class_std[UNIKIT_CLASS_N].len)},
+  {UNIKIT_DATA_KEY_CLASS_Z, &(m_class_std[UNIKIT_CLASS_Z].pTable),
+    &(m_class_std[UNIKIT_CLASS_Z].len)},
+  {UNIKIT_DATA_KEY_CLASS_LC, &(m_class_std[UNIKIT_CLASS_LC].pTable),
+    &(m_class_std[UNIKIT_CLASS_LC].len)}
+};
+
+static const TABLE_SLOT m_slots_props[] = {
+  {UNIKIT_DATA_KEY_PROPS, &m_props, &m_props_len}
+};
 
 /*
  * Local functions
@@ -95,18 +605,155 @@ static int32_t m_gcat_astral_len = 0;
  */
 
 /* Prototypes */
-static uint16_t *decodeUint16Array(const char *pStr, int32_t *pLen);
+#ifndef UNIKIT_STATIC_TABLES
+static void decodeUint16Array(
+    const char     *pStr,
+          uint16_t *pBuf,
+          int32_t  *pLen);
+#endif
+static void lockState(void);
+static void unlockState(void);
+static int isInit(void);
+static uint32_t readUint32(const uint8_t *p);
+static uint32_t checksumTable(const uint8_t *p, size_t len);
+static int mapDataFile(const char *pPath);
+static void unmapDataFile(void);
+static const uint16_t *mappedTable(int key, int32_t *pLen);
+static const uint16_t *loadTable(int key, int32_t *pLen);
+static void unloadTable(const uint16_t **ppTable, int32_t *pLen);
+static const TABLE_SLOT *groupSlots(int grp, int *pCount);
+static void loadTables(int grp);
+static void loadGroup(int grp);
+static void unloadGroup(int grp);
+static void requireTables(int grp);
+#ifndef UNIKIT_STATIC_TABLES
+static size_t arenaSize(void);
+static void loadArena(void *pMem);
+#endif
+static int startup(
+          unikit_fp_err   fpErr,
+    const char          * pPath,
+          void          * pMem,
+          size_t          mem_len);
+static uint16_t queryStage(
+    const uint16_t *pTable,
+          int32_t   tlen,
+          uint32_t  key);
+#ifndef UNIKIT_STAGE_TABLES
 static uint16_t queryTrie(
     const uint16_t *pTrie,
           int32_t   tlen,
           uint32_t  key,
           int       depth);
+#endif
+static uint16_t queryIndex(
+    const uint16_t *pTable,
+          int32_t   tlen,
+          uint32_t  key);
+static const char *verifyDataKey(uint16_t r, int32_t dlen);
+static const char *verifyStage(const uint16_t *pTable, int32_t tlen,
+                                int32_t dlen);
+#ifndef UNIKIT_STAGE_TABLES
+static const char *verifyTrie(const uint16_t *pTrie, int32_t tlen,
+                              int32_t tptr, int depth, int32_t dlen);
+#endif
+static const char *verifyIndex(const uint16_t *pTable, int32_t tlen,
+                                int32_t dlen);
+static const char *verifyClass(const uint16_t *pTable, int32_t tlen);
+static const char *verifyGroup(int grp);
+static uint16_t foldDelta(int32_t cv);
+static int foldCore(int32_t cv, int32_t *pcpa);
+static int32_t decodeUtf8(const uint8_t *pSrc, size_t n, size_t *pAdv);
+static int32_t decodeUtf16(
+    const uint8_t *pSrc,
+          size_t   n,
+          int      big,
+          size_t  *pAdv);
+static int encodeUtf8(int32_t cv, uint8_t *pBuf);
+static uint64_t foldAscii8(uint64_t w);
+static int encodeUtf16(int32_t cv, uint16_t *pBuf);
+static int32_t decodePair(
+    const uint16_t *pSrc,
+          size_t    n,
+          size_t   *pAdv);
+static size_t spanUtf16(const uint16_t *pSrc, size_t n);
+static uint64_t foldAscii4(uint64_t w);
+#ifdef UNIKIT_UNIFIED_GCAT
+static uint16_t queryUnified(int32_t cv);
+#endif
+static uint16_t categoryCore(int32_t cv);
+static uint32_t propsCore(int32_t cv);
+static void runFlush(RUN_WALK *pw);
+static void runEmit(RUN_WALK *pw, int32_t lo, int32_t hi,
+                      uint16_t gcat);
+#ifndef UNIKIT_UNIFIED_GCAT
+static void runRemainder(RUN_WALK *pw, int32_t lo, int32_t hi);
+static void runGeneral(RUN_WALK *pw, int32_t lo, int32_t hi,
+                        uint16_t v);
+static void runIndexFlush(RUN_WALK *pw);
+static void runIndex(RUN_WALK *pw, int32_t lo, int32_t hi, uint16_t v);
+#ifndef UNIKIT_STAGE_TABLES
+static void runTrie(RUN_WALK *pw, const uint16_t *pTrie, int32_t tptr,
+                      int depth, int32_t base);
+#endif
+static void walkIndex(RUN_WALK *pw, const uint16_t *pTable,
+                        int32_t base);
+#else
+static void walkUnified(RUN_WALK *pw);
+#endif
+static void walkAstral(RUN_WALK *pw);
+static int classValidCode(uint16_t code);
+static int classRun(void *pCustom, int32_t lo, int32_t hi,
+                      uint16_t gcat);
+static size_t countUtf8(const uint8_t *pSrc, size_t n);
+static size_t splitUtf8(const uint8_t *pSrc, size_t n, size_t pos);
+static void parJob(void *pJob, size_t i);
+static void parExec(PAR_JOB *pj, size_t count,
+                      unikit_fp_exec fpExec, void *pCustom);
+static size_t runPar(
+    const uint8_t        * pSrc,
+          size_t           n,
+          void           * pOut,
+          size_t           cap,
+          int              kind,
+          size_t           chunk,
+          unikit_fp_exec   fpExec,
+          void           * pCustom);
+static int32_t decodeNext(
+    const uint8_t *pSrc,
+          size_t   n,
+          int      enc,
+          size_t  *pAdv);
+static int emitDecoded(int32_t cv, int kind, void *pOut, size_t cap,
+                        size_t *pLen);
+static size_t decodeStream(
+          UNIKIT_DECODER * pd,
+    const uint8_t        * pSrc,
+          size_t           n,
+          int              kind,
+          void           * pOut,
+          size_t           cap,
+          size_t         * pUsed);
+static void foldIterInit(FOLD_ITER *pi, const uint8_t *pSrc, size_t n);
+static int32_t foldIterNext(FOLD_ITER *pi);
+static uint64_t matchAscii8(uint64_t w, uint64_t c);
+static void casefindFilter(UNIKIT_CASEFIND *pf);
+static int casefindAt(
+    const UNIKIT_CASEFIND * pf,
+    const uint8_t         * pSrc,
+          size_t            n,
+          size_t            i,
+          size_t          * pEnd);
+
+#ifndef UNIKIT_STATIC_TABLES
 
 /*
  * Decode a nul-terminated base-64 string with big endian ordering into
  * an array of unsigned 16-bit integers.
  * 
- * The returned array is dynamically allocated.
+ * The array is decoded into the buffer pBuf, which must have room for
+ * the decoded length.  If pBuf is NULL, the string is only checked and
+ * measured, so that callers can size the buffer first.
  * 
  * The base-64 string length must be greater than zero and a multiple of
  * four.  Padding = signs must be used if necessary in the last group of
@@ -115,19 +762,20 @@ static uint16_t queryTrie(
  * integers.
  * 
  * The pLen variable will receive the length -- in integers, not
- * bytes -- of the returned array.
+ * bytes -- of the decoded array.
  * 
  * Parameters:
  * 
  *   pStr - the base-64 string to decode
  * 
- *   pLen - variable to receive number of elements in the decoded array
- * 
- * Return:
+ *   pBuf - the buffer to receive the decoded array, or NULL
  * 
- *   a dynamically-allocated array decoded from the base-64 string
+ *   pLen - variable to receive number of elements in the decoded array
  */
-static uint16_t *decodeUint16Array(const char *pStr, int32_t *pLen) {
+static void decodeUint16Array(
+    const char     *pStr,
+          uint16_t *pBuf,
+          int32_t  *pLen) {
   
   int32_t slen = 0;
   int32_t i = 0;
@@ -138,11 +786,10 @@ static uint16_t *decodeUint16Array(const char *pStr, int32_t *pLen) {
   int32_t base = 0;
   int c = 0;
   
-  uint16_t *pBuf = NULL;
   uint16_t *pb = NULL;
   
   /* Check parameters */
-  if (pStr == NULL) {
+  if ((pStr == NULL) || (pLen == NULL)) {
     raiseErr(__LINE__, NULL);
   }
   
@@ -194,10 +841,9 @@ static uint16_t *decodeUint16Array(const char *pStr, int32_t *pLen) {
   /* Compute total number of elements */
   *pLen = (int32_t) ((groups * 3) + extra);
   
-  /* Allocate a buffer of the correct length */
-  pBuf = (uint16_t *) calloc((size_t) *pLen, sizeof(uint16_t));
+  /* If only measuring, we are done */
   if (pBuf == NULL) {
-    raiseErr(__LINE__, "Out of memory");
+    return;
   }
   
   /* Start the buffer pointer at the start */
@@ -286,102 +932,803 @@ static uint16_t *decodeUint16Array(const char *pStr, int32_t *pLen) {
       raiseErr(__LINE__, NULL);
     }
   }
-  
-  /* Return the decoded buffer */
-  return pBuf;
 }
 
+#endif
+
 /*
- * Query a compiled trie.
+ * Acquire the state lock that serializes initialization and shutdown.
  * 
- * pTrie is a pointer to the compiled trie, and depth is the depth of
- * the tree, which must be in range 1 to 8.  tlen is the length in
- * integers (not bytes!) of the compiled trie, which is used as a
- * safeguard against out-of-bounds memory access.
+ * This spins until the lock is available, which is acceptable because
+ * the lock is only ever held while the tables are loaded or freed.
+ * Without C11 atomics, this function does nothing.
+ */
+static void lockState(void) {
+#ifdef HAVE_ATOMICS
+  while (atomic_flag_test_and_set_explicit(
+            &m_lock, memory_order_acquire)) { }
+#endif
+}
+
+/*
+ * Release the state lock acquired with lockState().
+ */
+static void unlockState(void) {
+#ifdef HAVE_ATOMICS
+  atomic_flag_clear_explicit(&m_lock, memory_order_release);
+#endif
+}
+
+/*
+ * Check whether the module is initialized.
  * 
- * The compiled tree is a sequence of tables, where each table is
- * exactly 16 unsigned 16-bit integers.  Each table is either a leaf
- * table or a non-leaf table.  Leaf tables directly store key values, or
- * the special value 0xFFFF indicating no value.  Non-leaf tables store
- * indices of other tables, or the special value 0xFFFF indicating no
- * table.
+ * With C11 atomics, a non-zero return guarantees that the tables loaded
+ * by the initializing thread are visible to the calling thread.
  * 
- * The requested key encodes a sequence of 4-bit nybbles, with more
- * significant nybbles queried before less significant nybbles.  The
- * total number of nybbles in the key is always equal to the depth, and
- * the last nybble is always the least significant 4 bits of the key.
- * Nybbles of the key that are beyond the nybble length suggested by the
- * depth are ignored.
+ * Return:
  * 
- * The first nybble is always used to query the first table in the
- * compiled trie.  Nybbles from the key are always used as an index into
- * the 16 records in each table.  For all nybbles but the last, the
- * table is interpreted as a non-leaf table, and the indices to other
- * tables in the trie are followed.  For the last nybble, the table is
- * interpreted as a leaf table, and the records yield the value.
+ *   non-zero if initialized, zero if not
+ */
+static int isInit(void) {
+#ifdef HAVE_ATOMICS
+  return atomic_load_explicit(&m_init, memory_order_acquire);
+#else
+  return m_init;
+#endif
+}
+
+/*
+ * Read a little-endian unsigned 32-bit integer.
  * 
- * The return value is either an unsigned 16-bit value in range 0 to
- * 0xFFFE, or the special value 0xFFFF indicating that no record is
- * mapped to this key in the trie.
+ * Parameters:
+ * 
+ *   p - pointer to the four bytes of the integer
+ * 
+ * Return:
+ * 
+ *   the integer value
+ */
+static uint32_t readUint32(const uint8_t *p) {
+  return ((uint32_t) p[0])
+          | (((uint32_t) p[1]) << 8)
+          | (((uint32_t) p[2]) << 16)
+          | (((uint32_t) p[3]) << 24);
+}
+
+/*
+ * Compute the 32-bit FNV-1a checksum of a sequence of bytes.
+ * 
+ * This must match the checksum computed by the unikit_db.pl script for
+ * the tables of binary data files.
  * 
  * Parameters:
  * 
- *   pTrie - the compiled trie
+ *   p - the bytes to check
  * 
- *   tlen - the length in elements of the compiled trie
+ *   len - the number of bytes
  * 
- *   key - the encoded key nybble sequence
+ * Return:
  * 
- *   depth - the depth of the trie
+ *   the checksum
+ */
+static uint32_t checksumTable(const uint8_t *p, size_t len) {
+  
+  uint32_t h = UINT32_C(0x811c9dc5);
+  size_t i = 0;
+  
+  for(i = 0; i < len; i++) {
+    h ^= (uint32_t) p[i];
+    h *= UINT32_C(0x01000193);
+  }
+  
+  return h;
+}
+
+/*
+ * Map a binary data file into memory and validate it.
+ * 
+ * The file is mapped read-only.  On success, m_map, m_map_len, and
+ * m_map_count are set.  The header, the table directory, and the
+ * checksum of every table are all verified before returning success, so
+ * that the tables can afterwards be used in place without any further
+ * file checks.  See the unikit_db.pl script for the file format.
+ * 
+ * The file must also hold every table listed by groupSlots(), and each
+ * table group must pass verifyGroup().  Otherwise, a bad table would
+ * only be found when its group is first loaded, after
+ * unikit_init_mapped() has already succeeded.  The tables are bound
+ * for the check and then released, so the caller must hold the state
+ * lock and no group may be loaded.
+ * 
+ * The file must have been generated with the same byte order as this
+ * platform, which is little endian.  Files are rejected on big-endian
+ * platforms.
+ * 
+ * Without POSIX memory mapping support, this function always fails.
+ * 
+ * Parameters:
+ * 
+ *   pPath - the path to the data file
  * 
  * Return:
  * 
- *   the value mapped to the key, or 0xFFFF if no mapped value
+ *   non-zero if successful, zero if the file could not be mapped or is
+ *   not a valid data file
  */
-static uint16_t queryTrie(
-    const uint16_t *pTrie,
-          int32_t   tlen,
-          uint32_t  key,
-          int       depth) {
+static int mapDataFile(const char *pPath) {
+#ifdef HAVE_MMAP
   
-  int32_t tptr = 0;
-  int i = 0;
+  int fd = -1;
+  struct stat st;
+  void *pm = NULL;
+  const uint8_t *pb = NULL;
+  size_t flen = 0;
+  uint16_t bom = 0;
+  uint32_t count = 0;
+  uint32_t i = 0;
+  uint32_t key = 0;
+  uint32_t prev_key = 0;
+  uint32_t offs = 0;
+  uint32_t tlen = 0;
+  const uint8_t *pe = NULL;
+  const TABLE_SLOT *pSlots = NULL;
+  int32_t mlen = 0;
+  int valid = 1;
+  int grp = 0;
+  int n = 0;
   int j = 0;
-  uint16_t r = 0;
   
   /* Check parameters */
-  if (pTrie == NULL) {
+  if (pPath == NULL) {
     raiseErr(__LINE__, NULL);
   }
-  if (tlen < 1) {
-    raiseErr(__LINE__, NULL);
+  
+  /* Open the file and map all of it read-only */
+  memset(&st, 0, sizeof(struct stat));
+  fd = open(pPath, O_RDONLY);
+  if (fd < 0) {
+    return 0;
   }
-  if ((depth < 1) || (depth > 8)) {
-    raiseErr(__LINE__, NULL);
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return 0;
+  }
+  if ((st.st_size < DATAFILE_HEADER_LEN) ||
+      ((uintmax_t) st.st_size > (uintmax_t) INT32_MAX)) {
+    close(fd);
+    return 0;
   }
+  flen = (size_t) st.st_size;
   
-  /* Table offset pointer starts out at first table */
-  tptr = 0;
+  pm = mmap(NULL, flen, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (pm == MAP_FAILED) {
+    return 0;
+  }
+  pb = (const uint8_t *) pm;
   
-  /* Process all nybbles but the last to adjust the table pointer, or
-   * set table pointer to -1 if we encountered missing records */
-  for(i = 0; i <= depth - 2; i++) {
-    /* Get the current nybble */
-    j = (int) ((key >> ((depth - i - 1) * 4)) & 0x0f);
-    
-    /* Get the indexed record and handle missing record */
-    if (tptr + j >= tlen) {
-      raiseErr(__LINE__, "Trie bound error");
+  /* Check the header; the byte order mark is read in native byte order
+   * so that it only matches on little-endian platforms */
+  memcpy(&bom, pb + 4, 2);
+  if ((memcmp(pb, "UKDB", 4) != 0) || (bom != 0xfeff) ||
+      (pb[6] != DATAFILE_VERSION) || (pb[7] != 0)) {
+    valid = 0;
+  }
+  
+  if (valid) {
+    count = readUint32(pb + 12);
+    if ((count < 1) || (count > (uint32_t) (
+            (flen - DATAFILE_HEADER_LEN) / DATAFILE_ENTRY_LEN))) {
+      valid = 0;
     }
+  }
+  
+  /* Check each directory record and the table it refers to */
+  for(i = 0; valid && (i < count); i++) {
+    pe = pb + DATAFILE_HEADER_LEN + (i * DATAFILE_ENTRY_LEN);
+    key  = readUint32(pe);
+    offs = readUint32(pe + 4);
+    tlen = readUint32(pe + 8);
     
-    r = pTrie[tptr + j];
-    if (r == 0xffff) {
-      tptr = -1;
-      break;
+    /* Keys must be strictly ascending, tables aligned, within the file,
+     * and beyond the directory */
+    if ((i > 0) && (key <= prev_key)) {
+      valid = 0;
+    } else if ((offs % DATAFILE_ALIGN) != 0) {
+      valid = 0;
+    } else if (offs <
+                DATAFILE_HEADER_LEN + (count * DATAFILE_ENTRY_LEN)) {
+      valid = 0;
+    } else if ((tlen < 1) || (offs > flen) ||
+                (tlen > (flen - offs) / 2)) {
+      valid = 0;
+    } else if (checksumTable(pb + offs, ((size_t) tlen) * 2)
+                != readUint32(pe + 12)) {
+      valid = 0;
     }
     
-    /* Adjust table pointer offset */
-    tptr = ((int32_t) r) * 16;
+    prev_key = key;
+  }
+  
+  /* Unmap an invalid file */
+  if (!valid) {
+    munmap(pm, flen);
+    return 0;
+  }
+  
+  /* Store the mapping */
+  m_map = pb;
+  m_map_len = flen;
+  m_map_count = count;
+  
+  /* Check that every table the build mode loads is present */
+  for(grp = 0; grp < TABLES_COUNT; grp++) {
+    pSlots = groupSlots(grp, &n);
+    for(j = 0; j < n; j++) {
+      if (mappedTable(pSlots[j].key, &mlen) == NULL) {
+        valid = 0;
+      }
+    }
+  }
+  
+  /* Check the shapes of the tables in every group */
+  for(grp = 0; valid && (grp < TABLES_COUNT); grp++) {
+    loadTables(grp);
+    if (verifyGroup(grp) != NULL) {
+      valid = 0;
+    }
+    unloadGroup(grp);
+  }
+  
+  if (!valid) {
+    unmapDataFile();
+    return 0;
+  }
+  
+  return 1;
+  
+#else
+  (void) pPath;
+  return 0;
+#endif
+}
+
+/*
+ * Release the memory-mapped data file, if there is one.
+ */
+static void unmapDataFile(void) {
+#ifdef HAVE_MMAP
+  if (m_map != NULL) {
+    munmap((void *) m_map, m_map_len);
+  }
+#endif
+  m_map = NULL;
+  m_map_len = 0;
+  m_map_count = 0;
+}
+
+/*
+ * Find a table in the memory-mapped data file.
+ * 
+ * There must be a mapped data file.  Its directory was validated when
+ * the file was mapped, so the returned table is always within the
+ * mapping.
+ * 
+ * Parameters:
+ * 
+ *   key - the data key of the table
+ * 
+ *   pLen - variable to receive number of elements in the table
+ * 
+ * Return:
+ * 
+ *   the table within the mapping, or NULL if the file does not have a
+ *   table with the given key
+ */
+static const uint16_t *mappedTable(int key, int32_t *pLen) {
+  
+  const uint8_t *pe = NULL;
+  uint32_t i = 0;
+  
+  /* Check state */
+  if (m_map == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Search the directory for the key */
+  for(i = 0; i < m_map_count; i++) {
+    pe = m_map + DATAFILE_HEADER_LEN + (i * DATAFILE_ENTRY_LEN);
+    if (readUint32(pe) == (uint32_t) key) {
+      *pLen = (int32_t) readUint32(pe + 8);
+      return (const uint16_t *) (m_map + readUint32(pe + 4));
+    }
+  }
+  
+  *pLen = 0;
+  return NULL;
+}
+
+/*
+ * Load one of the data tables from the data module.
+ * 
+ * key is one of the UNIKIT_DATA_KEY constants.  pLen receives the
+ * length of the table in integers (not bytes).
+ * 
+ * If a data file is mapped, this returns the table in place within the
+ * mapping.  Otherwise, in the UNIKIT_STATIC_TABLES build mode, this
+ * returns the constant array stored in the data module without any
+ * copying.  Otherwise, the base-64 string from the data module is
+ * decoded into the next aligned position of the arena of the group
+ * being loaded.  During the sizing pass, when there is no arena yet,
+ * the space is only reserved and NULL is returned.
+ * 
+ * Parameters:
+ * 
+ *   key - the data key of the table
+ * 
+ *   pLen - variable to receive number of elements in the table
+ * 
+ * Return:
+ * 
+ *   the loaded table
+ */
+static const uint16_t *loadTable(int key, int32_t *pLen) {
+  
+  const uint16_t *pResult = NULL;
+#ifndef UNIKIT_STATIC_TABLES
+  uint16_t *pb = NULL;
+#endif
+  
+  /* Check parameters */
+  if (pLen == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  if (m_map != NULL) {
+    pResult = mappedTable(key, pLen);
+    if (pResult == NULL) {
+      raiseErr(__LINE__, "Missing table in data file");
+    }
+    return pResult;
+  }
+  
+#ifdef UNIKIT_STATIC_TABLES
+  pResult = unikit_data_table(key, pLen);
+  if ((pResult == NULL) || (*pLen < 1)) {
+    raiseErr(__LINE__, "Missing data table");
+  }
+#else
+  decodeUint16Array(unikit_data_fetch(key), NULL, pLen);
+  if (*pLen > INT32_MAX - m_arena_used - ARENA_ALIGN_LEN) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  if (m_arena_base != NULL) {
+    pb = m_arena_base + m_arena_used;
+    decodeUint16Array(unikit_data_fetch(key), pb, pLen);
+    pResult = pb;
+  }
+  
+  /* Reserve the table rounded up to the arena alignment */
+  m_arena_used += ((*pLen + ARENA_ALIGN_LEN - 1) / ARENA_ALIGN_LEN) *
+                    ARENA_ALIGN_LEN;
+#endif
+  
+  return pResult;
+}
+
+/*
+ * Release a data table loaded with loadTable().
+ * 
+ * The table pointer is reset to NULL and the length is reset to zero.
+ * Nothing is freed here, since decoded tables belong to the arena of
+ * their group, which unloadGroup() frees once all its tables are
+ * released.
+ * 
+ * Parameters:
+ * 
+ *   ppTable - the table pointer to release
+ * 
+ *   pLen - the length of the table
+ */
+static void unloadTable(const uint16_t **ppTable, int32_t *pLen) {
+  
+  /* Check parameters */
+  if ((ppTable == NULL) || (pLen == NULL)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  *ppTable = NULL;
+  *pLen = 0;
+}
+
+/*
+ * Get the data tables of a table group.
+ * 
+ * Parameters:
+ * 
+ *   grp - the table group
+ * 
+ *   pCount - variable that receives the number of tables in the group
+ * 
+ * Return:
+ * 
+ *   the tables of the group
+ */
+static const TABLE_SLOT *groupSlots(int grp, int *pCount) {
+  
+  const TABLE_SLOT *pResult = NULL;
+  size_t n = 0;
+  
+  /* Check parameters */
+  if (pCount == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  if (grp == TABLES_CASE) {
+    pResult = m_slots_case;
+    n = sizeof(m_slots_case);
+    
+  } else if (grp == TABLES_CORE) {
+    pResult = m_slots_core;
+    n = sizeof(m_slots_core);
+    
+  } else if (grp == TABLES_GCAT) {
+    pResult = m_slots_gcat;
+    n = sizeof(m_slots_gcat);
+    
+  } else if (grp == TABLES_CLASS) {
+    pResult = m_slots_class;
+    n = sizeof(m_slots_class);
+    
+  } else if (grp == TABLES_PROPS) {
+    pResult = m_slots_props;
+    n = sizeof(m_slots_props);
+    
+  } else {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  *pCount = (int) (n / sizeof(TABLE_SLOT));
+  return pResult;
+}
+
+/*
+ * Call loadTable() for every table in a table group, in the order of
+ * groupSlots().
+ * 
+ * Parameters:
+ * 
+ *   grp - the table group to load
+ */
+static void loadTables(int grp) {
+  
+  const TABLE_SLOT *pSlots = NULL;
+  int n = 0;
+  int i = 0;
+  
+  pSlots = groupSlots(grp, &n);
+  for(i = 0; i < n; i++) {
+    *(pSlots[i].ppTable) = loadTable(pSlots[i].key, pSlots[i].pLen);
+  }
+}
+
+/*
+ * Load all the tables in a table group.
+ * 
+ * grp is one of the TABLES constants.  The caller must hold the state
+ * lock and the group must not already be loaded.  This function does
+ * not update the m_loaded flags.  The loaded tables are verified with
+ * verifyGroup() before returning.
+ * 
+ * When the tables are decoded from the data module, this runs
+ * loadTables() twice.  The first pass only sums up the aligned lengths
+ * of the tables, and the second pass decodes them into a single arena
+ * of exactly that size.
+ * 
+ * Parameters:
+ * 
+ *   grp - the table group to load
+ */
+static void loadGroup(int grp) {
+  
+  const char *pMsg = NULL;
+#ifndef UNIKIT_STATIC_TABLES
+  void *pArena = NULL;
+#endif
+  
+  /* Check parameters */
+  if ((grp < 0) || (grp >= TABLES_COUNT)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+#ifndef UNIKIT_STATIC_TABLES
+  if (m_map == NULL) {
+    /* Sizing pass */
+    m_arena_base = NULL;
+    m_arena_used = 0;
+    loadTables(grp);
+    
+    /* Allocate the arena with room to align its start */
+    pArena = malloc(((size_t) m_arena_used) * sizeof(uint16_t) +
+                      (ARENA_ALIGN - 1));
+    if (pArena == NULL) {
+      raiseErr(__LINE__, "Out of memory");
+    }
+    m_arena[grp] = pArena;
+    m_arena_base = (uint16_t *) (((uintptr_t) pArena +
+                      (ARENA_ALIGN - 1)) &
+                      ~((uintptr_t) (ARENA_ALIGN - 1)));
+    m_arena_used = 0;
+  }
+#endif
+  
+  loadTables(grp);
+  
+#ifndef UNIKIT_STATIC_TABLES
+  m_arena_base = NULL;
+  m_arena_used = 0;
+#endif
+  
+  /* Check the table shapes once, so lookups need not check them */
+  pMsg = verifyGroup(grp);
+  if (pMsg != NULL) {
+    raiseErr(__LINE__, pMsg);
+  }
+}
+
+/*
+ * Release all the tables in a table group.
+ * 
+ * grp is one of the TABLES constants.  The caller must hold the state
+ * lock.  Tables that were never loaded are skipped.  This function does
+ * not update the m_loaded flags.
+ * 
+ * Parameters:
+ * 
+ *   grp - the table group to release
+ */
+static void unloadGroup(int grp) {
+  
+  const TABLE_SLOT *pSlots = NULL;
+  int n = 0;
+  int i = 0;
+  
+  pSlots = groupSlots(grp, &n);
+  for(i = 0; i < n; i++) {
+    unloadTable(pSlots[i].ppTable, pSlots[i].pLen);
+  }
+  
+#ifndef UNIKIT_STATIC_TABLES
+  /* Free the arena that held the decoded tables, if any */
+  if (m_arena[grp] != NULL) {
+    free(m_arena[grp]);
+    m_arena[grp] = NULL;
+  }
+#endif
+}
+
+/*
+ * Make sure that all the tables in a table group are loaded.
+ * 
+ * grp is one of the TABLES constants.  If the group is already loaded,
+ * this is only a single flag check.  Otherwise, the state lock is
+ * acquired and the group is loaded if no other thread has loaded it in
+ * the meantime.  The loaded flag is published with release ordering
+ * after the tables are stored, so that any thread that sees the flag
+ * also sees the tables.
+ * 
+ * The module must be initialized, but this function does not check the
+ * module state, so it is the caller's responsibility to do so.
+ * 
+ * Parameters:
+ * 
+ *   grp - the table group that is required
+ */
+static void requireTables(int grp) {
+  
+#ifdef HAVE_ATOMICS
+  if (atomic_load_explicit(&(m_loaded[grp]), memory_order_acquire)) {
+    return;
+  }
+  
+  lockState();
+  if (!atomic_load_explicit(&(m_loaded[grp]), memory_order_relaxed)) {
+    loadGroup(grp);
+    atomic_store_explicit(&(m_loaded[grp]), 1, memory_order_release);
+  }
+  unlockState();
+  
+#else
+  if (!m_loaded[grp]) {
+    loadGroup(grp);
+    m_loaded[grp] = 1;
+  }
+#endif
+}
+
+#ifndef UNIKIT_STATIC_TABLES
+
+/*
+ * Compute the size of a memory block that can hold the decoded tables
+ * of every table group, for loadArena().
+ * 
+ * The tables are only measured, so this does not touch the module
+ * state.  The size includes ARENA_ALIGN - 1 bytes, so that the tables
+ * can be aligned within a block of any alignment.
+ * 
+ * Return:
+ * 
+ *   the size of the memory block in bytes
+ */
+static size_t arenaSize(void) {
+  
+  const TABLE_SLOT *pSlots = NULL;
+  size_t total = 0;
+  int32_t len = 0;
+  int grp = 0;
+  int n = 0;
+  int i = 0;
+  
+  for(grp = 0; grp < TABLES_COUNT; grp++) {
+    pSlots = groupSlots(grp, &n);
+    for(i = 0; i < n; i++) {
+      decodeUint16Array(unikit_data_fetch(pSlots[i].key), NULL, &len);
+      
+      /* Reserve the table rounded up as loadTable() does */
+      total += ((size_t) ((len + ARENA_ALIGN_LEN - 1) /
+                  ARENA_ALIGN_LEN)) * ARENA_ALIGN;
+    }
+  }
+  
+  return total + (ARENA_ALIGN - 1);
+}
+
+/*
+ * Load every table group into a memory block provided by the client.
+ * 
+ * The caller must hold the state lock, no group may be loaded, and
+ * pMem must have room for at least arenaSize() bytes.  The tables of
+ * all the groups are decoded one after another into the block, with
+ * the same layout as in the arenas of loadGroup(), and each group is
+ * verified.  The m_arena entries remain NULL, so unloadGroup() frees
+ * nothing and the block still belongs to the client.  This function
+ * does not update the m_loaded flags.
+ * 
+ * Parameters:
+ * 
+ *   pMem - the memory block
+ */
+static void loadArena(void *pMem) {
+  
+  const char *pMsg = NULL;
+  int grp = 0;
+  
+  /* Check parameters */
+  if (pMem == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  m_arena_base = (uint16_t *) (((uintptr_t) pMem +
+                    (ARENA_ALIGN - 1)) &
+                    ~((uintptr_t) (ARENA_ALIGN - 1)));
+  m_arena_used = 0;
+  
+  for(grp = 0; grp < TABLES_COUNT; grp++) {
+    loadTables(grp);
+    pMsg = verifyGroup(grp);
+    if (pMsg != NULL) {
+      raiseErr(__LINE__, pMsg);
+    }
+  }
+  
+  m_arena_base = NULL;
+  m_arena_used = 0;
+}
+
+#endif
+
+#ifndef UNIKIT_STAGE_TABLES
+
+/*
+ * Query a compiled trie.
+ * 
+ * pTrie is a pointer to the compiled trie, and depth is the depth of
+ * the tree, which must be in range 1 to 8.  tlen is the length in
+ * integers (not bytes!) of the compiled trie, which is used as a
+ * safeguard against out-of-bounds memory access in the UNIKIT_CHECKED
+ * build mode.  Otherwise, the trie must have been checked with
+ * verifyTrie() when it was loaded.
+ * 
+ * The compiled tree is a sequence of tables, where each table is
+ * exactly 16 unsigned 16-bit integers.  Each table is either a leaf
+ * table or a non-leaf table.  Leaf tables directly store key values, or
+ * the special value 0xFFFF indicating no value.  Non-leaf tables store
+ * indices of other tables, or the special value 0xFFFF indicating no
+ * table.
+ * 
+ * The requested key encodes a sequence of 4-bit nybbles, with more
+ * significant nybbles queried before less significant nybbles.  The
+ * total number of nybbles in the key is always equal to the depth, and
+ * the last nybble is always the least significant 4 bits of the key.
+ * Nybbles of the key that are beyond the nybble length suggested by the
+ * depth are ignored.
+ * 
+ * The first nybble is always used to query the first table in the
+ * compiled trie.  Nybbles from the key are always used as an index into
+ * the 16 records in each table.  For all nybbles but the last, the
+ * table is interpreted as a non-leaf table, and the indices to other
+ * tables in the trie are followed.  For the last nybble, the table is
+ * interpreted as a leaf table, and the records yield the value.
+ * 
+ * The return value is either an unsigned 16-bit value in range 0 to
+ * 0xFFFE, or the special value 0xFFFF indicating that no record is
+ * mapped to this key in the trie.
+ * 
+ * Parameters:
+ * 
+ *   pTrie - the compiled trie
+ * 
+ *   tlen - the length in elements of the compiled trie
+ * 
+ *   key - the encoded key nybble sequence
+ * 
+ *   depth - the depth of the trie
+ * 
+ * Return:
+ * 
+ *   the value mapped to the key, or 0xFFFF if no mapped value
+ */
+static uint16_t queryTrie(
+    const uint16_t *pTrie,
+          int32_t   tlen,
+          uint32_t  key,
+          int       depth) {
+  
+  int32_t tptr = 0;
+  int i = 0;
+  int j = 0;
+  uint16_t r = 0;
+  
+  /* Check parameters */
+#ifdef UNIKIT_CHECKED
+  if (pTrie == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  if (tlen < 1) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((depth < 1) || (depth > 8)) {
+    raiseErr(__LINE__, NULL);
+  }
+#else
+  (void) tlen;
+#endif
+  
+  /* Table offset pointer starts out at first table */
+  tptr = 0;
+  
+  /* Process all nybbles but the last to adjust the table pointer, or
+   * set table pointer to -1 if we encountered missing records */
+  for(i = 0; i <= depth - 2; i++) {
+    /* Get the current nybble */
+    j = (int) ((key >> ((depth - i - 1) * 4)) & 0x0f);
+    
+    /* Get the indexed record and handle missing record */
+#ifdef UNIKIT_CHECKED
+    if (tptr + j >= tlen) {
+      raiseErr(__LINE__, "Trie bound error");
+    }
+#endif
+    
+    r = pTrie[tptr + j];
+    if (r == 0xffff) {
+      tptr = -1;
+      break;
+    }
+    
+    /* Adjust table pointer offset */
+    tptr = ((int32_t) r) * 16;
   }
   
   /* If we still have a valid table pointer, get the result record using
@@ -389,359 +1736,4130 @@ static uint16_t queryTrie(
   if (tptr >= 0) {
     j = (int) (key & 0x0f);
     
-    if (tptr + j >= tlen) {
-      raiseErr(__LINE__, "Trie bound error");
+#ifdef UNIKIT_CHECKED
+    if (tptr + j >= tlen) {
+      raiseErr(__LINE__, "Trie bound error");
+    }
+#endif
+    
+    r = pTrie[tptr + j];
+    
+  } else {
+    r = UINT16_C(0xffff);
+  }
+  
+  /* Count the number of levels that were read */
+  STAT_INC(trie_levels[((tptr >= 0) ? depth : (i + 1)) - 1]);
+  
+  /* Return the result */
+  return r;
+}
+
+#endif
+
+/*
+ * Query a two-stage table.
+ * 
+ * pTable is a pointer to the two-stage table, and tlen is its length in
+ * integers (not bytes!), which is used as a safeguard against
+ * out-of-bounds memory access in the UNIKIT_CHECKED build mode.
+ * Otherwise, the table must have been checked with verifyStage() when
+ * it was loaded.  The table must have been compiled with a shift of
+ * STAGE_SHIFT.  See the StageTable module in the db
+ * directory for the format of two-stage tables.
+ * 
+ * key is the key to query.  Only the 16 least significant bits are
+ * used.
+ * 
+ * The return value is either an unsigned 16-bit value in range 0 to
+ * 0xFFFE, or the special value 0xFFFF indicating that no record is
+ * mapped to this key in the table.
+ * 
+ * Parameters:
+ * 
+ *   pTable - the two-stage table
+ * 
+ *   tlen - the length in elements of the two-stage table
+ * 
+ *   key - the key to query
+ * 
+ * Return:
+ * 
+ *   the value mapped to the key, or 0xFFFF if no mapped value
+ */
+static uint16_t queryStage(
+    const uint16_t *pTable,
+          int32_t   tlen,
+          uint32_t  key) {
+  
+  int32_t i = 0;
+  
+  /* Check parameters */
+#ifdef UNIKIT_CHECKED
+  if (pTable == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  if (tlen < STAGE_INDEX_LEN) {
+    raiseErr(__LINE__, NULL);
+  }
+#else
+  (void) tlen;
+#endif
+  
+  /* Get the position of the data block from the index and then the
+   * position of the record within the block */
+  key &= 0xffff;
+  i = ((int32_t) pTable[key >> STAGE_SHIFT]) << STAGE_SHIFT;
+  i += (int32_t) (key & STAGE_MASK);
+  
+#ifdef UNIKIT_CHECKED
+  if (i >= tlen) {
+    raiseErr(__LINE__, "Stage table bound error");
+  }
+#endif
+  
+  STAT_INC(stage_queries);
+  return pTable[i];
+}
+
+/*
+ * Query one of the 16-bit indices of the case folding tables or the
+ * general character tables.
+ * 
+ * This queries the index as a nybble trie of depth 4 by default, or as
+ * a two-stage table in the UNIKIT_STAGE_TABLES build mode.  See
+ * queryTrie() and queryStage() for further information.
+ * 
+ * Parameters:
+ * 
+ *   pTable - the index
+ * 
+ *   tlen - the length in elements of the index
+ * 
+ *   key - the key to query, using only the 16 least significant bits
+ * 
+ * Return:
+ * 
+ *   the value mapped to the key, or 0xFFFF if no mapped value
+ */
+static uint16_t queryIndex(
+    const uint16_t *pTable,
+          int32_t   tlen,
+          uint32_t  key) {
+#ifdef UNIKIT_STAGE_TABLES
+  return queryStage(pTable, tlen, key);
+#else
+  return queryTrie(pTable, tlen, key & 0xffff, 4);
+#endif
+}
+
+/*
+ * Verify that a case folding data key is within the bounds of the case
+ * folding data array.
+ * 
+ * The special value 0xFFFF indicating no value is always accepted.
+ * 
+ * Parameters:
+ * 
+ *   r - the data key
+ * 
+ *   dlen - the length in elements of the data array
+ * 
+ * Return:
+ * 
+ *   NULL if the key is valid, otherwise an error message
+ */
+static const char *verifyDataKey(uint16_t r, int32_t dlen) {
+  if (r != 0xffff) {
+    if (((int32_t) (r >> 2)) + ((int32_t) (r & 0x3)) + 1 > dlen) {
+      return "Data bound error";
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Verify the shape of a two-stage table.
+ * 
+ * Every index element must select a data block that lies past the index
+ * and entirely within the table, so that queryStage() can never read
+ * out of bounds for any key.  If dlen is zero or greater, every value
+ * in the data blocks must also be a case folding data key that is valid
+ * for a data array of that length.
+ * 
+ * Parameters:
+ * 
+ *   pTable - the two-stage table
+ * 
+ *   tlen - the length in elements of the two-stage table
+ * 
+ *   dlen - the length of the case folding data array, or -1
+ * 
+ * Return:
+ * 
+ *   NULL if the table is valid, otherwise an error message
+ */
+static const char *verifyStage(const uint16_t *pTable, int32_t tlen,
+                                int32_t dlen) {
+  
+  const char *pMsg = NULL;
+  int32_t i = 0;
+  int32_t b = 0;
+  
+  if ((pTable == NULL) || (tlen < STAGE_INDEX_LEN)) {
+    return "Invalid stage table";
+  }
+  
+  for(i = 0; i < STAGE_INDEX_LEN; i++) {
+    b = ((int32_t) pTable[i]) << STAGE_SHIFT;
+    if ((b < STAGE_INDEX_LEN) ||
+        (b + ((int32_t) STAGE_MASK) >= tlen)) {
+      return "Stage table bound error";
+    }
+  }
+  
+  if (dlen >= 0) {
+    for(i = STAGE_INDEX_LEN; (pMsg == NULL) && (i < tlen); i++) {
+      pMsg = verifyDataKey(pTable[i], dlen);
+    }
+  }
+  
+  return pMsg;
+}
+
+#ifndef UNIKIT_STAGE_TABLES
+
+/*
+ * Verify the shape of a compiled trie.
+ * 
+ * This walks every table that can be reached from the table at offset
+ * tptr in a trie of the given depth, and checks that every table lies
+ * entirely within the trie, so that queryTrie() can never read out of
+ * bounds for any key.  If dlen is zero or greater, every value in the
+ * leaf tables must also be a case folding data key that is valid for a
+ * data array of that length.
+ * 
+ * To verify a whole trie, pass a tptr of zero.  depth must be in range
+ * 1 to 8.
+ * 
+ * Parameters:
+ * 
+ *   pTrie - the compiled trie
+ * 
+ *   tlen - the length in elements of the compiled trie
+ * 
+ *   tptr - the offset of the table to verify
+ * 
+ *   depth - the depth of the trie below and including this table
+ * 
+ *   dlen - the length of the case folding data array, or -1
+ * 
+ * Return:
+ * 
+ *   NULL if the trie is valid, otherwise an error message
+ */
+static const char *verifyTrie(const uint16_t *pTrie, int32_t tlen,
+                              int32_t tptr, int depth, int32_t dlen) {
+  
+  const char *pMsg = NULL;
+  int j = 0;
+  uint16_t r = 0;
+  
+  if ((depth < 1) || (depth > 8)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pTrie == NULL) || (tptr > tlen - 16)) {
+    return "Trie bound error";
+  }
+  
+  for(j = 0; (pMsg == NULL) && (j < 16); j++) {
+    r = pTrie[tptr + j];
+    if (depth > 1) {
+      if (r != 0xffff) {
+        pMsg = verifyTrie(
+                pTrie, tlen, ((int32_t) r) * 16, depth - 1, dlen);
+      }
+    } else if (dlen >= 0) {
+      pMsg = verifyDataKey(r, dlen);
+    }
+  }
+  
+  return pMsg;
+}
+
+#endif
+
+/*
+ * Verify the shape of one of the 16-bit indices of the case folding
+ * tables or the general character tables.
+ * 
+ * This is the counterpart of queryIndex() that is called once when the
+ * index is loaded.  See verifyStage() and verifyTrie() for further
+ * information.
+ * 
+ * Parameters:
+ * 
+ *   pTable - the index
+ * 
+ *   tlen - the length in elements of the index
+ * 
+ *   dlen - the length of the case folding data array, or -1
+ * 
+ * Return:
+ * 
+ *   NULL if the index is valid, otherwise an error message
+ */
+static const char *verifyIndex(const uint16_t *pTable, int32_t tlen,
+                                int32_t dlen) {
+#ifdef UNIKIT_STAGE_TABLES
+  return verifyStage(pTable, tlen, dlen);
+#else
+  return verifyTrie(pTable, tlen, 0, 4, dlen);
+#endif
+}
+
+/*
+ * Verify the shape of a character class table.
+ * 
+ * The table must begin with an index of CLASS_INDEX_LEN elements,
+ * followed by whole data blocks, and every index element must select
+ * one of the blocks within the table.  See unikit_class_test() for the
+ * format.
+ * 
+ * Parameters:
+ * 
+ *   pTable - the character class table
+ * 
+ *   tlen - the length in elements of the table
+ * 
+ * Return:
+ * 
+ *   NULL if the table is valid, otherwise an error message
+ */
+static const char *verifyClass(const uint16_t *pTable, int32_t tlen) {
+  
+  int32_t i = 0;
+  
+  if ((tlen < CLASS_INDEX_LEN) || ((tlen & CLASS_MASK) != 0)) {
+    return "Invalid character class table";
+  }
+  for(i = 0; i < CLASS_INDEX_LEN; i++) {
+    if (((int32_t) pTable[i]) >= (tlen >> CLASS_SHIFT)) {
+      return "Invalid character class table";
+    }
+  }
+  
+  return NULL;
+}
+
+/*
+ * Verify the shapes of all the tables in a table group.
+ * 
+ * grp is one of the TABLES constants, and the tables of the group must
+ * have just been loaded.  This checks every invariant that the lookup
+ * functions rely on, so that the lookups themselves do not need to
+ * check the tables on every call.
+ * 
+ * Parameters:
+ * 
+ *   grp - the table group to verify
+ * 
+ * Return:
+ * 
+ *   NULL if every table is valid, otherwise an error message for the
+ *   first invalid table
+ */
+static const char *verifyGroup(int grp) {
+  
+  const char *pMsg = NULL;
+  int32_t i = 0;
+  int32_t j = 0;
+  int32_t k = 0;
+  int32_t count = 0;
+  
+  if (grp == TABLES_CASE) {
+    pMsg = verifyIndex(m_case_lower, m_case_lower_len, m_case_data_len);
+    if (pMsg == NULL) {
+      pMsg = verifyIndex(
+              m_case_upper, m_case_upper_len, m_case_data_len);
+    }
+    if (pMsg == NULL) {
+      pMsg = verifyStage(
+              m_case_delta_lower, m_case_delta_lower_len, -1);
+    }
+    if (pMsg == NULL) {
+      pMsg = verifyStage(
+              m_case_delta_upper, m_case_delta_upper_len, -1);
+    }
+    if (pMsg != NULL) {
+      return pMsg;
+    }
+    
+  } else if (grp == TABLES_CORE) {
+    if (m_gcat_core_len != 256) {
+      return "Invalid core table length";
+    }
+    
+  } else if (grp == TABLES_GCAT) {
+#ifdef UNIKIT_UNIFIED_GCAT
+    if (m_gcat_unified_len < UNIFIED_INDEX_LEN) {
+      return "Invalid unified table length";
+    }
+    for(i = 0; i < UNIFIED_INDEX_LEN; i++) {
+      count = ((int32_t) m_gcat_unified[i]) << UNIFIED_SHIFT;
+      if ((count < UNIFIED_INDEX_LEN) ||
+          (count + ((int32_t) UNIFIED_MASK) >= m_gcat_unified_len)) {
+        return "Unified table bound error";
+      }
+    }
+    for(i = UNIFIED_INDEX_LEN; i < m_gcat_unified_len; i++) {
+      if (((m_gcat_unified[i] & 0xff) >= UNIFIED_CAT_COUNT) ||
+          ((m_gcat_unified[i] >> 8) >= UNIFIED_CAT_COUNT)) {
+        return "Invalid unified category index";
+      }
+    }
+#else
+    if (m_gcat_bitmap_len < BITMAP_LEN) {
+      return "Invalid bitmap length";
+    }
+    pMsg = verifyIndex(m_gcat_gen_low, m_gcat_gen_low_len, -1);
+    if (pMsg == NULL) {
+      pMsg = verifyIndex(m_gcat_gen_high, m_gcat_gen_high_len, -1);
+    }
+    if (pMsg != NULL) {
+      return pMsg;
+    }
+#endif
+    
+    if ((m_gcat_astral_len % 4) != 0) {
+      return "Invalid astral table length";
+    }
+    if (m_gcat_astral_dir_len != ASTRAL_DIR_LEN) {
+      return "Invalid astral directory length";
+    }
+    
+    /* Directory entries must never decrease and never pass the end of
+     * the astral records */
+    count = m_gcat_astral_len / 4;
+    for(i = 0; i < ASTRAL_DIR_LEN; i++) {
+      if ((((int32_t) m_gcat_astral_dir[i]) > count) ||
+          ((i > 0) &&
+            (m_gcat_astral_dir[i] < m_gcat_astral_dir[i - 1]))) {
+        return "Invalid astral directory";
+      }
+    }
+    
+  } else if (grp == TABLES_CLASS) {
+    for(i = 0; (pMsg == NULL) && (i < CLASS_COUNT); i++) {
+      pMsg = verifyClass(m_class_std[i].pTable, m_class_std[i].len);
+    }
+    if (pMsg != NULL) {
+      return pMsg;
+    }
+    
+  } else if (grp == TABLES_PROPS) {
+    /* The property table must have a whole index and whole blocks, and
+     * every value must be valid */
+    if ((m_props_len < PROPS_INDEX_LEN) ||
+        ((m_props_len & PROPS_MASK) != 0)) {
+      return "Invalid property table";
+    }
+    for(i = 0; i < PROPS_INDEX_LEN; i++) {
+      if (((int32_t) m_props[i]) >= (m_props_len >> PROPS_SHIFT)) {
+        return "Invalid property table";
+      }
+      k = ((int32_t) m_props[i]) << PROPS_SHIFT;
+      for(j = 0; j <= PROPS_MASK; j++) {
+        if (((m_props[k + j] & PROPS_CAT_MASK) >= UNIFIED_CAT_COUNT) ||
+            ((m_props[k + j] >> PROPS_FLAG_SHIFT) > PROPS_FLAG_MASK)) {
+          return "Invalid property table";
+        }
+      }
+    }
+    
+  } else {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  return NULL;
+}
+
+/*
+ * Look up a codepoint in the case folding delta tables.
+ * 
+ * cv must be a valid codepoint according to unikit_valid(), and the
+ * case folding tables must be loaded.  This function does not check
+ * the module state or its parameters, so it is the caller's
+ * responsibility to do so.
+ * 
+ * The return value is either the delta to add to the 16 least
+ * significant bits of the codepoint to get its single-codepoint case
+ * folding, or FOLD_EXPAND if the full case folding is an expansion.
+ * See the unikit_db.pl script for further information.
+ * 
+ * Parameters:
+ * 
+ *   cv - the codepoint to look up
+ * 
+ * Return:
+ * 
+ *   the folding delta, or FOLD_EXPAND
+ */
+static uint16_t foldDelta(int32_t cv) {
+  if (cv <= 0xffff) {
+    return queryStage(m_case_delta_lower, m_case_delta_lower_len,
+                        (uint32_t) cv);
+    
+  } else if (cv <= 0x1ffff) {
+    return queryStage(m_case_delta_upper, m_case_delta_upper_len,
+                        (uint32_t) (cv & 0xffff));
+  }
+  
+  /* Other planes have no case foldings */
+  return 0;
+}
+
+/*
+ * Look up the case folding of a codepoint in the case folding tables.
+ * 
+ * cv must be a valid codepoint according to unikit_valid().  This
+ * function does not check the module state or its parameters, so it is
+ * the caller's responsibility to do so.
+ * 
+ * pcpa is an array of at least four elements that receives the case
+ * folded codepoint sequence.  For trivial mappings, the first element
+ * is set to cv itself.
+ * 
+ * Parameters:
+ * 
+ *   cv - the codepoint to look up
+ * 
+ *   pcpa - array that receives the case folded codepoints
+ * 
+ * Return:
+ * 
+ *   the number of codepoints written to pcpa, in range 1 to 4
+ */
+static int foldCore(int32_t cv, int32_t *pcpa) {
+  
+  uint16_t r = 0;
+  int32_t plane_base = 0;
+  int sqlen = 0;
+  int32_t base = 0;
+  int i = 0;
+  
+  /* Make sure the case folding tables are loaded */
+  requireTables(TABLES_CASE);
+  
+  /* Single-codepoint foldings, which are nearly all of them, are
+   * answered by the delta tables alone */
+  r = foldDelta(cv);
+  if (r != FOLD_EXPAND) {
+    pcpa[0] = (cv & ~((int32_t) 0xffff)) |
+                ((cv + (int32_t) r) & 0xffff);
+    STAT_INC(fold_len[0]);
+    return 1;
+  }
+  
+  /* Expansion, so query the trie for plane 0 or 1 using the 16 least
+   * significant bits of the codepoint */
+  if (cv <= 0xffff) {
+    r = queryIndex(m_case_lower, m_case_lower_len, (uint32_t) cv);
+    plane_base = 0;
+    
+  } else if (cv <= 0x1ffff) {
+    r = queryIndex(m_case_upper, m_case_upper_len,
+                    (uint32_t) (cv & 0xffff));
+    plane_base = 0x10000;
+    
+  } else {
+    r = 0xffff;
+  }
+  
+  /* Handle trivial mapping */
+  if (r == 0xffff) {
+    pcpa[0] = cv;
+    STAT_INC(fold_len[0]);
+    return 1;
+  }
+  
+  /* Extract fields from the data key */
+  sqlen = ((int) (r & 0x3)) + 1;
+  base = (int32_t) (r >> 2);
+  STAT_INC(fold_len[sqlen - 1]);
+  
+  /* Check that range is within data array bounds */
+#ifdef UNIKIT_CHECKED
+  if (base > m_case_data_len - ((int32_t) sqlen)) {
+    raiseErr(__LINE__, "Data bound error");
+  }
+#endif
+  
+  /* Copy the codepoint array, adding the base of the plane */
+  for(i = 0; i < sqlen; i++) {
+    pcpa[i] = ((int32_t) m_case_data[base + i]) + plane_base;
+  }
+  
+  return sqlen;
+}
+
+/*
+ * Decode a single UTF-8 sequence.
+ * 
+ * pSrc points to the start of the sequence and n is the number of bytes
+ * available, which must be at least one.
+ * 
+ * If the bytes at the start of pSrc are a well-formed UTF-8 sequence,
+ * the decoded codepoint is returned and pAdv receives the length of the
+ * sequence in bytes.  Overlong encodings, encoded surrogates, values
+ * above U+10FFFF, and truncated sequences are not well-formed.
+ * 
+ * If the sequence is not well-formed, a negative value is returned and
+ * pAdv receives the length of the maximal subpart of the ill-formed
+ * sequence, which is always at least one.  This matches the recommended
+ * practice of the Unicode Standard for replacing ill-formed sequences
+ * with U+FFFD.  The negative value is DECODE_TRUNCATED if the sequence
+ * is only ill-formed because the available bytes end before it is
+ * complete, in which case pAdv receives n, or -1 otherwise.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-8 bytes to decode
+ * 
+ *   n - the number of available bytes
+ * 
+ *   pAdv - variable to receive the number of bytes consumed
+ * 
+ * Return:
+ * 
+ *   the decoded codepoint, or a negative value if the sequence is
+ *   ill-formed
+ */
+static int32_t decodeUtf8(const uint8_t *pSrc, size_t n, size_t *pAdv) {
+  
+  int32_t cv = 0;
+  int c = 0;
+  int need = 0;
+  int lo = 0x80;
+  int hi = 0xbf;
+  int i = 0;
+  
+  /* Examine the lead byte */
+  c = (int) pSrc[0];
+  if (c < 0x80) {
+    *pAdv = 1;
+    return (int32_t) c;
+    
+  } else if (c < 0xc2) {
+    /* Continuation byte or overlong two-byte lead */
+    *pAdv = 1;
+    return -1;
+    
+  } else if (c < 0xe0) {
+    need = 1;
+    cv = (int32_t) (c & 0x1f);
+    
+  } else if (c < 0xf0) {
+    need = 2;
+    cv = (int32_t) (c & 0x0f);
+    if (c == 0xe0) {
+      lo = 0xa0;
+    } else if (c == 0xed) {
+      hi = 0x9f;
+    }
+    
+  } else if (c < 0xf5) {
+    need = 3;
+    cv = (int32_t) (c & 0x07);
+    if (c == 0xf0) {
+      lo = 0x90;
+    } else if (c == 0xf4) {
+      hi = 0x8f;
+    }
+    
+  } else {
+    *pAdv = 1;
+    return -1;
+  }
+  
+  /* Decode the continuation bytes; only the first continuation byte has
+   * the restricted range selected above */
+  for(i = 1; i <= need; i++) {
+    if ((size_t) i >= n) {
+      *pAdv = (size_t) i;
+      return DECODE_TRUNCATED;
+    }
+    
+    c = (int) pSrc[i];
+    if ((c < lo) || (c > hi)) {
+      *pAdv = (size_t) i;
+      return -1;
+    }
+    lo = 0x80;
+    hi = 0xbf;
+    
+    cv = (cv << 6) | ((int32_t) (c & 0x3f));
+  }
+  
+  *pAdv = (size_t) (need + 1);
+  return cv;
+}
+
+/*
+ * Decode a single UTF-16 sequence.
+ * 
+ * pSrc points to the start of the sequence and n is the number of bytes
+ * available, which must be at least one.  big is non-zero for big
+ * endian byte order or zero for little endian.
+ * 
+ * The return value and pAdv have the same meaning as for decodeUtf8().
+ * A one-unit sequence is two bytes and a surrogate pair is four bytes.
+ * An unpaired surrogate is ill-formed and has a maximal subpart of one
+ * unit.  A trailing single byte, or a high surrogate at the end of the
+ * available bytes, is DECODE_TRUNCATED.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-16 bytes to decode
+ * 
+ *   n - the number of available bytes
+ * 
+ *   big - non-zero for big endian, zero for little endian
+ * 
+ *   pAdv - variable to receive the number of bytes consumed
+ * 
+ * Return:
+ * 
+ *   the decoded codepoint, or a negative value if the sequence is
+ *   ill-formed
+ */
+static int32_t decodeUtf16(
+    const uint8_t *pSrc,
+          size_t   n,
+          int      big,
+          size_t  *pAdv) {
+  
+  int32_t u = 0;
+  int32_t u2 = 0;
+  
+  /* Get the first unit */
+  if (n < 2) {
+    *pAdv = n;
+    return DECODE_TRUNCATED;
+  }
+  if (big) {
+    u = (((int32_t) pSrc[0]) << 8) | ((int32_t) pSrc[1]);
+  } else {
+    u = (((int32_t) pSrc[1]) << 8) | ((int32_t) pSrc[0]);
+  }
+  
+  /* Handle units that are not surrogates and unpaired low surrogates */
+  if ((u < 0xd800) || (u > 0xdfff)) {
+    *pAdv = 2;
+    return u;
+    
+  } else if (u >= 0xdc00) {
+    *pAdv = 2;
+    return -1;
+  }
+  
+  /* High surrogate, so get the second unit */
+  if (n < 4) {
+    *pAdv = n;
+    return DECODE_TRUNCATED;
+  }
+  if (big) {
+    u2 = (((int32_t) pSrc[2]) << 8) | ((int32_t) pSrc[3]);
+  } else {
+    u2 = (((int32_t) pSrc[3]) << 8) | ((int32_t) pSrc[2]);
+  }
+  
+  if ((u2 < 0xdc00) || (u2 > 0xdfff)) {
+    *pAdv = 2;
+    return -1;
+  }
+  
+  *pAdv = 4;
+  return (((u - 0xd800) << 10) | (u2 - 0xdc00)) + 0x10000;
+}
+
+/*
+ * Encode a codepoint in UTF-8.
+ * 
+ * cv must be a valid codepoint according to unikit_valid().  pBuf must
+ * have room for at least four bytes.
+ * 
+ * Parameters:
+ * 
+ *   cv - the codepoint to encode
+ * 
+ *   pBuf - the buffer to receive the encoded bytes
+ * 
+ * Return:
+ * 
+ *   the number of bytes written, in range 1 to 4
+ */
+static int encodeUtf8(int32_t cv, uint8_t *pBuf) {
+  
+  int result = 0;
+  
+  if (cv < 0x80) {
+    pBuf[0] = (uint8_t) cv;
+    result = 1;
+    
+  } else if (cv < 0x800) {
+    pBuf[0] = (uint8_t) (0xc0 | (cv >> 6));
+    pBuf[1] = (uint8_t) (0x80 | (cv & 0x3f));
+    result = 2;
+    
+  } else if (cv < 0x10000) {
+    pBuf[0] = (uint8_t) (0xe0 | (cv >> 12));
+    pBuf[1] = (uint8_t) (0x80 | ((cv >> 6) & 0x3f));
+    pBuf[2] = (uint8_t) (0x80 | (cv & 0x3f));
+    result = 3;
+    
+  } else {
+    pBuf[0] = (uint8_t) (0xf0 | (cv >> 18));
+    pBuf[1] = (uint8_t) (0x80 | ((cv >> 12) & 0x3f));
+    pBuf[2] = (uint8_t) (0x80 | ((cv >> 6) & 0x3f));
+    pBuf[3] = (uint8_t) (0x80 | (cv & 0x3f));
+    result = 4;
+  }
+  
+  return result;
+}
+
+/*
+ * Case fold eight ASCII bytes packed into a 64-bit word.
+ * 
+ * Every byte of w must be in range 0x00 to 0x7F.  The only ASCII
+ * characters with non-trivial case foldings are A-Z, which fold to a-z,
+ * so this sets the 0x20 bit in every byte that is in range 0x41 to
+ * 0x5A.  Since no byte has its high bit set, the additions below can
+ * never carry from one byte into the next.
+ * 
+ * Parameters:
+ * 
+ *   w - the packed ASCII bytes
+ * 
+ * Return:
+ * 
+ *   the packed case folded bytes
+ */
+static uint64_t foldAscii8(uint64_t w) {
+  
+  uint64_t ge_a = 0;
+  uint64_t gt_z = 0;
+  
+  /* High bit of each byte set if byte >= 'A' and if byte > 'Z' */
+  ge_a = w + UINT64_C(0x3f3f3f3f3f3f3f3f);
+  gt_z = w + UINT64_C(0x2525252525252525);
+  
+  /* Bytes in range A-Z have exactly the first of these set; shift that
+   * high bit down to the 0x20 position */
+  return w | (((ge_a ^ gt_z) & UINT64_C(0x8080808080808080)) >> 2);
+}
+
+/*
+ * Encode a codepoint in UTF-16 code units of the native byte order.
+ * 
+ * cv must be a valid codepoint according to unikit_valid().  pBuf must
+ * have room for at least two units.
+ * 
+ * Parameters:
+ * 
+ *   cv - the codepoint to encode
+ * 
+ *   pBuf - the buffer to receive the encoded units
+ * 
+ * Return:
+ * 
+ *   the number of units written, either 1 or 2
+ */
+static int encodeUtf16(int32_t cv, uint16_t *pBuf) {
+  
+  if (cv < 0x10000) {
+    pBuf[0] = (uint16_t) cv;
+    return 1;
+  }
+  
+  cv -= 0x10000;
+  pBuf[0] = (uint16_t) (0xd800 + (cv >> 10));
+  pBuf[1] = (uint16_t) (0xdc00 + (cv & 0x3ff));
+  return 2;
+}
+
+/*
+ * Decode a UTF-16 sequence of native code units that begins with a
+ * surrogate.
+ * 
+ * pSrc points to the surrogate and n is the number of units available,
+ * which must be at least one.  If it is a high surrogate followed by a
+ * low surrogate, the supplementary codepoint is returned and pAdv
+ * receives two.  Otherwise, the surrogate is unpaired, so -1 is
+ * returned and pAdv receives one, which is the maximal subpart.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-16 units to decode
+ * 
+ *   n - the number of available units
+ * 
+ *   pAdv - variable to receive the number of units consumed
+ * 
+ * Return:
+ * 
+ *   the decoded codepoint, or -1 if the surrogate is unpaired
+ */
+static int32_t decodePair(
+    const uint16_t *pSrc,
+          size_t    n,
+          size_t   *pAdv) {
+  
+  *pAdv = 1;
+  if ((pSrc[0] < 0xd800) || (pSrc[0] > 0xdbff) || (n < 2) ||
+      (pSrc[1] < 0xdc00) || (pSrc[1] > 0xdfff)) {
+    return -1;
+  }
+  
+  *pAdv = 2;
+  return ((((int32_t) pSrc[0] - 0xd800) << 10) |
+            ((int32_t) pSrc[1] - 0xdc00)) + 0x10000;
+}
+
+/*
+ * Count the UTF-16 code units at the start of a buffer that are not
+ * surrogates.
+ * 
+ * Each of these units is a codepoint of its own.  The units are
+ * scanned four at a time as the lanes of a 64-bit word.  Masking each
+ * lane to its five most significant bits and comparing with the
+ * surrogate prefix leaves a lane of zero exactly for a surrogate, which
+ * the usual zero lane test then detects.  A borrow can only come out of
+ * a lane that is zero, so the test has no false positives.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-16 units
+ * 
+ *   n - the number of units
+ * 
+ * Return:
+ * 
+ *   the number of units before the first surrogate, or n if there is
+ *   none
+ */
+static size_t spanUtf16(const uint16_t *pSrc, size_t n) {
+  
+  size_t i = 0;
+  uint64_t w = 0;
+  
+  while (n - i >= 4) {
+    memcpy(&w, pSrc + i, 8);
+    w = (w & UINT64_C(0xf800f800f800f800)) ^
+          UINT64_C(0xd800d800d800d800);
+    if (((w - UINT64_C(0x0001000100010001)) & ~w &
+          UINT64_C(0x8000800080008000)) != 0) {
+      break;
+    }
+    i += 4;
+  }
+  
+  while ((i < n) && ((pSrc[i] & 0xf800) != 0xd800)) {
+    i++;
+  }
+  
+  return i;
+}
+
+/*
+ * Case fold four ASCII UTF-16 code units packed into a 64-bit word.
+ * 
+ * Every unit of w must be in range 0x00 to 0x7F.  This is the same as
+ * foldAscii8(), except that the lanes are 16 bits wide.
+ * 
+ * Parameters:
+ * 
+ *   w - the packed ASCII units
+ * 
+ * Return:
+ * 
+ *   the packed case folded units
+ */
+static uint64_t foldAscii4(uint64_t w) {
+  
+  uint64_t ge_a = 0;
+  uint64_t gt_z = 0;
+  
+  /* Bit 7 of each unit set if unit >= 'A' and if unit > 'Z' */
+  ge_a = w + UINT64_C(0x003f003f003f003f);
+  gt_z = w + UINT64_C(0x0025002500250025);
+  
+  /* Units in range A-Z have exactly the first of these set; shift that
+   * bit down to the 0x20 position */
+  return w | (((ge_a ^ gt_z) & UINT64_C(0x0080008000800080)) >> 2);
+}
+
+#ifdef UNIKIT_UNIFIED_GCAT
+
+/*
+ * Query the unified category table for a codepoint.
+ * 
+ * The unified category table is a two-stage table with a shift of
+ * UNIFIED_SHIFT, where each element holds the category indices of two
+ * adjacent codepoints.  The even codepoint is in the 8 least
+ * significant bits, the odd codepoint is in the 8 most significant
+ * bits, and the key is the codepoint shifted right by one.  See the
+ * unikit_db.pl script for further information.
+ * 
+ * cv must be in range 0x0000 to 0x1FFFF.  This function does not check
+ * the module state, so it is the caller's responsibility to do so.
+ * 
+ * Parameters:
+ * 
+ *   cv - the integer codepoint value
+ * 
+ * Return:
+ * 
+ *   the Unicode General Category ASCII letters encoded in a 16-bit
+ *   integer
+ */
+static uint16_t queryUnified(int32_t cv) {
+  
+  uint32_t key = 0;
+  int32_t i = 0;
+  int ci = 0;
+  
+  /* Check parameters and table */
+#ifdef UNIKIT_CHECKED
+  if ((cv < 0) || (cv > 0x1ffff)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if (m_gcat_unified_len < UNIFIED_INDEX_LEN) {
+    raiseErr(__LINE__, "Invalid unified table length");
+  }
+#endif
+  
+  /* Get the element holding this codepoint */
+  key = ((uint32_t) cv) >> 1;
+  i = ((int32_t) m_gcat_unified[key >> UNIFIED_SHIFT]) << UNIFIED_SHIFT;
+  i += (int32_t) (key & UNIFIED_MASK);
+  
+#ifdef UNIKIT_CHECKED
+  if (i >= m_gcat_unified_len) {
+    raiseErr(__LINE__, "Unified table bound error");
+  }
+#endif
+  
+  /* Select the category index of this codepoint within the element */
+  if (cv & 0x1) {
+    ci = (int) (m_gcat_unified[i] >> 8);
+  } else {
+    ci = (int) (m_gcat_unified[i] & 0xff);
+  }
+  
+#ifdef UNIKIT_CHECKED
+  if (ci >= UNIFIED_CAT_COUNT) {
+    raiseErr(__LINE__, "Invalid unified category index");
+  }
+#endif
+  
+  return m_unified_cats[ci];
+}
+
+#endif
+
+/*
+ * Look up the general category of any integer value.
+ * 
+ * This is the implementation of unikit_category(), except that it does
+ * not check the module state, so it is the caller's responsibility to
+ * do so.
+ * 
+ * Parameters:
+ * 
+ *   cv - the integer codepoint value
+ * 
+ * Return:
+ * 
+ *   the Unicode General Category ASCII letters encoded in a 16-bit
+ *   integer
+ */
+static uint16_t categoryCore(int32_t cv) {
+  
+  uint16_t result = 0;
+  int32_t lbound = 0;
+  int32_t ubound = 0;
+  int32_t bucket = 0;
+#ifdef UNIKIT_INSTRUMENT
+  int32_t first = 0;
+#endif
+  
+  int plane = 0;
+  int32_t offs = 0;
+  uint16_t r_plane = 0;
+  uint16_t r_lower = 0;
+  uint16_t r_upper = 0;
+  
+  /* Default result if we don't find anything is Cn */
+  result = UNIKIT_GCAT_Cn;
+  
+  /* Handling depends on range */
+  if ((cv >= 0) && (cv <= 0xff)) {
+    /* In core range, so use the core lookup */
+    requireTables(TABLES_CORE);
+#ifdef UNIKIT_CHECKED
+    if (m_gcat_core_len != 256) {
+      raiseErr(__LINE__, "Invalid core table length");
+    }
+#endif
+    result = m_gcat_core[cv];
+    STAT_INC(cat_core);
+    
+  } else if ((cv >= 0x100) && (cv <= 0x1ffff)) {
+    requireTables(TABLES_GCAT);
+#ifdef UNIKIT_UNIFIED_GCAT
+    /* In general range, so use the unified category table */
+    result = queryUnified(cv);
+    STAT_INC(cat_unified);
+#else
+    /* In general range, so first we want to compute the offset and
+     * shift value for this codepoint within the character bitmap */
+    offs  = cv - 0x100;
+    plane = (int) ((offs % 8) * 2);
+    offs  = offs / 8;
+    
+    /* Get the bitmap value for this codepoint */
+#ifdef UNIKIT_CHECKED
+    if (offs >= m_gcat_bitmap_len) {
+      raiseErr(__LINE__, "Bitmap query out of range");
+    }
+#endif
+    result = (uint16_t) ((m_gcat_bitmap[offs] >> plane) & 0x3);
+    
+    /* Decode the bitmap value */
+    if (result == 1) {
+      result = UNIKIT_GCAT_Lo;
+      STAT_INC(cat_bitmap);
+      
+    } else if (result == 2) {
+      result = UNIKIT_GCAT_Ll;
+      STAT_INC(cat_bitmap);
+      
+    } else if (result == 3) {
+      result = UNIKIT_GCAT_So;
+      STAT_INC(cat_bitmap);
+      
+    } else {
+      /* Bitmap didn't answer our question, so our next attempt is to
+       * query the general character table tries */
+      if (cv <= 0xffff) {
+        result = queryIndex(m_gcat_gen_low, m_gcat_gen_low_len,
+                    (uint32_t) cv);
+      } else {
+        result = queryIndex(m_gcat_gen_high, m_gcat_gen_high_len,
+                    (uint32_t) (cv & 0xffff));
+      }
+      
+      /* If general character table didn't get a result, our last
+       * attempt is to use the hardcoded remainder table */
+      if (result == 0xffff) {
+        /* Reset result to Cn in case hardcoded tables don't work */
+        result = UNIKIT_GCAT_Cn;
+        STAT_INC(cat_remainder);
+        
+        /* Check hardcoded tables (derived from the "remainder"
+         * invocation  of the unikit_db.pl script) */
+        if ((cv >= 0xd800) && (cv <= 0xdfff)) {
+          result = UNIKIT_GCAT_Cs;
+        
+        } else if ((cv >= 0xe000) && (cv <= 0xf8ff)) {
+          result = UNIKIT_GCAT_Co;
+        }
+        
+      } else {
+        STAT_INC(cat_gen);
+      }
+    }
+#endif
+    
+  } else if ((cv >= 0x20000) && (cv <= 0x10ffff)) {
+    /* Astral range, so use the astral table */
+    requireTables(TABLES_GCAT);
+#ifdef UNIKIT_CHECKED
+    if ((m_gcat_astral_len % 4) != 0) {
+      raiseErr(__LINE__, "Invalid astral table length");
+    }
+    if (m_gcat_astral_dir_len != ASTRAL_DIR_LEN) {
+      raiseErr(__LINE__, "Invalid astral directory length");
+    }
+#endif
+    
+    /* Determine plane and offset of codepoint */
+    plane = (int) (cv >> 16);
+    offs = (cv & 0xffff);
+    
+    /* Get the directory position of the bucket holding the codepoint */
+    bucket = ((int32_t) (plane - 2) << (16 - ASTRAL_BUCKET_SHIFT))
+                + (offs >> ASTRAL_BUCKET_SHIFT);
+    
+    /* Scan starts at the first record that could contain the codepoint,
+     * and the entry of the next bucket is an upper bound on the record
+     * that contains it */
+    lbound = m_gcat_astral_dir[bucket];
+    ubound = m_gcat_astral_dir[bucket + 1];
+#ifdef UNIKIT_CHECKED
+    if ((lbound > ubound) || (ubound > (m_gcat_astral_len / 4))) {
+      raiseErr(__LINE__, "Invalid astral directory");
+    }
+#endif
+    if (ubound >= (m_gcat_astral_len / 4)) {
+      ubound = (m_gcat_astral_len / 4) - 1;
+    }
+#ifdef UNIKIT_INSTRUMENT
+    first = lbound;
+#endif
+    
+    /* Scan the records until we pass the codepoint; if a record covers
+     * the codepoint, then query result is the category in the record;
+     * else, leave query result at Cn */
+    for( ; lbound <= ubound; lbound++) {
+      r_plane = m_gcat_astral[(lbound * 4)    ];
+      r_lower = m_gcat_astral[(lbound * 4) + 1];
+      r_upper = m_gcat_astral[(lbound * 4) + 2];
+      
+      if ((r_plane != plane) || (r_lower > offs)) {
+        break;
+      }
+      if (offs <= r_upper) {
+        result = m_gcat_astral[(lbound * 4) + 3];
+        break;
+      }
+    }
+    
+#ifdef UNIKIT_INSTRUMENT
+    STAT_INC(cat_astral);
+    if (lbound - first < UNIKIT_STATS_SCAN_LEN - 1) {
+      STAT_INC(astral_scan[lbound - first]);
+    } else {
+      STAT_INC(astral_scan[UNIKIT_STATS_SCAN_LEN - 1]);
+    }
+#endif
+    
+  } else {
+    STAT_INC(cat_invalid);
+  }
+  
+  /* Return result */
+  return result;
+}
+
+/*
+ * Look up the combined property record of any integer value.
+ * 
+ * This is the implementation of unikit_props(), except that it does not
+ * check the module state, so it is the caller's responsibility to do
+ * so.
+ * 
+ * Codepoints outside the keys of the property table have none of the
+ * flags, so only their category is looked up.
+ * 
+ * Parameters:
+ * 
+ *   cv - the integer codepoint value
+ * 
+ * Return:
+ * 
+ *   the combined property record
+ */
+static uint32_t propsCore(int32_t cv) {
+  
+  int32_t key = 0;
+  int32_t i = 0;
+  uint16_t v = 0;
+  
+  /* Fold the codepoint into a key */
+  if ((cv >= 0) && (cv <= 0x3ffff)) {
+    key = cv;
+  } else if ((cv >= 0xe0000) && (cv <= 0xe0fff)) {
+    key = cv - 0xa0000;
+  } else {
+    return (uint32_t) categoryCore(cv);
+  }
+  
+  /* Query the two-stage table */
+  requireTables(TABLES_PROPS);
+  i = ((int32_t) m_props[key >> PROPS_SHIFT]) << PROPS_SHIFT;
+  i += key & PROPS_MASK;
+  
+#ifdef UNIKIT_CHECKED
+  if (i >= m_props_len) {
+    raiseErr(__LINE__, "Property table bound error");
+  }
+#endif
+  
+  v = m_props[i];
+  STAT_INC(stage_queries);
+  
+  return ((uint32_t) m_unified_cats[v & PROPS_CAT_MASK]) |
+          (((uint32_t) (v >> PROPS_FLAG_SHIFT)) << 16);
+}
+
+/*
+ * Deliver the pending run of a walk to the client callback.
+ * 
+ * If there is no pending run, or the walk has been stopped, this
+ * function does nothing.
+ * 
+ * Parameters:
+ * 
+ *   pw - the walk state
+ */
+static void runFlush(RUN_WALK *pw) {
+  if (pw->have && (!(pw->stop))) {
+    if (!((pw->fpRun)(pw->pCustom, pw->lo, pw->hi, pw->gcat))) {
+      pw->stop = 1;
+    }
+  }
+  pw->have = 0;
+}
+
+/*
+ * Add a range of codepoints with the same general category to a walk.
+ * 
+ * Ranges must be added in ascending order without gaps.  A range that
+ * has the same category as the pending run is merged into it, so that
+ * the client only sees maximal runs.
+ * 
+ * Parameters:
+ * 
+ *   pw - the walk state
+ * 
+ *   lo - the first codepoint of the range
+ * 
+ *   hi - the last codepoint of the range
+ * 
+ *   gcat - the general category of the range
+ */
+static void runEmit(RUN_WALK *pw, int32_t lo, int32_t hi,
+                      uint16_t gcat) {
+  if (pw->have && (pw->gcat == gcat) && (pw->hi + 1 == lo)) {
+    pw->hi = hi;
+  } else {
+    runFlush(pw);
+    pw->lo = lo;
+    pw->hi = hi;
+    pw->gcat = gcat;
+    pw->have = 1;
+  }
+}
+
+#ifndef UNIKIT_UNIFIED_GCAT
+
+/*
+ * Add a range of codepoints that neither the character bitmap nor the
+ * general character tables answer to a walk.
+ * 
+ * The range is split according to the hardcoded remainder table of
+ * categoryCore().
+ * 
+ * Parameters:
+ * 
+ *   pw - the walk state
+ * 
+ *   lo - the first codepoint of the range
+ * 
+ *   hi - the last codepoint of the range
+ */
+static void runRemainder(RUN_WALK *pw, int32_t lo, int32_t hi) {
+  
+  int32_t next = 0;
+  
+  while (lo <= hi) {
+    if (lo < 0xd800) {
+      next = 0xd800;
+      runEmit(pw, lo, (hi < next) ? hi : next - 1, UNIKIT_GCAT_Cn);
+      
+    } else if (lo <= 0xdfff) {
+      next = 0xe000;
+      runEmit(pw, lo, (hi < next) ? hi : next - 1, UNIKIT_GCAT_Cs);
+      
+    } else if (lo <= 0xf8ff) {
+      next = 0xf900;
+      runEmit(pw, lo, (hi < next) ? hi : next - 1, UNIKIT_GCAT_Co);
+      
+    } else {
+      next = hi + 1;
+      runEmit(pw, lo, hi, UNIKIT_GCAT_Cn);
+    }
+    lo = next;
+  }
+}
+
+/*
+ * Add a range of codepoints in range U+0100 to U+1FFFF that all have
+ * the same value in the general character tables to a walk.
+ * 
+ * v is the value of the range in the general character tables, or
+ * 0xFFFF if the tables have no value for it.  The character bitmap is
+ * overlaid on the range, one bitmap element at a time, and runs of
+ * uniform bitmap elements are added as a single range.
+ * 
+ * Parameters:
+ * 
+ *   pw - the walk state
+ * 
+ *   lo - the first codepoint of the range
+ * 
+ *   hi - the last codepoint of the range
+ * 
+ *   v - the general character table value of the range
+ */
+static void runGeneral(RUN_WALK *pw, int32_t lo, int32_t hi,
+                        uint16_t v) {
+  
+  int32_t cv = 0;
+  int32_t offs = 0;
+  int32_t len = 0;
+  uint16_t w = 0;
+  int b = 0;
+  
+  cv = lo;
+  while ((cv <= hi) && (!(pw->stop))) {
+    /* Get the bitmap element and the value of this codepoint */
+    offs = cv - 0x100;
+    w = m_gcat_bitmap[offs / 8];
+    b = (int) ((w >> ((offs % 8) * 2)) & 0x3);
+    
+    /* If the element is uniform and starts at this codepoint, take as
+     * many whole elements with the same value as fit in the range;
+     * otherwise, take just this codepoint */
+    len = 1;
+    if (((offs % 8) == 0) && ((w == 0x0000) || (w == 0x5555) ||
+          (w == 0xaaaa) || (w == 0xffff))) {
+      len = 0;
+      while ((hi - (cv + len) >= 7) &&
+              (m_gcat_bitmap[(offs + len) / 8] == w)) {
+        len += 8;
+      }
+      if (len < 1) {
+        len = 1;
+      }
+    }
+    
+    /* Add the range, resolving it the same way as categoryCore() */
+    if (b == 1) {
+      runEmit(pw, cv, cv + len - 1, UNIKIT_GCAT_Lo);
+      
+    } else if (b == 2) {
+      runEmit(pw, cv, cv + len - 1, UNIKIT_GCAT_Ll);
+      
+    } else if (b == 3) {
+      runEmit(pw, cv, cv + len - 1, UNIKIT_GCAT_So);
+      
+    } else if (v != 0xffff) {
+      runEmit(pw, cv, cv + len - 1, v);
+      
+    } else {
+      runRemainder(pw, cv, cv + len - 1);
+    }
+    
+    cv += len;
+  }
+}
+
+/*
+ * Resolve the pending run of general character table values of a walk.
+ * 
+ * Parameters:
+ * 
+ *   pw - the walk state
+ */
+static void runIndexFlush(RUN_WALK *pw) {
+  if (pw->ihave) {
+    runGeneral(pw, pw->ilo, pw->ihi, pw->ival);
+  }
+  pw->ihave = 0;
+}
+
+/*
+ * Add a range of codepoints that all have the same value in the general
+ * character tables to a walk.
+ * 
+ * Ranges must be added in ascending order without gaps.  Consecutive
+ * ranges with the same value are merged before the character bitmap is
+ * overlaid on them.  Codepoints below U+0100 belong to the core table,
+ * so they are ignored.
+ * 
+ * Parameters:
+ * 
+ *   pw - the walk state
+ * 
+ *   lo - the first codepoint of the range
+ * 
+ *   hi - the last codepoint of the range
+ * 
+ *   v - the general character table value of the range
+ */
+static void runIndex(RUN_WALK *pw, int32_t lo, int32_t hi, uint16_t v) {
+  if (hi < 0x100) {
+    return;
+  }
+  if (lo < 0x100) {
+    lo = 0x100;
+  }
+  
+  if (pw->ihave && (pw->ival == v) && (pw->ihi + 1 == lo)) {
+    pw->ihi = hi;
+  } else {
+    runIndexFlush(pw);
+    pw->ilo = lo;
+    pw->ihi = hi;
+    pw->ival = v;
+    pw->ihave = 1;
+  }
+}
+
+#ifndef UNIKIT_STAGE_TABLES
+
+/*
+ * Walk one table of a nybble trie of the general character tables.
+ * 
+ * tptr is the offset of the table within the trie and depth is the
+ * number of trie levels at and below this table.  base is the first
+ * codepoint covered by the table.  Missing records cover whole ranges
+ * without descending into them.
+ * 
+ * Parameters:
+ * 
+ *   pw - the walk state
+ * 
+ *   pTrie - the trie
+ * 
+ *   tptr - the offset of the table within the trie
+ * 
+ *   depth - the number of levels at and below the table
+ * 
+ *   base - the first codepoint covered by the table
+ */
+static void runTrie(RUN_WALK *pw, const uint16_t *pTrie, int32_t tptr,
+                      int depth, int32_t base) {
+  
+  int32_t span = 0;
+  int32_t lo = 0;
+  uint16_t r = 0;
+  int j = 0;
+  
+  span = ((int32_t) 1) << ((depth - 1) * 4);
+  for(j = 0; (j < 16) && (!(pw->stop)); j++) {
+    r = pTrie[tptr + j];
+    lo = base + (((int32_t) j) * span);
+    
+    if (depth <= 1) {
+      runIndex(pw, lo, lo, r);
+      
+    } else if (r == 0xffff) {
+      runIndex(pw, lo, lo + span - 1, r);
+      
+    } else {
+      runTrie(pw, pTrie, ((int32_t) r) * 16, depth - 1, lo);
+    }
+  }
+}
+
+#endif
+
+/*
+ * Walk one plane of the general character tables.
+ * 
+ * pTable is the index of the plane, which is a nybble trie by default
+ * or a two-stage table in the UNIKIT_STAGE_TABLES build mode.  base is
+ * the first codepoint of the plane.
+ * 
+ * Parameters:
+ * 
+ *   pw - the walk state
+ * 
+ *   pTable - the index of the plane
+ * 
+ *   base - the first codepoint of the plane
+ */
+static void walkIndex(RUN_WALK *pw, const uint16_t *pTable,
+                        int32_t base) {
+#ifdef UNIKIT_STAGE_TABLES
+  const uint16_t *pBlock = NULL;
+  int32_t i = 0;
+  int32_t j = 0;
+  
+  for(i = 0; (i < STAGE_INDEX_LEN) && (!(pw->stop)); i++) {
+    pBlock = pTable + (((int32_t) pTable[i]) << STAGE_SHIFT);
+    for(j = 0; j <= (int32_t) STAGE_MASK; j++) {
+      runIndex(pw, base + (i << STAGE_SHIFT) + j,
+                base + (i << STAGE_SHIFT) + j, pBlock[j]);
+    }
+  }
+#else
+  runTrie(pw, pTable, 0, 4, base);
+#endif
+}
+
+#else
+
+/*
+ * Walk the unified category table over U+0100 to U+1FFFF.
+ * 
+ * Parameters:
+ * 
+ *   pw - the walk state
+ */
+static void walkUnified(RUN_WALK *pw) {
+  
+  const uint16_t *pBlock = NULL;
+  int32_t i = 0;
+  int32_t j = 0;
+  int32_t cv = 0;
+  
+  for(i = 0; (i < UNIFIED_INDEX_LEN) && (!(pw->stop)); i++) {
+    pBlock = m_gcat_unified +
+              (((int32_t) m_gcat_unified[i]) << UNIFIED_SHIFT);
+    for(j = 0; j <= (int32_t) UNIFIED_MASK; j++) {
+      cv = ((i << UNIFIED_SHIFT) + j) * 2;
+      if (cv >= 0x100) {
+        runEmit(pw, cv, cv, m_unified_cats[pBlock[j] & 0xff]);
+        runEmit(pw, cv + 1, cv + 1, m_unified_cats[pBlock[j] >> 8]);
+      }
+    }
+  }
+}
+
+#endif
+
+/*
+ * Walk the astral table over U+20000 to U+10FFFF.
+ * 
+ * The records of the astral table are ranges in ascending order, and
+ * the gaps between them are Cn.
+ * 
+ * Parameters:
+ * 
+ *   pw - the walk state
+ */
+static void walkAstral(RUN_WALK *pw) {
+  
+  int32_t next = 0;
+  int32_t lo = 0;
+  int32_t hi = 0;
+  int32_t i = 0;
+  
+  next = 0x20000;
+  for(i = 0; (i < m_gcat_astral_len / 4) && (!(pw->stop)); i++) {
+    lo = (((int32_t) m_gcat_astral[i * 4]) << 16) |
+            ((int32_t) m_gcat_astral[(i * 4) + 1]);
+    hi = (((int32_t) m_gcat_astral[i * 4]) << 16) |
+            ((int32_t) m_gcat_astral[(i * 4) + 2]);
+    
+    if (lo > next) {
+      runEmit(pw, next, lo - 1, UNIKIT_GCAT_Cn);
+    }
+    runEmit(pw, lo, hi, m_gcat_astral[(i * 4) + 3]);
+    next = hi + 1;
+  }
+  
+  if (next <= 0x10ffff) {
+    runEmit(pw, next, 0x10ffff, UNIKIT_GCAT_Cn);
+  }
+}
+
+/*
+ * Check whether a category code is valid for unikit_class_compile().
+ * 
+ * A valid code has an uppercase ASCII letter in the high byte and
+ * either zero or a lowercase ASCII letter in the low byte.
+ * 
+ * Parameters:
+ * 
+ *   code - the category code to check
+ * 
+ * Return:
+ * 
+ *   non-zero if valid, zero if not
+ */
+static int classValidCode(uint16_t code) {
+  
+  int hb = 0;
+  int lb = 0;
+  
+  hb = (int) (code >> 8);
+  lb = (int) (code & 0xff);
+  
+  if ((hb < 'A') || (hb > 'Z')) {
+    return 0;
+  }
+  if ((lb != 0) && ((lb < 'a') || (lb > 'z'))) {
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Category run callback used while compiling a character class.
+ * 
+ * pCustom is the CLASS_BUILD state.  If the general category of the run
+ * is selected by any of the category codes, the bits of every codepoint
+ * in the run are set in the uncompressed bitset.  A code with a zero
+ * low byte selects its whole group.
+ * 
+ * Parameters:
+ * 
+ *   pCustom - the CLASS_BUILD state
+ * 
+ *   lo - the first codepoint of the run
+ * 
+ *   hi - the last codepoint of the run
+ * 
+ *   gcat - the general category of the run
+ * 
+ * Return:
+ * 
+ *   always non-zero, to continue the walk
+ */
+static int classRun(void *pCustom, int32_t lo, int32_t hi,
+                      uint16_t gcat) {
+  
+  CLASS_BUILD *pb = NULL;
+  size_t i = 0;
+  int32_t cv = 0;
+  int sel = 0;
+  
+  pb = (CLASS_BUILD *) pCustom;
+  
+  for(i = 0; i < pb->n; i++) {
+    if ((pb->pCats[i] & 0xff) == 0) {
+      if ((gcat & UNIKIT_CTGR_MASK) == pb->pCats[i]) {
+        sel = 1;
+        break;
+      }
+    } else if (gcat == pb->pCats[i]) {
+      sel = 1;
+      break;
+    }
+  }
+  
+  if (sel) {
+    for(cv = lo; cv <= hi; cv++) {
+      pb->pWords[cv >> 4] = (uint16_t)
+                  (pb->pWords[cv >> 4] | (UINT16_C(1) << (cv & 15)));
+    }
+  }
+  
+  return 1;
+}
+
+/*
+ * Count the codepoints in a buffer of UTF-8 text.
+ * 
+ * Each ill-formed sequence counts as a single codepoint, so the result
+ * is always the same as the return value of unikit_category_utf8().
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-8 input
+ * 
+ *   n - the number of input bytes
+ * 
+ * Return:
+ * 
+ *   the number of codepoints
+ */
+static size_t countUtf8(const uint8_t *pSrc, size_t n) {
+  
+  size_t i = 0;
+  size_t count = 0;
+  size_t adv = 0;
+  uint64_t w = 0;
+  
+  while (i < n) {
+    /* Fast path for runs of ASCII, eight bytes at a time */
+    while (n - i >= 8) {
+      memcpy(&w, pSrc + i, 8);
+      if ((w & UINT64_C(0x8080808080808080)) != 0) {
+        break;
+      }
+      count += 8;
+      i += 8;
+    }
+    if (i >= n) {
+      break;
+    }
+    
+    /* Skip over the next sequence */
+    if (pSrc[i] < 0x80) {
+      adv = 1;
+    } else {
+      decodeUtf8(pSrc + i, n - i, &adv);
+    }
+    i += adv;
+    count++;
+  }
+  
+  return count;
+}
+
+/*
+ * Find a safe position to split a buffer of UTF-8 text.
+ * 
+ * The returned split is the first position at or after pos where a new
+ * sequence always begins, so that decoding the text before and after
+ * the split gives the same result as decoding the whole buffer.  That
+ * is the case for any byte that is not a continuation byte.  It is also
+ * the case after three continuation bytes in a row, since no sequence
+ * has more than three continuation bytes, and each stray continuation
+ * byte is replaced on its own.  The split is therefore never more than
+ * three bytes after pos.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-8 input
+ * 
+ *   n - the number of input bytes
+ * 
+ *   pos - the desired split position, at most n
+ * 
+ * Return:
+ * 
+ *   the safe split position, at most n
+ */
+static size_t splitUtf8(const uint8_t *pSrc, size_t n, size_t pos) {
+  
+  int i = 0;
+  
+  for(i = 0; i < 3; i++) {
+    if ((pos >= n) || ((pSrc[pos] & 0xc0) != 0x80)) {
+      return pos;
+    }
+    pos++;
+  }
+  
+  return (pos < n) ? pos : n;
+}
+
+/*
+ * Process one chunk of a parallel buffer function.
+ * 
+ * This is the job function passed to the executor.  See PAR_JOB for
+ * the two passes.
+ * 
+ * Parameters:
+ * 
+ *   pJob - the PAR_JOB state
+ * 
+ *   i - the chunk index
+ */
+static void parJob(void *pJob, size_t i) {
+  
+  PAR_JOB *pj = NULL;
+  const uint8_t *pChunk = NULL;
+  size_t n = 0;
+  size_t cap = 0;
+  
+  pj = (PAR_JOB *) pJob;
+  pChunk = pj->pSrc + pj->pSplit[i];
+  n = pj->pSplit[i + 1] - pj->pSplit[i];
+  
+  if (pj->pOut == NULL) {
+    /* Measuring pass */
+    if (pj->kind == PAR_CATEGORIES) {
+      pj->pLen[i] = countUtf8(pChunk, n);
+    } else {
+      pj->pLen[i] = unikit_fold_utf8(pChunk, n, NULL, 0);
+    }
+    
+  } else {
+    /* Writing pass */
+    cap = pj->pLen[i + 1] - pj->pLen[i];
+    if (pj->kind == PAR_CATEGORIES) {
+      unikit_category_utf8(pChunk, n,
+        ((uint16_t *) pj->pOut) + pj->pLen[i], cap);
+    } else {
+      unikit_fold_utf8(pChunk, n,
+        ((uint8_t *) pj->pOut) + pj->pLen[i], cap);
+    }
+  }
+}
+
+/*
+ * Hand every chunk of a parallel buffer function to the executor.
+ * 
+ * If fpExec is NULL, the chunks are processed in order on the calling
+ * thread instead.
+ * 
+ * Parameters:
+ * 
+ *   pj - the job state
+ * 
+ *   count - the number of chunks
+ * 
+ *   fpExec - the executor, or NULL
+ * 
+ *   pCustom - the custom parameter to pass to the executor
+ */
+static void parExec(PAR_JOB *pj, size_t count,
+                      unikit_fp_exec fpExec, void *pCustom) {
+  
+  size_t i = 0;
+  
+  if (fpExec == NULL) {
+    for(i = 0; i < count; i++) {
+      parJob(pj, i);
+    }
+  } else {
+    fpExec(pCustom, &parJob, pj, count);
+  }
+}
+
+/*
+ * Shared implementation of the parallel buffer functions.
+ * 
+ * kind is one of the PAR constants, which determines the type of the
+ * pOut array.  The other parameters have already been checked by the
+ * caller.  See unikit_fold_utf8_par() for further information.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-8 input
+ * 
+ *   n - the number of input bytes
+ * 
+ *   pOut - the output array, or NULL
+ * 
+ *   cap - the capacity of the output array in elements
+ * 
+ *   kind - the output kind
+ * 
+ *   chunk - the approximate chunk size in bytes, or zero
+ * 
+ *   fpExec - the executor, or NULL
+ * 
+ *   pCustom - the custom parameter to pass to the executor
+ * 
+ * Return:
+ * 
+ *   the total number of output elements
+ */
+static size_t runPar(
+    const uint8_t        * pSrc,
+          size_t           n,
+          void           * pOut,
+          size_t           cap,
+          int              kind,
+          size_t           chunk,
+          unikit_fp_exec   fpExec,
+          void           * pCustom) {
+  
+  PAR_JOB job;
+  size_t *pSplit = NULL;
+  size_t *pLen = NULL;
+  size_t max_count = 0;
+  size_t count = 0;
+  size_t pos = 0;
+  size_t total = 0;
+  size_t len = 0;
+  size_t i = 0;
+  
+  /* Initialize structures */
+  memset(&job, 0, sizeof(PAR_JOB));
+  
+  if (n < 1) {
+    return 0;
+  }
+  if (chunk < 1) {
+    chunk = PAR_CHUNK_DEFAULT;
+  }
+  
+  /* Load the tables up front, so that the jobs never contend for the
+   * state lock */
+  if (kind == PAR_CATEGORIES) {
+    requireTables(TABLES_CORE);
+    requireTables(TABLES_GCAT);
+  } else {
+    requireTables(TABLES_CASE);
+  }
+  
+  /* Every chunk but the last has at least chunk bytes */
+  max_count = (n / chunk) + 1;
+  if (max_count >= SIZE_MAX / sizeof(size_t)) {
+    raiseErr(__LINE__, "Too many chunks");
+  }
+  pSplit = (size_t *) malloc((max_count + 1) * sizeof(size_t));
+  pLen = (size_t *) malloc((max_count + 1) * sizeof(size_t));
+  if ((pSplit == NULL) || (pLen == NULL)) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+  
+  /* Split the input at safe positions */
+  pSplit[0] = 0;
+  while (pos < n) {
+    if (n - pos <= chunk) {
+      pos = n;
+    } else {
+      pos = splitUtf8(pSrc, n, pos + chunk);
+    }
+    count++;
+    pSplit[count] = pos;
+  }
+  
+  /* Measure the output length of every chunk */
+  job.pSrc = pSrc;
+  job.pSplit = pSplit;
+  job.pLen = pLen;
+  job.kind = kind;
+  parExec(&job, count, fpExec, pCustom);
+  
+  /* Turn the lengths into output offsets */
+  for(i = 0; i < count; i++) {
+    len = pLen[i];
+    pLen[i] = total;
+    if (total > SIZE_MAX - len) {
+      raiseErr(__LINE__, "Output size overflow");
+    }
+    total += len;
+  }
+  pLen[count] = total;
+  
+  /* Write the output if all of it fits */
+  if ((pOut != NULL) && (total <= cap)) {
+    job.pOut = pOut;
+    parExec(&job, count, fpExec, pCustom);
+  }
+  
+  /* Release the job state */
+  free(pSplit);
+  free(pLen);
+  
+  return total;
+}
+
+/*
+ * Decode a single sequence in any of the streaming decoder encodings.
+ * 
+ * enc is one of the UNIKIT_ENC constants.  See decodeUtf8() and
+ * decodeUtf16() for the meaning of the other parameters and the return
+ * value.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the bytes to decode
+ * 
+ *   n - the number of available bytes, at least one
+ * 
+ *   enc - the encoding
+ * 
+ *   pAdv - variable to receive the number of bytes consumed
+ * 
+ * Return:
+ * 
+ *   the decoded codepoint, or a negative value if the sequence is
+ *   ill-formed
+ */
+static int32_t decodeNext(
+    const uint8_t *pSrc,
+          size_t   n,
+          int      enc,
+          size_t  *pAdv) {
+  
+  if (enc == UNIKIT_ENC_UTF8) {
+    return decodeUtf8(pSrc, n, pAdv);
+  }
+  return decodeUtf16(pSrc, n, (enc == UNIKIT_ENC_UTF16BE), pAdv);
+}
+
+/*
+ * Write the output of the streaming decoder for one decoded codepoint.
+ * 
+ * cv is the decoded codepoint, which must pass unikit_valid().  kind is
+ * one of the DECODE constants, which determines the type of the pOut
+ * array.  cap is the capacity of pOut in elements of that type, and
+ * pLen is the number of elements already written, which is advanced by
+ * this function.  For DECODE_CATEGORIES, the core table must already be
+ * loaded.
+ * 
+ * If the output for the codepoint does not fit in the remaining
+ * capacity, nothing is written and zero is returned.
+ * 
+ * Parameters:
+ * 
+ *   cv - the decoded codepoint
+ * 
+ *   kind - the output kind
+ * 
+ *   pOut - the output array
+ * 
+ *   cap - the capacity of the output array
+ * 
+ *   pLen - the number of elements written so far
+ * 
+ * Return:
+ * 
+ *   non-zero if the output was written, zero if it does not fit
+ */
+static int emitDecoded(int32_t cv, int kind, void *pOut, size_t cap,
+                        size_t *pLen) {
+  
+  int32_t cpa[4];
+  uint8_t ebuf[16];
+  int sqlen = 0;
+  int elen = 0;
+  int j = 0;
+  
+  if (kind == DECODE_FOLDS) {
+    /* Fold and encode the codepoint */
+    if (cv < 0x80) {
+      if ((cv >= 'A') && (cv <= 'Z')) {
+        cv += 0x20;
+      }
+      ebuf[0] = (uint8_t) cv;
+      elen = 1;
+      STAT_INC(fold_ascii);
+      
+    } else {
+      sqlen = foldCore(cv, cpa);
+      for(j = 0; j < sqlen; j++) {
+        elen += encodeUtf8(cpa[j], ebuf + elen);
+      }
+    }
+    
+    if (cap - *pLen < (size_t) elen) {
+      return 0;
+    }
+    memcpy(((uint8_t *) pOut) + *pLen, ebuf, (size_t) elen);
+    *pLen += (size_t) elen;
+    
+  } else {
+    if (*pLen >= cap) {
+      return 0;
+    }
+    if (kind == DECODE_CATEGORIES) {
+      if (cv < 0x100) {
+        ((uint16_t *) pOut)[*pLen] = m_gcat_core[cv];
+        STAT_INC(cat_core);
+      } else {
+        ((uint16_t *) pOut)[*pLen] = categoryCore(cv);
+      }
+    } else {
+      ((int32_t *) pOut)[*pLen] = cv;
+    }
+    (*pLen)++;
+  }
+  
+  return 1;
+}
+
+/*
+ * Decode a chunk of input with a streaming decoder.
+ * 
+ * This is the shared implementation of unikit_decode(),
+ * unikit_decode_category(), and unikit_decode_fold().  kind is one of
+ * the DECODE constants, which determines the type of the pOut array.
+ * See the header for the other parameters.  This function does not
+ * check the module state or its parameters, so it is the caller's
+ * responsibility to do so.
+ * 
+ * Parameters:
+ * 
+ *   pd - the decoder state
+ * 
+ *   pSrc - the input chunk
+ * 
+ *   n - the number of bytes in the chunk
+ * 
+ *   kind - the output kind
+ * 
+ *   pOut - the output array
+ * 
+ *   cap - the capacity of the output array
+ * 
+ *   pUsed - variable that receives the bytes consumed, or NULL
+ * 
+ * Return:
+ * 
+ *   the number of output elements written
+ */
+static size_t decodeStream(
+          UNIKIT_DECODER * pd,
+    const uint8_t        * pSrc,
+          size_t           n,
+          int              kind,
+          void           * pOut,
+          size_t           cap,
+          size_t         * pUsed) {
+  
+  size_t i = 0;
+  size_t olen = 0;
+  size_t adv = 0;
+  size_t tlen = 0;
+  size_t extra = 0;
+  uint64_t w = 0;
+  int32_t cv = 0;
+  int j = 0;
+  uint8_t tbuf[4];
+  
+  memset(tbuf, 0, sizeof(tbuf));
+  
+  /* First resolve any incomplete sequence left by the previous chunk,
+   * by decoding it together with the start of this chunk; for UTF-16,
+   * the held bytes may decode to an unpaired surrogate that leaves
+   * some of them held, so repeat until no bytes are held */
+  while (pd->pend_len > 0) {
+    tlen = (size_t) pd->pend_len;
+    memcpy(tbuf, pd->pend, tlen);
+    extra = n - i;
+    if (extra > 4 - tlen) {
+      extra = 4 - tlen;
+    }
+    memcpy(tbuf + tlen, pSrc + i, extra);
+    
+    cv = decodeNext(tbuf, tlen + extra, (int) pd->enc, &adv);
+    if (cv == DECODE_TRUNCATED) {
+      /* Still incomplete, so the whole chunk was held */
+      memcpy(pd->pend + tlen, pSrc + i, extra);
+      pd->pend_len = (uint8_t) (tlen + extra);
+      i += extra;
+      break;
+    }
+    
+    if (!emitDecoded((cv < 0) ? 0xfffd : cv, kind, pOut, cap, &olen)) {
+      break;
+    }
+    
+    if (adv >= tlen) {
+      i += adv - tlen;
+      pd->pend_len = 0;
+    } else {
+      memmove(pd->pend, pd->pend + adv, tlen - adv);
+      pd->pend_len = (uint8_t) (tlen - adv);
+    }
+  }
+  
+  /* Process the rest of the chunk, unless the output filled up while
+   * resolving the held bytes */
+  while ((i < n) && (pd->pend_len == 0)) {
+    /* Fast path for runs of UTF-8 ASCII, eight bytes at a time */
+    if (pd->enc == UNIKIT_ENC_UTF8) {
+      while ((n - i >= 8) && (cap - olen >= 8)) {
+        memcpy(&w, pSrc + i, 8);
+        if ((w & UINT64_C(0x8080808080808080)) != 0) {
+          break;
+        }
+        
+        if (kind == DECODE_FOLDS) {
+          w = foldAscii8(w);
+          memcpy(((uint8_t *) pOut) + olen, &w, 8);
+          STAT_ADD(fold_ascii, 8);
+        } else if (kind == DECODE_CATEGORIES) {
+          for(j = 0; j < 8; j++) {
+            ((uint16_t *) pOut)[olen + j] = m_gcat_core[pSrc[i + j]];
+          }
+          STAT_ADD(cat_core, 8);
+        } else {
+          for(j = 0; j < 8; j++) {
+            ((int32_t *) pOut)[olen + j] = (int32_t) pSrc[i + j];
+          }
+        }
+        
+        olen += 8;
+        i += 8;
+      }
+      if (i >= n) {
+        break;
+      }
+    }
+    
+    /* Decode the next sequence, holding it in the decoder state if it
+     * is cut off by the end of the chunk */
+    if ((pd->enc == UNIKIT_ENC_UTF8) && (pSrc[i] < 0x80)) {
+      cv = (int32_t) pSrc[i];
+      adv = 1;
+    } else {
+      cv = decodeNext(pSrc + i, n - i, (int) pd->enc, &adv);
+    }
+    if (cv == DECODE_TRUNCATED) {
+      memcpy(pd->pend, pSrc + i, adv);
+      pd->pend_len = (uint8_t) adv;
+      i += adv;
+      break;
+    }
+    
+    /* Write the output, replacing ill-formed sequences with U+FFFD */
+    if (!emitDecoded((cv < 0) ? 0xfffd : cv, kind, pOut, cap, &olen)) {
+      break;
+    }
+    i += adv;
+  }
+  
+  /* Return the consumed input and the output length */
+  if (pUsed != NULL) {
+    *pUsed = i;
+  }
+  return olen;
+}
+
+/*
+ * Initialize an iterator over the case folded codepoints of UTF-8
+ * text.
+ * 
+ * Parameters:
+ * 
+ *   pi - the iterator to initialize
+ * 
+ *   pSrc - the UTF-8 input, which may only be NULL if n is zero
+ * 
+ *   n - the number of input bytes
+ */
+static void foldIterInit(FOLD_ITER *pi, const uint8_t *pSrc, size_t n) {
+  memset(pi, 0, sizeof(FOLD_ITER));
+  pi->pSrc = pSrc;
+  pi->n = n;
+}
+
+/*
+ * Get the next case folded codepoint from an iterator.
+ * 
+ * Input is decoded one sequence at a time as the iterator advances,
+ * and each decoded codepoint is case folded as if by unikit_fold(), so
+ * that a codepoint with a multi-codepoint folding yields each codepoint
+ * of its folding in turn.  Ill-formed sequences are treated as U+FFFD
+ * in the same way as unikit_fold_utf8().
+ * 
+ * The module must be initialized, but this function does not check the
+ * module state, so it is the caller's responsibility to do so.
+ * 
+ * Parameters:
+ * 
+ *   pi - the iterator
+ * 
+ * Return:
+ * 
+ *   the next case folded codepoint, or -1 at the end of the input
+ */
+static int32_t foldIterNext(FOLD_ITER *pi) {
+  
+  int32_t cv = 0;
+  size_t adv = 0;
+  
+  /* Return the rest of the last folding first */
+  if (pi->pos < pi->len) {
+    return (pi->cpa)[(pi->pos)++];
+  }
+  if (pi->i >= pi->n) {
+    return -1;
+  }
+  
+  /* Handle ASCII directly */
+  cv = (int32_t) (pi->pSrc)[pi->i];
+  if (cv < 0x80) {
+    (pi->i)++;
+    if ((cv >= 'A') && (cv <= 'Z')) {
+      cv += 0x20;
+    }
+    STAT_INC(fold_ascii);
+    return cv;
+  }
+  
+  /* Decode and fold the next codepoint */
+  cv = decodeUtf8(pi->pSrc + pi->i, pi->n - pi->i, &adv);
+  if (cv < 0) {
+    cv = 0xfffd;
+  }
+  pi->i += adv;
+  
+  pi->len = foldCore(cv, pi->cpa);
+  pi->pos = 1;
+  return (pi->cpa)[0];
+}
+
+/*
+ * Find the bytes of an ASCII word that equal a given ASCII byte.
+ * 
+ * Each byte of w must be in range 0x00 to 0x7F, and c must have the
+ * same ASCII byte replicated into each of its bytes.  Since no byte has
+ * its high bit set, the additions below never carry between bytes, so
+ * the result is exact.
+ * 
+ * Parameters:
+ * 
+ *   w - the ASCII word
+ * 
+ *   c - the replicated byte
+ * 
+ * Return:
+ * 
+ *   a word with the high bit set in each byte of w that equals the byte
+ *   of c, and every other bit clear
+ */
+static uint64_t matchAscii8(uint64_t w, uint64_t c) {
+  
+  uint64_t t = 0;
+  
+  /* Bytes that are equal become zero, and only non-zero bytes get their
+   * high bit set by adding 0x7F */
+  t = w ^ c;
+  return ~((t + UINT64_C(0x7f7f7f7f7f7f7f7f)) | t) &
+            UINT64_C(0x8080808080808080);
+}
+
+/*
+ * Build the filter of a compiled case-insensitive search.
+ * 
+ * The folded needle must already be stored in the search, with at least
+ * one codepoint.  The lead table receives the first byte of every UTF-8
+ * sequence whose case folding begins with the first folded codepoint of
+ * the needle, and the word filter is set up when the first codepoints
+ * of the needle are ASCII.
+ * 
+ * Since ill-formed input folds to U+FFFD, a needle that begins with
+ * U+FFFD can match at bytes that are not lead bytes, so such needles
+ * use the exact mode instead of the filter.
+ * 
+ * The module must be initialized, but this function does not check the
+ * module state, so it is the caller's responsibility to do so.
+ * 
+ * Parameters:
+ * 
+ *   pf - the search to set up
+ */
+static void casefindFilter(UNIKIT_CASEFIND *pf) {
+  
+  const uint16_t *pTable = NULL;
+  int32_t cpa[4];
+  uint8_t ebuf[4];
+  int32_t first = 0;
+  int32_t zero = -1;
+  int32_t pos = 0;
+  int32_t cv = 0;
+  int32_t f = 0;
+  uint16_t r = 0;
+  int plane = 0;
+  int nonzero = 0;
+  int32_t b = 0;
+  int32_t j = 0;
+  
+  /* Initialize buffers */
+  memset(cpa, 0, sizeof(cpa));
+  memset(ebuf, 0, sizeof(ebuf));
+  
+  first = (pf->pFold)[0];
+  if (first == 0xfffd) {
+    pf->exact = 1;
+    return;
+  }
+  
+  /* The first codepoint is already folded, so it folds to itself, and
+   * ASCII letters are also matched by their uppercase */
+  encodeUtf8(first, ebuf);
+  (pf->lead)[ebuf[0]] = 1;
+  if ((first >= 'a') && (first <= 'z')) {
+    (pf->lead)[first - 0x20] = 1;
+  }
+  
+  /* Find the other codepoints whose folding begins with the first
+   * codepoint by walking the delta tables of both planes, skipping the
+   * data block that is shared by every block in which all codepoints
+   * fold to themselves */
+  requireTables(TABLES_CASE);
+  for(plane = 0; plane < 2; plane++) {
+    pTable = (plane == 0) ? m_case_delta_lower : m_case_delta_upper;
+    for(b = 0; b < STAGE_INDEX_LEN; b++) {
+      pos = ((int32_t) pTable[b]) << STAGE_SHIFT;
+      if (pos == zero) {
+        continue;
+      }
+      
+      nonzero = 0;
+      for(j = 0; j <= (int32_t) STAGE_MASK; j++) {
+        r = pTable[pos + j];
+        if (r == 0) {
+          continue;
+        }
+        nonzero = 1;
+        
+        cv = (((int32_t) plane) << 16) | (b << STAGE_SHIFT) | j;
+        if (cv < 0x80) {
+          continue;
+        }
+        if (r == FOLD_EXPAND) {
+          foldCore(cv, cpa);
+          f = cpa[0];
+        } else {
+          f = (cv & ~((int32_t) 0xffff)) |
+                ((cv + (int32_t) r) & 0xffff);
+        }
+        if (f == first) {
+          encodeUtf8(cv, ebuf);
+          (pf->lead)[ebuf[0]] = 1;
+        }
+      }
+      if (!nonzero) {
+        zero = pos;
+      }
+    }
+  }
+  
+  /* Set up the word filter for ASCII codepoints at the start of the
+   * needle */
+  if (first < 0x80) {
+    pf->first = ((uint64_t) first) * UINT64_C(0x0101010101010101);
+    pf->filter = 1;
+    if ((pf->len > 1) && ((pf->pFold)[1] < 0x80)) {
+      pf->second = ((uint64_t) (pf->pFold)[1]) *
+                      UINT64_C(0x0101010101010101);
+      pf->filter = 2;
+    }
+  }
+}
+
+/*
+ * Check whether a compiled case-insensitive search matches at a given
+ * offset of UTF-8 text.
+ * 
+ * The text is folded lazily from offset i, which must be on a codepoint
+ * boundary, and compared against the folded needle.  The match must end
+ * on a codepoint boundary, so a needle never matches only part of the
+ * folding of a codepoint.
+ * 
+ * The module must be initialized, but this function does not check the
+ * module state, so it is the caller's responsibility to do so.
+ * 
+ * Parameters:
+ * 
+ *   pf - the compiled search
+ * 
+ *   pSrc - the UTF-8 text
+ * 
+ *   n - the number of bytes of text
+ * 
+ *   i - the offset to check
+ * 
+ *   pEnd - variable to receive the offset of the end of the match
+ * 
+ * Return:
+ * 
+ *   non-zero if the needle matches at the offset, zero if not
+ */
+static int casefindAt(
+    const UNIKIT_CASEFIND * pf,
+    const uint8_t         * pSrc,
+          size_t            n,
+          size_t            i,
+          size_t          * pEnd) {
+  
+  FOLD_ITER it;
+  size_t k = 0;
+  
+  foldIterInit(&it, pSrc, n);
+  it.i = i;
+  
+  for(k = 0; k < pf->len; k++) {
+    if (foldIterNext(&it) != (pf->pFold)[k]) {
+      return 0;
+    }
+  }
+  if (it.pos < it.len) {
+    return 0;
+  }
+  
+  *pEnd = it.i;
+  return 1;
+}
+
+/*
+ * Initialize the module or add a reference to it.
+ * 
+ * This is the shared implementation of unikit_init(),
+ * unikit_init_mapped(), and unikit_init_memory().  If the module is not
+ * yet initialized and pPath is not NULL, the tables are taken from the
+ * data file at that path instead of from the data module.  Otherwise,
+ * if pMem is not NULL, every table is decoded now into that block of
+ * mem_len bytes instead of into arenas allocated on first use.  pPath
+ * and pMem may not both be given.
+ * 
+ * Parameters:
+ * 
+ *   fpErr - the custom error handler, or NULL for a default handler
+ * 
+ *   pPath - the path to a data file to map, or NULL
+ * 
+ *   pMem - the memory block for the tables, or NULL
+ * 
+ *   mem_len - the size of the memory block in bytes
+ * 
+ * Return:
+ * 
+ *   non-zero if successful, zero if the data file could not be mapped
+ *   or the memory block is too small
+ */
+static int startup(
+          unikit_fp_err   fpErr,
+    const char          * pPath,
+          void          * pMem,
+          size_t          mem_len) {
+  
+  int i = 0;
+  
+  lockState();
+  
+  /* If the module is already initialized, just add a reference */
+  if (m_refs >= INT32_MAX) {
+    raiseErr(__LINE__, "Too many Unikit references");
+  }
+  if (m_refs > 0) {
+    m_refs++;
+    unlockState();
+    return 1;
+  }
+  
+  /* Check parameters */
+  if ((pPath != NULL) && (pMem != NULL)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Check that a client memory block is large enough */
+#ifndef UNIKIT_STATIC_TABLES
+  if (pMem != NULL) {
+    if (mem_len < arenaSize()) {
+      unlockState();
+      return 0;
+    }
+  }
+#else
+  (void) mem_len;
+#endif
+  
+  /* Map the data file if requested */
+  if (pPath != NULL) {
+    if (!mapDataFile(pPath)) {
+      unlockState();
+      return 0;
+    }
+  }
+  
+  /* Store the error handler (which may be NULL) and the reference */
+  m_err = fpErr;
+  m_refs = 1;
+  
+  /* Decode every table now into a client memory block if one was
+   * given; static tables need no memory, so the block is unused */
+  if (pMem != NULL) {
+#ifndef UNIKIT_STATIC_TABLES
+    loadArena(pMem);
+#else
+    for(i = 0; i < TABLES_COUNT; i++) {
+      loadGroup(i);
+    }
+#endif
+    for(i = 0; i < TABLES_COUNT; i++) {
+#ifdef HAVE_ATOMICS
+      atomic_store_explicit(&(m_loaded[i]), 1, memory_order_relaxed);
+#else
+      m_loaded[i] = 1;
+#endif
+    }
+  }
+  
+  /* Tables are normally loaded on first use by requireTables(), but
+   * without atomics there is no safe way to publish them from a query
+   * running on another thread, so load everything now in that case */
+#ifndef HAVE_ATOMICS
+  for(i = 0; i < TABLES_COUNT; i++) {
+    if (!m_loaded[i]) {
+      loadGroup(i);
+      m_loaded[i] = 1;
+    }
+  }
+#endif
+  
+  /* Publish the initialized state by updating the init flag */
+#ifdef HAVE_ATOMICS
+  atomic_store_explicit(&m_init, 1, memory_order_release);
+#else
+  m_init = 1;
+#endif
+  
+  unlockState();
+  return 1;
+}
+
+/*
+ * Public functions
+ * ================
+ * 
+ * See the header for specifications.
+ */
+
+/*
+ * unikit_init function.
+ */
+void unikit_init(unikit_fp_err fpErr) {
+  startup(fpErr, NULL, NULL, 0);
+}
+
+/*
+ * unikit_init_mapped function.
+ */
+int unikit_init_mapped(const char *pPath, unikit_fp_err fpErr) {
+  
+  /* Check parameters */
+  if (pPath == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  return startup(fpErr, pPath, NULL, 0);
+}
+
+/*
+ * unikit_init_size function.
+ */
+size_t unikit_init_size(void) {
+#ifdef UNIKIT_STATIC_TABLES
+  return 0;
+#else
+  return arenaSize();
+#endif
+}
+
+/*
+ * unikit_init_memory function.
+ */
+int unikit_init_memory(
+    void          * pMem,
+    size_t          mem_len,
+    unikit_fp_err   fpErr) {
+  
+  /* Check parameters */
+  if (pMem == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  return startup(fpErr, NULL, pMem, mem_len);
+}
+
+/*
+ * unikit_shutdown function.
+ */
+void unikit_shutdown(void) {
+  
+  int i = 0;
+  
+  lockState();
+  
+  /* Release a reference; if other references remain, there is nothing
+   * further to do */
+  if (m_refs < 1) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  m_refs--;
+  if (m_refs > 0) {
+    unlockState();
+    return;
+  }
+  
+  /* Clear the init flag before releasing the tables */
+#ifdef HAVE_ATOMICS
+  atomic_store_explicit(&m_init, 0, memory_order_release);
+#else
+  m_init = 0;
+#endif
+  
+  /* Release tables of all groups that were loaded */
+  for(i = 0; i < TABLES_COUNT; i++) {
+    unloadGroup(i);
+#ifdef HAVE_ATOMICS
+    atomic_store_explicit(&(m_loaded[i]), 0, memory_order_relaxed);
+#else
+    m_loaded[i] = 0;
+#endif
+  }
+  
+  /* Release the data file if one was mapped */
+  unmapDataFile();
+  
+  /* Restore the default error handler */
+  m_err = NULL;
+  
+  unlockState();
+}
+
+/*
+ * unikit_valid function.
+ */
+int unikit_valid(int32_t cv) {
+  int result = 1;
+  
+  if ((cv >= 0x0) && (cv <= 0x10ffff)) {
+    if ((cv >= 0xd800) && (cv <= 0xdfff)) {
+      result = 0;
+    }
+  } else {
+    result = 0;
+  }
+  
+  return result;
+}
+
+/*
+ * unikit_fold function.
+ */
+int unikit_fold(UNIKIT_FOLD *pf, int32_t cv) {
+  
+  int result = 0;
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if (pf == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  if (!unikit_valid(cv)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Clear result structure */
+  memset(pf, 0, sizeof(UNIKIT_FOLD));
+  
+  /* Look up the case folding */
+  pf->len = (uint8_t) foldCore(cv, pf->cpa);
+  
+  /* Determine if mapping is trivial */
+  if ((pf->len == 1) && ((pf->cpa)[0] == cv)) {
+    result = 0;
+  } else {
+    result = 1;
+  }
+  
+  /* Return trivial indicator */
+  return result;
+}
+
+/*
+ * unikit_fold_utf8 function.
+ */
+size_t unikit_fold_utf8(
+    const uint8_t * pSrc,
+          size_t    n,
+          uint8_t * pDst,
+          size_t    cap) {
+  
+  size_t i = 0;
+  size_t olen = 0;
+  size_t adv = 0;
+  uint64_t w = 0;
+  int32_t cv = 0;
+  int32_t cpa[4];
+  int sqlen = 0;
+  int j = 0;
+  int elen = 0;
+  uint8_t ebuf[16];
+  
+  /* Initialize buffers */
+  memset(cpa, 0, sizeof(cpa));
+  memset(ebuf, 0, sizeof(ebuf));
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if ((pSrc == NULL) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pDst == NULL) && (cap > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Process the input; once the output has exceeded the capacity, olen
+   * is greater than cap and nothing more is written */
+  while (i < n) {
+    /* Fast path for runs of ASCII, eight bytes at a time */
+    while (n - i >= 8) {
+      memcpy(&w, pSrc + i, 8);
+      if ((w & UINT64_C(0x8080808080808080)) != 0) {
+        break;
+      }
+      
+      if (olen > SIZE_MAX - 8) {
+        raiseErr(__LINE__, "Output size overflow");
+      }
+      if (olen + 8 <= cap) {
+        w = foldAscii8(w);
+        memcpy(pDst + olen, &w, 8);
+      }
+      STAT_ADD(fold_ascii, 8);
+      
+      olen += 8;
+      i += 8;
+    }
+    if (i >= n) {
+      break;
+    }
+    
+    /* Decode the next codepoint, replacing ill-formed sequences with
+     * U+FFFD */
+    if (pSrc[i] < 0x80) {
+      cv = (int32_t) pSrc[i];
+      adv = 1;
+    } else {
+      cv = decodeUtf8(pSrc + i, n - i, &adv);
+      if (cv < 0) {
+        cv = 0xfffd;
+      }
+    }
+    i += adv;
+    
+    /* Fold and encode the codepoint */
+    if (cv < 0x80) {
+      if ((cv >= 'A') && (cv <= 'Z')) {
+        cv += 0x20;
+      }
+      ebuf[0] = (uint8_t) cv;
+      elen = 1;
+      STAT_INC(fold_ascii);
+      
+    } else {
+      sqlen = foldCore(cv, cpa);
+      elen = 0;
+      for(j = 0; j < sqlen; j++) {
+        elen += encodeUtf8(cpa[j], ebuf + elen);
+      }
+    }
+    
+    /* Write the encoded result if it fits */
+    if (olen > SIZE_MAX - ((size_t) elen)) {
+      raiseErr(__LINE__, "Output size overflow");
+    }
+    if (olen + ((size_t) elen) <= cap) {
+      memcpy(pDst + olen, ebuf, (size_t) elen);
+    }
+    olen += (size_t) elen;
+  }
+  
+  /* Return the total output length */
+  return olen;
+}
+
+/*
+ * unikit_fold_utf16 function.
+ */
+size_t unikit_fold_utf16(
+    const uint16_t * pSrc,
+          size_t     n,
+          uint16_t * pDst,
+          size_t     cap) {
+  
+  size_t i = 0;
+  size_t run = 0;
+  size_t olen = 0;
+  size_t adv = 0;
+  uint64_t w = 0;
+  int32_t cv = 0;
+  int32_t cpa[4];
+  int sqlen = 0;
+  int j = 0;
+  int elen = 0;
+  uint16_t ebuf[8];
+  
+  /* Initialize buffers */
+  memset(cpa, 0, sizeof(cpa));
+  memset(ebuf, 0, sizeof(ebuf));
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if ((pSrc == NULL) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pDst == NULL) && (cap > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Process the input; once the output has exceeded the capacity, olen
+   * is greater than cap and nothing more is written */
+  while (i < n) {
+    /* Find the run of units up to the next surrogate, in which each
+     * unit is a codepoint of its own */
+    if (i >= run) {
+      run = i + spanUtf16(pSrc + i, n - i);
+    }
+    
+    if (i < run) {
+      /* Fast path for ASCII, four units at a time */
+      if (run - i >= 4) {
+        memcpy(&w, pSrc + i, 8);
+        if ((w & UINT64_C(0xff80ff80ff80ff80)) == 0) {
+          if (olen > SIZE_MAX - 4) {
+            raiseErr(__LINE__, "Output size overflow");
+          }
+          if (olen + 4 <= cap) {
+            w = foldAscii4(w);
+            memcpy(pDst + olen, &w, 8);
+          }
+          STAT_ADD(fold_ascii, 4);
+          
+          olen += 4;
+          i += 4;
+          continue;
+        }
+      }
+      
+      cv = (int32_t) pSrc[i];
+      i++;
+      
+    } else {
+      /* The run ends at a surrogate, so decode it, replacing an
+       * unpaired surrogate with U+FFFD */
+      cv = decodePair(pSrc + i, n - i, &adv);
+      if (cv < 0) {
+        cv = 0xfffd;
+      }
+      i += adv;
+    }
+    
+    /* Fold and encode the codepoint */
+    if (cv < 0x80) {
+      if ((cv >= 'A') && (cv <= 'Z')) {
+        cv += 0x20;
+      }
+      ebuf[0] = (uint16_t) cv;
+      elen = 1;
+      STAT_INC(fold_ascii);
+      
+    } else {
+      sqlen = foldCore(cv, cpa);
+      elen = 0;
+      for(j = 0; j < sqlen; j++) {
+        elen += encodeUtf16(cpa[j], ebuf + elen);
+      }
+    }
+    
+    /* Write the encoded result if it fits */
+    if (olen > SIZE_MAX - ((size_t) elen)) {
+      raiseErr(__LINE__, "Output size overflow");
+    }
+    if (olen + ((size_t) elen) <= cap) {
+      memcpy(pDst + olen, ebuf, ((size_t) elen) * sizeof(uint16_t));
+    }
+    olen += (size_t) elen;
+  }
+  
+  /* Return the total output length */
+  return olen;
+}
+
+/*
+ * unikit_fold_utf32 function.
+ */
+size_t unikit_fold_utf32(
+    const int32_t * pSrc,
+          size_t    n,
+          int32_t * pDst,
+          size_t    cap) {
+  
+  size_t i = 0;
+  size_t olen = 0;
+  int32_t cv = 0;
+  int32_t cpa[4];
+  int sqlen = 0;
+  
+  /* Initialize buffers */
+  memset(cpa, 0, sizeof(cpa));
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if ((pSrc == NULL) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pDst == NULL) && (cap > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Process the input; once the output has exceeded the capacity, olen
+   * is greater than cap and nothing more is written */
+  for(i = 0; i < n; i++) {
+    /* ASCII that fits in the output is folded and written directly */
+    cv = pSrc[i];
+    if (((uint32_t) cv < 0x80) && (olen < cap)) {
+      if ((cv >= 'A') && (cv <= 'Z')) {
+        cv += 0x20;
+      }
+      pDst[olen] = cv;
+      olen++;
+      STAT_INC(fold_ascii);
+      continue;
+    }
+    
+    /* Replace ill-formed units with U+FFFD */
+    if (!unikit_valid(cv)) {
+      cv = 0xfffd;
+    }
+    
+    /* Fold the codepoint */
+    if (cv < 0x80) {
+      if ((cv >= 'A') && (cv <= 'Z')) {
+        cv += 0x20;
+      }
+      cpa[0] = cv;
+      sqlen = 1;
+      STAT_INC(fold_ascii);
+      
+    } else {
+      sqlen = foldCore(cv, cpa);
+    }
+    
+    /* Write the result if it fits */
+    if (olen > SIZE_MAX - ((size_t) sqlen)) {
+      raiseErr(__LINE__, "Output size overflow");
+    }
+    if (olen + ((size_t) sqlen) <= cap) {
+      memcpy(pDst + olen, cpa, ((size_t) sqlen) * sizeof(int32_t));
+    }
+    olen += (size_t) sqlen;
+  }
+  
+  /* Return the total output length */
+  return olen;
+}
+
+/*
+ * unikit_fold_utf8_par function.
+ */
+size_t unikit_fold_utf8_par(
+    const uint8_t        * pSrc,
+          size_t           n,
+          uint8_t        * pDst,
+          size_t           cap,
+          size_t           chunk,
+          unikit_fp_exec   fpExec,
+          void           * pCustom) {
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if ((pSrc == NULL) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pDst == NULL) && (cap > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  return runPar(pSrc, n, pDst, cap, PAR_FOLDS, chunk, fpExec, pCustom);
+}
+
+/*
+ * unikit_category function.
+ */
+uint16_t unikit_category(int32_t cv) {
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Look up the category */
+  return categoryCore(cv);
+}
+
+/*
+ * unikit_props function.
+ */
+uint32_t unikit_props(int32_t cv) {
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Look up the record */
+  return propsCore(cv);
+}
+
+/*
+ * unikit_category_buf function.
+ */
+void unikit_category_buf(
+    const int32_t  * pCps,
+          uint16_t * pOut,
+          size_t     n) {
+  
+  size_t i = 0;
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if (((pCps == NULL) || (pOut == NULL)) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Load core table once for the whole buffer */
+  requireTables(TABLES_CORE);
+  
+  /* Process the buffer four codepoints at a time; if all four are in
+   * the core range, look them up directly in the core table, which is
+   * the common case for ASCII and Latin-1 text -- negative values
+   * become large when converted to unsigned, so they never pass the
+   * test */
+  while (n - i >= 4) {
+    if (((uint32_t) (pCps[i] | pCps[i + 1] | pCps[i + 2] | pCps[i + 3]))
+          < 0x100) {
+      pOut[i    ] = m_gcat_core[pCps[i    ]];
+      pOut[i + 1] = m_gcat_core[pCps[i + 1]];
+      pOut[i + 2] = m_gcat_core[pCps[i + 2]];
+      pOut[i + 3] = m_gcat_core[pCps[i + 3]];
+      STAT_ADD(cat_core, 4);
+      
+    } else {
+      pOut[i    ] = categoryCore(pCps[i    ]);
+      pOut[i + 1] = categoryCore(pCps[i + 1]);
+      pOut[i + 2] = categoryCore(pCps[i + 2]);
+      pOut[i + 3] = categoryCore(pCps[i + 3]);
+    }
+    i += 4;
+  }
+  
+  /* Process any remaining codepoints */
+  for( ; i < n; i++) {
+    pOut[i] = categoryCore(pCps[i]);
+  }
+}
+
+/*
+ * unikit_category_utf8 function.
+ */
+size_t unikit_category_utf8(
+    const uint8_t  * pSrc,
+          size_t     n,
+          uint16_t * pOut,
+          size_t     cap) {
+  
+  size_t i = 0;
+  size_t olen = 0;
+  size_t adv = 0;
+  uint64_t w = 0;
+  int32_t cv = 0;
+  int j = 0;
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if ((pSrc == NULL) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pOut == NULL) && (cap > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Load core table once for the whole buffer */
+  requireTables(TABLES_CORE);
+  
+  /* Process the input; the output length can never exceed the input
+   * length, so it can not overflow */
+  while (i < n) {
+    /* Fast path for runs of ASCII, eight bytes at a time */
+    while (n - i >= 8) {
+      memcpy(&w, pSrc + i, 8);
+      if ((w & UINT64_C(0x8080808080808080)) != 0) {
+        break;
+      }
+      
+      if (olen + 8 <= cap) {
+        for(j = 0; j < 8; j++) {
+          pOut[olen + j] = m_gcat_core[pSrc[i + j]];
+        }
+        STAT_ADD(cat_core, 8);
+      }
+      
+      olen += 8;
+      i += 8;
+    }
+    if (i >= n) {
+      break;
+    }
+    
+    /* Decode the next codepoint, treating ill-formed sequences as
+     * U+FFFD */
+    if (pSrc[i] < 0x80) {
+      cv = (int32_t) pSrc[i];
+      adv = 1;
+    } else {
+      cv = decodeUtf8(pSrc + i, n - i, &adv);
+      if (cv < 0) {
+        cv = 0xfffd;
+      }
     }
+    i += adv;
     
-    r = pTrie[tptr + j];
+    /* Classify the codepoint */
+    if (olen < cap) {
+      if (cv < 0x100) {
+        pOut[olen] = m_gcat_core[cv];
+        STAT_INC(cat_core);
+      } else {
+        pOut[olen] = categoryCore(cv);
+      }
+    }
+    olen++;
+  }
+  
+  /* Return the total number of codepoints */
+  return olen;
+}
+
+/*
+ * unikit_category_utf16 function.
+ */
+size_t unikit_category_utf16(
+    const uint16_t * pSrc,
+          size_t     n,
+          uint16_t * pOut,
+          size_t     cap) {
+  
+  size_t i = 0;
+  size_t run = 0;
+  size_t olen = 0;
+  size_t adv = 0;
+  int32_t cv = 0;
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if ((pSrc == NULL) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pOut == NULL) && (cap > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Load core table once for the whole buffer */
+  requireTables(TABLES_CORE);
+  
+  /* Process the input; the output length can never exceed the input
+   * length, so it can not overflow */
+  while (i < n) {
+    /* Classify the run of units up to the next surrogate, each of
+     * which is a codepoint of its own */
+    run = i + spanUtf16(pSrc + i, n - i);
+    for( ; i < run; i++) {
+      if (olen < cap) {
+        cv = (int32_t) pSrc[i];
+        if (cv < 0x100) {
+          pOut[olen] = m_gcat_core[cv];
+          STAT_INC(cat_core);
+        } else {
+          pOut[olen] = categoryCore(cv);
+        }
+      }
+      olen++;
+    }
+    if (i >= n) {
+      break;
+    }
     
-  } else {
-    r = UINT16_C(0xffff);
+    /* Classify the surrogate pair at the end of the run, treating an
+     * unpaired surrogate as U+FFFD */
+    cv = decodePair(pSrc + i, n - i, &adv);
+    if (cv < 0) {
+      cv = 0xfffd;
+    }
+    i += adv;
+    
+    if (olen < cap) {
+      pOut[olen] = categoryCore(cv);
+    }
+    olen++;
+  }
+  
+  /* Return the total number of codepoints */
+  return olen;
+}
+
+/*
+ * unikit_category_utf32 function.
+ */
+size_t unikit_category_utf32(
+    const int32_t  * pSrc,
+          size_t     n,
+          uint16_t * pOut,
+          size_t     cap) {
+  
+  size_t i = 0;
+  int32_t cv = 0;
+  int j = 0;
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if ((pSrc == NULL) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pOut == NULL) && (cap > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Every unit is one codepoint, so if the output does not fit, there
+   * is nothing to do but to return the count */
+  if (n > cap) {
+    return n;
+  }
+  
+  /* Load core table once for the whole buffer */
+  requireTables(TABLES_CORE);
+  
+  /* Process the buffer four units at a time; if all four are in the
+   * core range, look them up directly in the core table, in the same
+   * way as unikit_category_buf(); otherwise, treat ill-formed units
+   * as U+FFFD */
+  while (n - i >= 4) {
+    if (((uint32_t) (pSrc[i] | pSrc[i + 1] | pSrc[i + 2] | pSrc[i + 3]))
+          < 0x100) {
+      pOut[i    ] = m_gcat_core[pSrc[i    ]];
+      pOut[i + 1] = m_gcat_core[pSrc[i + 1]];
+      pOut[i + 2] = m_gcat_core[pSrc[i + 2]];
+      pOut[i + 3] = m_gcat_core[pSrc[i + 3]];
+      STAT_ADD(cat_core, 4);
+      
+    } else {
+      for(j = 0; j < 4; j++) {
+        cv = pSrc[i + j];
+        if (!unikit_valid(cv)) {
+          cv = 0xfffd;
+        }
+        pOut[i + j] = categoryCore(cv);
+      }
+    }
+    i += 4;
+  }
+  
+  /* Process any remaining units */
+  for( ; i < n; i++) {
+    cv = pSrc[i];
+    if (!unikit_valid(cv)) {
+      cv = 0xfffd;
+    }
+    pOut[i] = categoryCore(cv);
+  }
+  
+  /* Return the total number of codepoints */
+  return n;
+}
+
+/*
+ * unikit_category_utf8_par function.
+ */
+size_t unikit_category_utf8_par(
+    const uint8_t        * pSrc,
+          size_t           n,
+          uint16_t       * pOut,
+          size_t           cap,
+          size_t           chunk,
+          unikit_fp_exec   fpExec,
+          void           * pCustom) {
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if ((pSrc == NULL) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pOut == NULL) && (cap > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  return runPar(pSrc, n, pOut, cap, PAR_CATEGORIES, chunk,
+                  fpExec, pCustom);
+}
+
+/*
+ * unikit_category_runs function.
+ */
+int unikit_category_runs(unikit_fp_run fpRun, void *pCustom) {
+  
+  RUN_WALK w;
+  int32_t cv = 0;
+  
+  /* Initialize structures */
+  memset(&w, 0, sizeof(RUN_WALK));
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if (fpRun == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Make sure the category tables are loaded */
+  requireTables(TABLES_CORE);
+  requireTables(TABLES_GCAT);
+  
+  w.fpRun = fpRun;
+  w.pCustom = pCustom;
+  
+  /* Walk the core range */
+  for(cv = 0; cv <= 0xff; cv++) {
+    runEmit(&w, cv, cv, m_gcat_core[cv]);
+  }
+  
+  /* Walk the general range */
+#ifdef UNIKIT_UNIFIED_GCAT
+  walkUnified(&w);
+#else
+  walkIndex(&w, m_gcat_gen_low, 0);
+  walkIndex(&w, m_gcat_gen_high, 0x10000);
+  runIndexFlush(&w);
+#endif
+  
+  /* Walk the astral range and deliver the last run */
+  walkAstral(&w);
+  runFlush(&w);
+  
+  return !(w.stop);
+}
+
+/*
+ * unikit_class_compile function.
+ */
+UNIKIT_CLASS *unikit_class_compile(const uint16_t *pCats, size_t n) {
+  
+  CLASS_BUILD b;
+  UNIKIT_CLASS *pc = NULL;
+  uint16_t *pTable = NULL;
+  int32_t *pPos = NULL;
+  uint32_t *pHash = NULL;
+  int32_t bcount = 0;
+  int32_t ucount = 0;
+  int32_t i = 0;
+  int32_t j = 0;
+  uint32_t h = 0;
+  size_t k = 0;
+  
+  /* Initialize structures */
+  memset(&b, 0, sizeof(CLASS_BUILD));
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if ((pCats == NULL) || (n < 1)) {
+    raiseErr(__LINE__, NULL);
+  }
+  for(k = 0; k < n; k++) {
+    if (!classValidCode(pCats[k])) {
+      raiseErr(__LINE__, "Invalid category code");
+    }
+  }
+  
+  /* Build the uncompressed bitset from the category runs */
+  b.pCats = pCats;
+  b.n = n;
+  b.pWords = (uint16_t *) calloc(
+                (size_t) CLASS_WORDS, sizeof(uint16_t));
+  pPos = (int32_t *) calloc(
+                (size_t) CLASS_INDEX_LEN, sizeof(int32_t));
+  pHash = (uint32_t *) calloc(
+                (size_t) CLASS_INDEX_LEN, sizeof(uint32_t));
+  if ((b.pWords == NULL) || (pPos == NULL) || (pHash == NULL)) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+  
+  unikit_category_runs(&classRun, &b);
+  
+  /* Find the distinct data blocks, comparing hashes before contents;
+   * pPos receives the distinct block number of each block */
+  for(i = 0; i < CLASS_INDEX_LEN; i++) {
+    h = UINT32_C(2166136261);
+    for(j = 0; j < (CLASS_MASK + 1); j++) {
+      h = (h ^ ((uint32_t) b.pWords[(i << CLASS_SHIFT) + j])) *
+            UINT32_C(16777619);
+    }
+    pHash[i] = h;
+    
+    pPos[i] = -1;
+    for(j = 0; j < i; j++) {
+      if ((pHash[j] == h) && (pPos[j] >= 0) &&
+          (memcmp(b.pWords + (i << CLASS_SHIFT),
+                  b.pWords + (j << CLASS_SHIFT),
+                  (size_t) (CLASS_MASK + 1) * sizeof(uint16_t)) == 0)) {
+        pPos[i] = pPos[j];
+        break;
+      }
+    }
+    if (pPos[i] < 0) {
+      pPos[i] = ucount;
+      ucount++;
+    }
+  }
+  
+  /* Allocate the class and the table in a single block */
+  bcount = (CLASS_INDEX_LEN >> CLASS_SHIFT) + ucount;
+  pc = (UNIKIT_CLASS *) malloc(sizeof(UNIKIT_CLASS) +
+          (((size_t) bcount) << CLASS_SHIFT) * sizeof(uint16_t));
+  if (pc == NULL) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+  pTable = (uint16_t *) (pc + 1);
+  
+  /* Write the index and copy each distinct block at its first use */
+  for(i = 0; i < CLASS_INDEX_LEN; i++) {
+    j = (CLASS_INDEX_LEN >> CLASS_SHIFT) + pPos[i];
+    pTable[i] = (uint16_t) j;
+    memcpy(pTable + (j << CLASS_SHIFT),
+            b.pWords + (i << CLASS_SHIFT),
+            (size_t) (CLASS_MASK + 1) * sizeof(uint16_t));
+  }
+  
+  free(b.pWords);
+  free(pPos);
+  free(pHash);
+  
+  pc->pTable = pTable;
+  pc->len = bcount << CLASS_SHIFT;
+  pc->owned = 1;
+  
+  return pc;
+}
+
+/*
+ * unikit_class_free function.
+ */
+void unikit_class_free(UNIKIT_CLASS *pc) {
+  
+  if (pc == NULL) {
+    return;
+  }
+  if (!(pc->owned)) {
+    raiseErr(__LINE__, "Can't free standard character class");
+  }
+  free(pc);
+}
+
+/*
+ * unikit_class_std function.
+ */
+const UNIKIT_CLASS *unikit_class_std(int cls) {
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if ((cls < 0) || (cls >= CLASS_COUNT)) {
+    raiseErr(__LINE__, "Unrecognized character class");
+  }
+  
+  /* Make sure the class tables are loaded */
+  requireTables(TABLES_CLASS);
+  
+  return &(m_class_std[cls]);
+}
+
+/*
+ * unikit_class_test function.
+ */
+int unikit_class_test(const UNIKIT_CLASS *pc, int32_t cv) {
+  
+  const uint16_t *pTable = NULL;
+  uint16_t w = 0;
+  
+  /* Check parameters */
+  if (pc == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  if ((cv < 0) || (cv > 0x10ffff)) {
+    return 0;
+  }
+  
+  pTable = pc->pTable;
+  w = pTable[(((int32_t) pTable[cv >> CLASS_BLOCK_BITS]) << CLASS_SHIFT)
+              + ((cv >> 4) & CLASS_MASK)];
+  return (int) ((w >> (cv & 15)) & 1);
+}
+
+/*
+ * unikit_decoder_init function.
+ */
+void unikit_decoder_init(UNIKIT_DECODER *pd, int enc) {
+  
+  /* Check parameters */
+  if (pd == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((enc != UNIKIT_ENC_UTF8) && (enc != UNIKIT_ENC_UTF16LE) &&
+      (enc != UNIKIT_ENC_UTF16BE)) {
+    raiseErr(__LINE__, "Unrecognized decoder encoding");
+  }
+  
+  /* Initialize state */
+  memset(pd, 0, sizeof(UNIKIT_DECODER));
+  pd->enc = (uint8_t) enc;
+}
+
+/*
+ * unikit_decode function.
+ */
+size_t unikit_decode(
+          UNIKIT_DECODER * pd,
+    const uint8_t        * pSrc,
+          size_t           n,
+          int32_t        * pOut,
+          size_t           cap,
+          size_t         * pUsed) {
+  
+  /* Check parameters */
+  if (pd == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pSrc == NULL) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pOut == NULL) && (cap > 0)) {
+    raiseErr(__LINE__, NULL);
   }
   
-  /* Return the result */
-  return r;
+  return decodeStream(pd, pSrc, n, DECODE_CODEPOINTS,
+                        pOut, cap, pUsed);
 }
 
 /*
- * Public functions
- * ================
- * 
- * See the header for specifications.
+ * unikit_decode_category function.
  */
+size_t unikit_decode_category(
+          UNIKIT_DECODER * pd,
+    const uint8_t        * pSrc,
+          size_t           n,
+          uint16_t       * pOut,
+          size_t           cap,
+          size_t         * pUsed) {
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if (pd == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pSrc == NULL) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pOut == NULL) && (cap > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Load core table once for the whole chunk */
+  requireTables(TABLES_CORE);
+  
+  return decodeStream(pd, pSrc, n, DECODE_CATEGORIES,
+                        pOut, cap, pUsed);
+}
 
 /*
- * unikit_init function.
+ * unikit_decode_fold function.
  */
-void unikit_init(unikit_fp_err fpErr) {
-  /* Check not already initialized */
-  if (m_init) {
-    raiseErr(__LINE__, "Unikit already initialized");
+size_t unikit_decode_fold(
+          UNIKIT_DECODER * pd,
+    const uint8_t        * pSrc,
+          size_t           n,
+          uint8_t        * pDst,
+          size_t           cap,
+          size_t         * pUsed) {
+  
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
   }
   
-  /* Store the error handler (which may be NULL) and update init flag */
-  m_err = fpErr;
-  m_init = 1;
+  /* Check parameters */
+  if (pd == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pSrc == NULL) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  if ((pDst == NULL) && (cap > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
   
-  /* Decode tables */
-  m_case_lower = decodeUint16Array(
-                  unikit_data_fetch(UNIKIT_DATA_KEY_CASE_LOWER),
-                  &m_case_lower_len);
-  m_case_upper = decodeUint16Array(
-                  unikit_data_fetch(UNIKIT_DATA_KEY_CASE_UPPER),
-                  &m_case_upper_len);
-  m_case_data  = decodeUint16Array(
-                  unikit_data_fetch(UNIKIT_DATA_KEY_CASE_DATA),
-                  &m_case_data_len);
-  
-  m_gcat_core     = decodeUint16Array(
-                      unikit_data_fetch(UNIKIT_DATA_KEY_GCAT_CORE),
-                      &m_gcat_core_len);
-  m_gcat_gen_low  = decodeUint16Array(
-                      unikit_data_fetch(UNIKIT_DATA_KEY_GCAT_GEN_LOW),
-                      &m_gcat_gen_low_len);
-  m_gcat_gen_high = decodeUint16Array(
-                      unikit_data_fetch(UNIKIT_DATA_KEY_GCAT_GEN_HIGH),
-                      &m_gcat_gen_high_len);
-  m_gcat_bitmap   = decodeUint16Array(
-                      unikit_data_fetch(UNIKIT_DATA_KEY_GCAT_BITMAP),
-                      &m_gcat_bitmap_len);
-  m_gcat_astral   = decodeUint16Array(
-                      unikit_data_fetch(UNIKIT_DATA_KEY_GCAT_ASTRAL),
-                      &m_gcat_astral_len);
+  return decodeStream(pd, pSrc, n, DECODE_FOLDS, pDst, cap, pUsed);
 }
 
 /*
- * unikit_valid function.
+ * unikit_decode_end function.
  */
-int unikit_valid(int32_t cv) {
-  int result = 1;
+int unikit_decode_end(UNIKIT_DECODER *pd) {
   
-  if ((cv >= 0x0) && (cv <= 0x10ffff)) {
-    if ((cv >= 0xd800) && (cv <= 0xdfff)) {
-      result = 0;
+  int result = 0;
+  
+  /* Check parameters */
+  if (pd == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Held bytes are one incomplete sequence, except that a UTF-16 high
+   * surrogate followed by a single byte is two */
+  if (pd->pend_len > 0) {
+    result = 1;
+    if ((pd->enc != UNIKIT_ENC_UTF8) && (pd->pend_len > 2)) {
+      result = 2;
     }
-  } else {
-    result = 0;
   }
   
+  /* Reset the state for another stream */
+  pd->pend_len = 0;
+  
   return result;
 }
 
 /*
- * unikit_fold function.
+ * unikit_casecmp_utf8 function.
  */
-int unikit_fold(UNIKIT_FOLD *pf, int32_t cv) {
+int unikit_casecmp_utf8(
+    const uint8_t * pA,
+          size_t    alen,
+    const uint8_t * pB,
+          size_t    blen) {
   
-  int result = 0;
-  int plane = 0;
-  uint16_t r = 0;
-  int sqlen = 0;
-  int base = 0;
-  int i = 0;
+  FOLD_ITER ia;
+  FOLD_ITER ib;
+  uint64_t wa = 0;
+  uint64_t wb = 0;
+  int32_t ca = 0;
+  int32_t cb = 0;
   
   /* Check state */
-  if (!m_init) {
+  if (!isInit()) {
     raiseErr(__LINE__, "Unikit not initialized");
   }
   
   /* Check parameters */
-  if (pf == NULL) {
+  if (((pA == NULL) && (alen > 0)) || ((pB == NULL) && (blen > 0))) {
     raiseErr(__LINE__, NULL);
   }
-  if (!unikit_valid(cv)) {
-    raiseErr(__LINE__, NULL);
+  
+  /* Initialize iterators */
+  foldIterInit(&ia, pA, alen);
+  foldIterInit(&ib, pB, blen);
+  
+  /* Fold both sides in lockstep until the first difference */
+  while (1) {
+    /* Fast path for runs of ASCII on both sides, eight bytes at a time,
+     * which is only possible when neither side is partway through a
+     * multi-codepoint folding */
+    while ((ia.pos >= ia.len) && (ib.pos >= ib.len) &&
+            (alen - ia.i >= 8) && (blen - ib.i >= 8)) {
+      memcpy(&wa, pA + ia.i, 8);
+      memcpy(&wb, pB + ib.i, 8);
+      if (((wa | wb) & UINT64_C(0x8080808080808080)) != 0) {
+        break;
+      }
+      if (foldAscii8(wa) != foldAscii8(wb)) {
+        break;
+      }
+      STAT_ADD(fold_ascii, 16);
+      ia.i += 8;
+      ib.i += 8;
+    }
+    
+    /* Compare the next folded codepoints; the end of either side is -1,
+     * which orders it before any codepoint */
+    ca = foldIterNext(&ia);
+    cb = foldIterNext(&ib);
+    if (ca != cb) {
+      return (ca < cb) ? -1 : 1;
+    }
+    if (ca < 0) {
+      break;
+    }
   }
   
-  /* Clear result structure */
-  memset(pf, 0, sizeof(UNIKIT_FOLD));
+  return 0;
+}
+
+/*
+ * unikit_casehash_utf8 function.
+ */
+uint64_t unikit_casehash_utf8(
+    const uint8_t * pSrc,
+          size_t    n,
+          uint64_t  seed) {
   
-  /* Determine the plane, 0 or 1, or -1 if some other plane */
-  if ((cv >= 0) && (cv <= 0xffff)) {
-    plane = 0;
+  FOLD_ITER it;
+  uint64_t h = 0;
+  int32_t cv = 0;
+  uint8_t ebuf[4];
+  int elen = 0;
+  int j = 0;
   
-  } else if ((cv >= 0x10000) && (cv <= 0x1ffff)) {
-    plane = 1;
+  /* Initialize buffers */
+  memset(ebuf, 0, sizeof(ebuf));
   
-  } else {
-    plane = -1;
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
   }
   
-  /* If in plane 0 or 1, query the appropriate trie using the 16 least
-   * significant bits of the codepoint; if in another plane, just set a
-   * failed query result */
-  if (plane == 0) {
-    r = queryTrie(m_case_lower, m_case_lower_len,
-                    (uint32_t) (cv & 0xffff), 4);
-    
-  } else if (plane == 1) {
-    r = queryTrie(m_case_upper, m_case_upper_len,
-                    (uint32_t) (cv & 0xffff), 4);
-    
-  } else {
-    r = 0xffff;
+  /* Check parameters */
+  if ((pSrc == NULL) && (n > 0)) {
+    raiseErr(__LINE__, NULL);
   }
   
-  /* If we found a record, copy codepoints into result structure;
-   * otherwise, use a trivial mapping */
-  if (r != 0xffff) {
-    /* Extract fields from the data key */
-    sqlen = ((int) (r & 0x3)) + 1;
-    base = (int) (r >> 2);
-    
-    /* Check that range is within data array bounds */
-    if (base > m_case_data_len - ((int32_t) sqlen)) {
-      raiseErr(__LINE__, "Data bound error");
-    }
-    
-    /* Copy the codepoint array, increasing codepoint values by 0x10000
-     * if they are in the upper plane */
-    pf->len = (uint8_t) sqlen;
-    for(i = 0; i < sqlen; i++) {
-      (pf->cpa)[i] = (int32_t) m_case_data[base + i];
-      if (plane == 1) {
-        (pf->cpa)[i] += 0x10000;
-      }
-    }
-    
-    /* Determine if mapping is trivial */
-    if (pf->len == 1) {
-      if ((pf->cpa)[0] == cv) {
-        result = 0;
-      } else {
-        result = 1;
-      }
+  /* Hash the UTF-8 encoding of each folded codepoint */
+  foldIterInit(&it, pSrc, n);
+  h = CASEHASH_BASIS ^ seed;
+  for(cv = foldIterNext(&it); cv >= 0; cv = foldIterNext(&it)) {
+    if (cv < 0x80) {
+      h ^= (uint64_t) cv;
+      h *= CASEHASH_PRIME;
       
     } else {
-      result = 1;
+      elen = encodeUtf8(cv, ebuf);
+      for(j = 0; j < elen; j++) {
+        h ^= (uint64_t) ebuf[j];
+        h *= CASEHASH_PRIME;
+      }
     }
-    
-  } else {
-    /* Trivial mapping */
-    (pf->cpa)[0] = cv;
-    pf->len = UINT8_C(1);
-    result = 0;
   }
   
-  /* Return trivial indicator */
-  return result;
+  return h;
 }
 
 /*
- * unikit_category function.
+ * unikit_casefind_compile function.
  */
-uint16_t unikit_category(int32_t cv) {
+UNIKIT_CASEFIND *unikit_casefind_compile(
+    const uint8_t * pNeedle,
+          size_t    m) {
   
-  uint16_t result = 0;
-  int32_t lbound = 0;
-  int32_t ubound = 0;
-  int32_t mid = 0;
+  UNIKIT_CASEFIND *pf = NULL;
+  int32_t *pFold = NULL;
+  FOLD_ITER it;
+  size_t count = 0;
+  int32_t cv = 0;
   
-  int cr = 0;
-  int plane = 0;
-  int32_t offs = 0;
-  uint16_t r_plane = 0;
-  uint16_t r_lower = 0;
-  uint16_t r_upper = 0;
+  /* Check state */
+  if (!isInit()) {
+    raiseErr(__LINE__, "Unikit not initialized");
+  }
+  
+  /* Check parameters */
+  if ((pNeedle == NULL) && (m > 0)) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Count the folded codepoints of the needle */
+  foldIterInit(&it, pNeedle, m);
+  for(cv = foldIterNext(&it); cv >= 0; cv = foldIterNext(&it)) {
+    count++;
+  }
+  if (count > (SIZE_MAX - sizeof(UNIKIT_CASEFIND)) / sizeof(int32_t)) {
+    raiseErr(__LINE__, "Needle too long");
+  }
+  
+  /* Allocate the search and the folded needle in a single block */
+  pf = (UNIKIT_CASEFIND *) malloc(sizeof(UNIKIT_CASEFIND) +
+          count * sizeof(int32_t));
+  if (pf == NULL) {
+    raiseErr(__LINE__, "Out of memory");
+  }
+  memset(pf, 0, sizeof(UNIKIT_CASEFIND));
+  pFold = (int32_t *) (pf + 1);
+  
+  /* Store the folded needle */
+  foldIterInit(&it, pNeedle, m);
+  for(cv = foldIterNext(&it); cv >= 0; cv = foldIterNext(&it)) {
+    pFold[pf->len] = cv;
+    (pf->len)++;
+  }
+  pf->pFold = pFold;
+  
+  /* Build the filter, unless the needle is empty */
+  if (pf->len > 0) {
+    casefindFilter(pf);
+  }
+  
+  return pf;
+}
+
+/*
+ * unikit_casefind_free function.
+ */
+void unikit_casefind_free(UNIKIT_CASEFIND *pf) {
+  if (pf != NULL) {
+    free(pf);
+  }
+}
+
+/*
+ * unikit_casefind_utf8 function.
+ */
+int unikit_casefind_utf8(
+    const UNIKIT_CASEFIND * pf,
+    const uint8_t         * pSrc,
+          size_t            n,
+          size_t          * pOff,
+          size_t          * pLen) {
+  
+  uint64_t w = 0;
+  uint64_t mw = 0;
+  size_t adv = 0;
+  size_t end = 0;
+  size_t i = 0;
+  int found = 0;
   
   /* Check state */
-  if (!m_init) {
+  if (!isInit()) {
     raiseErr(__LINE__, "Unikit not initialized");
   }
   
-  /* Default result if we don't find anything is Cn */
-  result = UNIKIT_GCAT_Cn;
+  /* Check parameters */
+  if ((pf == NULL) || ((pSrc == NULL) && (n > 0))) {
+    raiseErr(__LINE__, NULL);
+  }
   
-  /* Handling depends on range */
-  if ((cv >= 0) && (cv <= 0xff)) {
-    /* In core range, so use the core lookup */
-    if (m_gcat_core_len != 256) {
-      raiseErr(__LINE__, "Invalid core table length");
-    }
-    result = m_gcat_core[cv];
-    
-  } else if ((cv >= 0x100) && (cv <= 0x1ffff)) {
-    /* In general range, so first we want to compute the offset and
-     * shift value for this codepoint within the character bitmap */
-    offs  = cv - 0x100;
-    plane = (int) ((offs % 8) * 2);
-    offs  = offs / 8;
+  /* An empty needle matches at the start */
+  if (pf->len < 1) {
+    found = 1;
     
-    /* Get the bitmap value for this codepoint */
-    if (offs >= m_gcat_bitmap_len) {
-      raiseErr(__LINE__, "Bitmap query out of range");
-    }
-    result = (uint16_t) ((m_gcat_bitmap[offs] >> plane) & 0x3);
-    
-    /* Decode the bitmap value */
-    if (result == 1) {
-      result = UNIKIT_GCAT_Lo;
-      
-    } else if (result == 2) {
-      result = UNIKIT_GCAT_Ll;
-      
-    } else if (result == 3) {
-      result = UNIKIT_GCAT_So;
-      
-    } else if (result == 0) {
-      /* Bitmap didn't answer our question, so our next attempt is to
-       * query the general character table tries */
-      if (cv <= 0xffff) {
-        result = queryTrie(m_gcat_gen_low, m_gcat_gen_low_len,
-                    (uint32_t) cv, 4);
-      } else {
-        result = queryTrie(m_gcat_gen_high, m_gcat_gen_high_len,
-                    (uint32_t) (cv & 0xffff), 4);
+  } else if (pf->exact) {
+    /* Check every codepoint boundary in the exact mode */
+    for(i = 0; i < n; i += adv) {
+      if (casefindAt(pf, pSrc, n, i, &end)) {
+        found = 1;
+        break;
       }
-      
-      /* If general character table didn't get a result, our last
-       * attempt is to use the hardcoded remainder table */
-      if (result == 0xffff) {
-        /* Reset result to Cn in case hardcoded tables don't work */
-        result = UNIKIT_GCAT_Cn;
-        
-        /* Check hardcoded tables (derived from the "remainder"
-         * invocation  of the unikit_db.pl script) */
-        if ((cv >= 0xd800) && (cv <= 0xdfff)) {
-          result = UNIKIT_GCAT_Cs;
-        
-        } else if ((cv >= 0xe000) && (cv <= 0xf8ff)) {
-          result = UNIKIT_GCAT_Co;
-        }
+      if (pSrc[i] < 0x80) {
+        adv = 1;
+      } else {
+        decodeUtf8(pSrc + i, n - i, &adv);
       }
-      
-    } else {
-      raiseErr(__LINE__, NULL);
-    }
-    
-  } else if ((cv >= 0x20000) && (cv <= 0x10ffff)) {
-    /* Astral range, so make sure astral table is non-empty and has
-     * length divisible by four */
-    if ((m_gcat_astral_len < 1) || ((m_gcat_astral_len % 4) != 0)) {
-      raiseErr(__LINE__, "Invalid astral table length");
     }
     
-    /* Determine plane and offset of codepoint */
-    plane = (int) (cv >> 16);
-    offs = (cv & 0xffff);
-    
-    /* Search lower bound is zero and upper bound is maximum astral
-     * record index */
-    lbound = 0;
-    ubound = (m_gcat_astral_len / 4) - 1;
-    
-    /* Zoom in on the relevant record */
-    while (lbound < ubound) {
-      /* Midpoint record is halfway between, and at least one above
-       * lower bound */
-      mid = lbound + ((ubound - lbound) / 2);
-      if (mid <= lbound) {
-        mid = lbound + 1;
+  } else {
+    while (i < n) {
+      /* Skip eight bytes at a time while the word has no byte that
+       * could begin a match; words with non-ASCII bytes are always
+       * checked byte by byte through the lead table */
+      while (n - i >= 9) {
+        memcpy(&w, pSrc + i, 8);
+        if ((w & UINT64_C(0x8080808080808080)) != 0) {
+          break;
+        }
+        if (pf->filter > 0) {
+          mw = matchAscii8(foldAscii8(w), pf->first);
+          if ((mw != 0) && (pf->filter > 1)) {
+            /* The next codepoint of a match at an ASCII byte starts at
+             * the byte after it, so also check the following word */
+            memcpy(&w, pSrc + i + 1, 8);
+            if ((w & UINT64_C(0x8080808080808080)) == 0) {
+              mw &= matchAscii8(foldAscii8(w), pf->second);
+            }
+          }
+          if (mw != 0) {
+            break;
+          }
+        }
+        i += 8;
       }
       
-      /* Get key fields of midpoint record */
-      r_plane = m_gcat_astral[(mid * 4)    ];
-      r_lower = m_gcat_astral[(mid * 4) + 1];
-      
-      /* Compare query plane and offset to midpoint record plane */
-      if (plane < r_plane) {
-        cr = -1;
-        
-      } else if (plane > r_plane) {
-        cr = 1;
-        
-      } else if (plane == r_plane) {
-        if (offs < r_lower) {
-          cr = -1;
-          
-        } else if (offs > r_lower) {
-          cr = 1;
-          
-        } else if (offs == r_lower) {
-          cr = 0;
-          
-        } else {
-          raiseErr(__LINE__, NULL);
+      /* Check the bytes of the next word through the lead table; lead
+       * bytes are never continuation bytes, so each of them is on a
+       * codepoint boundary */
+      end = (n - i > 8) ? (i + 8) : n;
+      for( ; i < end; i++) {
+        if ((pf->lead)[pSrc[i]]) {
+          if (casefindAt(pf, pSrc, n, i, &adv)) {
+            found = 1;
+            break;
+          }
         }
-        
-      } else {
-        raiseErr(__LINE__, NULL);
       }
-      
-      /* Update boundaries depending on result of comparison */
-      if (cr < 0) {
-        /* Query is less than midpoint record, so new upper bound is one
-         * less than midpoint */
-        ubound = mid - 1;
-        
-      } else if (cr > 0) {
-        /* Query is greater than midpoint record, so new lower bound is
-         * the midpoint */
-        lbound = mid;
-        
-      } else if (cr == 0) {
-        /* Query exactly matches lower bound of record, so zoom in */
-        lbound = mid;
-        ubound = mid;
-        
-      } else {
-        raiseErr(__LINE__, NULL);
+      if (found) {
+        end = adv;
+        break;
       }
     }
-    
-    /* lbound is the selected record, so get its key fields */
-    r_plane = m_gcat_astral[(lbound * 4)    ];
-    r_lower = m_gcat_astral[(lbound * 4) + 1];
-    r_upper = m_gcat_astral[(lbound * 4) + 2];
-    
-    /* If the requested codepoint is covered by this selected record,
-     * then query result is the category in the record; else, leave
-     * query result at Cn */
-    if ((plane == r_plane) && (offs >= r_lower) && (offs <= r_upper)) {
-      result = m_gcat_astral[(lbound * 4) + 3];
-    }
   }
   
-  /* Return result */
-  return result;
+  /* Report the match, if any */
+  if (!found) {
+    return 0;
+  }
+  if (pOff != NULL) {
+    *pOff = i;
+  }
+  if (pLen != NULL) {
+    *pLen = end - i;
+  }
+  return 1;
+}
+
+/*
+ * unikit_stats_get function.
+ */
+int unikit_stats_get(UNIKIT_STATS *ps) {
+  
+  /* Check parameters */
+  if (ps == NULL) {
+    raiseErr(__LINE__, NULL);
+  }
+  
+  /* Copy the counters of this thread, if they are kept */
+#ifdef UNIKIT_INSTRUMENT
+  memcpy(ps, &m_stats, sizeof(UNIKIT_STATS));
+  return 1;
+#else
+  memset(ps, 0, sizeof(UNIKIT_STATS));
+  return 0;
+#endif
+}
+
+/*
+ * unikit_stats_reset function.
+ */
+void unikit_stats_reset(void) {
+#ifdef UNIKIT_INSTRUMENT
+  memset(&m_stats, 0, sizeof(UNIKIT_STATS));
+#endif
 }
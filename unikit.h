@@ -12,11 +12,74 @@
  * 
  * The unikit_data.c module is the only requirement.  It stores the data
  * tables needed by this library.
+ * 
+ * Build modes
+ * -----------
+ * 
+ * By default, the data tables are stored as base-64 strings that are
+ * decoded into dynamically allocated arrays.  Tables are decoded in
+ * groups on first use, so that a program which only ever queries the
+ * categories of U+0000 to U+00FF decodes only the core table, and a
+ * program which never case folds beyond ASCII never decodes the case
+ * folding tables.  All the tables of a group are decoded into a single
+ * allocation, with each table aligned to a 64-byte cache line.  Within
+ * each table, the blocks used by Latin, Greek, Cyrillic, and CJK text
+ * are stored first, so that typical text touches only a few cache
+ * lines and pages of each table.  Alternatively, unikit_init_memory()
+ * decodes every group at once into a single block provided by the
+ * caller.
+ * 
+ * If UNIKIT_STATIC_TABLES is defined when compiling both unikit.c and
+ * unikit_data.c, the data tables are instead stored as constant arrays
+ * that are used in place.  Initialization then performs no decoding or
+ * allocation, and the read-only table pages are shared between all
+ * processes that load the same binary.
+ * 
+ * If UNIKIT_STAGE_TABLES is defined when compiling unikit.c, the case
+ * folding indices and the general character tables are looked up as
+ * two-stage tables instead of nybble tries.  Each lookup then takes two
+ * dependent memory loads instead of four, at the cost of about four
+ * fifths more table memory for those tables.
+ * 
+ * If UNIKIT_UNIFIED_GCAT is defined when compiling unikit.c, the
+ * general categories of U+0100 to U+1FFFF are looked up in a single
+ * two-stage table of category indices instead of the chain of the
+ * character bitmap, the general character tables, and the hardcoded
+ * surrogate and private use ranges.  Every codepoint in that range then
+ * takes the same path of two memory loads.  The bitmap and general
+ * character tables are not loaded in this mode.
+ * 
+ * The shapes of the data tables are verified once when each group of
+ * tables is loaded, so that the lookups do not need to check table
+ * lengths and bounds on every call.  If UNIKIT_CHECKED is defined when
+ * compiling unikit.c, the lookups also check every table access, which
+ * is slower but useful when debugging changes to the tables or to the
+ * lookup code.  The parameters of the public functions are checked in
+ * all build modes.
+ * 
+ * If UNIKIT_INSTRUMENT is defined when compiling unikit.c, the lookups
+ * count which tiers of the data tables they use, in counters kept
+ * separately for each thread.  See unikit_stats_get().  The counters
+ * cost a few memory writes on every lookup, so this mode is meant for
+ * profiling real workloads rather than for production builds.
+ * 
+ * Inline header
+ * -------------
+ * 
+ * The generated unikit_inline.h header has static inline versions of a
+ * few lookups, which answer the core range U+0000 to U+00FF from
+ * a constant table in the header, so that they can be inlined and
+ * folded by the compiler.  They are constexpr when compiled as C++.
+ * See that header for further information.
  */
 
 #include <stddef.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /*
  * Constants
  * =========
@@ -101,6 +164,51 @@
 #define UNIKIT_CTGR_Z UINT16_C(0x5a00)  /* Group Z: Separatos */
 #define UNIKIT_CTGR_C UINT16_C(0x4300)  /* Group C: Other */
 
+/*
+ * The input encodings of the streaming decoder.
+ * 
+ * See unikit_decoder_init() for further information.
+ */
+#define UNIKIT_ENC_UTF8    (0)  /* UTF-8 */
+#define UNIKIT_ENC_UTF16LE (1)  /* UTF-16, little endian */
+#define UNIKIT_ENC_UTF16BE (2)  /* UTF-16, big endian */
+
+/*
+ * The standard character classes.
+ * 
+ * See unikit_class_std() for further information.
+ */
+#define UNIKIT_CLASS_L  (0)   /* Group L: Letters */
+#define UNIKIT_CLASS_N  (1)   /* Group N: Numbers */
+#define UNIKIT_CLASS_Z  (2)   /* Group Z: Separators */
+#define UNIKIT_CLASS_LC (3)   /* Cased letters: Lu, Ll and Lt */
+
+/*
+ * The property flags of a combined property record.
+ * 
+ * The general category is in the 16 least significant bits of the
+ * record, and UNIKIT_PROP_GCAT() extracts it.  The flags are in the
+ * bits above it.  UNIKIT_PROP_SPACE is the White_Space property, which
+ * is group Z along with the controls U+0009 to U+000D and U+0085.
+ * 
+ * See unikit_props() for further information.
+ */
+#define UNIKIT_PROP_FOLD   (UINT32_C(1) << 16) /* Has a case folding */
+#define UNIKIT_PROP_EXPAND (UINT32_C(1) << 17) /* Folds to several */
+#define UNIKIT_PROP_LETTER (UINT32_C(1) << 18) /* Group L: Letters */
+#define UNIKIT_PROP_CASED  (UINT32_C(1) << 19) /* Lu, Ll and Lt */
+#define UNIKIT_PROP_NUMBER (UINT32_C(1) << 20) /* Group N: Numbers */
+#define UNIKIT_PROP_DIGIT  (UINT32_C(1) << 21) /* Nd: decimal digit */
+#define UNIKIT_PROP_SPACE  (UINT32_C(1) << 22) /* White space */
+
+#define UNIKIT_PROP_GCAT(p) ((uint16_t) ((p) & UINT32_C(0xffff)))
+
+/*
+ * The lengths of the histogram arrays in the UNIKIT_STATS structure.
+ */
+#define UNIKIT_STATS_SCAN_LEN (8)
+#define UNIKIT_STATS_TRIE_LEN (8)
+
 /*
  * Type declarations
  * =================
@@ -122,6 +230,162 @@ typedef struct {
   
 } UNIKIT_FOLD;
 
+/*
+ * Represents the state of a streaming decoder.
+ * 
+ * The state must be initialized with unikit_decoder_init() before use.
+ * Its fields are private to the Unikit module.  The state holds no
+ * resources, so it may simply be discarded when no longer needed.
+ */
+typedef struct {
+  /*
+   * The bytes of an incomplete sequence at the end of the last chunk.
+   */
+  uint8_t pend[4];
+  
+  /*
+   * The number of bytes in pend, in range 0 to 3.
+   */
+  uint8_t pend_len;
+  
+  /*
+   * The input encoding, which is one of the UNIKIT_ENC constants.
+   */
+  uint8_t enc;
+  
+} UNIKIT_DECODER;
+
+/*
+ * Represents a compiled character class.
+ * 
+ * A character class is a set of codepoints, stored as a bitset with one
+ * bit per codepoint.  Character classes are either compiled with
+ * unikit_class_compile() or fetched with unikit_class_std().  The
+ * fields are private to the Unikit module, and the bitset is never
+ * modified after it is compiled.
+ */
+typedef struct {
+  /*
+   * The bitset, compiled as a two-stage table.
+   */
+  const uint16_t *pTable;
+  
+  /*
+   * The number of elements in pTable.
+   */
+  int32_t len;
+  
+  /*
+   * Non-zero if this class was allocated by unikit_class_compile().
+   */
+  int owned;
+  
+} UNIKIT_CLASS;
+
+/*
+ * Represents a compiled case-insensitive search.
+ * 
+ * A search is compiled from a needle with unikit_casefind_compile()
+ * and may then be run over any number of haystacks with
+ * unikit_casefind_utf8().  The fields are private to the Unikit module,
+ * and the search is never modified after it is compiled.
+ */
+typedef struct {
+  /*
+   * The case folded codepoints of the needle.
+   */
+  const int32_t *pFold;
+  
+  /*
+   * The number of codepoints in pFold.
+   */
+  size_t len;
+  
+  /*
+   * The word filter for the first and second codepoints of pFold, each
+   * replicated into every byte, when they are ASCII.
+   */
+  uint64_t first;
+  uint64_t second;
+  
+  /*
+   * The number of codepoints in the word filter, in range zero to two.
+   */
+  int filter;
+  
+  /*
+   * Non-zero if every codepoint boundary of a haystack must be checked,
+   * because the needle begins with U+FFFD.
+   */
+  int exact;
+  
+  /*
+   * Non-zero for each byte that begins a UTF-8 sequence whose case
+   * folding begins with the first codepoint of pFold.
+   */
+  uint8_t lead[256];
+  
+} UNIKIT_CASEFIND;
+
+/*
+ * Lookup counters of the UNIKIT_INSTRUMENT build mode.
+ * 
+ * See unikit_stats_get() for further information.
+ */
+typedef struct {
+  /*
+   * The number of general category lookups answered by each tier.
+   * 
+   * cat_core is the core table for U+0000 to U+00FF, including the
+   * ASCII fast paths of the buffer functions.  cat_bitmap is the
+   * character bitmap, cat_gen is the general character tables, and
+   * cat_remainder is the hardcoded surrogate and private use ranges,
+   * along with the codepoints of U+0100 to U+1FFFF that none of the
+   * earlier tiers answered.  cat_unified is the unified category table,
+   * which replaces the bitmap, general and remainder tiers in the
+   * UNIKIT_UNIFIED_GCAT build mode.  cat_astral is the astral table for
+   * U+20000 and above.  cat_invalid is values that are not codepoints.
+   */
+  uint64_t cat_core;
+  uint64_t cat_bitmap;
+  uint64_t cat_gen;
+  uint64_t cat_remainder;
+  uint64_t cat_unified;
+  uint64_t cat_astral;
+  uint64_t cat_invalid;
+  
+  /*
+   * Histogram of astral lookups by the number of astral records that
+   * were passed over before the scan stopped.  The last element also
+   * counts all longer scans.
+   */
+  uint64_t astral_scan[UNIKIT_STATS_SCAN_LEN];
+  
+  /*
+   * Histogram of nybble trie lookups by the number of trie levels that
+   * were read.  Element zero counts lookups that read one level.
+   */
+  uint64_t trie_levels[UNIKIT_STATS_TRIE_LEN];
+  
+  /*
+   * The number of two-stage table lookups, each of which reads exactly
+   * two levels.
+   */
+  uint64_t stage_queries;
+  
+  /*
+   * The number of ASCII codepoints case folded without a table lookup.
+   */
+  uint64_t fold_ascii;
+  
+  /*
+   * Histogram of the other case foldings by the number of codepoints
+   * in the result.  Element zero counts results of one codepoint.
+   */
+  uint64_t fold_len[4];
+  
+} UNIKIT_STATS;
+
 /*
  * Function pointer types
  * ======================
@@ -148,6 +412,83 @@ typedef struct {
  */
 typedef void (*unikit_fp_err)(int lnum, const char *pDetail);
 
+/*
+ * Callback for receiving the general category runs of
+ * unikit_category_runs().
+ * 
+ * pCustom is the custom parameter that was passed through to
+ * unikit_category_runs().
+ * 
+ * lo and hi are the first and last codepoint of the run, inclusive.
+ * Every codepoint in the run has the general category gcat, which is
+ * one of the UNIKIT_GCAT constants.
+ * 
+ * The callback returns non-zero to continue with the next run, or zero
+ * to stop the walk.
+ * 
+ * Parameters:
+ * 
+ *   pCustom - the custom parameter
+ * 
+ *   lo - the first codepoint of the run
+ * 
+ *   hi - the last codepoint of the run
+ * 
+ *   gcat - the general category of the run
+ * 
+ * Return:
+ * 
+ *   non-zero to continue, zero to stop
+ */
+typedef int (*unikit_fp_run)(
+    void     * pCustom,
+    int32_t    lo,
+    int32_t    hi,
+    uint16_t   gcat);
+
+/*
+ * A job of a parallel buffer function, which is passed to the executor.
+ * 
+ * pJob is the job state that was passed to the executor, and i is the
+ * index of the chunk to process, in range zero up to the chunk count.
+ * 
+ * Parameters:
+ * 
+ *   pJob - the job state
+ * 
+ *   i - the chunk index
+ */
+typedef void (*unikit_fp_job)(void *pJob, size_t i);
+
+/*
+ * Executor callback of the parallel buffer functions, such as
+ * unikit_fold_utf8_par().
+ * 
+ * pCustom is the custom parameter that was passed through to the
+ * parallel buffer function.
+ * 
+ * The executor must call fpJob(pJob, i) exactly once for each i from
+ * zero up to but excluding count.  The calls may happen in any order,
+ * on any threads, and concurrently with each other.  The executor must
+ * not return until every call has returned.  A thread pool typically
+ * implements this by queuing count tasks and then waiting for them.
+ * 
+ * Parameters:
+ * 
+ *   pCustom - the custom parameter
+ * 
+ *   fpJob - the job function to call for each chunk
+ * 
+ *   pJob - the job state to pass to fpJob
+ * 
+ *   count - the number of chunks
+ */
+typedef void (*unikit_fp_exec)(
+    void          * pCustom,
+    unikit_fp_job   fpJob,
+    void          * pJob,
+    size_t          count);
+
 /*
  * Public functions
  * ================
@@ -161,12 +502,136 @@ typedef void (*unikit_fp_err)(int lnum, const char *pDetail);
  * to NULL for a default handler.  See the unikit_fp_err documentation
  * for further information about the handler.
  * 
+ * Initialization is reference counted.  The first call installs the
+ * error handler, and the data tables are then loaded as they are first
+ * needed.  Each further call only adds a reference to the shared
+ * tables, and its error handler is ignored.  This allows several
+ * independent components of a program to each initialize Unikit while
+ * sharing one copy of the tables.
+ * 
+ * When compiled with C11 atomics, this function may be called
+ * concurrently from multiple threads, and tables loaded on first use by
+ * any thread are safely published to all other threads.  Without C11
+ * atomics, all tables are loaded by the first call instead, and calls
+ * to this function and to unikit_shutdown() must not be made
+ * concurrently.
+ * 
  * Parameters:
  * 
  *   fpErr - the custom error handler, or NULL for a default handler
  */
 void unikit_init(unikit_fp_err fpErr);
 
+/*
+ * Initialize the Unikit module with tables from a binary data file.
+ * 
+ * This is the same as unikit_init(), except that the data tables are
+ * not taken from the unikit_data.c module.  Instead, the data file at
+ * the given path is memory-mapped read-only and its tables are used in
+ * place, without any decoding or copying.  The pages of the file can
+ * then be shared by every process that maps the same file, and the
+ * Unicode data can be upgraded by replacing the file without
+ * recompiling.  Data files are generated with the datafile invocation
+ * of the unikit_db.pl script.
+ * 
+ * The header, directory, and table checksums of the file are verified
+ * before it is used, and the file must hold every table that this
+ * build of the library uses, each with a valid shape.  If the file can
+ * not be opened or mapped, or it is not a valid data file for this
+ * platform and build, zero is returned and the module remains
+ * uninitialized, so that the caller may fall back to unikit_init().
+ * Data files are little endian, so they are always rejected on
+ * big-endian platforms.  Memory mapping is only supported on POSIX
+ * platforms; elsewhere this function always returns zero.
+ * 
+ * If the module is already initialized, this function only adds a
+ * reference in the same way as unikit_init(), the tables that are
+ * already in use remain in use, and the path is ignored.
+ * 
+ * The file must not be modified while it is mapped.  Replace it with a
+ * new file instead, which takes effect the next time the module is
+ * initialized.
+ * 
+ * Parameters:
+ * 
+ *   pPath - the path to the data file
+ * 
+ *   fpErr - the custom error handler, or NULL for a default handler
+ * 
+ * Return:
+ * 
+ *   non-zero if successful, zero if the data file could not be used
+ */
+int unikit_init_mapped(const char *pPath, unikit_fp_err fpErr);
+
+/*
+ * Return the size of the memory block that unikit_init_memory()
+ * requires.
+ * 
+ * The size is exact for the data tables compiled into this build, and
+ * it already includes the slack needed to align the tables, so a block
+ * with any alignment will do.  This function may be called before the
+ * module is initialized.  It returns zero if the module was compiled
+ * with UNIKIT_STATIC_TABLES, since the tables then need no memory.
+ * 
+ * Return:
+ * 
+ *   the required size of the memory block in bytes
+ */
+size_t unikit_init_size(void);
+
+/*
+ * Initialize the Unikit module with tables decoded into a memory block
+ * provided by the caller.
+ * 
+ * This is the same as unikit_init(), except that every data table is
+ * decoded right away into the given block, one group after another,
+ * instead of into memory that is allocated as each group is first
+ * needed.  Table lookups then never allocate memory, so the memory
+ * used by the tables is known in advance and can come from a pool or
+ * a static buffer.  Use unikit_init_size() to get the required size of
+ * the block.
+ * 
+ * If the block is smaller than unikit_init_size(), zero is returned
+ * and the module remains uninitialized.  If the module is already
+ * initialized, this function only adds a reference in the same way as
+ * unikit_init(), and the block is not used.
+ * 
+ * The block must remain valid and unmodified until the last reference
+ * is released with unikit_shutdown(), after which the caller may free
+ * it.  Only the data tables are placed in the block; functions such as
+ * unikit_class_compile() still allocate their own memory.
+ * 
+ * Parameters:
+ * 
+ *   pMem - the memory block
+ * 
+ *   mem_len - the size of the memory block in bytes
+ * 
+ *   fpErr - the custom error handler, or NULL for a default handler
+ * 
+ * Return:
+ * 
+ *   non-zero if successful, zero if the block is too small
+ */
+int unikit_init_memory(void *pMem, size_t mem_len, unikit_fp_err fpErr);
+
+/*
+ * Release a reference acquired with unikit_init(),
+ * unikit_init_mapped(), or unikit_init_memory().
+ * 
+ * Each successful initialization call should be matched by one call to
+ * this function.  When the last reference is released, the data tables
+ * are freed or unmapped and the module returns to its uninitialized
+ * state, after which it may be initialized again.  A memory block
+ * given to unikit_init_memory() is not freed, since it belongs to the
+ * caller.  An error occurs if the module is not initialized.
+ * 
+ * Releasing the last reference while another thread is still calling
+ * other functions of this module is undefined behavior.
+ */
+void unikit_shutdown(void);
+
 /*
  * Check whether the given integer value is a valid Unicode codepoint.
  * 
@@ -210,6 +675,181 @@ int unikit_valid(int32_t cv);
  */
 int unikit_fold(UNIKIT_FOLD *pf, int32_t cv);
 
+/*
+ * Perform case folding on a whole buffer of UTF-8 text.
+ * 
+ * pSrc points to n bytes of UTF-8 input.  pSrc may only be NULL if n is
+ * zero.  The input does not need to be nul-terminated, and any nul
+ * bytes within it are passed through unchanged.
+ * 
+ * The input is decoded, every codepoint is case folded in the same way
+ * as unikit_fold(), and the result is encoded in UTF-8 into the output
+ * buffer pDst, which has a capacity of cap bytes.  pDst may only be
+ * NULL if cap is zero.  The input and output buffers must not overlap.
+ * 
+ * Ill-formed UTF-8 sequences in the input are replaced with U+FFFD,
+ * using the maximal subpart practice recommended by the Unicode
+ * Standard.  Runs of ASCII are handled with a fast path that does not
+ * consult the case folding tables.
+ * 
+ * The return value is always the total number of bytes required for the
+ * complete case folded output.  If it is less than or equal to cap, the
+ * whole output was written to pDst.  If it is greater than cap, the
+ * output did not fit, the contents of pDst are undefined, and the call
+ * should be repeated with a buffer of at least the returned size.  You
+ * can determine the required size without writing any output by passing
+ * NULL and zero for pDst and cap.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-8 input
+ * 
+ *   n - the number of input bytes
+ * 
+ *   pDst - the output buffer, or NULL
+ * 
+ *   cap - the capacity of the output buffer in bytes
+ * 
+ * Return:
+ * 
+ *   the number of bytes in the complete case folded output
+ */
+size_t unikit_fold_utf8(
+    const uint8_t * pSrc,
+          size_t    n,
+          uint8_t * pDst,
+          size_t    cap);
+
+/*
+ * Perform case folding on a whole buffer of UTF-8 text, split into
+ * chunks that are processed in parallel.
+ * 
+ * The parameters pSrc, n, pDst, and cap and the return value are the
+ * same as for unikit_fold_utf8(), and the output is always identical to
+ * the output of that function.
+ * 
+ * The input is split into chunks of about chunk bytes each, or 1 MiB
+ * each if chunk is zero.  Each split is moved forward by up to three
+ * bytes so that it never falls inside a UTF-8 sequence, nor inside an
+ * ill-formed sequence that would be replaced by a single U+FFFD.
+ * 
+ * The chunks are handed to the executor fpExec, which may process them
+ * on as many threads as it likes.  See unikit_fp_exec for the contract
+ * of the executor.  pCustom is passed through to the executor.  If
+ * fpExec is NULL, the chunks are processed one after another on the
+ * calling thread.
+ * 
+ * Since the length of the case folded output of a chunk is not known in
+ * advance, the work is done in two parallel passes.  The first pass
+ * measures the output length of every chunk.  If the complete output
+ * fits within cap, the second pass then folds each chunk directly into
+ * its position within pDst.  The total work is therefore about twice
+ * the work of unikit_fold_utf8(), but both passes scale with the
+ * number of threads.  Passing NULL and zero for pDst and cap only runs
+ * the first pass.
+ * 
+ * The module must be initialized.  The job state is allocated on the
+ * heap and released before the function returns.  Case folding might
+ * be performed from the executor threads, so any error handler must be
+ * safe to call from those threads.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-8 input
+ * 
+ *   n - the number of input bytes
+ * 
+ *   pDst - the output buffer, or NULL
+ * 
+ *   cap - the capacity of the output buffer in bytes
+ * 
+ *   chunk - the approximate chunk size in bytes, or zero
+ * 
+ *   fpExec - the executor, or NULL
+ * 
+ *   pCustom - the custom parameter to pass to the executor
+ * 
+ * Return:
+ * 
+ *   the number of bytes in the complete case folded output
+ */
+size_t unikit_fold_utf8_par(
+    const uint8_t        * pSrc,
+          size_t           n,
+          uint8_t        * pDst,
+          size_t           cap,
+          size_t           chunk,
+          unikit_fp_exec   fpExec,
+          void           * pCustom);
+
+/*
+ * Perform case folding on a whole buffer of UTF-16 text.
+ * 
+ * This is the same as unikit_fold_utf8(), except that the input and
+ * the output are UTF-16 code units in the native byte order of the
+ * platform, which is the form of the strings of the Java Native
+ * Interface and of the Windows API.  n is the number of input units
+ * and cap is the capacity of pDst in units.
+ * 
+ * A surrogate that is not part of a high and low surrogate pair is
+ * ill-formed and is replaced with U+FFFD.  Runs of units without any
+ * surrogates are found four units at a time, and each unit of such a
+ * run is looked up as a codepoint directly, without decoding.  Runs of
+ * ASCII within them are case folded four units at a time without
+ * consulting the case folding tables.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-16 input
+ * 
+ *   n - the number of input units
+ * 
+ *   pDst - the output buffer, or NULL
+ * 
+ *   cap - the capacity of the output buffer in units
+ * 
+ * Return:
+ * 
+ *   the number of units in the complete case folded output
+ */
+size_t unikit_fold_utf16(
+    const uint16_t * pSrc,
+          size_t     n,
+          uint16_t * pDst,
+          size_t     cap);
+
+/*
+ * Perform case folding on a whole buffer of UTF-32 text.
+ * 
+ * This is the same as unikit_fold_utf8(), except that the input and
+ * the output are UTF-32 code units, each of which holds one codepoint.
+ * n is the number of input units and cap is the capacity of pDst in
+ * units.
+ * 
+ * Every unit that does not pass unikit_valid(), including surrogates,
+ * negative values, and values above U+10FFFF, is ill-formed and is
+ * replaced with U+FFFD.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-32 input
+ * 
+ *   n - the number of input units
+ * 
+ *   pDst - the output buffer, or NULL
+ * 
+ *   cap - the capacity of the output buffer in units
+ * 
+ * Return:
+ * 
+ *   the number of units in the complete case folded output
+ */
+size_t unikit_fold_utf32(
+    const int32_t * pSrc,
+          size_t    n,
+          int32_t * pDst,
+          size_t    cap);
+
 /*
  * Given any integer value, return the Unicode General Category of the
  * corresponding codepoint.
@@ -240,4 +880,698 @@ int unikit_fold(UNIKIT_FOLD *pf, int32_t cv);
  */
 uint16_t unikit_category(int32_t cv);
 
+/*
+ * Given any integer value, return the general category, case folding
+ * flags and character class flags of the corresponding codepoint in a
+ * single record.
+ * 
+ * This answers the questions a tokenizer usually asks about each
+ * codepoint with one table lookup.  UNIKIT_PROP_GCAT() of the record is
+ * always the same as unikit_category().  The UNIKIT_PROP flags are set
+ * as follows:
+ * 
+ *   UNIKIT_PROP_FOLD if the full case folding of the codepoint is not
+ *   the codepoint itself
+ * 
+ *   UNIKIT_PROP_EXPAND if the full case folding is more than one
+ *   codepoint, which implies UNIKIT_PROP_FOLD
+ * 
+ *   UNIKIT_PROP_LETTER, UNIKIT_PROP_CASED and UNIKIT_PROP_NUMBER if the
+ *   codepoint is in the UNIKIT_CLASS_L, UNIKIT_CLASS_LC and
+ *   UNIKIT_CLASS_N standard classes, respectively
+ * 
+ *   UNIKIT_PROP_DIGIT if the category is Nd
+ * 
+ *   UNIKIT_PROP_SPACE if the codepoint has the White_Space property
+ * 
+ * This function works on all possible integer values, including
+ * negative values.  Out-of-range integer values will return
+ * UNIKIT_GCAT_Cn without any flags.
+ * 
+ * Parameters:
+ * 
+ *   cv - the integer codepoint value
+ * 
+ * Return:
+ * 
+ *   the combined property record
+ */
+uint32_t unikit_props(int32_t cv);
+
+/*
+ * Determine the Unicode General Category of every value in a buffer.
+ * 
+ * pCps points to n integer values, and pOut points to an output array
+ * of n elements that receives the category of each value, exactly as
+ * unikit_category() would return it.  As with that function, values do
+ * not need to pass unikit_valid().  The pointers may only be NULL if n
+ * is zero.
+ * 
+ * This is faster than calling unikit_category() in a loop, especially
+ * for text that is mostly in range U+0000 to U+00FF, since such runs
+ * are resolved directly from the core table.
+ * 
+ * Parameters:
+ * 
+ *   pCps - the integer codepoint values
+ * 
+ *   pOut - the array that receives the categories
+ * 
+ *   n - the number of values
+ */
+void unikit_category_buf(
+    const int32_t  * pCps,
+          uint16_t * pOut,
+          size_t     n);
+
+/*
+ * Determine the Unicode General Category of every codepoint in a buffer
+ * of UTF-8 text.
+ * 
+ * pSrc points to n bytes of UTF-8 input.  pSrc may only be NULL if n is
+ * zero.  One category is written to pOut for each decoded codepoint, in
+ * the same order as the codepoints.  pOut has room for cap categories,
+ * and may only be NULL if cap is zero.
+ * 
+ * Each ill-formed UTF-8 sequence in the input counts as a single U+FFFD
+ * codepoint, using the maximal subpart practice recommended by the
+ * Unicode Standard.  This matches the behavior of unikit_fold_utf8().
+ * 
+ * The return value is always the total number of codepoints in the
+ * input.  If it is less than or equal to cap, all the categories were
+ * written to pOut.  Otherwise, the contents of pOut are undefined, and
+ * the call should be repeated with a larger output array.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-8 input
+ * 
+ *   n - the number of input bytes
+ * 
+ *   pOut - the array that receives the categories, or NULL
+ * 
+ *   cap - the number of elements in the output array
+ * 
+ * Return:
+ * 
+ *   the number of codepoints in the input
+ */
+size_t unikit_category_utf8(
+    const uint8_t  * pSrc,
+          size_t     n,
+          uint16_t * pOut,
+          size_t     cap);
+
+/*
+ * Determine the Unicode General Category of every codepoint in a buffer
+ * of UTF-8 text, split into chunks that are processed in parallel.
+ * 
+ * The parameters pSrc, n, pOut, and cap and the return value are the
+ * same as for unikit_category_utf8(), and the output is always
+ * identical to the output of that function.  The parameters chunk,
+ * fpExec, and pCustom select the chunk size and the executor in the
+ * same way as for unikit_fold_utf8_par().
+ * 
+ * The work is done in two parallel passes, as with
+ * unikit_fold_utf8_par().  The first pass only counts the codepoints of
+ * each chunk, which is much cheaper than classifying them.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-8 input
+ * 
+ *   n - the number of input bytes
+ * 
+ *   pOut - the array that receives the categories, or NULL
+ * 
+ *   cap - the number of elements in the output array
+ * 
+ *   chunk - the approximate chunk size in bytes, or zero
+ * 
+ *   fpExec - the executor, or NULL
+ * 
+ *   pCustom - the custom parameter to pass to the executor
+ * 
+ * Return:
+ * 
+ *   the number of codepoints in the input
+ */
+size_t unikit_category_utf8_par(
+    const uint8_t        * pSrc,
+          size_t           n,
+          uint16_t       * pOut,
+          size_t           cap,
+          size_t           chunk,
+          unikit_fp_exec   fpExec,
+          void           * pCustom);
+
+/*
+ * Determine the Unicode General Category of every codepoint in a buffer
+ * of UTF-16 text.
+ * 
+ * This is the same as unikit_category_utf8(), except that the input is
+ * UTF-16 code units in the native byte order of the platform, and n is
+ * the number of input units.  A surrogate that is not part of a high
+ * and low surrogate pair is treated as U+FFFD.
+ * 
+ * Runs of units without any surrogates are found four units at a time,
+ * and each unit of such a run is looked up as a codepoint directly,
+ * without decoding.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-16 input
+ * 
+ *   n - the number of input units
+ * 
+ *   pOut - the array that receives the categories, or NULL
+ * 
+ *   cap - the number of elements in the output array
+ * 
+ * Return:
+ * 
+ *   the number of codepoints in the input
+ */
+size_t unikit_category_utf16(
+    const uint16_t * pSrc,
+          size_t     n,
+          uint16_t * pOut,
+          size_t     cap);
+
+/*
+ * Determine the Unicode General Category of every codepoint in a buffer
+ * of UTF-32 text.
+ * 
+ * This is the same as unikit_category_utf8(), except that the input is
+ * UTF-32 code units, and n is the number of input units.  Every unit
+ * that does not pass unikit_valid() is treated as U+FFFD, so the result
+ * differs from unikit_category_buf() for those units, and the return
+ * value is always n.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-32 input
+ * 
+ *   n - the number of input units
+ * 
+ *   pOut - the array that receives the categories, or NULL
+ * 
+ *   cap - the number of elements in the output array
+ * 
+ * Return:
+ * 
+ *   the number of codepoints in the input
+ */
+size_t unikit_category_utf32(
+    const int32_t  * pSrc,
+          size_t     n,
+          uint16_t * pOut,
+          size_t     cap);
+
+/*
+ * Enumerate the whole codepoint range as runs of the same general
+ * category.
+ * 
+ * fpRun is called once for each run, in ascending order of codepoint.
+ * The runs cover U+0000 to U+10FFFF without gaps, including the
+ * surrogates, and agree with unikit_category() for every codepoint.
+ * Each run is maximal, so two consecutive runs never have the same
+ * general category.  pCustom is passed through to each callback.
+ * 
+ * The runs are read from the ranges already encoded in the data
+ * tables, so enumerating the whole range takes time proportional to
+ * the size of the tables rather than to the number of codepoints.
+ * 
+ * The module must be initialized.  The callback may call any other
+ * Unikit function.
+ * 
+ * Parameters:
+ * 
+ *   fpRun - the callback that receives the runs
+ * 
+ *   pCustom - the custom parameter to pass to the callback
+ * 
+ * Return:
+ * 
+ *   non-zero if every run was delivered, zero if the callback stopped
+ *   the walk
+ */
+int unikit_category_runs(unikit_fp_run fpRun, void *pCustom);
+
+/*
+ * Compile a character class from a list of general categories.
+ * 
+ * pCats points to n category codes, where n is at least one.  Each code
+ * is either one of the UNIKIT_GCAT constants, which selects that
+ * general category, or one of the UNIKIT_CTGR group constants other
+ * than UNIKIT_CTGR_MASK, which selects every general category in the
+ * group.  The class holds every codepoint in U+0000 to U+10FFFF whose
+ * general category is selected by any of the codes.
+ * 
+ * The compiled class is a bitset in which blocks of 512 codepoints that
+ * have identical bits are stored only once, so most classes take a few
+ * kilobytes.  Testing a codepoint with unikit_class_test() takes two
+ * memory loads and a bit test.
+ * 
+ * The module must be initialized.  The returned class is dynamically
+ * allocated and independent of the module state, so it remains valid
+ * after unikit_shutdown().  Release it with unikit_class_free().
+ * 
+ * Parameters:
+ * 
+ *   pCats - the category codes
+ * 
+ *   n - the number of category codes
+ * 
+ * Return:
+ * 
+ *   the compiled character class
+ */
+UNIKIT_CLASS *unikit_class_compile(const uint16_t *pCats, size_t n);
+
+/*
+ * Release a character class compiled with unikit_class_compile().
+ * 
+ * If pc is NULL, this function does nothing.  It is an error to pass
+ * one of the classes returned by unikit_class_std().
+ * 
+ * Parameters:
+ * 
+ *   pc - the character class to release, or NULL
+ */
+void unikit_class_free(UNIKIT_CLASS *pc);
+
+/*
+ * Get one of the standard character classes.
+ * 
+ * cls is one of the UNIKIT_CLASS constants.  The standard classes are
+ * precompiled into the data tables, so this function does not compile
+ * anything.
+ * 
+ * The module must be initialized.  The returned class is owned by the
+ * module and remains valid until the module is shut down.  It must not
+ * be passed to unikit_class_free().
+ * 
+ * Parameters:
+ * 
+ *   cls - the standard class to get
+ * 
+ * Return:
+ * 
+ *   the standard character class
+ */
+const UNIKIT_CLASS *unikit_class_std(int cls);
+
+/*
+ * Test whether a character class contains a given integer value.
+ * 
+ * pc is the character class, which must remain valid during the call.
+ * cv may be any integer value.  Values that are not in range U+0000 to
+ * U+10FFFF are never in a class.
+ * 
+ * Parameters:
+ * 
+ *   pc - the character class
+ * 
+ *   cv - the integer value to test
+ * 
+ * Return:
+ * 
+ *   non-zero if cv is in the class, zero if not
+ */
+int unikit_class_test(const UNIKIT_CLASS *pc, int32_t cv);
+
+/*
+ * Initialize the state of a streaming decoder.
+ * 
+ * A streaming decoder decodes text that arrives in arbitrary chunks,
+ * such as reads from a socket, without first collecting it into a
+ * single buffer.  A sequence that is split across a chunk boundary is
+ * held in the decoder state until the rest of it arrives in the next
+ * chunk.  Apart from such split sequences, input is processed directly
+ * from each chunk without copying.
+ * 
+ * enc is the input encoding, which must be one of the UNIKIT_ENC
+ * constants.  Each ill-formed sequence in the input is decoded as a
+ * single U+FFFD codepoint, using the maximal subpart practice
+ * recommended by the Unicode Standard.  For UTF-8, this matches the
+ * behavior of unikit_fold_utf8() and unikit_category_utf8(), however
+ * the input is split into chunks.  For UTF-16, an unpaired surrogate
+ * or a trailing odd byte is decoded as U+FFFD.
+ * 
+ * This function does not require the module to be initialized.
+ * 
+ * Parameters:
+ * 
+ *   pd - the decoder state to initialize
+ * 
+ *   enc - the input encoding
+ */
+void unikit_decoder_init(UNIKIT_DECODER *pd, int enc);
+
+/*
+ * Decode a chunk of input to codepoints with a streaming decoder.
+ * 
+ * pd is the decoder state, which must have been initialized with
+ * unikit_decoder_init().  pSrc points to n bytes of input.  pSrc may
+ * only be NULL if n is zero.  Decoded codepoints are written to pOut,
+ * which has room for cap codepoints and may only be NULL if cap is
+ * zero.
+ * 
+ * Decoding stops when the input is exhausted or when the next
+ * codepoint does not fit in the output array.  If pUsed is not NULL,
+ * it receives the number of input bytes consumed, which includes the
+ * bytes of any incomplete sequence at the end of the chunk that were
+ * moved into the decoder state.  Bytes that were not consumed should be
+ * passed again at the start of the next call.  A cap of at least n + 1
+ * always consumes the whole chunk.
+ * 
+ * This function does not require the module to be initialized.
+ * 
+ * Parameters:
+ * 
+ *   pd - the decoder state
+ * 
+ *   pSrc - the input chunk
+ * 
+ *   n - the number of bytes in the chunk
+ * 
+ *   pOut - the array that receives the codepoints, or NULL
+ * 
+ *   cap - the number of elements in the output array
+ * 
+ *   pUsed - variable that receives the bytes consumed, or NULL
+ * 
+ * Return:
+ * 
+ *   the number of codepoints written to pOut
+ */
+size_t unikit_decode(
+          UNIKIT_DECODER * pd,
+    const uint8_t        * pSrc,
+          size_t           n,
+          int32_t        * pOut,
+          size_t           cap,
+          size_t         * pUsed);
+
+/*
+ * Decode a chunk of input directly to general categories with a
+ * streaming decoder.
+ * 
+ * This is the same as unikit_decode(), except that the general
+ * category of each decoded codepoint is written to pOut in place of
+ * the codepoint, as if by unikit_category().  The module must be
+ * initialized.
+ * 
+ * Parameters:
+ * 
+ *   pd - the decoder state
+ * 
+ *   pSrc - the input chunk
+ * 
+ *   n - the number of bytes in the chunk
+ * 
+ *   pOut - the array that receives the categories, or NULL
+ * 
+ *   cap - the number of elements in the output array
+ * 
+ *   pUsed - variable that receives the bytes consumed, or NULL
+ * 
+ * Return:
+ * 
+ *   the number of categories written to pOut
+ */
+size_t unikit_decode_category(
+          UNIKIT_DECODER * pd,
+    const uint8_t        * pSrc,
+          size_t           n,
+          uint16_t       * pOut,
+          size_t           cap,
+          size_t         * pUsed);
+
+/*
+ * Decode a chunk of input directly to case folded UTF-8 with a
+ * streaming decoder.
+ * 
+ * This is the same as unikit_decode(), except that each decoded
+ * codepoint is case folded as if by unikit_fold(), and the folded text
+ * is written to pDst in UTF-8.  pDst has room for cap bytes and may
+ * only be NULL if cap is zero.  Decoding stops before any codepoint
+ * whose folded encoding does not fit in the remaining space.  A cap of
+ * at least 3 * (n + 3) always consumes the whole chunk.  The module
+ * must be initialized.
+ * 
+ * Parameters:
+ * 
+ *   pd - the decoder state
+ * 
+ *   pSrc - the input chunk
+ * 
+ *   n - the number of bytes in the chunk
+ * 
+ *   pDst - the buffer that receives the folded UTF-8, or NULL
+ * 
+ *   cap - the number of bytes in the output buffer
+ * 
+ *   pUsed - variable that receives the bytes consumed, or NULL
+ * 
+ * Return:
+ * 
+ *   the number of bytes written to pDst
+ */
+size_t unikit_decode_fold(
+          UNIKIT_DECODER * pd,
+    const uint8_t        * pSrc,
+          size_t           n,
+          uint8_t        * pDst,
+          size_t           cap,
+          size_t         * pUsed);
+
+/*
+ * Finish decoding with a streaming decoder.
+ * 
+ * Call this function after the last chunk of input.  If the input ended
+ * in the middle of a sequence, the return value is the number of U+FFFD
+ * codepoints that the incomplete sequence decodes to, which the caller
+ * should append to its output.  Otherwise, the return value is zero.
+ * The decoder state is then reset, so that it may be used for another
+ * stream with the same encoding.
+ * 
+ * This function does not require the module to be initialized.
+ * 
+ * Parameters:
+ * 
+ *   pd - the decoder state
+ * 
+ * Return:
+ * 
+ *   the number of U+FFFD codepoints at the end of the input, in range
+ *   zero to two
+ */
+int unikit_decode_end(UNIKIT_DECODER *pd);
+
+/*
+ * Compare two buffers of UTF-8 text without regard to case.
+ * 
+ * pA points to alen bytes of UTF-8 input and pB points to blen bytes of
+ * UTF-8 input.  Each pointer may only be NULL if its length is zero.
+ * 
+ * The two inputs are case folded as if by unikit_fold_utf8() and the
+ * folded codepoint sequences are compared, so that the result is the
+ * same as comparing the folded UTF-8 of both inputs byte by byte.
+ * Folding happens lazily on both sides in lockstep, so nothing is
+ * allocated and the comparison stops at the first difference.  A
+ * codepoint with a multi-codepoint folding compares equal to the same
+ * sequence of codepoints on the other side, such as U+00DF LATIN SMALL
+ * LETTER SHARP S against "ss".
+ * 
+ * The module must be initialized.
+ * 
+ * Parameters:
+ * 
+ *   pA - the first UTF-8 input
+ * 
+ *   alen - the number of bytes in the first input
+ * 
+ *   pB - the second UTF-8 input
+ * 
+ *   blen - the number of bytes in the second input
+ * 
+ * Return:
+ * 
+ *   less than zero if the first input sorts first, zero if the inputs
+ *   are equal without regard to case, or greater than zero if the
+ *   second input sorts first
+ */
+int unikit_casecmp_utf8(
+    const uint8_t * pA,
+          size_t    alen,
+    const uint8_t * pB,
+          size_t    blen);
+
+/*
+ * Compute a hash of UTF-8 text without regard to case.
+ * 
+ * pSrc points to n bytes of UTF-8 input.  pSrc may only be NULL if n is
+ * zero.  Inputs that are equal according to unikit_casecmp_utf8()
+ * always have the same hash for the same seed, so this function is
+ * suitable for case-insensitive hash tables.
+ * 
+ * The hash is the 64-bit FNV-1a hash of the UTF-8 output that
+ * unikit_fold_utf8() would produce for the input, except that the
+ * offset basis is combined with seed by exclusive or.  The folded text
+ * is hashed as it is folded, without any allocation.
+ * 
+ * The module must be initialized.
+ * 
+ * Parameters:
+ * 
+ *   pSrc - the UTF-8 input
+ * 
+ *   n - the number of input bytes
+ * 
+ *   seed - the hash seed
+ * 
+ * Return:
+ * 
+ *   the hash value
+ */
+uint64_t unikit_casehash_utf8(
+    const uint8_t * pSrc,
+          size_t    n,
+          uint64_t  seed);
+
+/*
+ * Compile a case-insensitive search for a needle of UTF-8 text.
+ * 
+ * pNeedle points to m bytes of UTF-8 input, and may only be NULL if m
+ * is zero.  The needle is case folded as if by unikit_fold_utf8() and
+ * the folded codepoints are stored in the search, along with a filter
+ * that unikit_casefind_utf8() uses to skip quickly over text that can
+ * not contain a match.  Building the filter takes a walk over the case
+ * folding tables, so a needle that is searched for repeatedly should be
+ * compiled only once.
+ * 
+ * The module must be initialized.  The returned search is dynamically
+ * allocated and independent of the module state, but searching with it
+ * requires an initialized module.  Release it with
+ * unikit_casefind_free().
+ * 
+ * Parameters:
+ * 
+ *   pNeedle - the UTF-8 needle
+ * 
+ *   m - the number of bytes in the needle
+ * 
+ * Return:
+ * 
+ *   the compiled search
+ */
+UNIKIT_CASEFIND *unikit_casefind_compile(
+    const uint8_t * pNeedle,
+          size_t    m);
+
+/*
+ * Release a search compiled with unikit_casefind_compile().
+ * 
+ * If pf is NULL, this function does nothing.
+ * 
+ * Parameters:
+ * 
+ *   pf - the search to release, or NULL
+ */
+void unikit_casefind_free(UNIKIT_CASEFIND *pf);
+
+/*
+ * Find the first match of a compiled case-insensitive search in UTF-8
+ * text.
+ * 
+ * pf is the compiled search.  pSrc points to n bytes of UTF-8 input,
+ * the haystack, and may only be NULL if n is zero.
+ * 
+ * A match is a range of whole codepoints of the haystack whose case
+ * folding is the same as the folded needle, so that the result is the
+ * same as searching the unikit_fold_utf8() output of the haystack for
+ * the folded needle, except that a match may not begin or end within
+ * the folding of a single codepoint.  For example, a needle of "ss"
+ * matches U+00DF LATIN SMALL LETTER SHARP S, and a needle of that
+ * letter matches "SS", but a needle of "s" does not match it.
+ * Ill-formed sequences match U+FFFD in the same way as they are folded
+ * by unikit_fold_utf8().
+ * 
+ * The haystack is never copied.  Each word of eight ASCII bytes is
+ * checked at once against the first codepoints of the needle, other
+ * bytes are checked against a table of the lead bytes that can begin a
+ * match, and only the candidates that pass the filter are folded and
+ * compared lazily.  An empty needle matches at offset zero.
+ * 
+ * To find further matches, search the rest of the haystack again from
+ * the end of each match.
+ * 
+ * The module must be initialized.
+ * 
+ * Parameters:
+ * 
+ *   pf - the compiled search
+ * 
+ *   pSrc - the UTF-8 haystack
+ * 
+ *   n - the number of bytes in the haystack
+ * 
+ *   pOff - variable to receive the byte offset of the first match, or
+ *   NULL
+ * 
+ *   pLen - variable to receive the byte length of the first match, or
+ *   NULL
+ * 
+ * Return:
+ * 
+ *   non-zero if a match was found, zero if not
+ */
+int unikit_casefind_utf8(
+    const UNIKIT_CASEFIND * pf,
+    const uint8_t         * pSrc,
+          size_t            n,
+          size_t          * pOff,
+          size_t          * pLen);
+
+/*
+ * Get the lookup counters of the calling thread.
+ * 
+ * The counters are only kept if unikit.c was compiled with the
+ * UNIKIT_INSTRUMENT build mode.  Otherwise, ps is filled with zeros and
+ * the return value is zero.
+ * 
+ * Each thread has its own counters, which count the lookups that the
+ * thread has made since it started or since it last called
+ * unikit_stats_reset().  If the compiler does not support thread-local
+ * storage, all threads share one set of counters, which are then only
+ * accurate for single-threaded programs.
+ * 
+ * The module does not need to be initialized.
+ * 
+ * Parameters:
+ * 
+ *   ps - the structure to fill with the counters
+ * 
+ * Return:
+ * 
+ *   non-zero if the counters are available, zero if unikit.c was not
+ *   compiled with the UNIKIT_INSTRUMENT build mode
+ */
+int unikit_stats_get(UNIKIT_STATS *ps);
+
+/*
+ * Reset all the lookup counters of the calling thread to zero.
+ * 
+ * This has no effect unless unikit.c was compiled with the
+ * UNIKIT_INSTRUMENT build mode.  The module does not need to be
+ * initialized.
+ */
+void unikit_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
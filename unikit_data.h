@@ -15,6 +15,13 @@
  * directory.  See the documentation of that script for further
  * information about the data format stored here.
  * 
+ * If UNIKIT_STATIC_TABLES is defined, this module instead stores the
+ * tables as constant arrays of unsigned 16-bit integers, generated with
+ * the "array" style of the unikit_db.pl script.  Those arrays are
+ * placed in read-only memory and used in place by the main Unikit
+ * module, so no decoding or allocation is needed at startup.  The same
+ * definition must be used when compiling unikit.c and unikit_data.c.
+ * 
  * Requirements
  * ------------
  * 
@@ -22,6 +29,7 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
 
 /*
  * The data keys that can be fetched.
@@ -35,16 +43,80 @@
  * information.  CORE is the core character table.  GENCHAR is the
  * general character table.  BITMAP is the bitmap character table.
  * ASTRAL is the astral character table.
+ * 
+ * The STAGE constants are the same case folding indices and general
+ * character tables compiled as two-stage tables instead of tries.  They
+ * are used in the UNIKIT_STAGE_TABLES build mode of the main module.
+ * 
+ * The CASE_DELTA constants are the case folding delta tables, which
+ * are two-stage tables mapping each codepoint in the lower and upper
+ * plane to the delta of its single-codepoint case folding.
+ * 
+ * GCAT_UNIFIED is the unified category table, a two-stage table of
+ * packed category indices covering U+0000 to U+1FFFF.  It replaces
+ * the BITMAP and GENCHAR tables in the UNIKIT_UNIFIED_GCAT build mode
+ * of the main module.
+ * 
+ * GCAT_ASTRAL_DIR is the astral directory table, which indexes the
+ * records of the ASTRAL table by plane and 4096-codepoint bucket.
+ * 
+ * The CLASS constants are the character class tables, which are
+ * two-stage bitsets over every codepoint for the L, N, Z and LC
+ * category groups.
+ * 
+ * PROPS is the property table, a two-stage table of the packed general
+ * category, case folding flags and character class flags of each
+ * codepoint.
  */
 #define UNIKIT_DATA_KEY_CASE_LOWER    (100)
 #define UNIKIT_DATA_KEY_CASE_UPPER    (101)
 #define UNIKIT_DATA_KEY_CASE_DATA     (102)
+#define UNIKIT_DATA_KEY_CASE_LOWER_STAGE    (103)
+#define UNIKIT_DATA_KEY_CASE_UPPER_STAGE    (104)
+#define UNIKIT_DATA_KEY_CASE_DELTA_LOWER    (105)
+#define UNIKIT_DATA_KEY_CASE_DELTA_UPPER    (106)
 
 #define UNIKIT_DATA_KEY_GCAT_CORE     (200)
 #define UNIKIT_DATA_KEY_GCAT_GEN_LOW  (201)
 #define UNIKIT_DATA_KEY_GCAT_GEN_HIGH (202) 
 #define UNIKIT_DATA_KEY_GCAT_BITMAP   (203)
 #define UNIKIT_DATA_KEY_GCAT_ASTRAL   (204)
+#define UNIKIT_DATA_KEY_GCAT_GEN_LOW_STAGE  (205)
+#define UNIKIT_DATA_KEY_GCAT_GEN_HIGH_STAGE (206)
+#define UNIKIT_DATA_KEY_GCAT_UNIFIED  (207)
+#define UNIKIT_DATA_KEY_GCAT_ASTRAL_DIR (208)
+
+#define UNIKIT_DATA_KEY_CLASS_L       (300)
+#define UNIKIT_DATA_KEY_CLASS_N       (301)
+#define UNIKIT_DATA_KEY_CLASS_Z       (302)
+#define UNIKIT_DATA_KEY_CLASS_LC      (303)
+
+#define UNIKIT_DATA_KEY_PROPS         (600)
+
+#ifdef UNIKIT_STATIC_TABLES
+
+/*
+ * Fetch a constant data array for a given data key.
+ * 
+ * The key must be one of the UNIKIT_DATA_KEY constants defined above.
+ * NULL is returned if the key is not recognized.
+ * 
+ * If pLen is not NULL, it receives the length of the returned array in
+ * integers (not bytes), or zero if the key is not recognized.
+ * 
+ * Parameters:
+ * 
+ *   key - the data key to fetch
+ * 
+ *   pLen - variable to receive the array length, or NULL
+ * 
+ * Return:
+ * 
+ *   the constant data array, or NULL if key not recognized
+ */
+const uint16_t *unikit_data_table(int key, int32_t *pLen);
+
+#else
 
 /*
  * Fetch a base-64 string for a given data key.
@@ -64,3 +136,5 @@
 const char *unikit_data_fetch(int key);
 
 #endif
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef UNIKIT_INLINE_H_INCLUDED
+#define UNIKIT_INLINE_H_INCLUDED
+
+/*
+ * unikit_inline.h
+ * ===============
+ * 
+ * Inline lookups for the core range of the Unikit library.
+ * 
+ * This header is generated by the inline mode of the unikit_db.pl
+ * script.  Do not edit it by hand, but regenerate it along with the
+ * unikit_data.c tables.
+ * 
+ * The functions of this header answer queries on codepoints in range
+ * U+0000 to U+00FF from a constant table held in the header itself, and
+ * pass every other codepoint on to the matching function of unikit.h.
+ * The core path is a static inline function reading a constant array,
+ * so compilers can inline it into the loops of the caller, and fold it
+ * away entirely when the codepoint is a constant.  When the header is
+ * compiled as C++11 or later, the table and functions are constexpr,
+ * so queries on constant codepoints in the core range may be used in
+ * constant expressions such as static_assert.
+ * 
+ * The results are the same as those of the unikit.h functions.  The
+ * core path does not require the module to be initialized, but the
+ * other codepoints are subject to the requirements of the matching
+ * unikit.h function.
+ * 
+ * Requirements
+ * ------------
+ * 
+ * Requires the unikit library, which consists of the unikit.c and
+ * unikit_data.c modules, for codepoints outside the core range.
+ */
+
+#include "unikit.h"
+
+/*
+ * Storage of the table and functions of this header: constexpr in
+ * C++11 and later, or static and inline in C.
+ */
+#if defined(__cplusplus) && (__cplusplus >= 201103L)
+#define UNIKIT_INLINE_DATA static constexpr
+#define UNIKIT_INLINE static constexpr
+#else
+#define UNIKIT_INLINE_DATA static const
+#define UNIKIT_INLINE static inline
+#endif
+
+/*
+ * The general categories of U+0000 to U+00FF, in the format of the
+ * UNIKIT_GCAT constants.
+ */
+UNIKIT_INLINE_DATA uint16_t unikit_inline_core[256] = {
+  0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363,
+  0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363,
+  0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363,
+  0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363,
+  0x5a73, 0x506f, 0x506f, 0x506f, 0x5363, 0x506f, 0x506f, 0x506f,
+  0x5073, 0x5065, 0x506f, 0x536d, 0x506f, 0x5064, 0x506f, 0x506f,
+  0x4e64, 0x4e64, 0x4e64, 0x4e64, 0x4e64, 0x4e64, 0x4e64, 0x4e64,
+  0x4e64, 0x4e64, 0x506f, 0x506f, 0x536d, 0x536d, 0x536d, 0x506f,
+  0x506f, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75,
+  0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75,
+  0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75,
+  0x4c75, 0x4c75, 0x4c75, 0x5073, 0x506f, 0x5065, 0x536b, 0x5063,
+  0x536b, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c,
+  0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c,
+  0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c,
+  0x4c6c, 0x4c6c, 0x4c6c, 0x5073, 0x536d, 0x5065, 0x536d, 0x4363,
+  0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363,
+  0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363,
+  0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363,
+  0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363, 0x4363,
+  0x5a73, 0x506f, 0x5363, 0x5363, 0x5363, 0x5363, 0x536f, 0x506f,
+  0x536b, 0x536f, 0x4c6f, 0x5069, 0x536d, 0x4366, 0x536f, 0x536b,
+  0x536f, 0x536d, 0x4e6f, 0x4e6f, 0x536b, 0x4c6c, 0x506f, 0x506f,
+  0x536b, 0x4e6f, 0x4c6f, 0x5066, 0x4e6f, 0x4e6f, 0x4e6f, 0x506f,
+  0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75,
+  0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75,
+  0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x536d,
+  0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c75, 0x4c6c,
+  0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c,
+  0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c,
+  0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x536d,
+  0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c, 0x4c6c
+};
+
+/*
+ * Inline version of unikit_valid().
+ * 
+ * Parameters:
+ * 
+ *   cv - the integer value to check
+ * 
+ * Return:
+ * 
+ *   non-zero if valid codepoint, zero if not
+ */
+UNIKIT_INLINE int unikit_valid_inline(int32_t cv) {
+  return ((cv >= 0) && (cv <= 0x10ffff) &&
+          ((cv < 0xd800) || (cv > 0xdfff))) ? 1 : 0;
+}
+
+/*
+ * Inline version of unikit_category().
+ * 
+ * Parameters:
+ * 
+ *   cv - the integer value to query
+ * 
+ * Return:
+ * 
+ *   the general category
+ */
+UNIKIT_INLINE uint16_t unikit_category_inline(int32_t cv) {
+  return ((cv >= 0) && (cv <= 0xff)) ?
+            unikit_inline_core[cv] : unikit_category(cv);
+}
+
+/*
+ * Inline version of testing a standard character class.
+ * 
+ * cls is one of the UNIKIT_CLASS constants.  The result is the same as
+ * calling unikit_class_test() on the class returned by
+ * unikit_class_std(), which is only done for codepoints outside the
+ * core range.
+ * 
+ * Parameters:
+ * 
+ *   cls - the standard character class
+ * 
+ *   cv - the integer value to test
+ * 
+ * Return:
+ * 
+ *   non-zero if the codepoint is in the class, zero if not
+ */
+UNIKIT_INLINE int unikit_class_test_inline(int cls, int32_t cv) {
+  return ((cv >= 0) && (cv <= 0xff)) ?
+    ((cls == UNIKIT_CLASS_L) ?
+        (((unikit_inline_core[cv] >> 8) == 'L') ? 1 : 0) :
+      (cls == UNIKIT_CLASS_N) ?
+        (((unikit_inline_core[cv] >> 8) == 'N') ? 1 : 0) :
+      (cls == UNIKIT_CLASS_Z) ?
+        (((unikit_inline_core[cv] >> 8) == 'Z') ? 1 : 0) :
+        (((unikit_inline_core[cv] == UNIKIT_GCAT_Lu) ||
+          (unikit_inline_core[cv] == UNIKIT_GCAT_Ll) ||
+          (unikit_inline_core[cv] == UNIKIT_GCAT_Lt)) ? 1 : 0)) :
+    unikit_class_test(unikit_class_std(cls), cv);
+}
+
+#endif